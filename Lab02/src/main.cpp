@@ -142,6 +142,10 @@ bool isMovingRight_    = false;
 static const glm::vec4 kFirstCameraPos = glm::vec4(3.0F, 2.0F, 3.5F, 1.0F);
 glm::vec4              cameraPos_      = kFirstCameraPos;
 
+// Compara dois números com uma pequena tolerância. Usada para verificar, em
+// tempo de compilação, as matrizes calculadas pelo compilador.
+constexpr bool NearlyEqual(float x, float y) { return (x > y ? x - y : y - x) <= 1e-6F * (1.0F + (y > 0.0F ? y : -y)); }
+
 int main() {
     // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
     // sistema operacional, onde poderemos renderizar com OpenGL.
@@ -369,9 +373,18 @@ int main() {
             } else if (i == 2) {
                 // A segunda cópia do cubo sofrerá um escalamento não-uniforme,
                 // seguido de uma rotação no eixo (1,1,1), e uma translação em Z (nessa ordem!).
-                model = Matrix_Translate(0.0F, 0.0F, -2.0F)                              // TERCEIRO translação
-                        * Matrix_Rotate(M_PI / 8.0F, glm::vec4(1.0F, 1.0F, 1.0F, 0.0F))  // SEGUNDO rotação
-                        * Matrix_Scale(2.0F, 0.5F, 0.5F);                                // PRIMEIRO escala
+                // Como esta transformação não muda entre quadros, ela é
+                // calculada pelo compilador (veja Matrix_Const_Multiply()).
+                constexpr glm::mat4 kTranslation = Matrix_Translate(0.0F, 0.0F, -2.0F);
+                constexpr glm::mat4 kRotation    = Matrix_Const_Rotate(M_PI / 8.0F, glm::vec4(1.0F, 1.0F, 1.0F, 0.0F));
+                constexpr glm::mat4 kScale       = Matrix_Scale(2.0F, 0.5F, 0.5F);
+                constexpr glm::mat4 kSecondCubeModel =
+                    Matrix_Const_Multiply(Matrix_Const_Multiply(kTranslation, kRotation), kScale);
+                static_assert(NearlyEqual(kSecondCubeModel[0][0], 1.89850605F) &&
+                                  NearlyEqual(kSecondCubeModel[0][2], 0.49263179F) &&
+                                  NearlyEqual(kSecondCubeModel[1][1], 0.47462651F),
+                              "Rotação e escala do segundo cubo incorretas");
+                model = kSecondCubeModel;
             } else if (i == 3) {
                 // A terceira cópia do cubo sofrerá rotações em X,Y e Z (nessa
                 // ordem) seguindo o sistema de ângulos de Euler, e após uma
@@ -454,7 +467,7 @@ int main() {
         // Agora queremos desenhar os eixos XYZ de coordenadas GLOBAIS.
         // Para tanto, colocamos a matriz de modelagem igual à identidade.
         // Veja slides 2-14 e 184-190 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
-        glm::mat4 model = Matrix_Identity();
+        constexpr glm::mat4 model = Matrix_Identity();
 
         // Enviamos a nova matriz "model" para a placa de vídeo (GPU). Veja o
         // arquivo "shader_vertex.glsl".
@@ -1200,9 +1213,7 @@ void TextRendering_ShowModelViewProjection(GLFWwindow* window, glm::mat4 project
     glm::vec2 p = glm::vec2(0, 0);
     glm::vec2 q = glm::vec2(width, height);
 
-    glm::mat4 viewport_mapping = Matrix((q.x - p.x) / (b.x - a.x), 0.0F, 0.0F, (b.x * p.x - a.x * q.x) / (b.x - a.x),
-                                        0.0F, (q.y - p.y) / (b.y - a.y), 0.0F, (b.y * p.y - a.y * q.y) / (b.y - a.y),
-                                        0.0F, 0.0F, 1.0F, 0.0F, 0.0F, 0.0F, 0.0F, 1.0F);
+    glm::mat4 viewport_mapping = Matrix_Viewport(a, b, p, q);
 
     TextRendering_PrintString(window, "                                                       |  ", -1.0F,
                               1.0F - 22 * pad, 1.0F);
@@ -5,6 +5,7 @@
 #include <cstdlib>
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -27,7 +28,11 @@
 //
 // Para conseguirmos definir matrizes através de suas LINHAS, a função Matrix()
 // computa a transposta usando os elementos passados por parâmetros.
-glm::mat4 Matrix(float m00, float m01, float m02, float m03,  // LINHA 1
+//
+// Matrix() e as funções abaixo que só dependem dela são constexpr: quando os
+// parâmetros são conhecidos em tempo de compilação, a matriz é calculada pelo
+// compilador e armazenada como dado no executável.
+constexpr glm::mat4 Matrix(float m00, float m01, float m02, float m03,  // LINHA 1
                  float m10, float m11, float m12, float m13,  // LINHA 2
                  float m20, float m21, float m22, float m23,  // LINHA 3
                  float m30, float m31, float m32, float m33   // LINHA 4
@@ -41,7 +46,7 @@ glm::mat4 Matrix(float m00, float m01, float m02, float m03,  // LINHA 1
 }
 
 // Matriz identidade.
-glm::mat4 Matrix_Identity() {
+constexpr glm::mat4 Matrix_Identity() {
     return Matrix(1.0f, 0.0f, 0.0f, 0.0f,  // LINHA 1
                   0.0f, 1.0f, 0.0f, 0.0f,  // LINHA 2
                   0.0f, 0.0f, 1.0f, 0.0f,  // LINHA 3
@@ -55,7 +60,7 @@ glm::mat4 Matrix_Identity() {
 //
 //     T*p = p+t.
 //
-glm::mat4 Matrix_Translate(float tx, float ty, float tz) {
+constexpr glm::mat4 Matrix_Translate(float tx, float ty, float tz) {
     return Matrix(1.0f, 0.0f, 0.0f, tx,   // LINHA 1
                   0.0f, 1.0f, 0.0f, ty,   // LINHA 2
                   0.0f, 0.0f, 1.0f, tz,   // LINHA 3
@@ -69,7 +74,7 @@ glm::mat4 Matrix_Translate(float tx, float ty, float tz) {
 //
 //     S*p = [sx*px, sy*py, sz*pz, pw].
 //
-glm::mat4 Matrix_Scale(float sx, float sy, float sz) {
+constexpr glm::mat4 Matrix_Scale(float sx, float sy, float sz) {
     return Matrix(sx, 0.0f, 0.0f, 0.0f,   // LINHA 1
                   0.0f, sy, 0.0f, 0.0f,   // LINHA 2
                   0.0f, 0.0f, sz, 0.0f,   // LINHA 3
@@ -145,16 +150,10 @@ float norm(glm::vec4 v) {
 // coordenadas e em torno do eixo definido pelo vetor 'axis'. Esta matriz pode
 // ser definida pela fórmula de Rodrigues. Lembre-se que o vetor que define o
 // eixo de rotação deve ser normalizado!
-glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis) {
-    float c = cos(angle);
-    float s = sin(angle);
-
-    glm::vec4 v = axis / norm(axis);
-
-    float vx = v.x;
-    float vy = v.y;
-    float vz = v.z;
-
+//
+// A fórmula está em Matrix_Rotate_CosSin(), que recebe o cosseno e o seno do
+// ângulo e o eixo já normalizado; ela é compartilhada com Matrix_Const_Rotate().
+constexpr glm::mat4 Matrix_Rotate_CosSin(float c, float s, float vx, float vy, float vz) {
     return Matrix(
         (vx * vx * (1 - c)) + c, (vx * vy * (1 - c)) + (vz * s), (vz * vx * (1 - c)) + (vy * s), 0.0f,  // LINHA 1
         (vx * vy * (1 - c)) + (vz * s), (vy * vy * (1 - c)) + c, (vz * vy * (1 - c)) + (vx * s), 0.0f,  // LINHA 2
@@ -163,6 +162,117 @@ glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis) {
     );
 }
 
+glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis) {
+    glm::vec4 v = axis / norm(axis);
+
+    return Matrix_Rotate_CosSin(cos(angle), sin(angle), v.x, v.y, v.z);
+}
+
+// Seno, cosseno e raiz quadrada avaliáveis em tempo de compilação, já que
+// sin(), cos() e sqrt() da biblioteca padrão não são constexpr. O ângulo é
+// reduzido para [-pi,pi] e a série de Taylor é somada em double, com erro bem
+// menor que a precisão de um float. Em tempo de execução, use as funções da
+// biblioteca padrão, que são mais rápidas.
+constexpr double Const_Reduce_Angle(double angle) {
+    constexpr double kTwoPi = 6.283185307179586476925;
+
+    double    turns = angle / kTwoPi;
+    long long k     = static_cast<long long>(turns < 0.0 ? turns - 0.5 : turns + 0.5);
+    return angle - static_cast<double>(k) * kTwoPi;
+}
+
+constexpr float Const_Sin(float angle) {
+    double x    = Const_Reduce_Angle(angle);
+    double term = x;
+    double sum  = x;
+    for (int n = 1; n <= 12; ++n) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return static_cast<float>(sum);
+}
+
+constexpr float Const_Cos(float angle) {
+    double x    = Const_Reduce_Angle(angle);
+    double term = 1.0;
+    double sum  = 1.0;
+    for (int n = 1; n <= 12; ++n) {
+        term *= -x * x / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return static_cast<float>(sum);
+}
+
+// Método de Newton, partindo de uma estimativa maior que a raiz: a sequência
+// decresce até parar de mudar.
+constexpr float Const_Sqrt(float value) {
+    if (value <= 0.0f) {
+        return 0.0f;
+    }
+
+    double x = value < 1.0f ? 1.0 : value;
+    while (true) {
+        double next = 0.5 * (x + value / x);
+        if (next >= x) {
+            return static_cast<float>(x);
+        }
+        x = next;
+    }
+}
+
+// Versões constexpr das matrizes de rotação, para ângulos conhecidos em tempo
+// de compilação.
+constexpr glm::mat4 Matrix_Const_Rotate_X(float angle) {
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(1.0f, 0.0f, 0.0f, 0.0f,  // LINHA 1
+                  0.0f, c, -s, 0.0f,       // LINHA 2
+                  0.0f, s, c, 0.0f,        // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f   // LINHA 4
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate_Y(float angle) {
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(c, 0.0f, s, 0.0f,        // LINHA 1
+                  0.0f, 1.0f, 0.0f, 0.0f,  // LINHA 2
+                  -s, 0.0f, c, 0.0f,       // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f   // LINHA 4
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate_Z(float angle) {
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(c, -s, 0.0f, 0.0f,       // LINHA 1
+                  s, c, 0.0f, 0.0f,        // LINHA 2
+                  0.0f, 0.0f, 1.0f, 0.0f,  // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f   // LINHA 4
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate(float angle, glm::vec4 axis) {
+    float n = Const_Sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    return Matrix_Rotate_CosSin(Const_Cos(angle), Const_Sin(angle), axis.x / n, axis.y / n, axis.z / n);
+}
+
+// Produto de matrizes C = A*B avaliável em tempo de compilação, para compor
+// transformações constantes. Em tempo de execução, use o operador * da GLM.
+constexpr glm::mat4 Matrix_Const_Multiply(const glm::mat4& a, const glm::mat4& b) {
+    float m[4][4] = {};  // m[i][j] é o elemento da LINHA i e COLUNA j de A*B
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            m[i][j] = a[0][i] * b[j][0] + a[1][i] * b[j][1] + a[2][i] * b[j][2] + a[3][i] * b[j][3];
+        }
+    }
+    return Matrix(m[0][0], m[0][1], m[0][2], m[0][3],  // LINHA 1
+                  m[1][0], m[1][1], m[1][2], m[1][3],  // LINHA 2
+                  m[2][0], m[2][1], m[2][2], m[2][3],  // LINHA 3
+                  m[3][0], m[3][1], m[3][2], m[3][3]   // LINHA 4
+    );
+}
+
 // Produto vetorial entre dois vetores u e v definidos em um sistema de
 // coordenadas ortonormal.
 glm::vec4 crossproduct(glm::vec4 u, glm::vec4 v) {
@@ -299,6 +409,16 @@ glm::mat4 Matrix_Perspective(float field_of_view, float aspect, float n, float f
     return -M * P;
 }
 
+// Matriz de mapeamento do retângulo [a,b] em NDC para o retângulo [p,q] em
+// coordenadas de pixels da janela (viewport).
+constexpr glm::mat4 Matrix_Viewport(glm::vec2 a, glm::vec2 b, glm::vec2 p, glm::vec2 q) {
+    return Matrix((q.x - p.x) / (b.x - a.x), 0.0f, 0.0f, (b.x * p.x - a.x * q.x) / (b.x - a.x),  // LINHA 1
+                  0.0f, (q.y - p.y) / (b.y - a.y), 0.0f, (b.y * p.y - a.y * q.y) / (b.y - a.y),  // LINHA 2
+                  0.0f, 0.0f, 1.0f, 0.0f,                                                        // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f                                                         // LINHA 4
+    );
+}
+
 // Função que imprime uma matriz M no terminal
 void PrintMatrix(glm::mat4 M) {
     printf("\n");
@@ -1,10 +1,13 @@
 #ifndef _MATRICES_H
 #define _MATRICES_H
 
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -27,7 +30,11 @@
 //
 // Para conseguirmos definir matrizes através de suas LINHAS, a função Matrix()
 // computa a transposta usando os elementos passados por parâmetros.
-glm::mat4 Matrix(float m00, float m01, float m02, float m03,  // LINHA 1
+//
+// Matrix() e as funções abaixo que só dependem dela são constexpr: quando os
+// parâmetros são conhecidos em tempo de compilação, a matriz é calculada pelo
+// compilador e armazenada como dado no executável.
+constexpr glm::mat4 Matrix(float m00, float m01, float m02, float m03,  // LINHA 1
                  float m10, float m11, float m12, float m13,  // LINHA 2
                  float m20, float m21, float m22, float m23,  // LINHA 3
                  float m30, float m31, float m32, float m33   // LINHA 4
@@ -40,7 +47,7 @@ glm::mat4 Matrix(float m00, float m01, float m02, float m03,  // LINHA 1
 }
 
 // Matriz identidade.
-glm::mat4 Matrix_Identity() {
+constexpr glm::mat4 Matrix_Identity() {
     return Matrix(1.0f, 0.0f, 0.0f, 0.0f,  // LINHA 1
                   0.0f, 1.0f, 0.0f, 0.0f,  // LINHA 2
                   0.0f, 0.0f, 1.0f, 0.0f,  // LINHA 3
@@ -54,7 +61,7 @@ glm::mat4 Matrix_Identity() {
 //
 //     T*p = p+t.
 //
-glm::mat4 Matrix_Translate(float tx, float ty, float tz) {
+constexpr glm::mat4 Matrix_Translate(float tx, float ty, float tz) {
     return Matrix(1.0f, 0.0f, 0.0f, tx, 0.0f, 1.0f, 0.0f, ty, 0.0f, 0.0f, 1.0f, tz, 0.0f, 0.0f, 0.0f, 1.0f);
 }
 
@@ -64,7 +71,7 @@ glm::mat4 Matrix_Translate(float tx, float ty, float tz) {
 //
 //     S*p = [sx*px, sy*py, sz*pz, pw].
 //
-glm::mat4 Matrix_Scale(float sx, float sy, float sz) {
+constexpr glm::mat4 Matrix_Scale(float sx, float sy, float sz) {
     return Matrix(sx, 0.0f, 0.0f, 0.0f, 0.0f, sy, 0.0f, 0.0f, 0.0f, 0.0f, sz, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 }
 
@@ -124,22 +131,127 @@ float norm(glm::vec4 v) {
 // coordenadas e em torno do eixo definido pelo vetor 'axis'. Esta matriz pode
 // ser definida pela fórmula de Rodrigues. Lembre-se que o vetor que define o
 // eixo de rotação deve ser normalizado!
-glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis) {
-    float c = cos(angle);
-    float s = sin(angle);
-
-    glm::vec4 v = axis / norm(axis);
-
-    float vx = v.x;
-    float vy = v.y;
-    float vz = v.z;
-
+//
+// A fórmula está em Matrix_Rotate_CosSin(), que recebe o cosseno e o seno do
+// ângulo e o eixo já normalizado; ela é compartilhada com Matrix_Const_Rotate().
+constexpr glm::mat4 Matrix_Rotate_CosSin(float c, float s, float vx, float vy, float vz) {
     return Matrix(vx * vx * (1.0f - c) + c, vx * vy * (1.0f - c) - vz * s, vx * vz * (1 - c) + vy * s, 0.0f,
                   vx * vy * (1.0f - c) + vz * s, vy * vy * (1.0f - c) + c, vy * vz * (1 - c) - vx * s, 0.0f,
                   vx * vz * (1 - c) - vy * s, vy * vz * (1 - c) + vx * s, vz * vz * (1.0f - c) + c, 0.0f, 0.0f, 0.0f,
                   0.0f, 1.0f);
 }
 
+glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis) {
+    glm::vec4 v = axis / norm(axis);
+
+    return Matrix_Rotate_CosSin(cos(angle), sin(angle), v.x, v.y, v.z);
+}
+
+// Seno, cosseno e raiz quadrada avaliáveis em tempo de compilação, já que
+// sin(), cos() e sqrt() da biblioteca padrão não são constexpr. O ângulo é
+// reduzido para [-pi,pi] e a série de Taylor é somada em double, com erro bem
+// menor que a precisão de um float. Em tempo de execução, use as funções da
+// biblioteca padrão, que são mais rápidas.
+constexpr double Const_Reduce_Angle(double angle) {
+    constexpr double kTwoPi = 6.283185307179586476925;
+
+    double    turns = angle / kTwoPi;
+    long long k     = static_cast<long long>(turns < 0.0 ? turns - 0.5 : turns + 0.5);
+    return angle - static_cast<double>(k) * kTwoPi;
+}
+
+constexpr float Const_Sin(float angle) {
+    double x    = Const_Reduce_Angle(angle);
+    double term = x;
+    double sum  = x;
+    for (int n = 1; n <= 12; ++n) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return static_cast<float>(sum);
+}
+
+constexpr float Const_Cos(float angle) {
+    double x    = Const_Reduce_Angle(angle);
+    double term = 1.0;
+    double sum  = 1.0;
+    for (int n = 1; n <= 12; ++n) {
+        term *= -x * x / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return static_cast<float>(sum);
+}
+
+// Método de Newton, partindo de uma estimativa maior que a raiz: a sequência
+// decresce até parar de mudar.
+constexpr float Const_Sqrt(float value) {
+    if (value <= 0.0f) {
+        return 0.0f;
+    }
+
+    double x = value < 1.0f ? 1.0 : value;
+    while (true) {
+        double next = 0.5 * (x + value / x);
+        if (next >= x) {
+            return static_cast<float>(x);
+        }
+        x = next;
+    }
+}
+
+// Versões constexpr das matrizes de rotação, para ângulos conhecidos em tempo
+// de compilação.
+constexpr glm::mat4 Matrix_Const_Rotate_X(float angle) {
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(1.0f, 0.0f, 0.0f, 0.0f,  // LINHA 1
+                  0.0f, c, -s, 0.0f,       // LINHA 2
+                  0.0f, s, c, 0.0f,        // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f   // LINHA 4
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate_Y(float angle) {
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(c, 0.0f, s, 0.0f,        // LINHA 1
+                  0.0f, 1.0f, 0.0f, 0.0f,  // LINHA 2
+                  -s, 0.0f, c, 0.0f,       // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f   // LINHA 4
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate_Z(float angle) {
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(c, -s, 0.0f, 0.0f,       // LINHA 1
+                  s, c, 0.0f, 0.0f,        // LINHA 2
+                  0.0f, 0.0f, 1.0f, 0.0f,  // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f   // LINHA 4
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate(float angle, glm::vec4 axis) {
+    float n = Const_Sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    return Matrix_Rotate_CosSin(Const_Cos(angle), Const_Sin(angle), axis.x / n, axis.y / n, axis.z / n);
+}
+
+// Produto de matrizes C = A*B avaliável em tempo de compilação, para compor
+// transformações constantes. Em tempo de execução, use o operador * da GLM.
+constexpr glm::mat4 Matrix_Const_Multiply(const glm::mat4& a, const glm::mat4& b) {
+    float m[4][4] = {};  // m[i][j] é o elemento da LINHA i e COLUNA j de A*B
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            m[i][j] = a[0][i] * b[j][0] + a[1][i] * b[j][1] + a[2][i] * b[j][2] + a[3][i] * b[j][3];
+        }
+    }
+    return Matrix(m[0][0], m[0][1], m[0][2], m[0][3],  // LINHA 1
+                  m[1][0], m[1][1], m[1][2], m[1][3],  // LINHA 2
+                  m[2][0], m[2][1], m[2][2], m[2][3],  // LINHA 3
+                  m[3][0], m[3][1], m[3][2], m[3][3]   // LINHA 4
+    );
+}
+
 // Produto vetorial entre dois vetores u e v definidos em um sistema de
 // coordenadas ortonormal.
 glm::vec4 crossproduct(glm::vec4 u, glm::vec4 v) {
@@ -204,6 +316,217 @@ glm::mat4 Matrix_Camera_View(glm::vec4 position_c, glm::vec4 view_vector, glm::v
                   wx, wy, wz, -dotproduct(w, position_c - origin_o), 0.0f, 0.0f, 0.0f, 1.0f);
 }
 
+// Matriz afim 3x4: as três primeiras linhas de uma matriz 4x4 cuja última
+// linha é [0,0,0,1], como as de Matrix_Translate(), Matrix_Scale(),
+// Matrix_Rotate_*() e Matrix_Camera_View() e os seus produtos. Seja
+//
+//       [ A  t ]
+//   M = [ 0  1 ],
+//
+// onde A é a parte linear (3x3) e t a translação. Guardamos somente as linhas
+// [A t] (48 bytes em vez de 64), e o produto e a inversa aproveitam a última
+// linha conhecida. No vertex shader, a mesma matriz é uma mat3x4 (três
+// colunas de quatro coeficientes, que são as nossas linhas), e um ponto é
+// transformado como "vec4(p, 1.0) * model" (veja "shader_vertex.glsl").
+struct AffineMatrix {
+    glm::vec4 rows[3];
+};
+
+static_assert(sizeof(AffineMatrix) == 48, "AffineMatrix deve ocupar 48 bytes");
+
+// Como Matrix(), cria uma matriz afim a partir das suas três primeiras
+// LINHAS (a quarta é sempre [0,0,0,1]).
+AffineMatrix Affine(float m00, float m01, float m02, float m03,  // LINHA 1
+                    float m10, float m11, float m12, float m13,  // LINHA 2
+                    float m20, float m21, float m22, float m23   // LINHA 3
+) {
+    AffineMatrix a;
+    a.rows[0] = glm::vec4(m00, m01, m02, m03);
+    a.rows[1] = glm::vec4(m10, m11, m12, m13);
+    a.rows[2] = glm::vec4(m20, m21, m22, m23);
+    return a;
+}
+
+// Conversões entre matrizes 4x4 (afins) e AffineMatrix.
+AffineMatrix Affine_FromMatrix(const glm::mat4& m) {
+    return Affine(m[0][0], m[1][0], m[2][0], m[3][0],  // LINHA 1
+                  m[0][1], m[1][1], m[2][1], m[3][1],  // LINHA 2
+                  m[0][2], m[1][2], m[2][2], m[3][2]   // LINHA 3
+    );
+}
+
+glm::mat4 Affine_ToMatrix(const AffineMatrix& a) {
+    return Matrix(a.rows[0].x, a.rows[0].y, a.rows[0].z, a.rows[0].w,  // LINHA 1
+                  a.rows[1].x, a.rows[1].y, a.rows[1].z, a.rows[1].w,  // LINHA 2
+                  a.rows[2].x, a.rows[2].y, a.rows[2].z, a.rows[2].w,  // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f                               // LINHA 4
+    );
+}
+
+// Versões afins de Matrix_Identity(), Matrix_Translate(), Matrix_Scale() e
+// Matrix_Rotate_*(), construídas diretamente (sem passar por uma matriz 4x4).
+AffineMatrix Affine_Identity() {
+    return Affine(1.0f, 0.0f, 0.0f, 0.0f,  // LINHA 1
+                  0.0f, 1.0f, 0.0f, 0.0f,  // LINHA 2
+                  0.0f, 0.0f, 1.0f, 0.0f   // LINHA 3
+    );
+}
+
+AffineMatrix Affine_Translate(float tx, float ty, float tz) {
+    return Affine(1.0f, 0.0f, 0.0f, tx, 0.0f, 1.0f, 0.0f, ty, 0.0f, 0.0f, 1.0f, tz);
+}
+
+AffineMatrix Affine_Scale(float sx, float sy, float sz) {
+    return Affine(sx, 0.0f, 0.0f, 0.0f, 0.0f, sy, 0.0f, 0.0f, 0.0f, 0.0f, sz, 0.0f);
+}
+
+AffineMatrix Affine_Rotate_X(float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return Affine(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, c, -s, 0.0f, 0.0f, s, c, 0.0f);
+}
+
+AffineMatrix Affine_Rotate_Y(float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return Affine(c, 0.0f, s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -s, 0.0f, c, 0.0f);
+}
+
+AffineMatrix Affine_Rotate_Z(float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return Affine(c, -s, 0.0f, 0.0f, s, c, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+}
+
+// Produto a*b de duas matrizes afins. Cada linha do resultado é a
+// combinação das linhas de b com os coeficientes da linha de a, mais a
+// translação de a:
+//
+//   (a*b)_i = a_i0*b_0 + a_i1*b_1 + a_i2*b_2 + a_i3*[0,0,0,1].
+//
+// São 36 multiplicações, contra 64 do produto de matrizes 4x4.
+AffineMatrix Affine_Multiply(const AffineMatrix& a, const AffineMatrix& b) {
+    AffineMatrix r;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4& row = a.rows[i];
+        for (int j = 0; j < 4; ++j) {
+            r.rows[i][j] = (b.rows[0][j] * row.x + b.rows[1][j] * row.y) + b.rows[2][j] * row.z;
+        }
+        r.rows[i].w += row.w;
+    }
+    return r;
+}
+
+// Produto a*v, com v um ponto (w = 1) ou um vetor (w = 0). A coordenada w
+// não muda.
+glm::vec4 Affine_Multiply_Vector(const AffineMatrix& a, const glm::vec4& v) {
+    glm::vec4 r;
+    for (int i = 0; i < 3; ++i) {
+        r[i] = (a.rows[i].x * v.x + a.rows[i].y * v.y) + (a.rows[i].z * v.z + a.rows[i].w * v.w);
+    }
+    r.w = v.w;
+    return r;
+}
+
+// Inversa de uma matriz afim:
+//
+//       [ A  t ]                  [ A^-1  -A^-1*t ]
+//   M = [ 0  1 ],  então   M^-1 = [ 0     1       ],
+//
+// onde as linhas de A^-1 são os produtos vetoriais das colunas c0, c1 e c2
+// de A (c1 x c2, c2 x c0 e c0 x c1) divididos pelo determinante de A,
+// c0 . (c1 x c2).
+AffineMatrix Affine_Inverse(const AffineMatrix& a) {
+    glm::vec4 c0 = glm::vec4(a.rows[0].x, a.rows[1].x, a.rows[2].x, 0.0f);
+    glm::vec4 c1 = glm::vec4(a.rows[0].y, a.rows[1].y, a.rows[2].y, 0.0f);
+    glm::vec4 c2 = glm::vec4(a.rows[0].z, a.rows[1].z, a.rows[2].z, 0.0f);
+    glm::vec4 t  = glm::vec4(a.rows[0].w, a.rows[1].w, a.rows[2].w, 0.0f);
+
+    glm::vec4 r0 = crossproduct(c1, c2);
+    glm::vec4 r1 = crossproduct(c2, c0);
+    glm::vec4 r2 = crossproduct(c0, c1);
+
+    float one_over_determinant = 1.0f / ((c0.x * r0.x + c0.y * r0.y) + c0.z * r0.z);
+
+    AffineMatrix inverse;
+    inverse.rows[0] = r0 * one_over_determinant;
+    inverse.rows[1] = r1 * one_over_determinant;
+    inverse.rows[2] = r2 * one_over_determinant;
+    for (int i = 0; i < 3; ++i) {
+        glm::vec4& row = inverse.rows[i];
+        row.w          = -((row.x * t.x + row.y * t.y) + row.z * t.z);
+    }
+    return inverse;
+}
+
+// Matriz que transforma as normais de uma superfície transformada por "a":
+// a inversa da transposta da parte linear A, com translação nula (normais
+// são vetores).
+AffineMatrix Affine_Normal_Matrix(const AffineMatrix& a) {
+    AffineMatrix inverse = Affine_Inverse(a);
+
+    AffineMatrix normal;
+    for (int i = 0; i < 3; ++i) {
+        normal.rows[i] = glm::vec4(inverse.rows[0][i], inverse.rows[1][i], inverse.rows[2][i], 0.0f);
+    }
+    return normal;
+}
+
+// Seno e cosseno de um ângulo com uma única chamada: a maior parte das contas
+// é comum aos dois. Com a biblioteca C da GNU usamos sincosf(); nas demais,
+// sinf() e cosf().
+void Matrix_SinCos(float angle, float* s, float* c) {
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+    sincosf(angle, s, c);
+#else
+    *s = sinf(angle);
+    *c = cosf(angle);
+#endif
+}
+
+// Rotações em torno de X, Y e Z em uma única matriz, construída diretamente
+// em vez de multiplicar Affine_Rotate_X(), Affine_Rotate_Y() e
+// Affine_Rotate_Z(): um seno e um cosseno por ângulo, e os coeficientes do
+// produto escritos por extenso.
+//
+// Affine_Rotate_XYZ() aplica primeiro a rotação em torno de X, depois a em
+// torno de Y e por último a em torno de Z, isto é, Rz*Ry*Rx.
+// Affine_Rotate_ZYX() as aplica na ordem inversa, isto é, Rx*Ry*Rz.
+AffineMatrix Affine_Rotate_XYZ(float rx, float ry, float rz) {
+    float sx, cx, sy, cy, sz, cz;
+    Matrix_SinCos(rx, &sx, &cx);
+    Matrix_SinCos(ry, &sy, &cy);
+    Matrix_SinCos(rz, &sz, &cz);
+    return Affine(cz * cy, cz * sy * sx - sz * cx, cz * sy * cx + sz * sx, 0.0f,  // LINHA 1
+                  sz * cy, sz * sy * sx + cz * cx, sz * sy * cx - cz * sx, 0.0f,  // LINHA 2
+                  -sy, cy * sx, cy * cx, 0.0f                                     // LINHA 3
+    );
+}
+
+AffineMatrix Affine_Rotate_ZYX(float rx, float ry, float rz) {
+    float sx, cx, sy, cy, sz, cz;
+    Matrix_SinCos(rx, &sx, &cx);
+    Matrix_SinCos(ry, &sy, &cy);
+    Matrix_SinCos(rz, &sz, &cz);
+    return Affine(cy * cz, -cy * sz, sy, 0.0f,                                    // LINHA 1
+                  cx * sz + sx * sy * cz, cx * cz - sx * sy * sz, -sx * cy, 0.0f,  // LINHA 2
+                  sx * sz - cx * sy * cz, sx * cz + cx * sy * sz, cx * cy, 0.0f    // LINHA 3
+    );
+}
+
+// Transformação "TRS": primeiro a escala, depois as rotações em torno de X,
+// Y e Z (como em Affine_Rotate_XYZ()) e por último a translação, isto é,
+// T*Rz*Ry*Rx*S. A escala multiplica as colunas da rotação, e a translação é
+// a quarta coluna, sem nenhum produto de matrizes.
+AffineMatrix Affine_TRS(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale) {
+    AffineMatrix r = Affine_Rotate_XYZ(rotation.x, rotation.y, rotation.z);
+    for (int i = 0; i < 3; ++i) {
+        glm::vec4& row = r.rows[i];
+        row            = glm::vec4(row.x * scale.x, row.y * scale.y, row.z * scale.z, translation[i]);
+    }
+    return r;
+}
+
 // Matriz de projeção paralela ortográfica
 glm::mat4 Matrix_Orthographic(float l, float r, float b, float t, float n, float f) {
     glm::mat4 M = Matrix(2.0f / (r - l), 0.0f, 0.0f, -(r + l) / (r - l), 0.0f, 2.0f / (t - b), 0.0f, -(t + b) / (t - b),
@@ -261,6 +584,16 @@ glm::mat4 Matrix_Perspective(float field_of_view, float aspect, float n, float f
     return -M * P;
 }
 
+// Matriz de mapeamento do retângulo [a,b] em NDC para o retângulo [p,q] em
+// coordenadas de pixels da janela (viewport).
+constexpr glm::mat4 Matrix_Viewport(glm::vec2 a, glm::vec2 b, glm::vec2 p, glm::vec2 q) {
+    return Matrix((q.x - p.x) / (b.x - a.x), 0.0f, 0.0f, (b.x * p.x - a.x * q.x) / (b.x - a.x),  // LINHA 1
+                  0.0f, (q.y - p.y) / (b.y - a.y), 0.0f, (b.y * p.y - a.y * q.y) / (b.y - a.y),  // LINHA 2
+                  0.0f, 0.0f, 1.0f, 0.0f,                                                        // LINHA 3
+                  0.0f, 0.0f, 0.0f, 1.0f                                                         // LINHA 4
+    );
+}
+
 // Função que imprime uma matriz M no terminal
 void PrintMatrix(glm::mat4 M) {
     printf("\n");
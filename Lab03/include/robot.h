@@ -0,0 +1,230 @@
+#ifndef _ROBOT_H
+#define _ROBOT_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "matrices.h"
+#include "scenegraph.h"
+
+// Robô do laboratório, construído como um grafo de cena (veja
+// "scenegraph.h"). Cada parte do corpo é um nó com a sua articulação, e cada
+// cubo desenhado é um nó filho com a escala da parte.
+
+// Nós do robô cuja transformação local muda a cada quadro, controlados pelo
+// usuário.
+struct RobotNodes {
+    int32_t torso;
+    int32_t right_arm;
+    int32_t right_forearm;
+    int32_t head;
+    int32_t left_arm;
+    int32_t left_forearm;
+};
+
+// Variáveis controladas pelo usuário que definem a pose do robô.
+struct RobotPose {
+    float torso_x;    // Translação do torso
+    float torso_y;    //
+    float angle_x;    // Ângulos de Euler dos braços e da cabeça
+    float angle_y;    //
+    float angle_z;    //
+    float forearm_x;  // Rotação dos antebraços
+    float forearm_z;  //
+};
+
+// Constrói o grafo de cena do robô. Cada articulação é um nó, filho da
+// articulação à qual está presa; cada cubo é um nó folha com a escala do
+// cubo, filho da sua articulação, para que a escala não seja herdada pelas
+// demais partes. Os nós dos cubos são adicionados a "cube_nodes" na ordem em
+// que o código original, com PushMatrix() e PopMatrix(), desenhava os cubos
+// (veja Robot_MatrixStack()).
+void Robot_Build(SceneGraph* graph, RobotNodes* nodes, std::vector<int32_t>* cube_nodes) {
+    glm::vec3 zero = glm::vec3(0.0f, 0.0f, 0.0f);
+
+    // Torso
+    int32_t torso = SceneGraph_AddNode(graph, SCENEGRAPH_NO_PARENT, glm::vec3(-1.0f, 1.0f, 0.0f));
+    cube_nodes->push_back(SceneGraph_AddNode(graph, torso, zero, zero, glm::vec3(0.8f, 1.0f, 0.2f)));
+
+    // Braço, antebraço e mão direitos
+    int32_t right_arm = SceneGraph_AddNode(graph, torso, glm::vec3(-0.55f, 0.0f, 0.0f));
+    cube_nodes->push_back(SceneGraph_AddNode(graph, right_arm, zero, zero, glm::vec3(0.2f, 0.6f, 0.2f)));
+    int32_t right_forearm = SceneGraph_AddNode(graph, right_arm, glm::vec3(0.0f, -0.65f, 0.0f));
+    cube_nodes->push_back(SceneGraph_AddNode(graph, right_forearm, zero, zero, glm::vec3(0.2f, 0.6f, 0.2f)));
+    cube_nodes->push_back(
+        SceneGraph_AddNode(graph, right_forearm, glm::vec3(0.0f, -0.65f, 0.0f), zero, glm::vec3(0.2f, 0.1f, 0.2f)));
+
+    // Cabeça
+    int32_t head = SceneGraph_AddNode(graph, torso, glm::vec3(0.0f, 0.05f, 0.0f));
+    cube_nodes->push_back(SceneGraph_AddNode(graph, head, zero, zero, glm::vec3(-0.3f, -0.3f, 0.3f)));
+
+    // Braço, antebraço e mão esquerdos
+    int32_t left_arm = SceneGraph_AddNode(graph, torso, glm::vec3(0.55f, 0.0f, 0.0f));
+    cube_nodes->push_back(SceneGraph_AddNode(graph, left_arm, zero, zero, glm::vec3(0.2f, 0.6f, 0.2f)));
+    int32_t left_forearm = SceneGraph_AddNode(graph, left_arm, glm::vec3(0.0f, -0.65f, 0.0f));
+    cube_nodes->push_back(SceneGraph_AddNode(graph, left_forearm, zero, zero, glm::vec3(0.2f, 0.6f, 0.2f)));
+    cube_nodes->push_back(
+        SceneGraph_AddNode(graph, left_forearm, glm::vec3(0.0f, -0.65f, 0.0f), zero, glm::vec3(0.2f, 0.1f, 0.2f)));
+
+    // Pernas: coxa, canela e pé
+    const float legs[2] = {0.2f, -0.2f};
+    for (float x : legs) {
+        int32_t thigh = SceneGraph_AddNode(graph, torso, glm::vec3(x, -1.05f, 0.0f));
+        cube_nodes->push_back(SceneGraph_AddNode(graph, thigh, zero, zero, glm::vec3(0.3f, 0.6f, 0.3f)));
+        int32_t shin = SceneGraph_AddNode(graph, thigh, glm::vec3(0.0f, -0.65f, 0.0f));
+        cube_nodes->push_back(SceneGraph_AddNode(graph, shin, zero, zero, glm::vec3(0.25f, 0.6f, 0.25f)));
+        cube_nodes->push_back(
+            SceneGraph_AddNode(graph, shin, glm::vec3(0.0f, -0.65f, 0.1f), zero, glm::vec3(0.25f, 0.1f, 0.55f)));
+    }
+
+    nodes->torso         = torso;
+    nodes->right_arm     = right_arm;
+    nodes->right_forearm = right_forearm;
+    nodes->head          = head;
+    nodes->left_arm      = left_arm;
+    nodes->left_forearm  = left_forearm;
+}
+
+// Atualiza as transformações locais controladas pelo usuário. As matrizes
+// são recomputadas por SceneGraph_Update().
+void Robot_SetPose(SceneGraph* graph, const RobotNodes& nodes, const RobotPose& pose) {
+    glm::vec3 arm_rotation = glm::vec3(pose.angle_x, pose.angle_y, pose.angle_z);
+
+    SceneGraph_SetTranslation(graph, nodes.torso, glm::vec3(pose.torso_x - 1.0f, pose.torso_y + 1.0f, 0.0f));
+    SceneGraph_SetRotation(graph, nodes.right_arm, arm_rotation);
+    SceneGraph_SetRotation(graph, nodes.right_forearm, glm::vec3(pose.forearm_x, 0.0f, pose.forearm_z));
+    SceneGraph_SetRotation(graph, nodes.head, glm::vec3(-pose.angle_x, pose.angle_y, pose.angle_z));
+    SceneGraph_SetRotation(graph, nodes.left_arm, arm_rotation);
+    SceneGraph_SetRotation(graph, nodes.left_forearm, glm::vec3(pose.forearm_x, 0.0f, -pose.forearm_z));
+}
+
+// Matrizes de modelagem dos cubos do robô, computadas exatamente como no
+// código original do laboratório, percorrendo a hierarquia com uma pilha de
+// matrizes (PushMatrix() e PopMatrix()). Note que cada PopMatrix() restaura
+// a matriz empilhada pelo PushMatrix() correspondente, e não a matriz do
+// torso: a cabeça, o braço esquerdo e as pernas são posicionados em relação
+// à parte desenhada antes deles. Usada para verificar o grafo de Robot_Build().
+void Robot_MatrixStack(const RobotPose& pose, std::vector<glm::mat4>* cubes) {
+    std::vector<glm::mat4> stack;
+    glm::mat4              model;
+
+    auto push = [&]() { stack.push_back(model); };
+    auto pop  = [&]() {
+        model = stack.back();
+        stack.pop_back();
+    };
+    auto draw = [&](const glm::mat4& scale) { cubes->push_back(model * scale); };
+
+    glm::mat4 arm_rotation = Matrix_Rotate_Z(pose.angle_z) * Matrix_Rotate_Y(pose.angle_y) *
+                             Matrix_Rotate_X(pose.angle_x);
+
+    model = Matrix_Identity() * Matrix_Translate(pose.torso_x - 1.0f, pose.torso_y + 1.0f, 0.0f);
+    draw(Matrix_Scale(0.8f, 1.0f, 0.2f));  // Torso
+    push();
+    {
+        // Braço, antebraço e mão direitos
+        model = model * Matrix_Translate(-0.55f, 0.0f, 0.0f);
+        push();
+        {
+            model = model * arm_rotation;
+            draw(Matrix_Scale(0.2f, 0.6f, 0.2f));
+            model = model * Matrix_Translate(0.0f, -0.65f, 0.0f) * Matrix_Rotate_Z(pose.forearm_z) *
+                    Matrix_Rotate_X(pose.forearm_x);
+            draw(Matrix_Scale(0.2f, 0.6f, 0.2f));
+            model = model * Matrix_Translate(0.0f, -0.65f, 0.0f);
+            draw(Matrix_Scale(0.2f, 0.1f, 0.2f));
+        }
+        pop();
+
+        // Cabeça
+        model = model * Matrix_Translate(0.55f, 0.05f, 0.0f);
+        push();
+        {
+            model = model * Matrix_Rotate_Z(pose.angle_z) * Matrix_Rotate_Y(pose.angle_y) *
+                    Matrix_Rotate_X(-pose.angle_x);
+            draw(Matrix_Scale(-0.3f, -0.3f, 0.3f));
+        }
+        pop();
+
+        // Braço, antebraço e mão esquerdos
+        model = model * Matrix_Translate(0.55f, -0.05f, 0.0f);
+        push();
+        {
+            model = model * arm_rotation;
+            draw(Matrix_Scale(0.2f, 0.6f, 0.2f));
+            model = model * Matrix_Translate(0.0f, -0.65f, 0.0f) * Matrix_Rotate_Z(-pose.forearm_z) *
+                    Matrix_Rotate_X(pose.forearm_x);
+            draw(Matrix_Scale(0.2f, 0.6f, 0.2f));
+            model = model * Matrix_Translate(0.0f, -0.65f, 0.0f);
+            draw(Matrix_Scale(0.2f, 0.1f, 0.2f));
+        }
+        pop();
+
+        // Pernas: coxa, canela e pé
+        const glm::vec3 legs[2] = {glm::vec3(-0.35f, -1.05f, 0.0f), glm::vec3(-0.40f, 0.0f, 0.0f)};
+        for (const glm::vec3& offset : legs) {
+            model = model * Matrix_Translate(offset.x, offset.y, offset.z);
+            push();
+            {
+                draw(Matrix_Scale(0.3f, 0.6f, 0.3f));
+                model = model * Matrix_Translate(0.0f, -0.65f, 0.0f);
+                draw(Matrix_Scale(0.25f, 0.6f, 0.25f));
+                model = model * Matrix_Translate(0.0f, -0.65f, 0.1f);
+                draw(Matrix_Scale(0.25f, 0.1f, 0.55f));
+            }
+            pop();
+        }
+    }
+    pop();
+}
+
+// Verifica, para várias poses aleatórias, que as matrizes dos cubos do grafo
+// são praticamente iguais às do código original com a pilha de matrizes.
+// Retorna 0 em caso de sucesso.
+int Robot_Check(SceneGraph* graph, const RobotNodes& nodes, const std::vector<int32_t>& cube_nodes) {
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+    std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+
+    for (int i = 0; i < 100; ++i) {
+        RobotPose pose = {};
+        if (i > 0) {
+            pose = {offset(random), offset(random), angle(random), angle(random),
+                    angle(random),  angle(random),  angle(random)};
+        }
+        Robot_SetPose(graph, nodes, pose);
+        SceneGraph_Update(graph);
+
+        std::vector<glm::mat4> expected;
+        Robot_MatrixStack(pose, &expected);
+        if (expected.size() != cube_nodes.size()) {
+            fprintf(stderr, "ERROR: Robot has %zu cubes, but the matrix stack draws %zu.\n", cube_nodes.size(),
+                    expected.size());
+            return 1;
+        }
+
+        for (size_t k = 0; k < cube_nodes.size(); ++k) {
+            const AffineMatrix& world = graph->world[cube_nodes[k]];
+            for (int row = 0; row < 3; ++row) {
+                for (int column = 0; column < 4; ++column) {
+                    float e = expected[k][column][row];
+                    if (std::fabs(world.rows[row][column] - e) > 1e-5f * (1.0f + std::fabs(e))) {
+                        fprintf(stderr, "ERROR: Robot cube %zu differs from the matrix stack (pose %d).\n", k, i);
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+#endif  // _ROBOT_H
+// vim: set spell spelllang=pt_br :
@@ -0,0 +1,128 @@
+#ifndef _SCENEGRAPH_H
+#define _SCENEGRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "matrices.h"
+
+// Grafo de cena "achatado": em vez de construir as matrizes de modelagem de
+// forma hierárquica percorrendo o código com PushMatrix() e PopMatrix() a
+// cada quadro, a hierarquia é guardada uma única vez como uma lista de nós,
+// onde cada nó conhece somente o seu pai.
+//
+// Os nós ficam em arrays separados para cada campo ("structure of arrays"),
+// sempre com o pai antes dos filhos. Assim, as matrizes de todos os nós são
+// computadas por um único laço, do primeiro ao último nó: quando chegamos em
+// um nó, a matriz do seu pai já foi computada.
+//
+// Cada nó tem uma transformação local (translação, rotação e escala, "TRS"),
+// e um indicador "dirty" que marca que ela mudou. Somente os nós marcados e
+// os seus descendentes têm a matriz recomputada; os demais mantêm a matriz do
+// quadro anterior.
+//
+// Todas essas transformações são afins, então as matrizes são guardadas e
+// multiplicadas como matrizes 3x4 (veja AffineMatrix em "matrices.h").
+
+// Pai dos nós que não têm pai (raízes da hierarquia).
+#define SCENEGRAPH_NO_PARENT -1
+
+struct SceneGraph {
+    std::vector<int32_t>      parent;       // Pai de cada nó, sempre anterior a ele (ou SCENEGRAPH_NO_PARENT)
+    std::vector<glm::vec3>    translation;  // Transformação local: translação,
+    std::vector<glm::vec3>    rotation;     // ângulos de Euler (X, Y, Z), aplicados na ordem X, Y, Z,
+    std::vector<glm::vec3>    scale;        // e escala
+    std::vector<uint8_t>      dirty;        // 1 se a transformação local mudou desde o último SceneGraph_Update()
+    std::vector<AffineMatrix> world;        // Matriz de modelagem de cada nó, computada por SceneGraph_Update()
+};
+
+// Matriz da transformação local de um nó: primeiro a escala, depois as
+// rotações em X, Y e Z, e por último a translação. Veja Affine_TRS() em
+// "matrices.h", que constrói a matriz diretamente, sem os produtos de
+// Matrix_Translate(), Matrix_Rotate_Z(), Matrix_Rotate_Y(), Matrix_Rotate_X()
+// e Matrix_Scale().
+AffineMatrix SceneGraph_LocalMatrix(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale) {
+    return Affine_TRS(translation, rotation, scale);
+}
+
+// Adiciona um nó filho de "parent" (que já deve existir, ou
+// SCENEGRAPH_NO_PARENT), retornando o seu índice.
+int32_t SceneGraph_AddNode(SceneGraph* graph, int32_t parent, const glm::vec3& translation,
+                           const glm::vec3& rotation = glm::vec3(0.0f, 0.0f, 0.0f),
+                           const glm::vec3& scale    = glm::vec3(1.0f, 1.0f, 1.0f)) {
+    int32_t node = static_cast<int32_t>(graph->parent.size());
+    if (parent >= node) {
+        fprintf(stderr, "ERROR: Scene graph node %d added before its parent %d.\n", node, parent);
+        std::exit(EXIT_FAILURE);
+    }
+
+    graph->parent.push_back(parent);
+    graph->translation.push_back(translation);
+    graph->rotation.push_back(rotation);
+    graph->scale.push_back(scale);
+    graph->dirty.push_back(1);
+    graph->world.push_back(Affine_Identity());
+    return node;
+}
+
+// Funções que alteram a transformação local de um nó. O nó só é marcado
+// como "dirty" se o valor realmente mudou.
+void SceneGraph_SetTranslation(SceneGraph* graph, int32_t node, const glm::vec3& translation) {
+    if (graph->translation[node] != translation) {
+        graph->translation[node] = translation;
+        graph->dirty[node]       = 1;
+    }
+}
+
+void SceneGraph_SetRotation(SceneGraph* graph, int32_t node, const glm::vec3& rotation) {
+    if (graph->rotation[node] != rotation) {
+        graph->rotation[node] = rotation;
+        graph->dirty[node]    = 1;
+    }
+}
+
+void SceneGraph_SetScale(SceneGraph* graph, int32_t node, const glm::vec3& scale) {
+    if (graph->scale[node] != scale) {
+        graph->scale[node] = scale;
+        graph->dirty[node] = 1;
+    }
+}
+
+// Recomputa as matrizes dos nós marcados e dos seus descendentes, em um
+// único laço: como o pai vem antes do filho, a marcação do pai já está
+// propagada (e a sua matriz já está atualizada) quando chegamos no filho.
+// Retorna o número de matrizes recomputadas.
+size_t SceneGraph_Update(SceneGraph* graph) {
+    const size_t count = graph->parent.size();
+
+    size_t num_updated = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int32_t parent = graph->parent[i];
+        if (parent != SCENEGRAPH_NO_PARENT && graph->dirty[parent]) {
+            graph->dirty[i] = 1;
+        }
+        if (!graph->dirty[i]) {
+            continue;
+        }
+
+        AffineMatrix local = SceneGraph_LocalMatrix(graph->translation[i], graph->rotation[i], graph->scale[i]);
+        graph->world[i]    = parent != SCENEGRAPH_NO_PARENT ? Affine_Multiply(graph->world[parent], local) : local;
+        num_updated += 1;
+    }
+
+    // As marcações só podem ser limpas depois do laço, pois são lidas pelos
+    // filhos.
+    std::fill(graph->dirty.begin(), graph->dirty.end(), 0);
+    return num_updated;
+}
+
+#endif  // _SCENEGRAPH_H
+// vim: set spell spelllang=pt_br :
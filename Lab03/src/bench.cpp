@@ -0,0 +1,274 @@
+//     Universidade Federal do Rio Grande do Sul
+//             Instituto de Informática
+//       Departamento de Informática Aplicada
+//
+//    INF01047 Fundamentos de Computação Gráfica
+//               Prof. Eduardo Gastal
+//
+//                   LABORATÓRIO 3
+//
+
+// Testes de desempenho do laboratório, em um executável separado
+// ("Lab03_bench"), para que o programa principal seja somente o renderizador.
+// Nenhum dos testes abre uma janela. Uso:
+//
+//   ./Lab03_bench --bench-<teste> [argumento]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stack>
+#include <vector>
+
+#include "matrices.h"
+#include "scenegraph.h"
+#include "robot.h"
+
+// Mede o tempo para computar as matrizes de um grafo com "num_nodes" nós
+// aleatórios: percorrendo a hierarquia com uma pilha de matrizes, como
+// PushMatrix() e PopMatrix() (todas as matrizes, a cada quadro), com
+// matrizes 4x4 e 3x4, e com SceneGraph_Update() quando todos, 1% ou nenhum
+// dos nós mudaram.
+// Executado com o argumento "--bench-scenegraph [número de nós]".
+int SceneGraph_Benchmark(size_t num_nodes) {
+    typedef std::chrono::steady_clock clock;
+
+    const int    max_depth   = 16;
+    const int    repetitions = 20;
+    std::mt19937 random(42);
+
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+    std::uniform_int_distribution<int>    climb(0, 2);
+
+    // Geramos os nós em pré-ordem (cada nó logo depois dos seus ancestrais),
+    // que é também a ordem em que a pilha os visitaria. "ancestors" é o
+    // caminho da raiz até o último nó criado, e "depth" a profundidade de
+    // cada nó.
+    SceneGraph           graph;
+    std::vector<int32_t> ancestors;
+    std::vector<int>     depth;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        for (int k = climb(random); k > 0 && !ancestors.empty(); --k) {
+            ancestors.pop_back();
+        }
+        if (static_cast<int>(ancestors.size()) >= max_depth) {
+            ancestors.pop_back();
+        }
+
+        int32_t parent = ancestors.empty() ? SCENEGRAPH_NO_PARENT : ancestors.back();
+        int32_t node   = SceneGraph_AddNode(&graph, parent, glm::vec3(offset(random), offset(random), offset(random)),
+                                            glm::vec3(angle(random), angle(random), angle(random)));
+        depth.push_back(static_cast<int>(ancestors.size()));
+        ancestors.push_back(node);
+    }
+
+    // Pilha de matrizes: antes de cada nó, desempilhamos até o topo ser a
+    // matriz do seu pai. Primeiro com matrizes 4x4, para comparação.
+    std::vector<glm::mat4> stack_world_4x4(num_nodes);
+    double                 seconds = 0.0;
+    for (int r = 0; r < repetitions; ++r) {
+        clock::time_point     start = clock::now();
+        std::stack<glm::mat4> matrices;
+        for (size_t i = 0; i < num_nodes; ++i) {
+            while (static_cast<int>(matrices.size()) > depth[i]) {
+                matrices.pop();
+            }
+            const glm::vec3& t     = graph.translation[i];
+            const glm::vec3& a     = graph.rotation[i];
+            const glm::vec3& s     = graph.scale[i];
+            glm::mat4        model = Matrix_Translate(t.x, t.y, t.z) * Matrix_Rotate_Z(a.z) * Matrix_Rotate_Y(a.y) *
+                              Matrix_Rotate_X(a.x) * Matrix_Scale(s.x, s.y, s.z);
+            if (!matrices.empty()) {
+                model = matrices.top() * model;
+            }
+            matrices.push(model);
+            stack_world_4x4[i] = model;
+        }
+        seconds += std::chrono::duration<double>(clock::now() - start).count();
+    }
+    printf("Pilha de matrizes 4x4: %zu matrizes, %.3f ms por quadro\n", num_nodes, 1e3 * seconds / repetitions);
+
+    std::vector<AffineMatrix> stack_world(num_nodes);
+    seconds = 0.0;
+    for (int r = 0; r < repetitions; ++r) {
+        clock::time_point        start = clock::now();
+        std::stack<AffineMatrix> matrices;
+        for (size_t i = 0; i < num_nodes; ++i) {
+            while (static_cast<int>(matrices.size()) > depth[i]) {
+                matrices.pop();
+            }
+            AffineMatrix model = SceneGraph_LocalMatrix(graph.translation[i], graph.rotation[i], graph.scale[i]);
+            if (!matrices.empty()) {
+                model = Affine_Multiply(matrices.top(), model);
+            }
+            matrices.push(model);
+            stack_world[i] = model;
+        }
+        seconds += std::chrono::duration<double>(clock::now() - start).count();
+    }
+    printf("Pilha de matrizes 3x4: %zu matrizes, %.3f ms por quadro\n", num_nodes, 1e3 * seconds / repetitions);
+
+    // A pilha de matrizes 3x4 e o grafo fazem as mesmas multiplicações, na
+    // mesma ordem, e devem computar exatamente as mesmas matrizes; as
+    // matrizes 4x4 devem ser praticamente iguais. Todos os nós ainda estão
+    // marcados, pois acabaram de ser criados.
+    SceneGraph_Update(&graph);
+    for (size_t i = 0; i < num_nodes; ++i) {
+        const AffineMatrix& world = graph.world[i];
+        const AffineMatrix& stack = stack_world[i];
+        if (world.rows[0] != stack.rows[0] || world.rows[1] != stack.rows[1] || world.rows[2] != stack.rows[2]) {
+            fprintf(stderr, "ERROR: Scene graph and matrix stack differ at node %zu.\n", i);
+            return 1;
+        }
+        for (int row = 0; row < 3; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                float expected = stack_world_4x4[i][column][row];
+                if (std::fabs(world.rows[row][column] - expected) > 1e-4f * (1.0f + std::fabs(expected))) {
+                    fprintf(stderr, "ERROR: 3x4 and 4x4 matrices differ at node %zu.\n", i);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // Grafo achatado, com uma fração dos nós alterados antes de cada quadro.
+    const double fractions[] = {1.0, 0.01, 0.0};
+    for (double fraction : fractions) {
+        size_t num_changed = static_cast<size_t>(fraction * num_nodes);
+        size_t num_updated = 0;
+        seconds            = 0.0;
+        for (int r = 0; r < repetitions; ++r) {
+            clock::time_point start = clock::now();
+            for (size_t k = 0; k < num_changed; ++k) {
+                size_t    node     = num_changed == num_nodes ? k : random() % num_nodes;
+                glm::vec3 rotation = graph.rotation[node];
+                rotation.y += 0.01f;
+                SceneGraph_SetRotation(&graph, static_cast<int32_t>(node), rotation);
+            }
+            num_updated = SceneGraph_Update(&graph);
+            seconds += std::chrono::duration<double>(clock::now() - start).count();
+        }
+        printf("Grafo, %5.1f%% mudados: %zu matrizes, %.3f ms por quadro\n", 100.0 * fraction, num_updated,
+               1e3 * seconds / repetitions);
+    }
+
+    return 0;
+}
+
+// Tempo médio, em nanossegundos, de function(i) para i = 0, ..., count-1.
+template <typename Function>
+double SceneGraph_Benchmark_Time(size_t count, int repetitions, Function function) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        for (size_t i = 0; i < count; ++i) {
+            function(i);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return 1e9 * seconds / (static_cast<double>(count) * repetitions);
+}
+
+// Mede o custo por nó da matriz local de cada nó de "graph", construída
+// diretamente por SceneGraph_LocalMatrix() e como o produto de matrizes de
+// translação, rotação e escala separadas (com matrizes 4x4 e 3x4), e
+// verifica que as três são praticamente iguais. Os nós recebem ângulos
+// aleatórios, como as articulações controladas pelo usuário. Executado com
+// o argumento "--bench-robot", com o grafo do robô (veja Robot_Build() em
+// "robot.h").
+int SceneGraph_LocalMatrix_Benchmark(const SceneGraph& graph) {
+    const size_t count       = graph.parent.size();
+    const int    repetitions = 100000;
+
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+
+    std::vector<glm::vec3> rotation(count);
+    for (size_t i = 0; i < count; ++i) {
+        rotation[i] = glm::vec3(angle(random), angle(random), angle(random));
+    }
+
+    std::vector<glm::mat4>    product_4x4(count);
+    std::vector<AffineMatrix> product_3x4(count), fused(count);
+
+    double ns_4x4 = SceneGraph_Benchmark_Time(count, repetitions, [&](size_t i) {
+        const glm::vec3& t = graph.translation[i];
+        const glm::vec3& a = rotation[i];
+        const glm::vec3& s = graph.scale[i];
+        product_4x4[i]     = Matrix_Translate(t.x, t.y, t.z) * Matrix_Rotate_Z(a.z) * Matrix_Rotate_Y(a.y) *
+                         Matrix_Rotate_X(a.x) * Matrix_Scale(s.x, s.y, s.z);
+    });
+    double ns_3x4 = SceneGraph_Benchmark_Time(count, repetitions, [&](size_t i) {
+        const glm::vec3& t = graph.translation[i];
+        const glm::vec3& a = rotation[i];
+        const glm::vec3& s = graph.scale[i];
+        AffineMatrix     m = Affine_Multiply(Affine_Translate(t.x, t.y, t.z), Affine_Rotate_Z(a.z));
+        m                  = Affine_Multiply(Affine_Multiply(m, Affine_Rotate_Y(a.y)), Affine_Rotate_X(a.x));
+        product_3x4[i]     = Affine_Multiply(m, Affine_Scale(s.x, s.y, s.z));
+    });
+    double ns_fused = SceneGraph_Benchmark_Time(count, repetitions, [&](size_t i) {
+        fused[i] = SceneGraph_LocalMatrix(graph.translation[i], rotation[i], graph.scale[i]);
+    });
+
+    for (size_t i = 0; i < count; ++i) {
+        for (int row = 0; row < 3; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                float expected    = product_4x4[i][column][row];
+                float error_3x4   = std::fabs(product_3x4[i].rows[row][column] - expected);
+                float error_fused = std::fabs(fused[i].rows[row][column] - expected);
+                if (std::max(error_3x4, error_fused) > 1e-5f * (1.0f + std::fabs(expected))) {
+                    fprintf(stderr, "ERROR: Local matrices differ at node %zu.\n", i);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    printf("%zu nós, tempo por nó (e por quadro, com todos os nós mudados):\n", count);
+    printf("  Produtos de matrizes 4x4: %7.2f ns (%7.3f us)\n", ns_4x4, 1e-3 * ns_4x4 * count);
+    printf("  Produtos de matrizes 3x4: %7.2f ns (%7.3f us)\n", ns_3x4, 1e-3 * ns_3x4 * count);
+    printf("  Construção direta (TRS):  %7.2f ns (%7.3f us)\n", ns_fused, 1e-3 * ns_fused * count);
+
+    // Impede que as contas acima sejam descartadas.
+    volatile float sink = product_4x4[0][0][0] + product_3x4[0].rows[0][0] + fused[0].rows[0][0];
+    (void)sink;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Com o argumento "--bench-scenegraph [número de nós]", medimos o tempo
+    // para computar as matrizes de modelagem de um grafo de cena grande. Veja
+    // "scenegraph.h".
+    if (argc > 1 && strcmp(argv[1], "--bench-scenegraph") == 0) {
+        return SceneGraph_Benchmark(argc > 2 ? static_cast<size_t>(atol(argv[2])) : 100000);
+    }
+
+    // Com o argumento "--bench-robot", verificamos que o grafo do robô
+    // reproduz as matrizes do código original com a pilha de matrizes (veja
+    // "robot.h"), e medimos o custo por nó das matrizes locais do robô,
+    // construídas diretamente ou como produtos de matrizes de rotação
+    // separadas. Veja "scenegraph.h".
+    if (argc > 1 && strcmp(argv[1], "--bench-robot") == 0) {
+        SceneGraph           graph;
+        RobotNodes           nodes;
+        std::vector<int32_t> cube_nodes;
+        Robot_Build(&graph, &nodes, &cube_nodes);
+        if (Robot_Check(&graph, nodes, cube_nodes) != 0) {
+            return EXIT_FAILURE;
+        }
+        return SceneGraph_LocalMatrix_Benchmark(graph);
+    }
+
+    fprintf(stderr,
+            "Usage: %s <benchmark>\n"
+            "  --bench-scenegraph [number of nodes]\n"
+            "  --bench-robot\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
+
+// vim: set spell spelllang=pt_br :
@@ -17,8 +17,8 @@
 #include <cstdlib>
 
 #include <map>
-#include <stack>
 #include <string>
+#include <vector>
 #include <limits>
 #include <fstream>
 #include <sstream>
@@ -30,10 +30,8 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "matrices.h"
-
-// Declaração de funções utilizadas para pilha de matrizes de modelagem.
-void PushMatrix(glm::mat4 M);
-void PopMatrix(glm::mat4& M);
+#include "scenegraph.h"
+#include "robot.h"
 
 // Declaração de várias funções utilizadas em main().  Essas estão definidas
 // logo após a definição de main() neste arquivo.
@@ -94,8 +92,16 @@ struct SceneObject {
 // estes são acessados.
 std::map<const char*, SceneObject> g_VirtualScene;
 
-// Pilha que guardará as matrizes de modelagem.
-std::stack<glm::mat4> g_MatrixStack;
+// Grafo de cena com a hierarquia de transformações do robô. Veja
+// "scenegraph.h" e a função Robot_Build() em "robot.h".
+SceneGraph g_SceneGraph;
+
+// Nós do robô cuja transformação local muda a cada quadro, controlados pelo
+// usuário.
+RobotNodes g_RobotNodes;
+
+// Nós do grafo desenhados como cubos, com a matriz de modelagem do nó.
+std::vector<int32_t> g_CubeNodes;
 
 // Razão de proporção da janela (largura/altura). Veja função FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
@@ -209,6 +215,9 @@ int main() {
     // Construímos a representação de um triângulo
     GLuint vertex_array_object_id = BuildTriangles();
 
+    // Construímos a hierarquia de transformações do robô
+    Robot_Build(&g_SceneGraph, &g_RobotNodes, &g_CubeNodes);
+
     // Inicializamos o código para renderização de texto.
     TextRendering_Init();
 
@@ -321,234 +330,37 @@ int main() {
         // slides 2-14 e 184-190 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
         //
         // Entretanto, neste laboratório as matrizes de modelagem dos cubos
-        // serão construídas de maneira hierárquica, tal que operações em
+        // são construídas de maneira hierárquica, tal que operações em
         // alguns objetos influenciem outros objetos. Por exemplo: ao
         // transladar o torso, a cabeça deve se movimentar junto.
         // Veja slides 243-273 do documento Aula_08_Sistemas_de_Coordenadas.pdf
         //
-        glm::mat4 model = Matrix_Identity();  // Transformação inicial = identidade.
-
-        // Translação inicial do torso
-        model = model * Matrix_Translate(g_TorsoPositionX - 1.0f, g_TorsoPositionY + 1.0f, 0.0f);
-        // Guardamos matriz model atual na pilha
-        PushMatrix(model);
-        {
-            // Atualizamos a matriz model (multiplicação à direita) para fazer um escalamento do torso
-            model = model * Matrix_Scale(0.8f, 1.0f, 0.2f);
-            // Enviamos a matriz "model" para a placa de vídeo (GPU). Veja o
-            // arquivo "shader_vertex.glsl", onde esta é efetivamente
-            // aplicada em todos os pontos.
-            glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-            // Desenhamos um cubo. Esta renderização irá executar o Vertex
-            // Shader definido no arquivo "shader_vertex.glsl", e o mesmo irá
-            // utilizar as matrizes "model", "view" e "projection" definidas
-            // acima e já enviadas para a placa de vídeo (GPU).
-            DrawCube(render_as_black_uniform);  // #### TORSO
-        }
-        // Tiramos da pilha a matriz model guardada anteriormente
-        PopMatrix(model);
-
-        PushMatrix(model);  // Guardamos matriz model atual na pilha
-        {
-            model = model * Matrix_Translate(-0.55f, 0.0f,
-                                             0.0f);  // Atualizamos matriz model (multiplicação à direita) com uma
-                                                     // translação para o braço direito
-            PushMatrix(model);                       // Guardamos matriz model atual na pilha
-            {
-                model = model  // Atualizamos matriz model (multiplicação à direita) com a rotação do braço direito
-                        * Matrix_Rotate_Z(angleZ_)   // TERCEIRO rotação Z de Euler
-                        * Matrix_Rotate_Y(angleY_)   // SEGUNDO rotação Y de Euler
-                        * Matrix_Rotate_X(angleX_);  // PRIMEIRO rotação X de Euler
-                PushMatrix(model);                   // Guardamos matriz model atual na pilha
-                {
-                    model = model * Matrix_Scale(0.2f, 0.6f,
-                                                 0.2f);  // Atualizamos matriz model (multiplicação à direita) com um
-                                                         // escalamento do braço direito
-                    glUniformMatrix4fv(model_uniform, 1, GL_FALSE,
-                                       glm::value_ptr(model));  // Enviamos matriz model atual para a GPU
-                    DrawCube(render_as_black_uniform);          // #### BRAÇO DIREITO // Desenhamos o braço direito
-                }
-                PopMatrix(model);   // Tiramos da pilha a matriz model guardada anteriormente
-                PushMatrix(model);  // Guardamos matriz model atual na pilha
-                {
-                    model = model * Matrix_Translate(0.0f, -0.65f,
-                                                     0.0f);  // Atualizamos matriz model (multiplicação à direita) com a
-                                                             // translação do antebraço direito
-                    model =
-                        model  // Atualizamos matriz model (multiplicação à direita) com a rotação do antebraço direito
-                        * Matrix_Rotate_Z(g_ForearmAngleZ)   // SEGUNDO rotação Z de Euler
-                        * Matrix_Rotate_X(g_ForearmAngleX);  // PRIMEIRO rotação X de Euler
-                    PushMatrix(model);                       // Guardamos matriz model atual na pilha
-                    {
-                        model = model * Matrix_Scale(0.2f, 0.6f,
-                                                     0.2f);  // Atualizamos matriz model (multiplicação à direita) com
-                                                             // um escalamento do antebraço direito
-                        glUniformMatrix4fv(model_uniform, 1, GL_FALSE,
-                                           glm::value_ptr(model));  // Enviamos matriz model atual para a GPU
-                        DrawCube(render_as_black_uniform);  // #### ANTEBRAÇO DIREITO // Desenhamos o antebraço direito
-                    }
-                    PopMatrix(model);
-                    PushMatrix(model);
-                    {
-                        // Desenho da mão direita
-                        model = model * Matrix_Translate(0.0f, -.65f, 0.0f);
-                        PushMatrix(model);
-                        {
-                            model = model * Matrix_Scale(0.2f, 0.1f, 0.2f);
-                            glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                            DrawCube(render_as_black_uniform);
-                        }
-                        PopMatrix(model);
-                    }
-                    PopMatrix(model);
-                }
-                PopMatrix(model);
-            }
-            PopMatrix(model);
-
-            // Desenhando a cabeça
-            model = model * Matrix_Translate(0.55f, 0.05f, 0.0f);
-            PushMatrix(model);
-            {
-                model = model * Matrix_Rotate_Z(angleZ_) * Matrix_Rotate_Y(angleY_) * Matrix_Rotate_X(-angleX_);
-                PushMatrix(model);
-                {
-                    model = model * Matrix_Scale(-0.3f, -0.3f, 0.3f);
-                    glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                    DrawCube(render_as_black_uniform);
-                }
-                PopMatrix(model);
-            }
-            PopMatrix(model);
-
-            // Desenhando o braço esquerdo
-            model = model * Matrix_Translate(0.55f, -0.05f, 0.0f);
-            PushMatrix(model);
-            {
-                model = model * Matrix_Rotate_Z(angleZ_) * Matrix_Rotate_Y(angleY_) * Matrix_Rotate_X(angleX_);
-                PushMatrix(model);
-                {
-                    model = model * Matrix_Scale(0.2f, 0.6f, 0.2f);
-                    glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                    DrawCube(render_as_black_uniform);
-                }
-                PopMatrix(model);
-                PushMatrix(model);
-                {
-                    model = model * Matrix_Translate(0.0f, -0.65f, 0.0f);
-                    model = model * Matrix_Rotate_Z(-g_ForearmAngleZ) * Matrix_Rotate_X(g_ForearmAngleX);
-                    PushMatrix(model);
-                    {
-                        model = model * Matrix_Scale(0.2f, 0.6f, 0.2f);
-                        glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                        DrawCube(render_as_black_uniform);
-                    }
-                    PopMatrix(model);
-                    PushMatrix(model);
-                    {
-                        model = model * Matrix_Translate(0.0f, -.65f, 0.0f);
-                        PushMatrix(model);
-                        {
-                            model = model * Matrix_Scale(0.2f, 0.1f, 0.2f);
-                            glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                            DrawCube(render_as_black_uniform);
-                        }
-                        PopMatrix(model);
-                    }
-                    PopMatrix(model);
-                }
-                PopMatrix(model);
-            }
-            PopMatrix(model);
-
-            // Desenhando a perna esquerda
-            model = model * Matrix_Translate(-0.35f, -1.05f, 0.0f);
-            PushMatrix(model);
-            {
-                PushMatrix(model);
-                {
-                    model = model * Matrix_Scale(0.3f, 0.6f, 0.3);
-                    glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                    DrawCube(render_as_black_uniform);
-                }
-                PopMatrix(model);
-                PushMatrix(model);
-                {
-                    model = model * Matrix_Translate(0.0f, -0.65f, 0.0f);
-                    PushMatrix(model);
-                    {
-                        model = model * Matrix_Scale(0.25f, 0.6f, 0.25f);
-                        glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                        DrawCube(render_as_black_uniform);
-                    }
-                    PopMatrix(model);
-                    PushMatrix(model);
-                    {
-                        model = model * Matrix_Translate(0.0f, -.65f, 0.1f);
-                        PushMatrix(model);
-                        {
-                            model = model * Matrix_Scale(0.25f, 0.1f, 0.55f);
-                            glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                            DrawCube(render_as_black_uniform);
-                        }
-                        PopMatrix(model);
-                    }
-                    PopMatrix(model);
-                }
-                PopMatrix(model);
-            }
-            PopMatrix(model);
-
-            // Desenhando a perna direita
-            model = model * Matrix_Translate(-0.40f, 0.0f, 0.0f);
-            PushMatrix(model);
-            {
-                PushMatrix(model);
-                {
-                    model = model * Matrix_Scale(0.3f, 0.6f, 0.3);
-                    glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                    DrawCube(render_as_black_uniform);
-                }
-                PopMatrix(model);
-                PushMatrix(model);
-                {
-                    model = model * Matrix_Translate(0.0f, -0.65f, 0.0f);
-                    PushMatrix(model);
-                    {
-                        model = model * Matrix_Scale(0.25f, 0.6f, 0.25f);
-                        glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                        DrawCube(render_as_black_uniform);
-                    }
-                    PopMatrix(model);
-                    PushMatrix(model);
-                    {
-                        model = model * Matrix_Translate(0.0f, -.65f, 0.1f);
-                        PushMatrix(model);
-                        {
-                            model = model * Matrix_Scale(0.25f, 0.1f, 0.55f);
-                            glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                            DrawCube(render_as_black_uniform);
-                        }
-                        PopMatrix(model);
-                    }
-                    PopMatrix(model);
-                }
-                PopMatrix(model);
-            }
-            PopMatrix(model);
+        // A hierarquia é guardada no grafo de cena g_SceneGraph (veja
+        // Robot_Build() em "robot.h"). A cada quadro somente atualizamos
+        // as transformações controladas pelo usuário; as matrizes são
+        // recomputadas somente para os nós que mudaram e os seus
+        // descendentes.
+        RobotPose pose = {g_TorsoPositionX, g_TorsoPositionY, angleX_, angleY_, angleZ_, g_ForearmAngleX,
+                          g_ForearmAngleZ};
+        Robot_SetPose(&g_SceneGraph, g_RobotNodes, pose);
+        SceneGraph_Update(&g_SceneGraph);
+
+        // Desenhamos cada cubo com a matriz de modelagem do seu nó. Veja o
+        // arquivo "shader_vertex.glsl", onde esta é efetivamente aplicada em
+        // todos os pontos.
+        for (int32_t node : g_CubeNodes) {
+            glUniformMatrix3x4fv(model_uniform, 1, GL_FALSE, &g_SceneGraph.world[node].rows[0][0]);
+            DrawCube(render_as_black_uniform);
         }
-        PopMatrix(model);
-
-        // Neste ponto a matriz model recuperada é a matriz inicial (translação do torso)
 
         // Agora queremos desenhar os eixos XYZ de coordenadas GLOBAIS.
         // Para tanto, colocamos a matriz de modelagem igual à identidade.
         // Veja slides 2-14 e 184-190 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
-        model = Matrix_Identity();
+        AffineMatrix model = Affine_Identity();
 
         // Enviamos a nova matriz "model" para a placa de vídeo (GPU). Veja o
         // arquivo "shader_vertex.glsl".
-        glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
+        glUniformMatrix3x4fv(model_uniform, 1, GL_FALSE, &model.rows[0][0]);
 
         // Pedimos para OpenGL desenhar linhas com largura de 10 pixels.
         glLineWidth(10.0f);
@@ -604,19 +416,6 @@ int main() {
     return 0;
 }
 
-// Função que pega a matriz M e guarda a mesma no topo da pilha
-void PushMatrix(glm::mat4 M) { g_MatrixStack.push(M); }
-
-// Função que remove a matriz atualmente no topo da pilha e armazena a mesma na variável M
-void PopMatrix(glm::mat4& M) {
-    if (g_MatrixStack.empty()) {
-        M = Matrix_Identity();
-    } else {
-        M = g_MatrixStack.top();
-        g_MatrixStack.pop();
-    }
-}
-
 // Função que desenha um cubo com arestas em preto, definido dentro da função BuildTriangles().
 void DrawCube(GLint render_as_black_uniform) {
     // Informamos para a placa de vídeo (GPU) que a variável booleana
@@ -1354,9 +1153,7 @@ void TextRendering_ShowModelViewProjection(GLFWwindow* window, glm::mat4 project
     glm::vec2 p = glm::vec2(0, 0);
     glm::vec2 q = glm::vec2(width, height);
 
-    glm::mat4 viewport_mapping = Matrix((q.x - p.x) / (b.x - a.x), 0.0f, 0.0f, (b.x * p.x - a.x * q.x) / (b.x - a.x),
-                                        0.0f, (q.y - p.y) / (b.y - a.y), 0.0f, (b.y * p.y - a.y * q.y) / (b.y - a.y),
-                                        0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    glm::mat4 viewport_mapping = Matrix_Viewport(a, b, p, q);
 
     TextRendering_PrintString(window, "                                                       |  ", -1.0f,
                               1.0f - 22 * pad, 1.0f);
@@ -11,8 +11,12 @@ layout (location = 1) in vec4 color_coefficients;
 // Shader. Veja o arquivo "shader_fragment.glsl".
 out vec4 cor_interpolada_pelo_rasterizador;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
+// Matrizes computadas no código C++ e enviadas para a GPU. A matriz de
+// modelagem é afim, e somente as suas três primeiras linhas são enviadas,
+// como as três colunas de uma mat3x4 (veja AffineMatrix em "matrices.h").
+// Assim, o produto "M*p" da matriz 4x4 M por um ponto p é escrito abaixo
+// como "p * model", que resulta em um vec3.
+uniform mat3x4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -32,7 +36,7 @@ void main()
     // deste Vertex Shader, a placa de vídeo (GPU) fará a divisão por W. Veja
     // slides 41-67 e 69-86 do documento Aula_09_Projecoes.pdf.
 
-    gl_Position = projection * view * model * model_coefficients;
+    gl_Position = projection * view * vec4(model_coefficients * model, 1.0);
 
     // Como as variáveis acima  (tipo vec4) são vetores com 4 coeficientes,
     // também é possível acessar e modificar cada coeficiente de maneira
@@ -1118,11 +1118,7 @@ void TextRendering_ShowModelViewProjection(GLFWwindow* window, glm::mat4 project
     glm::vec2 p = glm::vec2(0, 0);
     glm::vec2 q = glm::vec2(width, height);
 
-    glm::mat4 viewport_mapping =
-        Matrix((q.x - p.x) / (b.x - a.x), 0.0f, 0.0f, (b.x * p.x - a.x * q.x) / (b.x - a.x),  //
-               0.0f, (q.y - p.y) / (b.y - a.y), 0.0f, (b.y * p.y - a.y * q.y) / (b.y - a.y),  //
-               0.0f, 0.0f, 1.0f, 0.0f,                                                        //
-               0.0f, 0.0f, 0.0f, 1.0f);
+    glm::mat4 viewport_mapping = Matrix_Viewport(a, b, p, q);
 
     TextRendering_PrintString(window, "                                                       |  ", -1.0f,
                               1.0f - 22 * pad, 1.0f);
@@ -0,0 +1,172 @@
+#ifndef _ASSETLOADER_H
+#define _ASSETLOADER_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+// Carregamento assíncrono de recursos (malhas e texturas).
+//
+// Ler arquivos do disco, interpretar ".obj", computar normais e decodificar
+// imagens não depende da GPU, então é feito por um conjunto de threads de
+// trabalho ("worker threads") enquanto a janela já está sendo desenhada.
+// Somente uma thread possui o contexto OpenGL, então o resultado de cada
+// tarefa é uma função de envio (AssetUpload) colocada em uma fila, que é
+// executada no início de cada quadro com AssetLoader_ProcessUploads(), pela
+// thread de renderização e com a thread principal parada (veja
+// RenderThread_Call() em "renderthread.h"). Um limite de bytes enviados por
+// quadro evita que vários envios grandes no mesmo quadro causem engasgos na
+// animação.
+//
+// Os objetos aparecem na cena à medida que ficam prontos: DrawVirtualObject()
+// ignora objetos que ainda não estão em g_VirtualScene.
+
+// Número máximo (aproximado) de bytes enviados para a GPU por quadro. Pelo
+// menos um envio é feito por quadro, mesmo que seja maior que o limite.
+#define ASSET_UPLOAD_BUDGET (16 * 1024 * 1024)
+
+// Função executada pela thread com o contexto OpenGL para enviar um recurso
+// já carregado para a GPU. Retorna o número de bytes enviados.
+typedef std::function<size_t()> AssetUpload;
+
+// Tarefa executada por uma thread de trabalho. Retorna o envio a ser feito
+// pela thread com o contexto OpenGL. Erros devem ser reportados com exceções.
+typedef std::function<AssetUpload()> AssetJob;
+
+struct AssetLoader {
+    std::vector<std::thread> workers;
+    std::mutex               mutex;           // Protege todos os campos abaixo
+    std::condition_variable  job_ready;       // Sinalizada quando há tarefas ou ao encerrar
+    std::deque<AssetJob>     jobs;            // Tarefas ainda não iniciadas
+    std::deque<AssetUpload>  uploads;         // Envios prontos para AssetLoader_ProcessUploads()
+    size_t                   num_pending;     // Tarefas submetidas cujo envio ainda não foi feito
+    size_t                   uploaded_bytes;  // Total de bytes enviados para a GPU
+    bool                     stopping;
+};
+
+// Laço executado por cada thread de trabalho.
+void AssetLoader_WorkerLoop(AssetLoader* loader) {
+    for (;;) {
+        AssetJob job;
+        {
+            std::unique_lock<std::mutex> lock(loader->mutex);
+            while (!loader->stopping && loader->jobs.empty()) {
+                loader->job_ready.wait(lock);
+            }
+            if (loader->stopping) {
+                return;
+            }
+            job = loader->jobs.front();
+            loader->jobs.pop_front();
+        }
+
+        // Erros não podem ser reportados a partir desta thread; eles são
+        // repassados para AssetLoader_ProcessUploads(), que encerra o
+        // programa como faria se o recurso tivesse sido carregado nele.
+        AssetUpload upload;
+        try {
+            upload = job();
+        } catch (const std::exception& e) {
+            std::string message = e.what();
+            upload              = [message]() -> size_t {
+                fprintf(stderr, "ERROR: %s\n", message.c_str());
+                std::exit(EXIT_FAILURE);
+            };
+        }
+
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->uploads.push_back(upload);
+    }
+}
+
+// Inicia as threads de trabalho. Deixamos um núcleo livre para a thread
+// principal, que continua desenhando a cena.
+void AssetLoader_Start(AssetLoader* loader) {
+    unsigned int num_threads = ParallelThreadCount() > 1 ? ParallelThreadCount() - 1 : 1;
+
+    loader->num_pending    = 0;
+    loader->uploaded_bytes = 0;
+    loader->stopping       = false;
+
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        loader->workers.emplace_back(AssetLoader_WorkerLoop, loader);
+    }
+}
+
+// Adiciona uma tarefa na fila. Pode ser chamada somente pela thread principal.
+void AssetLoader_Submit(AssetLoader* loader, const AssetJob& job) {
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->jobs.push_back(job);
+        loader->num_pending += 1;
+    }
+    loader->job_ready.notify_one();
+}
+
+// Executa envios prontos até que "budget" bytes tenham sido enviados neste
+// quadro. Deve ser chamada pela thread com o contexto OpenGL, enquanto
+// nenhuma outra thread altera a cena. Retorna o número de envios feitos.
+size_t AssetLoader_ProcessUploads(AssetLoader* loader, size_t budget) {
+    size_t num_uploads = 0;
+    size_t bytes       = 0;
+
+    while (num_uploads == 0 || bytes < budget) {
+        AssetUpload upload;
+        {
+            std::lock_guard<std::mutex> lock(loader->mutex);
+            if (loader->uploads.empty()) {
+                break;
+            }
+            upload = loader->uploads.front();
+            loader->uploads.pop_front();
+        }
+
+        // O envio é feito fora da região crítica, para não bloquear as
+        // threads de trabalho enquanto a GPU recebe os dados.
+        bytes += upload();
+        num_uploads += 1;
+
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->num_pending -= 1;
+    }
+
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    loader->uploaded_bytes += bytes;
+    return num_uploads;
+}
+
+// Número de recursos ainda não enviados para a GPU.
+size_t AssetLoader_NumPending(AssetLoader* loader) {
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    return loader->num_pending;
+}
+
+// Encerra as threads de trabalho. Tarefas em execução são terminadas;
+// tarefas e envios ainda na fila são descartados. Pode ser chamada mais de
+// uma vez (ex.: no fim de main() e novamente por std::atexit()).
+void AssetLoader_Stop(AssetLoader* loader) {
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->stopping = true;
+    }
+    loader->job_ready.notify_all();
+
+    for (std::thread& worker : loader->workers) {
+        worker.join();
+    }
+    loader->workers.clear();
+    loader->jobs.clear();
+    loader->uploads.clear();
+}
+
+#endif  // _ASSETLOADER_H
+// vim: set spell spelllang=pt_br :
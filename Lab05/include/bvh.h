@@ -0,0 +1,596 @@
+#ifndef _BVH_H
+#define _BVH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "frustumcull.h"
+#include "matrices.h"
+
+// Hierarquia de volumes envolventes ("bounding volume hierarchy", BVH) sobre
+// as AABBs dos objetos de um quadro, em coordenadas globais (as mesmas de
+// FrustumCullBatch; veja "frustumcull.h").
+//
+// Cada nó da árvore guarda a AABB de todos os objetos abaixo dele. Assim,
+// uma consulta (objetos dentro do frustum, atravessados por um raio ou
+// próximos de um ponto) descarta de uma vez todos os objetos de um nó cuja
+// AABB não satisfaz a consulta, e o custo cresce com o número de objetos
+// encontrados, e não com o número de objetos da cena.
+//
+// A árvore é construída com a heurística de área de superfície ("surface
+// area heuristic", SAH): cada nó é dividido no plano que minimiza a soma das
+// áreas das AABBs dos dois filhos, ponderadas pelos seus números de objetos,
+// que estima o custo de uma consulta. Os planos candidatos são os limites de
+// BVH_NUM_BINS intervalos iguais ao longo de cada eixo ("binning").
+//
+// Quando objetos se movem, a árvore não é reconstruída: somente as AABBs dos
+// nós acima de cada objeto movido são recomputadas ("refit"). As consultas
+// continuam corretas, mas podem ficar mais lentas se os objetos se afastarem
+// muito das posições em que a árvore foi construída. Veja Bvh_Sync().
+
+// Número de intervalos por eixo avaliados pela SAH.
+#define BVH_NUM_BINS 16
+
+// Nós com até BVH_LEAF_SIZE objetos são sempre folhas; nós com mais de
+// BVH_MAX_LEAF_SIZE objetos são sempre divididos.
+#define BVH_LEAF_SIZE     4
+#define BVH_MAX_LEAF_SIZE 16
+
+// Profundidade máxima da árvore, que limita as pilhas das consultas. Abaixo
+// de BVH_MAX_DEPTH - 32 níveis, os nós são divididos ao meio em vez de pela
+// SAH, o que garante no máximo 32 níveis a mais para até 2^32 objetos.
+#define BVH_MAX_DEPTH 64
+
+// Folga relativa das AABBs das folhas. Com ela, o teste de um nó nunca
+// descarta ou aceita um objeto que o teste do próprio objeto trataria de
+// outra forma por causa de arredondamentos, e Bvh_CullBatch() dá exatamente
+// o mesmo resultado que FrustumCull_Test().
+#define BVH_MARGIN 1e-5f
+
+// Objeto retornado por Bvh_Raycast() quando o raio não atravessa nenhum
+// objeto.
+#define BVH_NO_OBJECT -1
+
+struct BvhNode {
+    glm::vec3 bbox_min;
+    int32_t   first;  // Folha: primeiro objeto em Bvh::objects; nó interno: filho da esquerda (o outro é first + 1)
+    glm::vec3 bbox_max;
+    int32_t   count;  // Número de objetos da folha, ou 0 para nós internos
+};
+
+struct Bvh {
+    std::vector<BvhNode>   nodes;    // nodes[0] é a raiz; os filhos vêm sempre depois do pai
+    std::vector<int32_t>   parents;  // Pai de cada nó (-1 para a raiz)
+    std::vector<uint32_t>  objects;  // Objetos de cada folha, em intervalos contíguos
+    std::vector<int32_t>   leaves;   // Folha de cada objeto
+    std::vector<glm::vec3> centers;  // AABB de cada objeto: centro e metade das dimensões
+    std::vector<glm::vec3> extents;
+};
+
+// Área da superfície de uma AABB.
+float Bvh_Area(const glm::vec3& bbox_min, const glm::vec3& bbox_max) {
+    glm::vec3 size = bbox_max - bbox_min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// Recomputa a AABB de um nó: a união das AABBs dos seus objetos (folhas,
+// com a folga BVH_MARGIN) ou dos seus filhos.
+void Bvh_FitNode(Bvh* bvh, int32_t index) {
+    BvhNode& node = bvh->nodes[index];
+
+    if (node.count == 0) {
+        const BvhNode& left  = bvh->nodes[node.first];
+        const BvhNode& right = bvh->nodes[node.first + 1];
+        node.bbox_min        = glm::min(left.bbox_min, right.bbox_min);
+        node.bbox_max        = glm::max(left.bbox_max, right.bbox_max);
+        return;
+    }
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    glm::vec3   bbox_min = glm::vec3(infinity);
+    glm::vec3   bbox_max = glm::vec3(-infinity);
+    for (int32_t i = node.first; i < node.first + node.count; ++i) {
+        uint32_t object = bvh->objects[i];
+        bbox_min        = glm::min(bbox_min, bvh->centers[object] - bvh->extents[object]);
+        bbox_max        = glm::max(bbox_max, bvh->centers[object] + bvh->extents[object]);
+    }
+    for (int k = 0; k < 3; ++k) {
+        bbox_min[k] -= BVH_MARGIN * (1.0f + std::fabs(bbox_min[k]));
+        bbox_max[k] += BVH_MARGIN * (1.0f + std::fabs(bbox_max[k]));
+    }
+    node.bbox_min = bbox_min;
+    node.bbox_max = bbox_max;
+}
+
+// Recomputa as AABBs de todos os nós, das folhas para a raiz, depois que as
+// AABBs de muitos objetos mudaram.
+void Bvh_Refit(Bvh* bvh) {
+    for (size_t i = bvh->nodes.size(); i > 0; --i) {
+        Bvh_FitNode(bvh, static_cast<int32_t>(i - 1));
+    }
+}
+
+// Divide o nó "index", que tem os objetos [first, first + count) de
+// bvh->objects, retornando a posição do primeiro objeto do filho da direita,
+// ou -1 se o nó deve ser uma folha.
+int32_t Bvh_Split(Bvh* bvh, int32_t first, int32_t count, int depth) {
+    if (count <= BVH_LEAF_SIZE) {
+        return -1;
+    }
+
+    // AABB dos objetos do nó e dos seus centros.
+    const float infinity     = std::numeric_limits<float>::infinity();
+    glm::vec3   bbox_min     = glm::vec3(infinity);
+    glm::vec3   bbox_max     = glm::vec3(-infinity);
+    glm::vec3   centroid_min = glm::vec3(infinity);
+    glm::vec3   centroid_max = glm::vec3(-infinity);
+    for (int32_t i = first; i < first + count; ++i) {
+        const glm::vec3& center = bvh->centers[bvh->objects[i]];
+        const glm::vec3& extent = bvh->extents[bvh->objects[i]];
+        bbox_min                = glm::min(bbox_min, center - extent);
+        bbox_max                = glm::max(bbox_max, center + extent);
+        centroid_min            = glm::min(centroid_min, center);
+        centroid_max            = glm::max(centroid_max, center);
+    }
+
+    // Custo de cada divisão (o custo de visitar o nó mais o número esperado
+    // de objetos testados), comparado com o custo de testar todos os objetos
+    // de uma folha.
+    int   best_axis = -1;
+    int   best_bin  = 0;
+    float best_cost = static_cast<float>(count);
+    float area      = Bvh_Area(bbox_min, bbox_max);
+
+    for (int axis = 0; axis < 3 && depth < BVH_MAX_DEPTH - 32 && area > 0.0f; ++axis) {
+        if (centroid_max[axis] <= centroid_min[axis]) {
+            continue;
+        }
+        float scale = BVH_NUM_BINS / (centroid_max[axis] - centroid_min[axis]);
+
+        int       bin_count[BVH_NUM_BINS] = {0};
+        glm::vec3 bin_min[BVH_NUM_BINS];
+        glm::vec3 bin_max[BVH_NUM_BINS];
+        for (int b = 0; b < BVH_NUM_BINS; ++b) {
+            bin_min[b] = glm::vec3(infinity);
+            bin_max[b] = glm::vec3(-infinity);
+        }
+        for (int32_t i = first; i < first + count; ++i) {
+            const glm::vec3& center = bvh->centers[bvh->objects[i]];
+            const glm::vec3& extent = bvh->extents[bvh->objects[i]];
+            int b = std::min(static_cast<int>((center[axis] - centroid_min[axis]) * scale), BVH_NUM_BINS - 1);
+            bin_count[b] += 1;
+            bin_min[b]    = glm::min(bin_min[b], center - extent);
+            bin_max[b]    = glm::max(bin_max[b], center + extent);
+        }
+
+        // Áreas e números de objetos à direita de cada plano, acumulados do
+        // último intervalo para o primeiro; depois, o mesmo à esquerda.
+        float     right_area[BVH_NUM_BINS];
+        int       right_count[BVH_NUM_BINS];
+        glm::vec3 right_min = glm::vec3(infinity);
+        glm::vec3 right_max = glm::vec3(-infinity);
+        int       num_right = 0;
+        for (int b = BVH_NUM_BINS - 1; b > 0; --b) {
+            right_min      = glm::min(right_min, bin_min[b]);
+            right_max      = glm::max(right_max, bin_max[b]);
+            num_right     += bin_count[b];
+            right_area[b]  = num_right > 0 ? Bvh_Area(right_min, right_max) : 0.0f;
+            right_count[b] = num_right;
+        }
+
+        glm::vec3 left_min = glm::vec3(infinity);
+        glm::vec3 left_max = glm::vec3(-infinity);
+        int       num_left = 0;
+        for (int b = 0; b < BVH_NUM_BINS - 1; ++b) {
+            left_min  = glm::min(left_min, bin_min[b]);
+            left_max  = glm::max(left_max, bin_max[b]);
+            num_left += bin_count[b];
+            if (num_left == 0 || right_count[b + 1] == 0) {
+                continue;
+            }
+            float left_cost  = num_left * Bvh_Area(left_min, left_max);
+            float right_cost = right_count[b + 1] * right_area[b + 1];
+            float cost       = 1.0f + (left_cost + right_cost) / area;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin  = b;
+            }
+        }
+    }
+
+    uint32_t* begin = bvh->objects.data() + first;
+    uint32_t* end   = begin + count;
+
+    if (best_axis >= 0) {
+        const int   axis  = best_axis;
+        const float min   = centroid_min[axis];
+        const float scale = BVH_NUM_BINS / (centroid_max[axis] - centroid_min[axis]);
+        uint32_t*   middle = std::partition(begin, end, [&](uint32_t object) {
+            int b = std::min(static_cast<int>((bvh->centers[object][axis] - min) * scale), BVH_NUM_BINS - 1);
+            return b <= best_bin;
+        });
+        return first + static_cast<int32_t>(middle - begin);
+    }
+
+    if (count <= BVH_MAX_LEAF_SIZE && depth < BVH_MAX_DEPTH - 32) {
+        return -1;
+    }
+
+    // Nenhuma divisão vale a pena, mas o nó tem objetos demais (ou a árvore
+    // está profunda demais): dividimos os objetos ao meio, pela mediana dos
+    // centros no eixo em que eles estão mais espalhados.
+    glm::vec3 spread = centroid_max - centroid_min;
+    int       axis   = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+    std::nth_element(begin, begin + count / 2, end, [&](uint32_t a, uint32_t b) {
+        return bvh->centers[a][axis] < bvh->centers[b][axis];
+    });
+    return first + count / 2;
+}
+
+// Constrói a árvore sobre os objetos de "batch" (as AABBs calculadas por
+// FrustumCull_Set()). Os objetos são identificados pelas suas posições no
+// lote.
+void Bvh_Build(Bvh* bvh, const FrustumCullBatch& batch) {
+    const size_t count = batch.center_x.size();
+
+    bvh->centers.resize(count);
+    bvh->extents.resize(count);
+    bvh->objects.resize(count);
+    bvh->leaves.assign(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        bvh->centers[i] = glm::vec3(batch.center_x[i], batch.center_y[i], batch.center_z[i]);
+        bvh->extents[i] = glm::vec3(batch.extent_x[i], batch.extent_y[i], batch.extent_z[i]);
+        bvh->objects[i] = static_cast<uint32_t>(i);
+    }
+
+    bvh->nodes.clear();
+    bvh->parents.clear();
+    if (count == 0) {
+        return;
+    }
+
+    BvhNode root;
+    root.first = 0;
+    root.count = static_cast<int32_t>(count);
+    bvh->nodes.reserve(2 * count);
+    bvh->nodes.push_back(root);
+    bvh->parents.push_back(-1);
+
+    // Nós ainda não divididos, com as suas profundidades.
+    std::vector<std::pair<int32_t, int>> pending;
+    pending.push_back(std::make_pair(0, 0));
+    while (!pending.empty()) {
+        int32_t index = pending.back().first;
+        int     depth = pending.back().second;
+        pending.pop_back();
+
+        int32_t first  = bvh->nodes[index].first;
+        int32_t count  = bvh->nodes[index].count;
+        int32_t middle = Bvh_Split(bvh, first, count, depth);
+        if (middle < 0) {
+            for (int32_t i = first; i < first + count; ++i) {
+                bvh->leaves[bvh->objects[i]] = index;
+            }
+            continue;
+        }
+
+        BvhNode left, right;
+        left.first  = first;
+        left.count  = middle - first;
+        right.first = middle;
+        right.count = first + count - middle;
+
+        int32_t child = static_cast<int32_t>(bvh->nodes.size());
+        bvh->nodes.push_back(left);
+        bvh->nodes.push_back(right);
+        bvh->parents.push_back(index);
+        bvh->parents.push_back(index);
+        bvh->nodes[index].first = child;
+        bvh->nodes[index].count = 0;
+
+        pending.push_back(std::make_pair(child + 1, depth + 1));
+        pending.push_back(std::make_pair(child, depth + 1));
+    }
+
+    Bvh_Refit(bvh);
+}
+
+// Muda a AABB de um objeto, recomputando somente as AABBs dos nós acima
+// dele, e somente até o primeiro nó cuja AABB não mudou. Retorna false se a
+// AABB do objeto não mudou.
+bool Bvh_Update(Bvh* bvh, uint32_t object, const glm::vec3& center, const glm::vec3& extent) {
+    if (bvh->centers[object] == center && bvh->extents[object] == extent) {
+        return false;
+    }
+    bvh->centers[object] = center;
+    bvh->extents[object] = extent;
+
+    for (int32_t index = bvh->leaves[object]; index >= 0; index = bvh->parents[index]) {
+        glm::vec3 bbox_min = bvh->nodes[index].bbox_min;
+        glm::vec3 bbox_max = bvh->nodes[index].bbox_max;
+        Bvh_FitNode(bvh, index);
+        if (bvh->nodes[index].bbox_min == bbox_min && bvh->nodes[index].bbox_max == bbox_max) {
+            break;
+        }
+    }
+    return true;
+}
+
+// Atualiza a árvore com as AABBs atuais dos objetos de "batch". Se o número
+// de objetos mudou, a árvore é reconstruída; senão, os objetos que se
+// moveram são atualizados com Bvh_Update() ou, se forem muitos, com um único
+// Bvh_Refit(). Retorna o número de objetos atualizados.
+size_t Bvh_Sync(Bvh* bvh, const FrustumCullBatch& batch) {
+    const size_t count = batch.center_x.size();
+    if (count != bvh->centers.size()) {
+        Bvh_Build(bvh, batch);
+        return count;
+    }
+
+    // Cada Bvh_Update() sobe até a raiz no pior caso; acima de 1/8 dos
+    // objetos, é mais barato recomputar todos os nós uma única vez.
+    const size_t max_updates = count / 8;
+    size_t       num_changed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 center = glm::vec3(batch.center_x[i], batch.center_y[i], batch.center_z[i]);
+        glm::vec3 extent = glm::vec3(batch.extent_x[i], batch.extent_y[i], batch.extent_z[i]);
+        if (center == bvh->centers[i] && extent == bvh->extents[i]) {
+            continue;
+        }
+        num_changed += 1;
+        if (num_changed <= max_updates) {
+            Bvh_Update(bvh, static_cast<uint32_t>(i), center, extent);
+        } else {
+            bvh->centers[i] = center;
+            bvh->extents[i] = extent;
+        }
+    }
+    if (num_changed > max_updates) {
+        Bvh_Refit(bvh);
+    }
+    return num_changed;
+}
+
+// Testa uma AABB contra os planos do frustum indicados pelos bits de
+// "planes_mask", com a mesma conta de FrustumCull_TestScalar(). Retorna false
+// se a AABB está inteiramente fora de algum plano, e apaga de "planes_mask"
+// os planos que têm a AABB inteiramente do lado de dentro: eles não precisam
+// ser testados para os objetos abaixo do nó.
+bool Bvh_TestPlanes(const FrustumPlanes& planes, const glm::vec3& center, const glm::vec3& extent,
+                    unsigned int* planes_mask) {
+    for (int p = 0; p < 6; ++p) {
+        if ((*planes_mask & (1u << p)) == 0) {
+            continue;
+        }
+        float distance = planes.a[p] * center.x + planes.b[p] * center.y + planes.c[p] * center.z + planes.d[p];
+        float radius   = std::fabs(planes.a[p]) * extent.x + std::fabs(planes.b[p]) * extent.y +
+                       std::fabs(planes.c[p]) * extent.z;
+        if (distance + radius < 0.0f) {
+            return false;
+        }
+        if (distance - radius >= 0.0f) {
+            *planes_mask &= ~(1u << p);
+        }
+    }
+    return true;
+}
+
+// Chama function(object) para cada objeto cuja AABB não está inteiramente
+// fora de algum plano do frustum (o mesmo teste de "frustumcull.h"). Os
+// objetos de nós inteiramente dentro do frustum são aceitos sem testes.
+template <typename Function>
+void Bvh_ForEachInFrustum(const Bvh& bvh, const FrustumPlanes& planes, Function function) {
+    if (bvh.nodes.empty()) {
+        return;
+    }
+
+    struct Entry {
+        int32_t      node;
+        unsigned int planes_mask;
+    };
+    Entry stack[BVH_MAX_DEPTH + 1];
+    int   size = 0;
+    stack[size++] = {0, 0x3Fu};
+
+    while (size > 0) {
+        Entry          entry = stack[--size];
+        const BvhNode& node  = bvh.nodes[entry.node];
+
+        glm::vec3 center = 0.5f * (node.bbox_min + node.bbox_max);
+        glm::vec3 extent = 0.5f * (node.bbox_max - node.bbox_min);
+        if (entry.planes_mask != 0 && !Bvh_TestPlanes(planes, center, extent, &entry.planes_mask)) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack[size++] = {node.first + 1, entry.planes_mask};
+            stack[size++] = {node.first, entry.planes_mask};
+            continue;
+        }
+
+        for (int32_t i = node.first; i < node.first + node.count; ++i) {
+            uint32_t     object      = bvh.objects[i];
+            unsigned int planes_mask = entry.planes_mask;
+            if (planes_mask == 0 || Bvh_TestPlanes(planes, bvh.centers[object], bvh.extents[object], &planes_mask)) {
+                function(object);
+            }
+        }
+    }
+}
+
+// Adiciona a "results" os objetos dentro do frustum (veja
+// Bvh_ForEachInFrustum()), retornando quantos foram adicionados.
+size_t Bvh_QueryFrustum(const Bvh& bvh, const FrustumPlanes& planes, std::vector<uint32_t>* results) {
+    size_t count = results->size();
+    Bvh_ForEachInFrustum(bvh, planes, [&](uint32_t object) { results->push_back(object); });
+    return results->size() - count;
+}
+
+// Preenche batch->visible como FrustumCull_Test(), mas testando somente os
+// nós da árvore que cruzam o frustum. A árvore deve estar atualizada com o
+// lote (veja Bvh_Sync()). Retorna o número de objetos visíveis.
+size_t Bvh_CullBatch(const Bvh& bvh, const FrustumPlanes& planes, FrustumCullBatch* batch) {
+    std::fill(batch->visible.begin(), batch->visible.end(), 0);
+
+    size_t num_visible = 0;
+    Bvh_ForEachInFrustum(bvh, planes, [&](uint32_t object) {
+        batch->visible[object] = 1;
+        num_visible += 1;
+    });
+    return num_visible;
+}
+
+// Distância, ao longo do raio origin + t * direction, em que ele entra na
+// AABB [bbox_min, bbox_max] ("slab test"), ou infinito se ele não a
+// atravessa com 0 <= t <= max_t. "inverse_direction" é 1 / direction, em
+// cada coordenada.
+float Bvh_RayBox(const glm::vec3& origin, const glm::vec3& inverse_direction, const glm::vec3& bbox_min,
+                 const glm::vec3& bbox_max, float max_t) {
+    float t_near = 0.0f;
+    float t_far  = max_t;
+    for (int k = 0; k < 3; ++k) {
+        float t0 = (bbox_min[k] - origin[k]) * inverse_direction[k];
+        float t1 = (bbox_max[k] - origin[k]) * inverse_direction[k];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        t_near = std::max(t_near, t0);
+        t_far  = std::min(t_far, t1);
+    }
+    return t_near <= t_far ? t_near : std::numeric_limits<float>::infinity();
+}
+
+// Retorna o objeto cuja AABB é a primeira atravessada pelo raio origin + t *
+// direction, com 0 <= t <= max_t, e a distância "t" em que o raio entra
+// nela; ou BVH_NO_OBJECT, se o raio não atravessa nenhum objeto. Os nós são
+// visitados do mais próximo para o mais distante, e nós mais distantes que o
+// objeto mais próximo já encontrado são descartados.
+int32_t Bvh_Raycast(const Bvh& bvh, const glm::vec3& origin, const glm::vec3& direction, float max_t,
+                    float* hit_t) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    glm::vec3   inverse_direction = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    int32_t best_object = BVH_NO_OBJECT;
+    float   best_t      = infinity;
+    if (bvh.nodes.empty()) {
+        return BVH_NO_OBJECT;
+    }
+
+    struct Entry {
+        int32_t node;
+        float   t;  // Distância de entrada na AABB do nó
+    };
+    Entry stack[BVH_MAX_DEPTH + 1];
+    int   size = 0;
+
+    float t = Bvh_RayBox(origin, inverse_direction, bvh.nodes[0].bbox_min, bvh.nodes[0].bbox_max, max_t);
+    if (t < infinity) {
+        stack[size++] = {0, t};
+    }
+
+    while (size > 0) {
+        Entry entry = stack[--size];
+        if (entry.t >= best_t) {
+            continue;
+        }
+        const BvhNode& node = bvh.nodes[entry.node];
+
+        if (node.count > 0) {
+            for (int32_t i = node.first; i < node.first + node.count; ++i) {
+                uint32_t object = bvh.objects[i];
+                float    t_object =
+                        Bvh_RayBox(origin, inverse_direction, bvh.centers[object] - bvh.extents[object],
+                                   bvh.centers[object] + bvh.extents[object], max_t);
+                if (t_object < best_t) {
+                    best_t      = t_object;
+                    best_object = static_cast<int32_t>(object);
+                }
+            }
+            continue;
+        }
+
+        // O filho mais próximo é empilhado por último, para ser visitado
+        // primeiro.
+        const BvhNode& left    = bvh.nodes[node.first];
+        const BvhNode& right   = bvh.nodes[node.first + 1];
+        float          t_left  = Bvh_RayBox(origin, inverse_direction, left.bbox_min, left.bbox_max, max_t);
+        float          t_right = Bvh_RayBox(origin, inverse_direction, right.bbox_min, right.bbox_max, max_t);
+        Entry          near    = {node.first, t_left};
+        Entry          far     = {node.first + 1, t_right};
+        if (t_right < t_left) {
+            std::swap(near, far);
+        }
+        if (far.t < best_t) {
+            stack[size++] = far;
+        }
+        if (near.t < best_t) {
+            stack[size++] = near;
+        }
+    }
+
+    if (hit_t != nullptr) {
+        *hit_t = best_t;
+    }
+    return best_object;
+}
+
+// Quadrado da distância de um ponto à AABB [bbox_min, bbox_max] (zero se o
+// ponto está dentro dela).
+float Bvh_PointBoxDistance2(const glm::vec3& point, const glm::vec3& bbox_min, const glm::vec3& bbox_max) {
+    float distance2 = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        float d = std::max(std::max(bbox_min[k] - point[k], point[k] - bbox_max[k]), 0.0f);
+        distance2 += d * d;
+    }
+    return distance2;
+}
+
+// Adiciona a "results" os objetos cuja AABB tem algum ponto a uma distância
+// de no máximo "radius" de "center", retornando quantos foram adicionados.
+size_t Bvh_QuerySphere(const Bvh& bvh, const glm::vec3& center, float radius, std::vector<uint32_t>* results) {
+    if (bvh.nodes.empty()) {
+        return 0;
+    }
+
+    const float radius2 = radius * radius;
+    size_t      count   = results->size();
+
+    int32_t stack[BVH_MAX_DEPTH + 1];
+    int     size  = 0;
+    stack[size++] = 0;
+
+    while (size > 0) {
+        const BvhNode& node = bvh.nodes[stack[--size]];
+        if (Bvh_PointBoxDistance2(center, node.bbox_min, node.bbox_max) > radius2) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack[size++] = node.first + 1;
+            stack[size++] = node.first;
+            continue;
+        }
+
+        for (int32_t i = node.first; i < node.first + node.count; ++i) {
+            uint32_t object = bvh.objects[i];
+            if (Bvh_PointBoxDistance2(center, bvh.centers[object] - bvh.extents[object],
+                                      bvh.centers[object] + bvh.extents[object]) <= radius2) {
+                results->push_back(object);
+            }
+        }
+    }
+    return results->size() - count;
+}
+
+#endif  // _BVH_H
+// vim: set spell spelllang=pt_br :
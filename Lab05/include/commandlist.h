@@ -0,0 +1,200 @@
+#ifndef _COMMANDLIST_H
+#define _COMMANDLIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "instancing.h"
+#include "occlusion.h"
+#include "uniformbuffer.h"
+
+// Lista de comandos de renderização: em vez de chamar OpenGL diretamente, a
+// preparação de um quadro grava, em ordem, cada troca de estado e cada
+// desenho em uma lista, que é executada depois com CommandList_Execute(),
+// possivelmente por outra thread (veja "renderthread.h"). Somente quem
+// executa a lista precisa do contexto OpenGL.
+//
+// Cada comando guarda tudo o que é necessário para executá-lo (IDs de
+// objetos OpenGL, intervalos de índices, posições nos buffers do quadro), e
+// não aponta para os objetos da cena, que podem mudar enquanto a lista é
+// executada. Os vetores da lista são reaproveitados de um quadro para o
+// outro: depois dos primeiros quadros, gravar uma lista não aloca memória.
+
+// Tipos de comandos.
+#define COMMAND_BIND_PROGRAM       0  // glUseProgram()
+#define COMMAND_BIND_VERTEX_ARRAY  1  // glBindVertexArray()
+#define COMMAND_BIND_TEXTURE       2  // glBindTexture() em uma unidade de textura
+#define COMMAND_BIND_UNIFORM_BLOCK 3  // Bloco ObjectUniforms do quadro (veja UniformRing_Bind())
+#define COMMAND_DRAW               4  // glDrawElementsBaseVertex()
+#define COMMAND_DRAW_INSTANCED     5  // glDrawElementsInstancedBaseVertex() (veja "instancing.h")
+#define COMMAND_DRAW_RANGES        6  // glMultiDrawElementsBaseVertex() (veja "meshlet.h")
+#define COMMAND_BEGIN_OCCLUSION    7  // Teste de oclusão e glBeginConditionalRender() (veja "occlusion.h")
+#define COMMAND_END_OCCLUSION      8  // glEndConditionalRender()
+
+struct RenderCommand {
+    int    type;            // COMMAND_*
+    GLuint object;          // Programa, VAO ou textura (COMMAND_BIND_*)
+    GLenum mode;            // Modo de rasterização (COMMAND_DRAW*)
+    GLint  base_vertex;     // Primeiro vértice da malha na arena (COMMAND_DRAW*)
+    size_t first;           // Primeiro índice, primeiro intervalo, bloco ou unidade de textura
+    size_t count;           // Número de índices ou de intervalos
+    size_t first_instance;  // Instâncias desenhadas (COMMAND_DRAW_INSTANCED)
+    size_t num_instances;
+};
+
+struct CommandList {
+    std::vector<RenderCommand> commands;
+
+    // Intervalos de índices desenhados pelos comandos COMMAND_DRAW_RANGES.
+    std::vector<GLsizei>     range_counts;
+    std::vector<const void*> range_offsets;
+    std::vector<GLint>       range_base_vertices;
+};
+
+// Descarta os comandos gravados, mantendo a memória alocada.
+void CommandList_Clear(CommandList* list) {
+    list->commands.clear();
+    list->range_counts.clear();
+    list->range_offsets.clear();
+    list->range_base_vertices.clear();
+}
+
+// Adiciona um comando do tipo "type", com os demais campos zerados.
+RenderCommand* CommandList_Push(CommandList* list, int type) {
+    RenderCommand command = {type, 0, 0, 0, 0, 0, 0, 0};
+    list->commands.push_back(command);
+    return &list->commands.back();
+}
+
+void CommandList_BindProgram(CommandList* list, GLuint program_id) {
+    CommandList_Push(list, COMMAND_BIND_PROGRAM)->object = program_id;
+}
+
+void CommandList_BindVertexArray(CommandList* list, GLuint vertex_array_object_id) {
+    CommandList_Push(list, COMMAND_BIND_VERTEX_ARRAY)->object = vertex_array_object_id;
+}
+
+void CommandList_BindTexture(CommandList* list, int unit, GLuint texture_id) {
+    RenderCommand* command = CommandList_Push(list, COMMAND_BIND_TEXTURE);
+    command->object        = texture_id;
+    command->first         = static_cast<size_t>(unit);
+}
+
+void CommandList_BindUniformBlock(CommandList* list, size_t block) {
+    CommandList_Push(list, COMMAND_BIND_UNIFORM_BLOCK)->first = block;
+}
+
+// Desenha "num_indices" índices a partir de "first_index", somados a
+// "base_vertex".
+void CommandList_Draw(CommandList* list, GLenum mode, size_t first_index, size_t num_indices, GLint base_vertex) {
+    RenderCommand* command = CommandList_Push(list, COMMAND_DRAW);
+    command->mode          = mode;
+    command->base_vertex   = base_vertex;
+    command->first         = first_index;
+    command->count         = num_indices;
+}
+
+// Como CommandList_Draw(), para as instâncias [first_instance, first_instance
+// + num_instances) do buffer de instâncias do quadro.
+void CommandList_DrawInstanced(CommandList* list, GLenum mode, size_t first_index, size_t num_indices,
+                               GLint base_vertex, size_t first_instance, size_t num_instances) {
+    RenderCommand* command  = CommandList_Push(list, COMMAND_DRAW_INSTANCED);
+    command->mode           = mode;
+    command->base_vertex    = base_vertex;
+    command->first          = first_index;
+    command->count          = num_indices;
+    command->first_instance = first_instance;
+    command->num_instances  = num_instances;
+}
+
+// Desenha "num_ranges" intervalos de índices (número de índices e
+// deslocamento em bytes no buffer de índices), todos com o mesmo
+// "base_vertex". Os intervalos são copiados para a lista.
+void CommandList_DrawRanges(CommandList* list, GLenum mode, const GLsizei* counts, const void* const* offsets,
+                            size_t num_ranges, GLint base_vertex) {
+    RenderCommand* command = CommandList_Push(list, COMMAND_DRAW_RANGES);
+    command->mode          = mode;
+    command->base_vertex   = base_vertex;
+    command->first         = list->range_counts.size();
+    command->count         = num_ranges;
+
+    list->range_counts.insert(list->range_counts.end(), counts, counts + num_ranges);
+    list->range_offsets.insert(list->range_offsets.end(), offsets, offsets + num_ranges);
+    list->range_base_vertices.insert(list->range_base_vertices.end(), num_ranges, base_vertex);
+}
+
+// Os desenhos entre CommandList_BeginOcclusion() e CommandList_EndOcclusion()
+// só acontecem se a AABB do bloco ObjectUniforms atual não estiver escondida
+// pelos objetos já desenhados. Veja "occlusion.h".
+void CommandList_BeginOcclusion(CommandList* list) { CommandList_Push(list, COMMAND_BEGIN_OCCLUSION); }
+
+void CommandList_EndOcclusion(CommandList* list) { CommandList_Push(list, COMMAND_END_OCCLUSION); }
+
+// Executa os comandos da lista, em ordem. Os blocos ObjectUniforms e as
+// instâncias do quadro já devem ter sido enviados para "ring" e "instances";
+// os testes de oclusão usam "occlusion" e o programa "occlusion_program_id".
+void CommandList_Execute(const CommandList& list, const UniformRing& ring, const InstanceBuffer& instances,
+                         OcclusionQueries* occlusion, GLuint occlusion_program_id) {
+    // Programa e VAO atuais, religados depois de cada teste de oclusão.
+    GLuint program = 0;
+    GLuint vao     = 0;
+
+    for (const RenderCommand& command : list.commands) {
+        const void* indices = reinterpret_cast<const void*>(static_cast<uintptr_t>(command.first * sizeof(GLuint)));
+
+        switch (command.type) {
+            case COMMAND_BIND_PROGRAM:
+                glUseProgram(command.object);
+                program = command.object;
+                break;
+            case COMMAND_BIND_VERTEX_ARRAY:
+                glBindVertexArray(command.object);
+                vao = command.object;
+                break;
+            case COMMAND_BIND_TEXTURE:
+                glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(command.first));
+                glBindTexture(GL_TEXTURE_2D, command.object);
+                break;
+            case COMMAND_BIND_UNIFORM_BLOCK:
+                UniformRing_Bind(ring, command.first);
+                break;
+            case COMMAND_DRAW:
+                glDrawElementsBaseVertex(command.mode, static_cast<GLsizei>(command.count), GL_UNSIGNED_INT, indices,
+                                         command.base_vertex);
+                break;
+            case COMMAND_DRAW_INSTANCED:
+                InstanceBuffer_SetupAttributes(instances, command.first_instance);
+                glDrawElementsInstancedBaseVertex(command.mode, static_cast<GLsizei>(command.count), GL_UNSIGNED_INT,
+                                                  indices, static_cast<GLsizei>(command.num_instances),
+                                                  command.base_vertex);
+                break;
+            case COMMAND_DRAW_RANGES:
+                glMultiDrawElementsBaseVertex(command.mode, &list.range_counts[command.first], GL_UNSIGNED_INT,
+                                              &list.range_offsets[command.first], static_cast<GLsizei>(command.count),
+                                              &list.range_base_vertices[command.first]);
+                break;
+            case COMMAND_BEGIN_OCCLUSION: {
+                GLuint query = OcclusionQueries_Test(occlusion, occlusion_program_id);
+
+                // O teste troca o programa e o VAO atuais.
+                glUseProgram(program);
+                glBindVertexArray(vao);
+
+                // Com GL_QUERY_NO_WAIT, a GPU desenha o objeto caso o
+                // resultado da consulta ainda não esteja pronto, em vez de
+                // esperá-lo.
+                glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+                break;
+            }
+            case COMMAND_END_OCCLUSION:
+                glEndConditionalRender();
+                break;
+        }
+    }
+}
+
+#endif  // _COMMANDLIST_H
+// vim: set spell spelllang=pt_br :
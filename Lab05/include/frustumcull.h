@@ -0,0 +1,232 @@
+#ifndef _FRUSTUMCULL_H
+#define _FRUSTUMCULL_H
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "matrices.h"
+#include "parallel.h"
+
+// Com SSE2 (presente em todos os processadores x86 de 64 bits) testamos
+// quatro objetos de uma vez; nos demais processadores usamos somente o teste
+// escalar.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUMCULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Número de objetos testados por tarefa em FrustumCull_Test(). Veja
+// "parallel.h".
+#define FRUSTUMCULL_TASK_SIZE 4096
+
+// Descarte de objetos fora do "view frustum" da câmera.
+//
+// Cada objeto submetido em um quadro é representado pela sua AABB em
+// coordenadas globais: a AABB do objeto (bbox_min, bbox_max) transformada
+// pela sua matriz de modelagem. Um objeto é descartado se a sua AABB está
+// inteiramente do lado de fora de algum dos seis planos do frustum. O teste
+// é conservador: alguns objetos fora do frustum (perto dos seus cantos) não
+// são descartados, mas nenhum objeto visível é descartado.
+//
+// As AABBs são armazenadas como "structure of arrays" (SoA): um array para
+// cada coordenada dos centros e das meias-dimensões de todos os objetos,
+// em vez de um array de structs. Assim, as coordenadas de quatro objetos
+// consecutivos ficam lado a lado na memória, e são carregadas com uma única
+// instrução SSE; os seis planos são testados para os quatro objetos ao
+// mesmo tempo.
+
+// Planos do frustum (a x + b y + c z + d >= 0 para pontos dentro), em
+// coordenadas globais, também em SoA.
+struct FrustumPlanes {
+    float a[6];
+    float b[6];
+    float c[6];
+    float d[6];
+};
+
+struct FrustumCullBatch {
+    std::vector<float>   center_x;  // Centro da AABB em coordenadas globais
+    std::vector<float>   center_y;
+    std::vector<float>   center_z;
+    std::vector<float>   extent_x;  // Metade das dimensões da AABB
+    std::vector<float>   extent_y;
+    std::vector<float>   extent_z;
+    std::vector<uint8_t> visible;   // Resultado de FrustumCull_Test(), 1 se o objeto é visível
+};
+
+// Objetos testados e descartados em um quadro.
+struct FrustumCullStats {
+    size_t num_objects;
+    size_t num_culled;
+};
+
+// Extrai os planos do frustum das linhas da matriz "projection * view"
+// (Gribb e Hartmann). Os planos não são normalizados, pois o teste só
+// compara distâncias ao mesmo plano.
+void FrustumCull_ExtractPlanes(const glm::mat4& view_projection, FrustumPlanes* planes) {
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i) {
+        row[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i],
+                           view_projection[3][i]);
+    }
+
+    const glm::vec4 all[6] = {row[3] + row[0], row[3] - row[0], row[3] + row[1],
+                              row[3] - row[1], row[3] + row[2], row[3] - row[2]};
+    for (int p = 0; p < 6; ++p) {
+        planes->a[p] = all[p].x;
+        planes->b[p] = all[p].y;
+        planes->c[p] = all[p].z;
+        planes->d[p] = all[p].w;
+    }
+}
+
+void FrustumCull_Clear(FrustumCullBatch* batch) {
+    batch->center_x.clear();
+    batch->center_y.clear();
+    batch->center_z.clear();
+    batch->extent_x.clear();
+    batch->extent_y.clear();
+    batch->extent_z.clear();
+    batch->visible.clear();
+}
+
+// Muda o número de objetos do lote para "count". Os objetos novos devem ser
+// preenchidos com FrustumCull_Set(), o que pode ser feito em paralelo.
+void FrustumCull_Resize(FrustumCullBatch* batch, size_t count) {
+    batch->center_x.resize(count);
+    batch->center_y.resize(count);
+    batch->center_z.resize(count);
+    batch->extent_x.resize(count);
+    batch->extent_y.resize(count);
+    batch->extent_z.resize(count);
+    batch->visible.resize(count, 1);
+}
+
+// Define o objeto "index" do lote, com AABB (bbox_min, bbox_max) e matriz de
+// modelagem "model". A AABB transformada é a menor AABB que contém a AABB
+// original após a transformação (Arvo): o centro é transformado como um
+// ponto, e cada meia-dimensão é a soma das meias-dimensões originais
+// ponderadas pelo valor absoluto dos coeficientes da matriz.
+void FrustumCull_Set(FrustumCullBatch* batch, size_t index, const glm::vec3& bbox_min, const glm::vec3& bbox_max,
+                     const glm::mat4& model) {
+    glm::vec3 center = 0.5f * (bbox_min + bbox_max);
+    glm::vec3 extent = 0.5f * (bbox_max - bbox_min);
+
+    glm::vec4 world        = Matrix_Multiply_Vector(model, glm::vec4(center, 1.0f));
+    batch->center_x[index] = world.x;
+    batch->center_y[index] = world.y;
+    batch->center_z[index] = world.z;
+
+    float e[3];
+    for (int i = 0; i < 3; ++i) {
+        e[i] = std::fabs(model[0][i]) * extent.x + std::fabs(model[1][i]) * extent.y +
+               std::fabs(model[2][i]) * extent.z;
+    }
+    batch->extent_x[index] = e[0];
+    batch->extent_y[index] = e[1];
+    batch->extent_z[index] = e[2];
+    batch->visible[index]  = 1;
+}
+
+// Adiciona um objeto ao fim do lote (veja FrustumCull_Set()), retornando a
+// sua posição.
+size_t FrustumCull_Add(FrustumCullBatch* batch, const glm::vec3& bbox_min, const glm::vec3& bbox_max,
+                       const glm::mat4& model) {
+    size_t index = batch->visible.size();
+    FrustumCull_Resize(batch, index + 1);
+    FrustumCull_Set(batch, index, bbox_min, bbox_max, model);
+    return index;
+}
+
+// Testa os objetos [first, last) do lote, um por vez. A distância do centro
+// da AABB ao plano é comparada com o "raio" da AABB na direção da normal do
+// plano.
+size_t FrustumCull_TestScalar(const FrustumPlanes& planes, FrustumCullBatch* batch, size_t first, size_t last) {
+    size_t num_visible = 0;
+    for (size_t i = first; i < last; ++i) {
+        bool outside = false;
+        for (int p = 0; p < 6; ++p) {
+            float distance = planes.a[p] * batch->center_x[i] + planes.b[p] * batch->center_y[i] +
+                             planes.c[p] * batch->center_z[i] + planes.d[p];
+            float radius   = std::fabs(planes.a[p]) * batch->extent_x[i] + std::fabs(planes.b[p]) * batch->extent_y[i] +
+                             std::fabs(planes.c[p]) * batch->extent_z[i];
+            outside = outside || distance + radius < 0.0f;
+        }
+        batch->visible[i] = outside ? 0 : 1;
+        num_visible += outside ? 0 : 1;
+    }
+    return num_visible;
+}
+
+// Testa os objetos [first, last) do lote, quatro de cada vez com SSE,
+// preenchendo batch->visible. Retorna o número de objetos visíveis.
+size_t FrustumCull_TestRange(const FrustumPlanes& planes, FrustumCullBatch* batch, size_t first, size_t last) {
+    size_t num_visible = 0;
+
+#ifdef FRUSTUMCULL_SSE
+    // Coeficientes de cada plano replicados nas quatro posições dos
+    // registradores, e os seus valores absolutos.
+    __m128 a[6], b[6], c[6], d[6], abs_a[6], abs_b[6], abs_c[6];
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (int p = 0; p < 6; ++p) {
+        a[p]     = _mm_set1_ps(planes.a[p]);
+        b[p]     = _mm_set1_ps(planes.b[p]);
+        c[p]     = _mm_set1_ps(planes.c[p]);
+        d[p]     = _mm_set1_ps(planes.d[p]);
+        abs_a[p] = _mm_andnot_ps(sign, a[p]);
+        abs_b[p] = _mm_andnot_ps(sign, b[p]);
+        abs_c[p] = _mm_andnot_ps(sign, c[p]);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    for (; first + 4 <= last; first += 4) {
+        __m128 cx = _mm_loadu_ps(&batch->center_x[first]);
+        __m128 cy = _mm_loadu_ps(&batch->center_y[first]);
+        __m128 cz = _mm_loadu_ps(&batch->center_z[first]);
+        __m128 ex = _mm_loadu_ps(&batch->extent_x[first]);
+        __m128 ey = _mm_loadu_ps(&batch->extent_y[first]);
+        __m128 ez = _mm_loadu_ps(&batch->extent_z[first]);
+
+        // Mesma ordem de operações de FrustumCull_TestScalar(), para que os
+        // dois testes deem exatamente o mesmo resultado.
+        __m128 outside = zero;
+        for (int p = 0; p < 6; ++p) {
+            __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], cx), _mm_mul_ps(b[p], cy)), _mm_mul_ps(c[p], cz)), d[p]);
+            __m128 radius   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_a[p], ex), _mm_mul_ps(abs_b[p], ey)),
+                                         _mm_mul_ps(abs_c[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; ++k) {
+            uint8_t visible           = (mask & (1 << k)) != 0 ? 0 : 1;
+            batch->visible[first + k] = visible;
+            num_visible += visible;
+        }
+    }
+#endif
+
+    // Objetos restantes (ou todos, sem SSE).
+    num_visible += FrustumCull_TestScalar(planes, batch, first, last);
+    return num_visible;
+}
+
+// Testa todos os objetos do lote, em paralelo, preenchendo batch->visible.
+// Retorna o número de objetos visíveis.
+size_t FrustumCull_Test(const FrustumPlanes& planes, FrustumCullBatch* batch) {
+    std::atomic<size_t> num_visible(0);
+    ParallelForRange(batch->visible.size(), FRUSTUMCULL_TASK_SIZE, [&](size_t first, size_t last) {
+        num_visible += FrustumCull_TestRange(planes, batch, first, last);
+    });
+    return num_visible;
+}
+
+#endif  // _FRUSTUMCULL_H
+// vim: set spell spelllang=pt_br :
@@ -0,0 +1,306 @@
+#ifndef _GEOMETRYARENA_H
+#define _GEOMETRYARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "mesh.h"
+
+// Arena de geometria: todas as malhas da cena ficam em um único VBO e um
+// único buffer de índices, descritos por um único VAO. Antes cada ".obj"
+// tinha o seu próprio VAO e buffers, e DrawVirtualObject() precisava trocar de
+// VAO a cada objeto desenhado.
+//
+// Cada malha recebe um intervalo de vértices e um intervalo de índices dos
+// buffers compartilhados (veja ArenaAllocator). Os índices de uma malha
+// continuam relativos ao seu primeiro vértice: o deslocamento é aplicado pela
+// GPU com glDrawElementsBaseVertex(). Assim, os índices são copiados sem
+// modificação, e uma malha pode ser removida da arena, liberando o seu
+// espaço para as próximas.
+//
+// Todas as malhas de uma arena usam o mesmo VertexFormat, já que os
+// atributos de vértices são definidos uma única vez no VAO.
+
+// Capacidade inicial da arena. Quando uma malha não cabe no espaço livre, os
+// buffers são realocados com pelo menos o dobro do tamanho.
+#define GEOMETRYARENA_INITIAL_VERTICES (256 * 1024)
+#define GEOMETRYARENA_INITIAL_INDICES  (1024 * 1024)
+
+// Intervalo [offset, offset + size) de uma arena, em elementos.
+struct ArenaRange {
+    size_t offset;
+    size_t size;
+};
+
+// Alocador de intervalos com lista de blocos livres. Os blocos livres ficam
+// ordenados por posição, o que permite juntar blocos vizinhos ao liberar um
+// intervalo. A alocação escolhe o menor bloco livre em que o intervalo cabe
+// ("best fit"), preservando os blocos grandes para as malhas grandes.
+struct ArenaAllocator {
+    size_t                  capacity;     // Número total de elementos
+    size_t                  used;         // Número de elementos alocados
+    std::vector<ArenaRange> free_ranges;  // Blocos livres, ordenados por offset e nunca vizinhos
+};
+
+void ArenaAllocator_Init(ArenaAllocator* allocator, size_t capacity) {
+    allocator->capacity = capacity;
+    allocator->used     = 0;
+    allocator->free_ranges.clear();
+    if (capacity > 0) {
+        ArenaRange all = {0, capacity};
+        allocator->free_ranges.push_back(all);
+    }
+}
+
+// Aloca "size" elementos. Retorna false caso nenhum bloco livre seja grande
+// o suficiente.
+bool ArenaAllocator_Allocate(ArenaAllocator* allocator, size_t size, size_t* offset) {
+    if (size == 0) {
+        *offset = 0;
+        return true;
+    }
+
+    std::vector<ArenaRange>& ranges = allocator->free_ranges;
+
+    size_t best = ranges.size();
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (ranges[i].size >= size && (best == ranges.size() || ranges[i].size < ranges[best].size)) {
+            best = i;
+        }
+    }
+    if (best == ranges.size()) {
+        return false;
+    }
+
+    *offset = ranges[best].offset;
+    ranges[best].offset += size;
+    ranges[best].size -= size;
+    if (ranges[best].size == 0) {
+        ranges.erase(ranges.begin() + best);
+    }
+
+    allocator->used += size;
+    return true;
+}
+
+// Devolve um intervalo alocado por ArenaAllocator_Allocate(), juntando-o com
+// os blocos livres vizinhos.
+void ArenaAllocator_Free(ArenaAllocator* allocator, size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    std::vector<ArenaRange>& ranges = allocator->free_ranges;
+
+    // Primeiro bloco livre depois do intervalo.
+    size_t next = 0;
+    while (next < ranges.size() && ranges[next].offset < offset) {
+        ++next;
+    }
+
+    bool merge_prev = next > 0 && ranges[next - 1].offset + ranges[next - 1].size == offset;
+    bool merge_next = next < ranges.size() && offset + size == ranges[next].offset;
+
+    if (merge_prev && merge_next) {
+        ranges[next - 1].size += size + ranges[next].size;
+        ranges.erase(ranges.begin() + next);
+    } else if (merge_prev) {
+        ranges[next - 1].size += size;
+    } else if (merge_next) {
+        ranges[next].offset = offset;
+        ranges[next].size += size;
+    } else {
+        ArenaRange range = {offset, size};
+        ranges.insert(ranges.begin() + next, range);
+    }
+
+    allocator->used -= size;
+}
+
+// Aumenta a capacidade do alocador; o espaço novo fica livre no fim.
+void ArenaAllocator_Grow(ArenaAllocator* allocator, size_t capacity) {
+    size_t old_capacity = allocator->capacity;
+    allocator->capacity = capacity;
+    allocator->used += capacity - old_capacity;  // ArenaAllocator_Free() desconta o espaço novo
+    ArenaAllocator_Free(allocator, old_capacity, capacity - old_capacity);
+}
+
+// Tamanho do maior bloco livre: a maior malha que pode ser alocada sem
+// realocar a arena.
+size_t ArenaAllocator_LargestFree(const ArenaAllocator& allocator) {
+    size_t largest = 0;
+    for (const ArenaRange& range : allocator.free_ranges) {
+        largest = std::max(largest, range.size);
+    }
+    return largest;
+}
+
+// Fragmentação do espaço livre, entre 0 (todo o espaço livre em um único
+// bloco) e 1 (espaço livre espalhado em blocos muito pequenos).
+float ArenaAllocator_Fragmentation(const ArenaAllocator& allocator) {
+    size_t free_size = allocator.capacity - allocator.used;
+    if (free_size == 0) {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(ArenaAllocator_LargestFree(allocator)) / static_cast<float>(free_size);
+}
+
+struct GeometryArena {
+    VertexFormat   format;                  // Formato de todos os vértices da arena
+    GLuint         vertex_array_object_id;  // VAO compartilhado por todas as malhas
+    GLuint         vertex_buffer_id;        // VBO "interleaved" com os vértices de todas as malhas
+    GLuint         index_buffer_id;         // Índices de todas as malhas
+    ArenaAllocator vertices;                // Em número de vértices
+    ArenaAllocator indices;                 // Em número de índices
+    size_t         num_reallocations;       // Quantas vezes os buffers foram aumentados
+};
+
+// Espaço ocupado por uma malha dentro da arena. Os objetos da malha são
+// desenhados com "base_vertex" como deslocamento dos índices, e com seus
+// intervalos de índices deslocados por "first_index".
+struct GeometryAllocation {
+    size_t base_vertex;   // Primeiro vértice da malha no VBO da arena
+    size_t num_vertices;  // Número de vértices da malha
+    size_t first_index;   // Primeiro índice da malha no buffer de índices da arena
+    size_t num_indices;   // Número de índices da malha
+};
+
+// Cria um buffer com "size" bytes e copia para ele os "copy_size" primeiros
+// bytes de "old_buffer" (caso exista), que é então destruído.
+GLuint GeometryArena_ReallocateBuffer(GLuint old_buffer, size_t copy_size, size_t size) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STATIC_DRAW);
+
+    if (old_buffer != 0) {
+        if (copy_size > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(copy_size));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &old_buffer);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffer;
+}
+
+// (Re)define os buffers apontados pelo VAO da arena.
+void GeometryArena_SetupVertexArray(GeometryArena* arena) {
+    glBindVertexArray(arena->vertex_array_object_id);
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena->vertex_buffer_id);
+    SetupVertexAttributes(arena->format);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // O buffer de índices faz parte do estado do VAO, e portanto não deve ser
+    // "desligado" antes do VAO.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->index_buffer_id);
+
+    glBindVertexArray(0);
+}
+
+// Aumenta os buffers da arena para pelo menos "num_vertices" vértices e
+// "num_indices" índices, copiando o conteúdo atual na GPU.
+void GeometryArena_Grow(GeometryArena* arena, size_t num_vertices, size_t num_indices) {
+    const size_t stride = arena->format.stride;
+
+    if (num_vertices > arena->vertices.capacity) {
+        size_t capacity         = std::max(num_vertices, 2 * arena->vertices.capacity);
+        arena->vertex_buffer_id = GeometryArena_ReallocateBuffer(arena->vertex_buffer_id,
+                                                                 arena->vertices.capacity * stride, capacity * stride);
+        ArenaAllocator_Grow(&arena->vertices, capacity);
+    }
+
+    if (num_indices > arena->indices.capacity) {
+        size_t capacity        = std::max(num_indices, 2 * arena->indices.capacity);
+        arena->index_buffer_id = GeometryArena_ReallocateBuffer(
+                arena->index_buffer_id, arena->indices.capacity * sizeof(GLuint), capacity * sizeof(GLuint));
+        ArenaAllocator_Grow(&arena->indices, capacity);
+    }
+
+    arena->num_reallocations += 1;
+    GeometryArena_SetupVertexArray(arena);
+}
+
+// Cria a arena (deve ser chamada depois que o contexto OpenGL existir).
+void GeometryArena_Init(GeometryArena* arena, const VertexFormat& format) {
+    arena->format            = format;
+    arena->vertex_buffer_id  = 0;
+    arena->index_buffer_id   = 0;
+    arena->num_reallocations = 0;
+    ArenaAllocator_Init(&arena->vertices, 0);
+    ArenaAllocator_Init(&arena->indices, 0);
+
+    glGenVertexArrays(1, &arena->vertex_array_object_id);
+    GeometryArena_Grow(arena, GEOMETRYARENA_INITIAL_VERTICES, GEOMETRYARENA_INITIAL_INDICES);
+    arena->num_reallocations = 0;
+}
+
+// Copia os vértices e índices de uma malha para a arena, aumentando os
+// buffers caso não haja um bloco livre grande o suficiente. Os ponteiros da
+// malha são passados diretamente para glBufferSubData(), então eles podem
+// apontar para um arquivo mapeado em memória (veja "meshcache.h"). Retorna
+// false caso o formato dos vértices da malha seja diferente do da arena.
+bool GeometryArena_Upload(GeometryArena* arena, const MeshView& mesh, GeometryAllocation* allocation) {
+    if (mesh.format.stride != arena->format.stride || mesh.format.position_format != arena->format.position_format ||
+        mesh.format.normal_format != arena->format.normal_format ||
+        mesh.format.texcoord_format != arena->format.texcoord_format) {
+        fprintf(stderr, "ERROR: Mesh vertex format does not match the geometry arena.\n");
+        return false;
+    }
+
+    allocation->num_vertices = mesh.num_vertices;
+    allocation->num_indices  = mesh.num_indices;
+
+    if (!ArenaAllocator_Allocate(&arena->vertices, mesh.num_vertices, &allocation->base_vertex)) {
+        GeometryArena_Grow(arena, arena->vertices.capacity + mesh.num_vertices, 0);
+        ArenaAllocator_Allocate(&arena->vertices, mesh.num_vertices, &allocation->base_vertex);
+    }
+    if (!ArenaAllocator_Allocate(&arena->indices, mesh.num_indices, &allocation->first_index)) {
+        GeometryArena_Grow(arena, 0, arena->indices.capacity + mesh.num_indices);
+        ArenaAllocator_Allocate(&arena->indices, mesh.num_indices, &allocation->first_index);
+    }
+
+    // Usamos os "binding points" de cópia para não alterar o estado do VAO.
+    const size_t stride = arena->format.stride;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vertex_buffer_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation->base_vertex * stride),
+                    static_cast<GLsizeiptr>(mesh.num_vertices * stride), mesh.vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->index_buffer_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation->first_index * sizeof(GLuint)),
+                    static_cast<GLsizeiptr>(mesh.num_indices * sizeof(GLuint)), mesh.indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return true;
+}
+
+// Libera o espaço de uma malha enviada por GeometryArena_Upload(). O
+// conteúdo dos buffers não é alterado; o espaço é reaproveitado pelas
+// próximas malhas.
+void GeometryArena_Free(GeometryArena* arena, const GeometryAllocation& allocation) {
+    ArenaAllocator_Free(&arena->vertices, allocation.base_vertex, allocation.num_vertices);
+    ArenaAllocator_Free(&arena->indices, allocation.first_index, allocation.num_indices);
+}
+
+// Imprime a ocupação e a fragmentação da arena.
+void GeometryArena_PrintStats(const GeometryArena& arena) {
+    const double mb     = 1.0 / (1024.0 * 1024.0);
+    const size_t stride = arena.format.stride;
+
+    printf("Arena de geometria: vértices %.1f/%.1f MB (%d blocos livres, fragmentação %.0f%%), "
+           "índices %.1f/%.1f MB (%d blocos livres, fragmentação %.0f%%), %d realocações.\n",
+           arena.vertices.used * stride * mb, arena.vertices.capacity * stride * mb,
+           static_cast<int>(arena.vertices.free_ranges.size()), 100.0f * ArenaAllocator_Fragmentation(arena.vertices),
+           arena.indices.used * sizeof(GLuint) * mb, arena.indices.capacity * sizeof(GLuint) * mb,
+           static_cast<int>(arena.indices.free_ranges.size()), 100.0f * ArenaAllocator_Fragmentation(arena.indices),
+           static_cast<int>(arena.num_reallocations));
+}
+
+#endif  // _GEOMETRYARENA_H
+// vim: set spell spelllang=pt_br :
@@ -0,0 +1,106 @@
+#ifndef _INSTANCING_H
+#define _INSTANCING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "glad/glad.h"
+#include <glm/mat4x4.hpp>
+
+#include "matrices.h"
+
+// Renderização instanciada: vários objetos que usam a mesma malha são
+// desenhados com uma única chamada glDrawElementsInstancedBaseVertex(). Os
+// dados que mudam de um objeto para o outro (matriz de modelagem e
+// "object_id") não são enviados com glUniform*(), e sim como atributos de
+// vértices de um VBO separado, que avançam uma vez por instância em vez de
+// uma vez por vértice (veja glVertexAttribDivisor()). Veja a variante
+// INSTANCED de "shader_vertex.glsl".
+
+// Posições ("location") dos atributos de instância em "shader_vertex.glsl".
+// A matriz de modelagem é uma matriz afim 3x4 (veja AffineMatrix em
+// "matrices.h"), que ocupa três posições consecutivas, uma por linha.
+#define INSTANCE_ATTRIBUTE_MODEL     3  // Posições 3, 4 e 5
+#define INSTANCE_ATTRIBUTE_OBJECT_ID 6
+
+// Dados de uma instância, como armazenados no VBO.
+struct InstanceData {
+    float   model[12];   // Matriz de modelagem, por linhas (como AffineMatrix)
+    int32_t object_id;   // Material da instância ("object_id" em "shader_fragment.glsl")
+    int32_t padding[3];  // Alinha cada instância em 16 bytes
+};
+
+// VBO com as instâncias do quadro atual. As instâncias são gravadas junto
+// com o quadro (veja "renderthread.h") e enviadas por InstanceBuffer_Upload().
+struct InstanceBuffer {
+    GLuint buffer_id;
+    size_t capacity;  // Número de instâncias que cabem no VBO
+};
+
+void InstanceBuffer_Init(InstanceBuffer* buffer) {
+    glGenBuffers(1, &buffer->buffer_id);
+    buffer->capacity = 0;
+}
+
+// Preenche uma instância. Instâncias diferentes podem ser preenchidas em
+// paralelo.
+void InstanceData_Set(InstanceData* instance, const AffineMatrix& model, int object_id) {
+    memcpy(instance->model, &model.rows[0][0], sizeof(instance->model));
+    instance->object_id = object_id;
+    memset(instance->padding, 0, sizeof(instance->padding));
+}
+
+// Envia as "count" instâncias do quadro atual para a GPU. O conteúdo
+// anterior do VBO é descartado ("orphaning") antes da cópia, para que o
+// driver não precise esperar a GPU terminar de desenhar o quadro anterior.
+void InstanceBuffer_Upload(InstanceBuffer* buffer, const InstanceData* instances, size_t count) {
+    if (count > buffer->capacity) {
+        buffer->capacity = std::max(count, 2 * buffer->capacity);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer->buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(buffer->capacity * sizeof(InstanceData)), nullptr,
+                 GL_STREAM_DRAW);
+    if (count > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(count * sizeof(InstanceData)), instances);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Aponta os atributos de instância do VAO atualmente "ligado" para as
+// instâncias a partir de "first_instance". OpenGL 3.3 não tem
+// glDrawElementsInstancedBaseVertexBaseInstance() (OpenGL 4.2), então a
+// primeira instância de cada desenho é escolhida pelo deslocamento dos
+// atributos.
+//
+// Programas que não usam estes atributos (a variante não instanciada de
+// "shader_vertex.glsl") simplesmente os ignoram, então eles podem continuar
+// habilitados no VAO.
+void InstanceBuffer_SetupAttributes(const InstanceBuffer& buffer, size_t first_instance) {
+    const GLsizei stride = sizeof(InstanceData);
+    const size_t  base   = first_instance * sizeof(InstanceData);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.buffer_id);
+
+    for (GLuint row = 0; row < 3; ++row) {
+        GLuint location = INSTANCE_ATTRIBUTE_MODEL + row;
+        size_t offset   = base + row * 4 * sizeof(float);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+
+    size_t offset = base + offsetof(InstanceData, object_id);
+    glVertexAttribIPointer(INSTANCE_ATTRIBUTE_OBJECT_ID, 1, GL_INT, stride,
+                           reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)));
+    glVertexAttribDivisor(INSTANCE_ATTRIBUTE_OBJECT_ID, 1);
+    glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_OBJECT_ID);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif  // _INSTANCING_H
+// vim: set spell spelllang=pt_br :
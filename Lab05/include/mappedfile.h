@@ -0,0 +1,123 @@
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Arquivo mapeado em memória (somente leitura). O conteúdo do arquivo é
+// acessado diretamente através do ponteiro "data", sem cópias: o sistema
+// operacional carrega as páginas sob demanda.
+struct MappedFile {
+    const unsigned char* data;
+    size_t               size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+// Mapeia o arquivo "filename" em memória. Retorna false caso o arquivo não
+// exista, esteja vazio, ou não possa ser mapeado.
+bool MapFile(const std::string& filename, MappedFile* mapped) {
+    mapped->data = nullptr;
+    mapped->size = 0;
+
+#ifdef _WIN32
+    mapped->file    = INVALID_HANDLE_VALUE;
+    mapped->mapping = nullptr;
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mapped->file    = file;
+    mapped->mapping = mapping;
+    mapped->data    = static_cast<const unsigned char*>(data);
+    mapped->size    = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // O mapeamento continua válido após fecharmos o descritor do arquivo.
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    mapped->data = static_cast<const unsigned char*>(data);
+    mapped->size = static_cast<size_t>(st.st_size);
+#endif
+
+    return true;
+}
+
+// Desfaz o mapeamento criado por MapFile(). Todos os ponteiros para dentro do
+// arquivo se tornam inválidos.
+void UnmapFile(MappedFile* mapped) {
+    if (mapped->data == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapped->data);
+    CloseHandle(mapped->mapping);
+    CloseHandle(mapped->file);
+    mapped->file    = INVALID_HANDLE_VALUE;
+    mapped->mapping = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(mapped->data), mapped->size);
+#endif
+
+    mapped->data = nullptr;
+    mapped->size = 0;
+}
+
+#endif  // _MAPPEDFILE_H
+// vim: set spell spelllang=pt_br :
@@ -1,13 +1,32 @@
 #ifndef _MATRICES_H
 #define _MATRICES_H
 
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/matrix.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// Com SSE2 (presente em todos os processadores x86 de 64 bits), os produtos,
+// a transposta e as inversas de Matrix_Multiply() e seguintes operam sobre
+// uma coluna inteira (quatro floats) por instrução; com AVX, o produto de
+// matrizes calcula duas colunas por instrução. Nos demais processadores, ou
+// se MATRICES_SCALAR for definida antes de incluir este arquivo, usamos as
+// versões escalares (Matrix_Multiply_Scalar() e seguintes).
+#if !defined(MATRICES_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATRICES_SSE 1
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define MATRICES_AVX 1
+#include <immintrin.h>
+#endif
+#endif
+
 // Esta função Matrix() auxilia na criação de matrizes usando a biblioteca GLM.
 // Note que em OpenGL (e GLM) as matrizes são definidas como "column-major",
 // onde os elementos da matriz são armazenadas percorrendo as COLUNAS da mesma.
@@ -27,7 +46,11 @@
 //
 // Para conseguirmos definir matrizes através de suas LINHAS, a função Matrix()
 // computa a transposta usando os elementos passados por parâmetros.
-glm::mat4 Matrix(
+//
+// Matrix() e as funções abaixo que só dependem dela são constexpr: quando os
+// parâmetros são conhecidos em tempo de compilação, a matriz é calculada pelo
+// compilador e armazenada como dado no executável.
+constexpr glm::mat4 Matrix(
     float m00, float m01, float m02, float m03, // LINHA 1
     float m10, float m11, float m12, float m13, // LINHA 2
     float m20, float m21, float m22, float m23, // LINHA 3
@@ -43,7 +66,7 @@ glm::mat4 Matrix(
 }
 
 // Matriz identidade.
-glm::mat4 Matrix_Identity()
+constexpr glm::mat4 Matrix_Identity()
 {
     return Matrix(
         1.0f , 0.0f , 0.0f , 0.0f , // LINHA 1
@@ -59,7 +82,7 @@ glm::mat4 Matrix_Identity()
 //
 //     T*p = p+t.
 //
-glm::mat4 Matrix_Translate(float tx, float ty, float tz)
+constexpr glm::mat4 Matrix_Translate(float tx, float ty, float tz)
 {
     return Matrix(
         1.0f , 0.0f , 0.0f , tx ,
@@ -75,7 +98,7 @@ glm::mat4 Matrix_Translate(float tx, float ty, float tz)
 //
 //     S*p = [sx*px, sy*py, sz*pz, pw].
 //
-glm::mat4 Matrix_Scale(float sx, float sy, float sz)
+constexpr glm::mat4 Matrix_Scale(float sx, float sy, float sz)
 {
     return Matrix(
         sx   , 0.0f , 0.0f , 0.0f ,
@@ -160,17 +183,11 @@ float norm(glm::vec4 v)
 // coordenadas e em torno do eixo definido pelo vetor 'axis'. Esta matriz pode
 // ser definida pela fórmula de Rodrigues. Lembre-se que o vetor que define o
 // eixo de rotação deve ser normalizado!
-glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis)
+//
+// A fórmula está em Matrix_Rotate_CosSin(), que recebe o cosseno e o seno do
+// ângulo e o eixo já normalizado; ela é compartilhada com Matrix_Const_Rotate().
+constexpr glm::mat4 Matrix_Rotate_CosSin(float c, float s, float vx, float vy, float vz)
 {
-    float c = cos(angle);
-    float s = sin(angle);
-
-    glm::vec4 v = axis / norm(axis);
-
-    float vx = v.x;
-    float vy = v.y;
-    float vz = v.z;
-
     return Matrix(
         vx*vx*(1.0f-c)+c    , vx*vy*(1.0f-c)-vz*s , vx*vz*(1-c)+vy*s , 0.0f ,
         vx*vy*(1.0f-c)+vz*s , vy*vy*(1.0f-c)+c    , vy*vz*(1-c)-vx*s , 0.0f ,
@@ -179,6 +196,131 @@ glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis)
     );
 }
 
+glm::mat4 Matrix_Rotate(float angle, glm::vec4 axis)
+{
+    glm::vec4 v = axis / norm(axis);
+
+    return Matrix_Rotate_CosSin(cos(angle), sin(angle), v.x, v.y, v.z);
+}
+
+// Seno, cosseno e raiz quadrada avaliáveis em tempo de compilação, já que
+// sin(), cos() e sqrt() da biblioteca padrão não são constexpr. O ângulo é
+// reduzido para [-pi,pi] e a série de Taylor é somada em double, com erro bem
+// menor que a precisão de um float. Em tempo de execução, use as funções da
+// biblioteca padrão, que são mais rápidas.
+constexpr double Const_Reduce_Angle(double angle)
+{
+    constexpr double kTwoPi = 6.283185307179586476925;
+
+    double turns = angle / kTwoPi;
+    long long k = static_cast<long long>(turns < 0.0 ? turns - 0.5 : turns + 0.5);
+    return angle - static_cast<double>(k) * kTwoPi;
+}
+
+constexpr float Const_Sin(float angle)
+{
+    double x = Const_Reduce_Angle(angle);
+    double term = x;
+    double sum = x;
+    for (int n = 1; n <= 12; ++n)
+    {
+        term *= -x*x / ((2*n) * (2*n + 1));
+        sum += term;
+    }
+    return static_cast<float>(sum);
+}
+
+constexpr float Const_Cos(float angle)
+{
+    double x = Const_Reduce_Angle(angle);
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n <= 12; ++n)
+    {
+        term *= -x*x / ((2*n - 1) * (2*n));
+        sum += term;
+    }
+    return static_cast<float>(sum);
+}
+
+// Método de Newton, partindo de uma estimativa maior que a raiz: a sequência
+// decresce até parar de mudar.
+constexpr float Const_Sqrt(float value)
+{
+    if (value <= 0.0f)
+        return 0.0f;
+
+    double x = value < 1.0f ? 1.0 : value;
+    while (true)
+    {
+        double next = 0.5 * (x + value / x);
+        if (next >= x)
+            return static_cast<float>(x);
+        x = next;
+    }
+}
+
+// Versões constexpr das matrizes de rotação, para ângulos conhecidos em tempo
+// de compilação.
+constexpr glm::mat4 Matrix_Const_Rotate_X(float angle)
+{
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(
+        1.0f , 0.0f , 0.0f , 0.0f ,
+        0.0f ,  c   , -s   , 0.0f ,
+        0.0f ,  s   ,  c   , 0.0f ,
+        0.0f , 0.0f , 0.0f , 1.0f
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate_Y(float angle)
+{
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(
+         c   , 0.0f ,  s   , 0.0f ,
+        0.0f , 1.0f , 0.0f , 0.0f ,
+        -s   , 0.0f ,  c   , 0.0f ,
+        0.0f , 0.0f , 0.0f , 1.0f
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate_Z(float angle)
+{
+    float c = Const_Cos(angle);
+    float s = Const_Sin(angle);
+    return Matrix(
+         c   , -s   , 0.0f , 0.0f ,
+         s   ,  c   , 0.0f , 0.0f ,
+        0.0f , 0.0f , 1.0f , 0.0f ,
+        0.0f , 0.0f , 0.0f , 1.0f
+    );
+}
+
+constexpr glm::mat4 Matrix_Const_Rotate(float angle, glm::vec4 axis)
+{
+    float n = Const_Sqrt(axis.x*axis.x + axis.y*axis.y + axis.z*axis.z);
+    return Matrix_Rotate_CosSin(Const_Cos(angle), Const_Sin(angle), axis.x/n, axis.y/n, axis.z/n);
+}
+
+// Produto de matrizes C = A*B avaliável em tempo de compilação, para compor
+// transformações constantes. Em tempo de execução, use o operador * da GLM.
+constexpr glm::mat4 Matrix_Const_Multiply(const glm::mat4& a, const glm::mat4& b)
+{
+    float m[4][4] = {}; // m[i][j] é o elemento da LINHA i e COLUNA j de A*B
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            m[i][j] = a[0][i]*b[j][0] + a[1][i]*b[j][1] + a[2][i]*b[j][2] + a[3][i]*b[j][3];
+
+    return Matrix(
+        m[0][0] , m[0][1] , m[0][2] , m[0][3] , // LINHA 1
+        m[1][0] , m[1][1] , m[1][2] , m[1][3] , // LINHA 2
+        m[2][0] , m[2][1] , m[2][2] , m[2][3] , // LINHA 3
+        m[3][0] , m[3][1] , m[3][2] , m[3][3]   // LINHA 4
+    );
+}
+
 // Produto vetorial entre dois vetores u e v definidos em um sistema de
 // coordenadas ortonormal.
 glm::vec4 crossproduct(glm::vec4 u, glm::vec4 v)
@@ -252,6 +394,779 @@ glm::mat4 Matrix_Camera_View(glm::vec4 position_c, glm::vec4 view_vector, glm::v
     );
 }
 
+// Produtos, transposta e inversas de matrizes 4x4.
+//
+// As versões escalares fazem exatamente as mesmas operações de ponto
+// flutuante, na mesma ordem, que os operadores e funções correspondentes da
+// GLM; as versões SSE/AVX fazem as mesmas operações em quatro (ou oito)
+// coeficientes por instrução. Como cada operação de ponto flutuante é
+// arredondada da mesma forma nos dois casos, os resultados são idênticos
+// bit a bit aos da GLM, desde que o compilador não funda multiplicações e
+// somas em instruções FMA. Em C++, o GCC e o Clang fazem isso por padrão
+// sempre que o processador alvo tem FMA (ex.: com -march=native), então o
+// CMakeLists.txt deste laboratório compila com -ffp-contract=off. Veja
+// Matrix_Benchmark() em "src/bench.cpp".
+//
+// Lembre-se que glm::mat4 é "column-major": M[j] é a coluna j, e M[j][i] o
+// coeficiente da linha i e coluna j.
+
+// Produto de matrizes A*B. Cada coluna j do resultado é a combinação das
+// colunas de A com os coeficientes da coluna j de B:
+//
+//   (A*B)[j] = A[0]*B[j][0] + A[1]*B[j][1] + A[2]*B[j][2] + A[3]*B[j][3]
+//
+glm::mat4 Matrix_Multiply_Scalar(const glm::mat4& a, const glm::mat4& b)
+{
+    glm::mat4 r;
+    for (int j = 0; j < 4; ++j)
+        for (int i = 0; i < 4; ++i)
+            r[j][i] = a[0][i]*b[j][0] + a[1][i]*b[j][1] + a[2][i]*b[j][2] + a[3][i]*b[j][3];
+    return r;
+}
+
+// Produto de uma matriz por um vetor, M*v. Como na GLM, os quatro termos são
+// somados dois a dois:
+//
+//   M*v = (M[0]*v[0] + M[1]*v[1]) + (M[2]*v[2] + M[3]*v[3])
+//
+glm::vec4 Matrix_Multiply_Vector_Scalar(const glm::mat4& m, const glm::vec4& v)
+{
+    glm::vec4 r;
+    for (int i = 0; i < 4; ++i)
+        r[i] = (m[0][i]*v[0] + m[1][i]*v[1]) + (m[2][i]*v[2] + m[3][i]*v[3]);
+    return r;
+}
+
+// Transposta de uma matriz.
+glm::mat4 Matrix_Transpose_Scalar(const glm::mat4& m)
+{
+    glm::mat4 r;
+    for (int j = 0; j < 4; ++j)
+        for (int i = 0; i < 4; ++i)
+            r[j][i] = m[i][j];
+    return r;
+}
+
+// Inversa de uma matriz qualquer, pela matriz adjunta (transposta da matriz
+// de cofatores) dividida pelo determinante, com as mesmas contas de
+// glm::inverse().
+//
+// Cada cofator é uma soma de três termos, cada um o produto de um
+// coeficiente por um menor 2x2 ("fator") formado por duas das linhas da
+// matriz. Os fatores das linhas p e q são guardados como vetores
+//
+//   F(p,q) = [ X, X, Y, Z ],  X = m[2][p]*m[3][q] - m[3][p]*m[2][q],
+//                             Y = m[1][p]*m[3][q] - m[3][p]*m[1][q],
+//                             Z = m[1][p]*m[2][q] - m[2][p]*m[1][q],
+//
+// e cada coluna da adjunta é a combinação de três deles, coeficiente a
+// coeficiente, com os vetores V(p) = [ m[1][p], m[0][p], m[0][p], m[0][p] ].
+// Se a matriz não for inversível, o resultado terá infinitos ou NaNs.
+glm::mat4 Matrix_Inverse_Scalar(const glm::mat4& m)
+{
+    // Linhas (p,q) de cada fator: F0 = F(2,3), F1 = F(1,3), ..., F5 = F(0,1).
+    const int rows[6][2] = { {2,3}, {1,3}, {1,2}, {0,3}, {0,2}, {0,1} };
+
+    float factor[6][4];
+    for (int k = 0; k < 6; ++k)
+    {
+        int p = rows[k][0];
+        int q = rows[k][1];
+        factor[k][0] = m[2][p]*m[3][q] - m[3][p]*m[2][q];
+        factor[k][1] = factor[k][0];
+        factor[k][2] = m[1][p]*m[3][q] - m[3][p]*m[1][q];
+        factor[k][3] = m[1][p]*m[2][q] - m[2][p]*m[1][q];
+    }
+
+    float vec[4][4];
+    for (int p = 0; p < 4; ++p)
+    {
+        vec[p][0] = m[1][p];
+        vec[p][1] = m[0][p];
+        vec[p][2] = m[0][p];
+        vec[p][3] = m[0][p];
+    }
+
+    // Coluna j da adjunta: (V(a)*F(b) - V(c)*F(d) + V(e)*F(f)) com os sinais
+    // alternados do cofator.
+    const int terms[4][6] = {
+        { 1,0 , 2,1 , 3,2 },
+        { 0,0 , 2,3 , 3,4 },
+        { 0,1 , 1,3 , 3,5 },
+        { 0,2 , 1,4 , 2,5 }
+    };
+
+    glm::mat4 inverse;
+    for (int j = 0; j < 4; ++j)
+    {
+        const int* t = terms[j];
+        for (int i = 0; i < 4; ++i)
+        {
+            float sign = ((i + j) % 2 == 0) ? 1.0f : -1.0f;
+            inverse[j][i] = (vec[t[0]][i]*factor[t[1]][i] - vec[t[2]][i]*factor[t[3]][i]
+                             + vec[t[4]][i]*factor[t[5]][i]) * sign;
+        }
+    }
+
+    // Determinante: produto da primeira coluna da matriz pela primeira linha
+    // da adjunta.
+    float dot[4];
+    for (int j = 0; j < 4; ++j)
+        dot[j] = m[0][j] * inverse[j][0];
+    float one_over_determinant = 1.0f / ((dot[0] + dot[1]) + (dot[2] + dot[3]));
+
+    for (int j = 0; j < 4; ++j)
+        for (int i = 0; i < 4; ++i)
+            inverse[j][i] = inverse[j][i] * one_over_determinant;
+    return inverse;
+}
+
+// Inversa de uma matriz afim, isto é, com última linha [0,0,0,1], como as
+// matrizes de Matrix_Translate(), Matrix_Scale(), Matrix_Rotate*() e
+// Matrix_Camera_View() e os seus produtos. Seja
+//
+//       [ A  t ]                  [ A^-1  -A^-1*t ]
+//   M = [ 0  1 ],  então   M^-1 = [ 0     1       ],
+//
+// onde as linhas de A^-1 são os produtos vetoriais das colunas c0, c1 e c2
+// de A (c1 x c2, c2 x c0 e c0 x c1) divididos pelo determinante de A,
+// c0 . (c1 x c2). São bem menos contas que em Matrix_Inverse(), e o
+// resultado é muito próximo, mas não idêntico bit a bit.
+glm::mat4 Matrix_Inverse_Affine_Scalar(const glm::mat4& m)
+{
+    glm::vec4 r0 = crossproduct(m[1], m[2]);
+    glm::vec4 r1 = crossproduct(m[2], m[0]);
+    glm::vec4 r2 = crossproduct(m[0], m[1]);
+
+    float one_over_determinant = 1.0f / (m[0][0]*r0[0] + m[0][1]*r0[1] + m[0][2]*r0[2]);
+
+    glm::mat4 inverse;
+    for (int j = 0; j < 3; ++j)
+    {
+        inverse[j][0] = r0[j] * one_over_determinant;
+        inverse[j][1] = r1[j] * one_over_determinant;
+        inverse[j][2] = r2[j] * one_over_determinant;
+        inverse[j][3] = 0.0f;
+    }
+    for (int i = 0; i < 3; ++i)
+        inverse[3][i] = -(inverse[0][i]*m[3][0] + inverse[1][i]*m[3][1] + inverse[2][i]*m[3][2]);
+    inverse[3][3] = 1.0f;
+    return inverse;
+}
+
+#ifdef MATRICES_SSE
+// Copia o coeficiente "k" de um vetor SSE para as suas quatro posições.
+#define MATRICES_SPLAT(v, k) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(k, k, k, k))
+
+// Produto vetorial dos três primeiros coeficientes de u e v, com zero no
+// quarto se ele for zero em u e v (como em crossproduct()).
+__m128 Matrix_Cross_SSE(__m128 u, __m128 v)
+{
+    __m128 u_yzx = _mm_shuffle_ps(u, u, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 u_zxy = _mm_shuffle_ps(u, u, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 v_yzx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 v_zxy = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 2));
+    return _mm_sub_ps(_mm_mul_ps(u_yzx, v_zxy), _mm_mul_ps(u_zxy, v_yzx));
+}
+
+// Fator F(p,q) de Matrix_Inverse_Scalar(), a partir das linhas p e q da
+// matriz.
+__m128 Matrix_Inverse_Factor_SSE(__m128 row_p, __m128 row_q)
+{
+    __m128 a = _mm_shuffle_ps(row_p, row_p, _MM_SHUFFLE(1, 1, 2, 2));  // [ m[2][p], m[2][p], m[1][p], m[1][p] ]
+    __m128 b = _mm_shuffle_ps(row_q, row_q, _MM_SHUFFLE(2, 3, 3, 3));  // [ m[3][q], m[3][q], m[3][q], m[2][q] ]
+    __m128 c = _mm_shuffle_ps(row_p, row_p, _MM_SHUFFLE(2, 3, 3, 3));
+    __m128 d = _mm_shuffle_ps(row_q, row_q, _MM_SHUFFLE(1, 1, 2, 2));
+    return _mm_sub_ps(_mm_mul_ps(a, b), _mm_mul_ps(c, d));
+}
+#endif
+
+// Versões SSE/AVX das funções acima, quando disponíveis. Veja o início
+// deste arquivo.
+glm::mat4 Matrix_Multiply(const glm::mat4& a, const glm::mat4& b)
+{
+#if defined(MATRICES_AVX)
+    // Duas colunas do resultado por vez: cada metade de 128 bits de um
+    // registrador AVX guarda uma coluna.
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[0][0]));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[1][0]));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[2][0]));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[3][0]));
+
+    glm::mat4 r;
+    for (int j = 0; j < 4; j += 2)
+    {
+        __m256 bj = _mm256_loadu_ps(&b[j][0]);
+        __m256 rj = _mm256_mul_ps(a0, _mm256_shuffle_ps(bj, bj, _MM_SHUFFLE(0, 0, 0, 0)));
+        rj = _mm256_add_ps(rj, _mm256_mul_ps(a1, _mm256_shuffle_ps(bj, bj, _MM_SHUFFLE(1, 1, 1, 1))));
+        rj = _mm256_add_ps(rj, _mm256_mul_ps(a2, _mm256_shuffle_ps(bj, bj, _MM_SHUFFLE(2, 2, 2, 2))));
+        rj = _mm256_add_ps(rj, _mm256_mul_ps(a3, _mm256_shuffle_ps(bj, bj, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm256_storeu_ps(&r[j][0], rj);
+    }
+    return r;
+#elif defined(MATRICES_SSE)
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+    glm::mat4 r;
+    for (int j = 0; j < 4; ++j)
+    {
+        __m128 bj = _mm_loadu_ps(&b[j][0]);
+        __m128 rj = _mm_mul_ps(a0, MATRICES_SPLAT(bj, 0));
+        rj = _mm_add_ps(rj, _mm_mul_ps(a1, MATRICES_SPLAT(bj, 1)));
+        rj = _mm_add_ps(rj, _mm_mul_ps(a2, MATRICES_SPLAT(bj, 2)));
+        rj = _mm_add_ps(rj, _mm_mul_ps(a3, MATRICES_SPLAT(bj, 3)));
+        _mm_storeu_ps(&r[j][0], rj);
+    }
+    return r;
+#else
+    return Matrix_Multiply_Scalar(a, b);
+#endif
+}
+
+glm::vec4 Matrix_Multiply_Vector(const glm::mat4& m, const glm::vec4& v)
+{
+#ifdef MATRICES_SSE
+    __m128 x   = _mm_loadu_ps(&v[0]);
+    __m128 m01 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m[0][0]), MATRICES_SPLAT(x, 0)),
+                            _mm_mul_ps(_mm_loadu_ps(&m[1][0]), MATRICES_SPLAT(x, 1)));
+    __m128 m23 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m[2][0]), MATRICES_SPLAT(x, 2)),
+                            _mm_mul_ps(_mm_loadu_ps(&m[3][0]), MATRICES_SPLAT(x, 3)));
+    glm::vec4 r;
+    _mm_storeu_ps(&r[0], _mm_add_ps(m01, m23));
+    return r;
+#else
+    return Matrix_Multiply_Vector_Scalar(m, v);
+#endif
+}
+
+glm::mat4 Matrix_Transpose(const glm::mat4& m)
+{
+#ifdef MATRICES_SSE
+    __m128 c0 = _mm_loadu_ps(&m[0][0]);
+    __m128 c1 = _mm_loadu_ps(&m[1][0]);
+    __m128 c2 = _mm_loadu_ps(&m[2][0]);
+    __m128 c3 = _mm_loadu_ps(&m[3][0]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    glm::mat4 r;
+    _mm_storeu_ps(&r[0][0], c0);
+    _mm_storeu_ps(&r[1][0], c1);
+    _mm_storeu_ps(&r[2][0], c2);
+    _mm_storeu_ps(&r[3][0], c3);
+    return r;
+#else
+    return Matrix_Transpose_Scalar(m);
+#endif
+}
+
+glm::mat4 Matrix_Inverse(const glm::mat4& m)
+{
+#ifdef MATRICES_SSE
+    // Linhas da matriz.
+    __m128 column0 = _mm_loadu_ps(&m[0][0]);
+    __m128 row0    = column0;
+    __m128 row1    = _mm_loadu_ps(&m[1][0]);
+    __m128 row2    = _mm_loadu_ps(&m[2][0]);
+    __m128 row3    = _mm_loadu_ps(&m[3][0]);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+    __m128 factor0 = Matrix_Inverse_Factor_SSE(row2, row3);
+    __m128 factor1 = Matrix_Inverse_Factor_SSE(row1, row3);
+    __m128 factor2 = Matrix_Inverse_Factor_SSE(row1, row2);
+    __m128 factor3 = Matrix_Inverse_Factor_SSE(row0, row3);
+    __m128 factor4 = Matrix_Inverse_Factor_SSE(row0, row2);
+    __m128 factor5 = Matrix_Inverse_Factor_SSE(row0, row1);
+
+    __m128 vec0 = _mm_shuffle_ps(row0, row0, _MM_SHUFFLE(0, 0, 0, 1));
+    __m128 vec1 = _mm_shuffle_ps(row1, row1, _MM_SHUFFLE(0, 0, 0, 1));
+    __m128 vec2 = _mm_shuffle_ps(row2, row2, _MM_SHUFFLE(0, 0, 0, 1));
+    __m128 vec3 = _mm_shuffle_ps(row3, row3, _MM_SHUFFLE(0, 0, 0, 1));
+
+    __m128 sign_a = _mm_set_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    __m128 sign_b = _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f);
+
+    __m128 inverse0 = _mm_sub_ps(_mm_mul_ps(vec1, factor0), _mm_mul_ps(vec2, factor1));
+    __m128 inverse1 = _mm_sub_ps(_mm_mul_ps(vec0, factor0), _mm_mul_ps(vec2, factor3));
+    __m128 inverse2 = _mm_sub_ps(_mm_mul_ps(vec0, factor1), _mm_mul_ps(vec1, factor3));
+    __m128 inverse3 = _mm_sub_ps(_mm_mul_ps(vec0, factor2), _mm_mul_ps(vec1, factor4));
+    inverse0 = _mm_mul_ps(_mm_add_ps(inverse0, _mm_mul_ps(vec3, factor2)), sign_a);
+    inverse1 = _mm_mul_ps(_mm_add_ps(inverse1, _mm_mul_ps(vec3, factor4)), sign_b);
+    inverse2 = _mm_mul_ps(_mm_add_ps(inverse2, _mm_mul_ps(vec3, factor5)), sign_a);
+    inverse3 = _mm_mul_ps(_mm_add_ps(inverse3, _mm_mul_ps(vec2, factor5)), sign_b);
+
+    // Determinante: produto da primeira coluna da matriz pela primeira linha
+    // da adjunta, somado dois a dois.
+    __m128 first_row = _mm_movelh_ps(_mm_unpacklo_ps(inverse0, inverse1), _mm_unpacklo_ps(inverse2, inverse3));
+    __m128 dot       = _mm_mul_ps(column0, first_row);
+    __m128 dot01     = _mm_add_ss(dot, MATRICES_SPLAT(dot, 1));
+    __m128 dot23     = _mm_add_ss(MATRICES_SPLAT(dot, 2), MATRICES_SPLAT(dot, 3));
+    float  one_over_determinant = 1.0f / _mm_cvtss_f32(_mm_add_ss(dot01, dot23));
+    __m128 scale     = _mm_set1_ps(one_over_determinant);
+
+    glm::mat4 r;
+    _mm_storeu_ps(&r[0][0], _mm_mul_ps(inverse0, scale));
+    _mm_storeu_ps(&r[1][0], _mm_mul_ps(inverse1, scale));
+    _mm_storeu_ps(&r[2][0], _mm_mul_ps(inverse2, scale));
+    _mm_storeu_ps(&r[3][0], _mm_mul_ps(inverse3, scale));
+    return r;
+#else
+    return Matrix_Inverse_Scalar(m);
+#endif
+}
+
+glm::mat4 Matrix_Inverse_Affine(const glm::mat4& m)
+{
+#ifdef MATRICES_SSE
+    __m128 c0 = _mm_loadu_ps(&m[0][0]);
+    __m128 c1 = _mm_loadu_ps(&m[1][0]);
+    __m128 c2 = _mm_loadu_ps(&m[2][0]);
+    __m128 t  = _mm_loadu_ps(&m[3][0]);
+
+    __m128 r0 = Matrix_Cross_SSE(c1, c2);
+    __m128 r1 = Matrix_Cross_SSE(c2, c0);
+    __m128 r2 = Matrix_Cross_SSE(c0, c1);
+    __m128 r3 = _mm_setzero_ps();
+
+    // Determinante c0 . r0, somado na mesma ordem da versão escalar.
+    __m128 dot = _mm_mul_ps(c0, r0);
+    __m128 sum = _mm_add_ss(_mm_add_ss(dot, MATRICES_SPLAT(dot, 1)), MATRICES_SPLAT(dot, 2));
+    __m128 scale = _mm_set1_ps(1.0f / _mm_cvtss_f32(sum));
+
+    // As linhas de A^-1 viram as colunas do resultado.
+    r0 = _mm_mul_ps(r0, scale);
+    r1 = _mm_mul_ps(r1, scale);
+    r2 = _mm_mul_ps(r2, scale);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    __m128 translation = _mm_mul_ps(r0, MATRICES_SPLAT(t, 0));
+    translation = _mm_add_ps(translation, _mm_mul_ps(r1, MATRICES_SPLAT(t, 1)));
+    translation = _mm_add_ps(translation, _mm_mul_ps(r2, MATRICES_SPLAT(t, 2)));
+    translation = _mm_xor_ps(translation, _mm_set1_ps(-0.0f));
+
+    glm::mat4 r;
+    _mm_storeu_ps(&r[0][0], r0);
+    _mm_storeu_ps(&r[1][0], r1);
+    _mm_storeu_ps(&r[2][0], r2);
+    _mm_storeu_ps(&r[3][0], translation);
+    r[3][3] = 1.0f;
+    return r;
+#else
+    return Matrix_Inverse_Affine_Scalar(m);
+#endif
+}
+
+// Matriz afim 3x4: as três primeiras linhas de uma matriz 4x4 cuja última
+// linha é [0,0,0,1], como as de Matrix_Translate(), Matrix_Scale(),
+// Matrix_Rotate*() e Matrix_Camera_View() e os seus produtos. Seja
+//
+//       [ A  t ]
+//   M = [ 0  1 ],
+//
+// onde A é a parte linear (3x3) e t a translação. Guardamos somente as linhas
+// [A t] (48 bytes em vez de 64), e o produto e a inversa aproveitam a última
+// linha conhecida. Nos shaders, a mesma matriz é uma mat3x4 (três colunas de
+// quatro coeficientes, que são as nossas linhas), e um ponto é transformado
+// como "vec4(p, 1.0) * model" (veja "shader_vertex.glsl").
+struct AffineMatrix
+{
+    glm::vec4 rows[3];
+};
+
+static_assert(sizeof(AffineMatrix) == 48, "AffineMatrix deve ocupar 48 bytes");
+
+// Como Matrix(), cria uma matriz afim a partir das suas três primeiras
+// LINHAS (a quarta é sempre [0,0,0,1]).
+AffineMatrix Affine(
+    float m00, float m01, float m02, float m03, // LINHA 1
+    float m10, float m11, float m12, float m13, // LINHA 2
+    float m20, float m21, float m22, float m23  // LINHA 3
+)
+{
+    AffineMatrix a;
+    a.rows[0] = glm::vec4(m00, m01, m02, m03);
+    a.rows[1] = glm::vec4(m10, m11, m12, m13);
+    a.rows[2] = glm::vec4(m20, m21, m22, m23);
+    return a;
+}
+
+// Conversões entre matrizes 4x4 (afins) e AffineMatrix.
+AffineMatrix Affine_FromMatrix(const glm::mat4& m)
+{
+    return Affine(
+        m[0][0] , m[1][0] , m[2][0] , m[3][0] ,
+        m[0][1] , m[1][1] , m[2][1] , m[3][1] ,
+        m[0][2] , m[1][2] , m[2][2] , m[3][2]
+    );
+}
+
+glm::mat4 Affine_ToMatrix(const AffineMatrix& a)
+{
+    return Matrix(
+        a.rows[0].x , a.rows[0].y , a.rows[0].z , a.rows[0].w ,
+        a.rows[1].x , a.rows[1].y , a.rows[1].z , a.rows[1].w ,
+        a.rows[2].x , a.rows[2].y , a.rows[2].z , a.rows[2].w ,
+        0.0f        , 0.0f        , 0.0f        , 1.0f
+    );
+}
+
+// Versões afins de Matrix_Identity(), Matrix_Translate(), Matrix_Scale() e
+// Matrix_Rotate_*(), construídas diretamente (sem passar por uma matriz 4x4).
+AffineMatrix Affine_Identity()
+{
+    return Affine(
+        1.0f , 0.0f , 0.0f , 0.0f ,
+        0.0f , 1.0f , 0.0f , 0.0f ,
+        0.0f , 0.0f , 1.0f , 0.0f
+    );
+}
+
+AffineMatrix Affine_Translate(float tx, float ty, float tz)
+{
+    return Affine(
+        1.0f , 0.0f , 0.0f , tx ,
+        0.0f , 1.0f , 0.0f , ty ,
+        0.0f , 0.0f , 1.0f , tz
+    );
+}
+
+AffineMatrix Affine_Scale(float sx, float sy, float sz)
+{
+    return Affine(
+        sx   , 0.0f , 0.0f , 0.0f ,
+        0.0f , sy   , 0.0f , 0.0f ,
+        0.0f , 0.0f , sz   , 0.0f
+    );
+}
+
+AffineMatrix Affine_Rotate_X(float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return Affine(
+        1.0f , 0.0f , 0.0f , 0.0f ,
+        0.0f ,  c   , -s   , 0.0f ,
+        0.0f ,  s   ,  c   , 0.0f
+    );
+}
+
+AffineMatrix Affine_Rotate_Y(float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return Affine(
+        c    , 0.0f ,  s   , 0.0f ,
+        0.0f , 1.0f , 0.0f , 0.0f ,
+        -s   , 0.0f ,  c   , 0.0f
+    );
+}
+
+AffineMatrix Affine_Rotate_Z(float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return Affine(
+        c    , -s   , 0.0f , 0.0f ,
+        s    ,  c   , 0.0f , 0.0f ,
+        0.0f , 0.0f , 1.0f , 0.0f
+    );
+}
+
+// Produto a*b de duas matrizes afins. Cada linha do resultado é a
+// combinação das linhas de b com os coeficientes da linha de a, mais a
+// translação de a:
+//
+//   (a*b)_i = a_i0*b_0 + a_i1*b_1 + a_i2*b_2 + a_i3*[0,0,0,1].
+//
+// São 36 multiplicações, contra 64 de Matrix_Multiply().
+AffineMatrix Affine_Multiply_Scalar(const AffineMatrix& a, const AffineMatrix& b)
+{
+    AffineMatrix r;
+    for (int i = 0; i < 3; ++i)
+    {
+        const glm::vec4& row = a.rows[i];
+        for (int j = 0; j < 4; ++j)
+            r.rows[i][j] = (b.rows[0][j]*row.x + b.rows[1][j]*row.y) + b.rows[2][j]*row.z;
+        r.rows[i].w += row.w;
+    }
+    return r;
+}
+
+// Produto a*v, com v um ponto (w = 1) ou um vetor (w = 0). A coordenada w
+// não muda.
+glm::vec4 Affine_Multiply_Vector(const AffineMatrix& a, const glm::vec4& v)
+{
+    glm::vec4 r;
+    for (int i = 0; i < 3; ++i)
+        r[i] = (a.rows[i].x*v.x + a.rows[i].y*v.y) + (a.rows[i].z*v.z + a.rows[i].w*v.w);
+    r.w = v.w;
+    return r;
+}
+
+// Inversa de uma matriz afim, como em Matrix_Inverse_Affine(): as linhas de
+// A^-1 são os produtos vetoriais das colunas c0, c1 e c2 de A (c1 x c2,
+// c2 x c0 e c0 x c1) divididos pelo determinante, e a translação é -A^-1*t.
+AffineMatrix Affine_Inverse_Scalar(const AffineMatrix& a)
+{
+    glm::vec4 c0 = glm::vec4(a.rows[0].x, a.rows[1].x, a.rows[2].x, 0.0f);
+    glm::vec4 c1 = glm::vec4(a.rows[0].y, a.rows[1].y, a.rows[2].y, 0.0f);
+    glm::vec4 c2 = glm::vec4(a.rows[0].z, a.rows[1].z, a.rows[2].z, 0.0f);
+    glm::vec4 t  = glm::vec4(a.rows[0].w, a.rows[1].w, a.rows[2].w, 0.0f);
+
+    glm::vec4 r0 = crossproduct(c1, c2);
+    glm::vec4 r1 = crossproduct(c2, c0);
+    glm::vec4 r2 = crossproduct(c0, c1);
+
+    float one_over_determinant = 1.0f / ((c0.x*r0.x + c0.y*r0.y) + c0.z*r0.z);
+
+    AffineMatrix inverse;
+    inverse.rows[0] = r0 * one_over_determinant;
+    inverse.rows[1] = r1 * one_over_determinant;
+    inverse.rows[2] = r2 * one_over_determinant;
+    for (int i = 0; i < 3; ++i)
+    {
+        glm::vec4& row = inverse.rows[i];
+        row.w = -((row.x*t.x + row.y*t.y) + row.z*t.z);
+    }
+    return inverse;
+}
+
+// Matriz que transforma as normais de uma superfície transformada por "a":
+// a inversa da transposta da parte linear A, com translação nula (normais
+// são vetores). Veja slides 123-151 do documento
+// Aula_07_Transformacoes_Geometricas_3D.pdf.
+AffineMatrix Affine_Normal_Matrix(const AffineMatrix& a)
+{
+    AffineMatrix inverse = Affine_Inverse_Scalar(a);
+
+    AffineMatrix normal;
+    for (int i = 0; i < 3; ++i)
+        normal.rows[i] = glm::vec4(inverse.rows[0][i], inverse.rows[1][i], inverse.rows[2][i], 0.0f);
+    return normal;
+}
+
+// Versões SSE de Affine_Multiply_Scalar() e Affine_Inverse_Scalar(), com as
+// mesmas operações na mesma ordem (resultados idênticos bit a bit).
+AffineMatrix Affine_Multiply(const AffineMatrix& a, const AffineMatrix& b)
+{
+#ifdef MATRICES_SSE
+    __m128 b0 = _mm_loadu_ps(&b.rows[0][0]);
+    __m128 b1 = _mm_loadu_ps(&b.rows[1][0]);
+    __m128 b2 = _mm_loadu_ps(&b.rows[2][0]);
+    __m128 w_mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    AffineMatrix r;
+    for (int i = 0; i < 3; ++i)
+    {
+        __m128 row = _mm_loadu_ps(&a.rows[i][0]);
+        __m128 sum = _mm_add_ps(_mm_mul_ps(MATRICES_SPLAT(row, 0), b0), _mm_mul_ps(MATRICES_SPLAT(row, 1), b1));
+        sum = _mm_add_ps(sum, _mm_mul_ps(MATRICES_SPLAT(row, 2), b2));
+        // Soma a translação de a somente na quarta posição.
+        __m128 translated = _mm_add_ps(sum, row);
+        sum = _mm_or_ps(_mm_and_ps(w_mask, translated), _mm_andnot_ps(w_mask, sum));
+        _mm_storeu_ps(&r.rows[i][0], sum);
+    }
+    return r;
+#else
+    return Affine_Multiply_Scalar(a, b);
+#endif
+}
+
+AffineMatrix Affine_Inverse(const AffineMatrix& a)
+{
+#ifdef MATRICES_SSE
+    // Colunas c0, c1, c2 e t, com zero na quarta posição.
+    __m128 c0 = _mm_loadu_ps(&a.rows[0][0]);
+    __m128 c1 = _mm_loadu_ps(&a.rows[1][0]);
+    __m128 c2 = _mm_loadu_ps(&a.rows[2][0]);
+    __m128 t  = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, t);
+
+    __m128 r0 = Matrix_Cross_SSE(c1, c2);
+    __m128 r1 = Matrix_Cross_SSE(c2, c0);
+    __m128 r2 = Matrix_Cross_SSE(c0, c1);
+    __m128 r3 = _mm_setzero_ps();
+
+    __m128 dot = _mm_mul_ps(c0, r0);
+    __m128 sum = _mm_add_ss(_mm_add_ss(dot, MATRICES_SPLAT(dot, 1)), MATRICES_SPLAT(dot, 2));
+    __m128 scale = _mm_set1_ps(1.0f / _mm_cvtss_f32(sum));
+    r0 = _mm_mul_ps(r0, scale);
+    r1 = _mm_mul_ps(r1, scale);
+    r2 = _mm_mul_ps(r2, scale);
+
+    AffineMatrix inverse;
+    _mm_storeu_ps(&inverse.rows[0][0], r0);
+    _mm_storeu_ps(&inverse.rows[1][0], r1);
+    _mm_storeu_ps(&inverse.rows[2][0], r2);
+
+    // -A^-1*t, calculado a partir das colunas de A^-1.
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    __m128 translation = _mm_mul_ps(r0, MATRICES_SPLAT(t, 0));
+    translation = _mm_add_ps(translation, _mm_mul_ps(r1, MATRICES_SPLAT(t, 1)));
+    translation = _mm_add_ps(translation, _mm_mul_ps(r2, MATRICES_SPLAT(t, 2)));
+    translation = _mm_xor_ps(translation, _mm_set1_ps(-0.0f));
+
+    float w[4];
+    _mm_storeu_ps(w, translation);
+    inverse.rows[0].w = w[0];
+    inverse.rows[1].w = w[1];
+    inverse.rows[2].w = w[2];
+    return inverse;
+#else
+    return Affine_Inverse_Scalar(a);
+#endif
+}
+
+// Seno e cosseno de um ângulo com uma única chamada: a maior parte das contas
+// é comum aos dois. Com a biblioteca C da GNU usamos sincosf(); nas demais,
+// sinf() e cosf().
+void Matrix_SinCos(float angle, float* s, float* c)
+{
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+    sincosf(angle, s, c);
+#else
+    *s = sinf(angle);
+    *c = cosf(angle);
+#endif
+}
+
+// Rotações em torno de X, Y e Z em uma única matriz, construída diretamente
+// em vez de multiplicar Affine_Rotate_X(), Affine_Rotate_Y() e
+// Affine_Rotate_Z(): um seno e um cosseno por ângulo, e os coeficientes do
+// produto escritos por extenso.
+//
+// Affine_Rotate_XYZ() aplica primeiro a rotação em torno de X, depois a em
+// torno de Y e por último a em torno de Z, isto é, Rz*Ry*Rx.
+// Affine_Rotate_ZYX() as aplica na ordem inversa, isto é, Rx*Ry*Rz.
+AffineMatrix Affine_Rotate_XYZ(float rx, float ry, float rz)
+{
+    float sx, cx, sy, cy, sz, cz;
+    Matrix_SinCos(rx, &sx, &cx);
+    Matrix_SinCos(ry, &sy, &cy);
+    Matrix_SinCos(rz, &sz, &cz);
+    return Affine(
+        cz*cy , cz*sy*sx - sz*cx , cz*sy*cx + sz*sx , 0.0f ,
+        sz*cy , sz*sy*sx + cz*cx , sz*sy*cx - cz*sx , 0.0f ,
+        -sy   , cy*sx            , cy*cx            , 0.0f
+    );
+}
+
+AffineMatrix Affine_Rotate_ZYX(float rx, float ry, float rz)
+{
+    float sx, cx, sy, cy, sz, cz;
+    Matrix_SinCos(rx, &sx, &cx);
+    Matrix_SinCos(ry, &sy, &cy);
+    Matrix_SinCos(rz, &sz, &cz);
+    return Affine(
+        cy*cz            , -cy*sz           , sy     , 0.0f ,
+        cx*sz + sx*sy*cz , cx*cz - sx*sy*sz , -sx*cy , 0.0f ,
+        sx*sz - cx*sy*cz , sx*cz + cx*sy*sz , cx*cy  , 0.0f
+    );
+}
+
+// Transformação "TRS" a partir de uma rotação "r" (com translação nula): a
+// escala multiplica as colunas de r, e a translação é a quarta coluna, sem
+// nenhum produto de matrizes.
+AffineMatrix Affine_TRS_From_Rotation(const glm::vec3& translation, AffineMatrix r, const glm::vec3& scale)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        glm::vec4& row = r.rows[i];
+        row = glm::vec4(row.x*scale.x, row.y*scale.y, row.z*scale.z, translation[i]);
+    }
+    return r;
+}
+
+// Transformação "TRS": primeiro a escala, depois as rotações em torno de X,
+// Y e Z (como em Affine_Rotate_XYZ()) e por último a translação, isto é,
+// T*Rz*Ry*Rx*S.
+AffineMatrix Affine_TRS(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale)
+{
+    return Affine_TRS_From_Rotation(translation, Affine_Rotate_XYZ(rotation.x, rotation.y, rotation.z), scale);
+}
+
+// Quatérnios unitários: a rotação de um ângulo θ em torno de um eixo n
+// (unitário) é o quatérnio q = [ sin(θ/2)*n, cos(θ/2) ], guardado em um
+// glm::vec4 com a parte real em w. Ao contrário dos ângulos de Euler, dois
+// quatérnios podem ser interpolados de forma que a rotação intermediária
+// gire com velocidade constante (veja Quat_Slerp()).
+glm::vec4 Quat_FromAxisAngle(float angle, glm::vec4 axis)
+{
+    float s, c;
+    Matrix_SinCos(0.5f * angle, &s, &c);
+
+    glm::vec4 v = axis / norm(axis);
+    return glm::vec4(s*v.x, s*v.y, s*v.z, c);
+}
+
+// Produto a*b de dois quatérnios: a rotação b seguida da rotação a, como no
+// produto das matrizes correspondentes.
+glm::vec4 Quat_Multiply(const glm::vec4& a, const glm::vec4& b)
+{
+    return glm::vec4(
+        a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y,
+        a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x,
+        a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w,
+        a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z
+    );
+}
+
+// Interpolação esférica ("slerp") entre as rotações a (t = 0) e b (t = 1),
+// pelo caminho mais curto. Quando a e b são muito próximos, sin(θ) é quase
+// zero, e a interpolação linear normalizada é equivalente e estável.
+glm::vec4 Quat_Slerp(const glm::vec4& a, glm::vec4 b, float t)
+{
+    // q e -q representam a mesma rotação; escolhemos o sinal de b que fica
+    // mais perto de a.
+    float cos_theta = a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+    if (cos_theta < 0.0f)
+    {
+        b = -b;
+        cos_theta = -cos_theta;
+    }
+
+    if (cos_theta > 0.9995f)
+    {
+        glm::vec4 q = a + (b - a) * t;
+        return q / sqrtf(q.x*q.x + q.y*q.y + q.z*q.z + q.w*q.w);
+    }
+
+    float theta = acosf(cos_theta);
+    float one_over_sin_theta = 1.0f / sinf(theta);
+    return a * (sinf((1.0f - t) * theta) * one_over_sin_theta) + b * (sinf(t * theta) * one_over_sin_theta);
+}
+
+// Matriz de rotação de um quatérnio unitário q.
+AffineMatrix Affine_FromQuat(const glm::vec4& q)
+{
+    float xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+    float xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+    float wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+    return Affine(
+        1.0f - 2.0f*(yy + zz) , 2.0f*(xy - wz)        , 2.0f*(xz + wy)        , 0.0f ,
+        2.0f*(xy + wz)        , 1.0f - 2.0f*(xx + zz) , 2.0f*(yz - wx)        , 0.0f ,
+        2.0f*(xz - wy)        , 2.0f*(yz + wx)        , 1.0f - 2.0f*(xx + yy) , 0.0f
+    );
+}
+
+// Versões 4x4 das funções acima.
+glm::mat4 Matrix_FromQuat(const glm::vec4& q)
+{
+    return Affine_ToMatrix(Affine_FromQuat(q));
+}
+
+glm::mat4 Matrix_TRS(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale)
+{
+    return Affine_ToMatrix(Affine_TRS(translation, rotation, scale));
+}
+
+glm::mat4 Matrix_TRS_Quat(const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale)
+{
+    return Affine_ToMatrix(Affine_TRS_From_Rotation(translation, Affine_FromQuat(rotation), scale));
+}
+
 // Matriz de projeção paralela ortográfica
 glm::mat4 Matrix_Orthographic(float l, float r, float b, float t, float n, float f)
 {
@@ -317,9 +1232,48 @@ glm::mat4 Matrix_Perspective(float field_of_view, float aspect, float n, float f
     // precisamos utilizar a matriz -M*P para projeção perspectiva, de forma que
     // w seja positivo.
     //
-    return -M*P;
+    return Matrix_Multiply(-M, P);
+}
+
+// Matriz de mapeamento do retângulo [a,b] em NDC para o retângulo [p,q] em
+// coordenadas de pixels da janela (viewport).
+constexpr glm::mat4 Matrix_Viewport(glm::vec2 a, glm::vec2 b, glm::vec2 p, glm::vec2 q)
+{
+    return Matrix(
+        (q.x-p.x)/(b.x-a.x) , 0.0f                , 0.0f , (b.x*p.x-a.x*q.x)/(b.x-a.x) ,
+        0.0f                , (q.y-p.y)/(b.y-a.y) , 0.0f , (b.y*p.y-a.y*q.y)/(b.y-a.y) ,
+        0.0f                , 0.0f                , 1.0f , 0.0f                        ,
+        0.0f                , 0.0f                , 0.0f , 1.0f
+    );
 }
 
+// Testes em tempo de compilação: as transformações abaixo são calculadas pelo
+// compilador, e o programa não compila se algum valor estiver errado.
+constexpr bool Const_Near(float x, float y)
+{
+    return (x > y ? x - y : y - x) <= 1e-6f * (1.0f + (y > 0.0f ? y : -y));
+}
+
+static_assert(Const_Near(Const_Sin(3.14159265f / 6.0f), 0.5f), "Const_Sin() incorreta");
+static_assert(Const_Near(Const_Cos(3.14159265f / 3.0f), 0.5f), "Const_Cos() incorreta");
+static_assert(Const_Near(Const_Cos(100.0f), 0.862318872f), "Const_Cos() incorreta para ângulos grandes");
+static_assert(Const_Near(Const_Sqrt(2.0f), 1.41421356f), "Const_Sqrt() incorreta");
+
+// As matrizes são lidas através de variáveis const, já que só a versão const
+// de operator[] da GLM é constexpr.
+constexpr bool Matrix_Const_Test()
+{
+    const glm::mat4 product = Matrix_Const_Multiply(Matrix_Translate(1, 2, 3), Matrix_Scale(2, 2, 2));
+    const glm::mat4 rotation = Matrix_Const_Rotate_Z(3.14159265f / 2.0f);
+    const glm::mat4 viewport = Matrix_Viewport(glm::vec2(-1), glm::vec2(1), glm::vec2(0), glm::vec2(800, 600));
+
+    return product[0][0] == 2.0f && product[3][2] == 3.0f
+        && Const_Near(rotation[0][1], 1.0f) && Const_Near(rotation[1][0], -1.0f)
+        && viewport[0][0] == 400.0f && viewport[3][1] == 300.0f;
+}
+
+static_assert(Matrix_Const_Test(), "Matrizes constexpr incorretas");
+
 // Função que imprime uma matriz M no terminal
 void PrintMatrix(glm::mat4 M)
 {
@@ -341,9 +1295,9 @@ void PrintVector(glm::vec4 v)
 }
 
 // Função que imprime o produto de uma matriz por um vetor no terminal
-void PrintMatrixVectorProduct(glm::mat4 M, glm::vec4 v)
+void PrintMatrixVectorProduct(const glm::mat4& M, const glm::vec4& v)
 {
-    auto r = M*v;
+    glm::vec4 r = Matrix_Multiply_Vector(M, v);
     printf("\n");
     printf("[ %+0.2f  %+0.2f  %+0.2f  %+0.2f ][ %+0.2f ]   [ %+0.2f ]\n", M[0][0], M[1][0], M[2][0], M[3][0], v[0], r[0]);
     printf("[ %+0.2f  %+0.2f  %+0.2f  %+0.2f ][ %+0.2f ] = [ %+0.2f ]\n", M[0][1], M[1][1], M[2][1], M[3][1], v[1], r[1]);
@@ -353,9 +1307,9 @@ void PrintMatrixVectorProduct(glm::mat4 M, glm::vec4 v)
 
 // Função que imprime o produto de uma matriz por um vetor, junto com divisão
 // por w, no terminal.
-void PrintMatrixVectorProductDivW(glm::mat4 M, glm::vec4 v)
+void PrintMatrixVectorProductDivW(const glm::mat4& M, const glm::vec4& v)
 {
-    auto r = M*v;
+    glm::vec4 r = Matrix_Multiply_Vector(M, v);
     auto w = r[3];
     printf("\n");
     printf("[ %+0.2f  %+0.2f  %+0.2f  %+0.2f ][ %+0.2f ]   [ %+0.2f ]            [ %+0.2f ]\n", M[0][0], M[1][0], M[2][0], M[3][0], v[0], r[0], r[0]/w);
@@ -364,6 +1318,5 @@ void PrintMatrixVectorProductDivW(glm::mat4 M, glm::vec4 v)
     printf("[ %+0.2f  %+0.2f  %+0.2f  %+0.2f ][ %+0.2f ]   [ %+0.2f ]            [ %+0.2f ]\n", M[0][3], M[1][3], M[2][3], M[3][3], v[3], r[3], r[3]/w);
 }
 
-
 #endif // _MATRICES_H
 // vim: set spell spelllang=pt_br :
@@ -0,0 +1,356 @@
+#ifndef _MESH_H
+#define _MESH_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "glad/glad.h"
+#include <glm/vec3.hpp>
+
+// Codificações possíveis para cada atributo de vértice. Veja VertexFormat.
+#define VERTEX_POSITION_FLOAT32 0  // 3 floats (12 bytes)
+#define VERTEX_POSITION_FLOAT16 1  // 3 half-floats + 2 bytes de alinhamento (8 bytes)
+#define VERTEX_POSITION_UNORM16 2  // 3 inteiros de 16 bits, quantizados na AABB do objeto (8 bytes)
+
+#define VERTEX_NORMAL_NONE           0  // Malha sem normais
+#define VERTEX_NORMAL_FLOAT32        1  // 3 floats (12 bytes)
+#define VERTEX_NORMAL_INT_2_10_10_10 2  // GL_INT_2_10_10_10_REV (4 bytes)
+
+#define VERTEX_TEXCOORD_NONE    0  // Malha sem coordenadas de textura
+#define VERTEX_TEXCOORD_FLOAT32 1  // 2 floats (8 bytes)
+#define VERTEX_TEXCOORD_FLOAT16 2  // 2 half-floats (4 bytes)
+
+// Formato de um vértice dentro do VBO "interleaved" de uma malha: todos os
+// atributos de um vértice ficam lado a lado na memória, em um único buffer,
+// na ordem posição, normal, coordenada de textura.
+//
+// Antigamente cada vértice ocupava 40 bytes, divididos em três VBOs
+// (posição e normal como vec4 com W constante, e textura como vec2). Com o
+// formato compacto (posição UNORM16, normal INT_2_10_10_10 e textura
+// FLOAT16) cada vértice ocupa somente 16 bytes. O W da posição e da normal é
+// reconstruído em "shader_vertex.glsl".
+struct VertexFormat {
+    uint32_t position_format;  // VERTEX_POSITION_*
+    uint32_t normal_format;    // VERTEX_NORMAL_*
+    uint32_t texcoord_format;  // VERTEX_TEXCOORD_*
+    uint32_t stride;           // Número de bytes por vértice
+    uint32_t normal_offset;    // Posição da normal dentro do vértice, em bytes
+    uint32_t texcoord_offset;  // Posição da coordenada de textura dentro do vértice, em bytes
+};
+
+// Nível de detalhe de um objeto: um intervalo de indices[] com uma versão
+// simplificada dos seus triângulos, que usa os mesmos vértices. Veja
+// "meshlod.h".
+struct MeshLod {
+    size_t first_index;  // Posição do primeiro índice do nível dentro de indices[]
+    size_t num_indices;  // Número de índices do nível
+    float  error;        // Erro geométrico, relativo à diagonal da AABB do objeto (0 no nível 0)
+};
+
+// Grupo de triângulos vizinhos de um objeto ("meshlet"), contíguo em
+// indices[], com volumes envolventes que permitem descartar o grupo inteiro
+// antes de desenhá-lo. Veja "meshlet.h".
+struct MeshCluster {
+    size_t    first_index;  // Posição do primeiro índice do grupo dentro de indices[]
+    size_t    num_indices;  // Número de índices do grupo
+    glm::vec3 center;       // Esfera envolvente, no sistema de coordenadas do modelo
+    float     radius;
+    glm::vec3 cone_axis;    // Cone que contém as normais de todos os triângulos do grupo
+    float     cone_cutoff;  // 1 caso o cone seja aberto demais para descartar o grupo
+};
+
+// Informações de um objeto (shape) de um arquivo ".obj" dentro dos buffers de
+// uma malha. São os campos de SceneObject que não dependem da GPU.
+struct MeshObject {
+    std::string name;           // Nome do objeto
+    size_t      first_index;    // Posição do primeiro índice do objeto dentro de indices[]
+    size_t      num_indices;    // Número de índices do objeto dentro de indices[]
+    size_t      first_vertex;   // Primeiro vértice do objeto (os vértices de um objeto são contíguos)
+    size_t      num_vertices;   // Número de vértices do objeto
+    glm::vec3   bbox_min;       // Axis-Aligned Bounding Box do objeto
+    glm::vec3   bbox_max;
+    size_t      first_lod;      // Primeiro nível de detalhe do objeto dentro de lods[]
+    size_t      num_lods;       // Número de níveis (0 caso BuildMeshLods() não tenha sido chamada)
+    size_t      first_cluster;  // Primeiro grupo do objeto dentro de clusters[]
+    size_t      num_clusters;   // Número de grupos (0 caso o objeto não tenha sido dividido)
+};
+
+// Malha de triângulos construída a partir de um ObjModel. Os atributos são
+// mantidos como floats, que é o que as etapas de processamento da malha
+// utilizam, e são convertidos por PackVertices() para o array "vertices",
+// que é o que efetivamente é enviado para a GPU (e salvo no cache).
+struct MeshData {
+    std::vector<MeshObject>    objects;
+    std::vector<MeshLod>       lods;       // Níveis de detalhe dos objetos, gerados por BuildMeshLods()
+    std::vector<MeshCluster>   clusters;   // Grupos de triângulos dos objetos, gerados por BuildMeshClusters()
+    std::vector<GLuint>        indices;
+    std::vector<float>         positions;  // 3 floats por vértice (X, Y, Z)
+    std::vector<float>         normals;    // 3 floats por vértice, ou vazio
+    std::vector<float>         texcoords;  // 2 floats por vértice, ou vazio
+    VertexFormat               format;     // Formato dos vértices em "vertices"
+    std::vector<unsigned char> vertices;   // Vértices "interleaved", gerados por PackVertices()
+};
+
+// "Visão" de uma malha: somente ponteiros para arrays que pertencem a outro
+// lugar. Assim conseguimos enviar para a GPU tanto um MeshData quanto um
+// arquivo de cache mapeado em memória (veja "meshcache.h"), sem nenhuma cópia
+// intermediária.
+struct MeshView {
+    const MeshObject*    objects;
+    size_t               num_objects;
+    const MeshLod*       lods;
+    size_t               num_lods;
+    const MeshCluster*   clusters;
+    size_t               num_clusters;
+    const GLuint*        indices;
+    size_t               num_indices;
+    VertexFormat         format;
+    const unsigned char* vertices;
+    size_t               num_vertices;
+};
+
+// Chave que identifica um vértice único de um ".obj": a combinação dos índices
+// de posição, normal e coordenada de textura de um canto de triângulo (os
+// campos de tinyobj::index_t). Cantos com a mesma chave são o mesmo vértice e
+// podem ser compartilhados entre triângulos ("vertex welding").
+struct VertexKey {
+    int vertex_index;
+    int normal_index;
+    int texcoord_index;
+
+    bool operator==(const VertexKey& other) const {
+        return vertex_index == other.vertex_index && normal_index == other.normal_index &&
+               texcoord_index == other.texcoord_index;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        uint64_t h = static_cast<uint32_t>(key.vertex_index);
+        h          = h * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(key.normal_index);
+        h          = h * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(key.texcoord_index);
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
+// Constrói uma visão que aponta para os arrays de um MeshData. A visão só é
+// válida enquanto o MeshData existir e não for modificado.
+MeshView MakeMeshView(const MeshData& mesh) {
+    MeshView view;
+    view.objects      = mesh.objects.data();
+    view.num_objects  = mesh.objects.size();
+    view.lods         = mesh.lods.data();
+    view.num_lods     = mesh.lods.size();
+    view.clusters     = mesh.clusters.data();
+    view.num_clusters = mesh.clusters.size();
+    view.indices      = mesh.indices.data();
+    view.num_indices  = mesh.indices.size();
+    view.format       = mesh.format;
+    view.vertices     = mesh.vertices.data();
+    view.num_vertices = mesh.positions.size() / 3;
+    return view;
+}
+
+// Constrói um VertexFormat, calculando a posição de cada atributo dentro do
+// vértice. Todos os atributos ficam alinhados em 4 bytes.
+VertexFormat MakeVertexFormat(uint32_t position_format, uint32_t normal_format, uint32_t texcoord_format) {
+    VertexFormat format;
+    format.position_format = position_format;
+    format.normal_format   = normal_format;
+    format.texcoord_format = texcoord_format;
+
+    uint32_t offset = position_format == VERTEX_POSITION_FLOAT32 ? 12 : 8;
+
+    format.normal_offset = offset;
+    if (normal_format == VERTEX_NORMAL_FLOAT32) {
+        offset += 12;
+    } else if (normal_format == VERTEX_NORMAL_INT_2_10_10_10) {
+        offset += 4;
+    }
+
+    format.texcoord_offset = offset;
+    if (texcoord_format == VERTEX_TEXCOORD_FLOAT32) {
+        offset += 8;
+    } else if (texcoord_format == VERTEX_TEXCOORD_FLOAT16) {
+        offset += 4;
+    }
+
+    format.stride = offset;
+    return format;
+}
+
+// Converte um float de 32 bits para um "half-float" de 16 bits (IEEE 754),
+// arredondando para o mais próximo.
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // Infinito e NaN
+    if (exponent == 0xFF) {
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+    }
+
+    int half_exponent = static_cast<int>(exponent) - 127 + 15;
+
+    // Grande demais: vira infinito.
+    if (half_exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+
+    // Pequeno demais para um half normalizado: vira subnormal ou zero.
+    if (half_exponent <= 0) {
+        if (half_exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift     = static_cast<uint32_t>(14 - half_exponent);
+        uint32_t half      = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway   = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) {
+            half += 1;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half      = sign | (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0)) {
+        half += 1;  // Pode propagar para o expoente, o que é o arredondamento correto.
+    }
+    return static_cast<uint16_t>(half);
+}
+
+// Converte um valor em [-1,1] para um inteiro de 10 bits com sinal,
+// normalizado, como esperado por GL_INT_2_10_10_10_REV.
+uint32_t PackSnorm10(float value) {
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    auto i = static_cast<int32_t>(std::lround(value * 511.0f));
+    return static_cast<uint32_t>(i) & 0x3FF;
+}
+
+// Converte os atributos (floats) de uma malha para o array "interleaved"
+// "vertices", no formato pedido. Atributos que a malha não possui são
+// preenchidos com zeros, pois todas as malhas da arena de geometria precisam
+// ter o mesmo formato (veja "geometryarena.h"). Posições
+// VERTEX_POSITION_UNORM16 são quantizadas em relação à AABB do objeto ao
+// qual o vértice pertence; veja GetPositionDequantization().
+void PackVertices(MeshData* mesh, const VertexFormat& requested) {
+    size_t num_vertices  = mesh->positions.size() / 3;
+    bool   has_normals   = !mesh->normals.empty();
+    bool   has_texcoords = !mesh->texcoords.empty();
+
+    mesh->format = MakeVertexFormat(requested.position_format, requested.normal_format, requested.texcoord_format);
+
+    const VertexFormat& format = mesh->format;
+
+    mesh->vertices.assign(num_vertices * format.stride, 0);
+
+    for (const MeshObject& object : mesh->objects) {
+        glm::vec3 extent = object.bbox_max - object.bbox_min;
+
+        for (size_t v = object.first_vertex; v < object.first_vertex + object.num_vertices; ++v) {
+            unsigned char* vertex   = &mesh->vertices[v * format.stride];
+            const float*   position = &mesh->positions[3 * v];
+
+            if (format.position_format == VERTEX_POSITION_FLOAT32) {
+                memcpy(vertex, position, 3 * sizeof(float));
+            } else if (format.position_format == VERTEX_POSITION_FLOAT16) {
+                uint16_t half[3] = {FloatToHalf(position[0]), FloatToHalf(position[1]), FloatToHalf(position[2])};
+                memcpy(vertex, half, sizeof(half));
+            } else {
+                uint16_t quantized[3];
+                for (int i = 0; i < 3; ++i) {
+                    float t      = extent[i] > 0.0f ? (position[i] - object.bbox_min[i]) / extent[i] : 0.0f;
+                    quantized[i] = static_cast<uint16_t>(std::lround(t * 65535.0f));
+                }
+                memcpy(vertex, quantized, sizeof(quantized));
+            }
+
+            if (!has_normals) {
+                // Deixamos a normal zerada.
+            } else if (format.normal_format == VERTEX_NORMAL_FLOAT32) {
+                memcpy(vertex + format.normal_offset, &mesh->normals[3 * v], 3 * sizeof(float));
+            } else if (format.normal_format == VERTEX_NORMAL_INT_2_10_10_10) {
+                const float* n      = &mesh->normals[3 * v];
+                uint32_t     packed = PackSnorm10(n[0]) | (PackSnorm10(n[1]) << 10) | (PackSnorm10(n[2]) << 20);
+                memcpy(vertex + format.normal_offset, &packed, sizeof(packed));
+            }
+
+            if (!has_texcoords) {
+                // Deixamos as coordenadas de textura zeradas.
+            } else if (format.texcoord_format == VERTEX_TEXCOORD_FLOAT32) {
+                memcpy(vertex + format.texcoord_offset, &mesh->texcoords[2 * v], 2 * sizeof(float));
+            } else if (format.texcoord_format == VERTEX_TEXCOORD_FLOAT16) {
+                uint16_t half[2] = {FloatToHalf(mesh->texcoords[2 * v + 0]), FloatToHalf(mesh->texcoords[2 * v + 1])};
+                memcpy(vertex + format.texcoord_offset, half, sizeof(half));
+            }
+        }
+    }
+}
+
+// Transformação que reconstrói a posição de um vértice a partir do valor lido
+// pelo Vertex Shader: posição = offset + scale * valor. Somente posições
+// quantizadas (VERTEX_POSITION_UNORM16) precisam de uma transformação.
+void GetPositionDequantization(const VertexFormat& format, const glm::vec3& bbox_min, const glm::vec3& bbox_max,
+                               glm::vec3* offset, glm::vec3* scale) {
+    if (format.position_format == VERTEX_POSITION_UNORM16) {
+        *offset = bbox_min;
+        *scale  = bbox_max - bbox_min;
+    } else {
+        *offset = glm::vec3(0.0f, 0.0f, 0.0f);
+        *scale  = glm::vec3(1.0f, 1.0f, 1.0f);
+    }
+}
+
+// Configura os atributos de vértice do VAO atualmente "ligado" para ler o
+// VBO atualmente ligado em GL_ARRAY_BUFFER com o formato "format". As
+// "locations" são as definidas em "shader_vertex.glsl".
+void SetupVertexAttributes(const VertexFormat& format) {
+    const GLsizei stride = static_cast<GLsizei>(format.stride);
+
+    // (location = 0): posição
+    if (format.position_format == VERTEX_POSITION_FLOAT32) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+    } else if (format.position_format == VERTEX_POSITION_FLOAT16) {
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, nullptr);
+    } else {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, nullptr);
+    }
+    glEnableVertexAttribArray(0);
+
+    // (location = 1): normal
+    const void* normal_offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(format.normal_offset));
+    if (format.normal_format == VERTEX_NORMAL_FLOAT32) {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, normal_offset);
+        glEnableVertexAttribArray(1);
+    } else if (format.normal_format == VERTEX_NORMAL_INT_2_10_10_10) {
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, normal_offset);
+        glEnableVertexAttribArray(1);
+    } else {
+        glDisableVertexAttribArray(1);
+    }
+
+    // (location = 2): coordenadas de textura
+    const void* texcoord_offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(format.texcoord_offset));
+    if (format.texcoord_format == VERTEX_TEXCOORD_FLOAT32) {
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, texcoord_offset);
+        glEnableVertexAttribArray(2);
+    } else if (format.texcoord_format == VERTEX_TEXCOORD_FLOAT16) {
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, texcoord_offset);
+        glEnableVertexAttribArray(2);
+    } else {
+        glDisableVertexAttribArray(2);
+    }
+}
+
+#endif  // _MESH_H
+// vim: set spell spelllang=pt_br :
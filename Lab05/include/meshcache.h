@@ -0,0 +1,465 @@
+#ifndef _MESHCACHE_H
+#define _MESHCACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "mesh.h"
+#include "mappedfile.h"
+
+// Cache binário de malhas. Ler um ".obj" grande (ex.: bunny.obj) como texto,
+// computar suas normais e construir os triângulos é o que domina o tempo de
+// inicialização do programa. Por isso, após a primeira execução, salvamos os
+// arrays finais (exatamente como são enviados para a GPU) em um arquivo
+// "<modelo>.obj.meshcache". Nas execuções seguintes este arquivo é mapeado em
+// memória e os ponteiros para dentro dele são passados diretamente para
+// glBufferData(), sem nenhum parsing e sem vetores intermediários.
+//
+// Formato do arquivo (todos os valores na ordem de bytes da máquina):
+//
+//   MeshCacheHeader
+//   MeshCacheSection[num_sections]
+//   dados das seções, cada uma alinhada em 16 bytes
+//
+// O cache é invalidado quando MESHCACHE_VERSION muda, ou quando o ".obj" de
+// origem muda de tamanho ou de conteúdo. Caso somente a data de modificação
+// mude (ex.: após um "git checkout"), comparamos o hash do conteúdo.
+
+// Incremente sempre que o formato do arquivo ou o conteúdo dos arrays mudar.
+#define MESHCACHE_VERSION 8
+
+#define MESHCACHE_TAG(a, b, c, d) \
+    (static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | \
+     (static_cast<uint32_t>(d) << 24))
+
+#define MESHCACHE_SECTION_PATH MESHCACHE_TAG('P', 'A', 'T', 'H')  // Caminho do ".obj" de origem
+#define MESHCACHE_SECTION_OBJS MESHCACHE_TAG('O', 'B', 'J', 'S')  // MeshCacheObject[]
+#define MESHCACHE_SECTION_LODS MESHCACHE_TAG('L', 'O', 'D', 'S')  // MeshCacheLod[]
+#define MESHCACHE_SECTION_CLUS MESHCACHE_TAG('C', 'L', 'U', 'S')  // MeshCacheCluster[]
+#define MESHCACHE_SECTION_STRS MESHCACHE_TAG('S', 'T', 'R', 'S')  // Nomes dos objetos
+#define MESHCACHE_SECTION_INDX MESHCACHE_TAG('I', 'N', 'D', 'X')  // GLuint indices[]
+#define MESHCACHE_SECTION_VFMT MESHCACHE_TAG('V', 'F', 'M', 'T')  // VertexFormat pedido e VertexFormat real
+#define MESHCACHE_SECTION_VERT MESHCACHE_TAG('V', 'E', 'R', 'T')  // Vértices "interleaved"
+
+struct MeshCacheHeader {
+    char     magic[8];          // "FCGMESH"
+    uint32_t version;           // MESHCACHE_VERSION
+    uint32_t byte_order;        // 0x01020304, para detectar arquivos de outra arquitetura
+    uint64_t source_size;       // Tamanho em bytes do ".obj" de origem
+    int64_t  source_mtime;      // Data de modificação do ".obj" de origem
+    uint64_t source_hash;       // Hash FNV-1a (64 bits) do conteúdo do ".obj" de origem
+    uint32_t num_sections;
+    uint32_t normal_weighting;  // NORMALS_WEIGHT_* usado para computar normais ausentes
+};
+
+struct MeshCacheSection {
+    uint32_t tag;
+    uint32_t reserved;
+    uint64_t offset;  // Posição dos dados, em bytes, a partir do início do arquivo
+    uint64_t size;    // Tamanho dos dados, em bytes
+};
+
+// Versão em disco de MeshObject. O nome fica na seção STRS.
+struct MeshCacheObject {
+    uint64_t first_index;
+    uint64_t num_indices;
+    uint64_t first_vertex;
+    uint64_t num_vertices;
+    uint32_t name_offset;
+    uint32_t name_length;
+    float    bbox_min[3];
+    float    bbox_max[3];
+    uint32_t first_lod;
+    uint32_t num_lods;
+    uint32_t first_cluster;
+    uint32_t num_clusters;
+};
+
+// Versão em disco de MeshLod.
+struct MeshCacheLod {
+    uint64_t first_index;
+    uint64_t num_indices;
+    float    error;
+    uint32_t reserved;
+};
+
+// Versão em disco de MeshCluster.
+struct MeshCacheCluster {
+    uint64_t first_index;
+    uint64_t num_indices;
+    float    center[3];
+    float    radius;
+    float    cone_axis[3];
+    float    cone_cutoff;
+};
+
+// Cache aberto por MeshCache_Open(). A visão "view" aponta para dentro do
+// arquivo mapeado, e só é válida até a chamada de MeshCache_Close().
+struct MeshCache {
+    MappedFile               file;
+    std::vector<MeshObject>  objects;
+    std::vector<MeshLod>     lods;
+    std::vector<MeshCluster> clusters;
+    MeshView                 view;
+};
+
+static const char     g_MeshCacheMagic[8]  = {'F', 'C', 'G', 'M', 'E', 'S', 'H', '\0'};
+static const uint32_t g_MeshCacheByteOrder = 0x01020304;
+static const size_t   g_MeshCacheAlignment = 16;
+
+// Caminho do arquivo de cache correspondente a um ".obj".
+std::string MeshCache_PathFor(const std::string& source_path) { return source_path + ".meshcache"; }
+
+// Data de modificação de um arquivo, com a maior resolução disponível no
+// sistema operacional (nanossegundos em Linux e macOS, segundos nos demais).
+int64_t MeshCache_ModificationTime(const struct stat& st) {
+#if defined(__linux__)
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(st.st_mtime);
+#endif
+}
+
+// Hash FNV-1a de 64 bits de todo o conteúdo de um arquivo. Retorna 0 caso o
+// arquivo não possa ser lido.
+uint64_t MeshCache_HashFile(const std::string& filename) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+
+    uint64_t      hash = 14695981039346656037ULL;
+    unsigned char buffer[64 * 1024];
+    size_t        n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            hash ^= buffer[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    fclose(file);
+    return hash;
+}
+
+// Procura uma seção no cache. Retorna nullptr caso ela não exista ou caso
+// aponte para fora do arquivo (arquivo truncado ou corrompido).
+const MeshCacheSection* MeshCache_FindSection(const MappedFile& file, uint32_t tag) {
+    const auto* header   = reinterpret_cast<const MeshCacheHeader*>(file.data);
+    const auto* sections = reinterpret_cast<const MeshCacheSection*>(file.data + sizeof(MeshCacheHeader));
+
+    for (uint32_t i = 0; i < header->num_sections; ++i) {
+        if (sections[i].tag != tag) {
+            continue;
+        }
+        if (sections[i].offset % g_MeshCacheAlignment != 0 || sections[i].offset > file.size ||
+            sections[i].size > file.size - sections[i].offset) {
+            return nullptr;
+        }
+        return &sections[i];
+    }
+
+    return nullptr;
+}
+
+void MeshCache_Close(MeshCache* cache) {
+    UnmapFile(&cache->file);
+    cache->objects.clear();
+    cache->lods.clear();
+    cache->clusters.clear();
+    memset(&cache->view, 0, sizeof(cache->view));
+}
+
+// Abre o cache correspondente ao ".obj" "source_path", cujos vértices devem
+// ter sido gerados com o formato "requested" (veja PackVertices()) e cujas
+// normais ausentes devem ter sido computadas com o peso "normal_weighting"
+// (veja ComputeVertexNormals()). Retorna false caso o cache não exista ou esteja desatualizado; neste caso o
+// chamador deve ler o ".obj" normalmente e chamar MeshCache_Write().
+bool MeshCache_Open(const std::string& source_path, const VertexFormat& requested, uint32_t normal_weighting,
+                    MeshCache* cache) {
+    memset(&cache->view, 0, sizeof(cache->view));
+    cache->objects.clear();
+    cache->lods.clear();
+    cache->clusters.clear();
+
+    struct stat source_stat;
+    if (stat(source_path.c_str(), &source_stat) != 0) {
+        return false;
+    }
+
+    if (!MapFile(MeshCache_PathFor(source_path), &cache->file)) {
+        return false;
+    }
+
+    const MappedFile& file   = cache->file;
+    const auto*       header = reinterpret_cast<const MeshCacheHeader*>(file.data);
+
+    bool valid = file.size >= sizeof(MeshCacheHeader) &&
+                 memcmp(header->magic, g_MeshCacheMagic, sizeof(g_MeshCacheMagic)) == 0 &&
+                 header->version == MESHCACHE_VERSION && header->byte_order == g_MeshCacheByteOrder &&
+                 header->num_sections <= (file.size - sizeof(MeshCacheHeader)) / sizeof(MeshCacheSection) &&
+                 header->source_size == static_cast<uint64_t>(source_stat.st_size) &&
+                 header->normal_weighting == normal_weighting;
+
+    // A data de modificação é somente um atalho: se ela mudou mas o conteúdo
+    // é o mesmo, o cache continua válido.
+    if (valid && header->source_mtime != MeshCache_ModificationTime(source_stat)) {
+        valid = header->source_hash == MeshCache_HashFile(source_path);
+    }
+
+    const MeshCacheSection* path = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_PATH) : nullptr;
+    const MeshCacheSection* objs = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_OBJS) : nullptr;
+    const MeshCacheSection* lods = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_LODS) : nullptr;
+    const MeshCacheSection* clus = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_CLUS) : nullptr;
+    const MeshCacheSection* strs = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_STRS) : nullptr;
+    const MeshCacheSection* indx = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_INDX) : nullptr;
+    const MeshCacheSection* vfmt = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_VFMT) : nullptr;
+    const MeshCacheSection* vert = valid ? MeshCache_FindSection(file, MESHCACHE_SECTION_VERT) : nullptr;
+
+    valid = valid && path != nullptr && objs != nullptr && lods != nullptr && clus != nullptr && strs != nullptr &&
+            indx != nullptr && vfmt != nullptr && vert != nullptr && objs->size % sizeof(MeshCacheObject) == 0 &&
+            lods->size % sizeof(MeshCacheLod) == 0 && clus->size % sizeof(MeshCacheCluster) == 0 &&
+            vfmt->size == 2 * sizeof(VertexFormat);
+
+    // Os vértices salvos precisam ter sido gerados com o formato pedido.
+    const auto* formats = valid ? reinterpret_cast<const VertexFormat*>(file.data + vfmt->offset) : nullptr;
+    valid = valid && formats[0].position_format == requested.position_format &&
+            formats[0].normal_format == requested.normal_format &&
+            formats[0].texcoord_format == requested.texcoord_format && formats[1].stride != 0 &&
+            vert->size % formats[1].stride == 0;
+
+    // Garantimos que o cache pertence a este ".obj", e não a outro arquivo
+    // de mesmo tamanho.
+    valid = valid && path->size == source_path.size() &&
+            memcmp(file.data + path->offset, source_path.data(), source_path.size()) == 0;
+
+    if (valid) {
+        const auto* records     = reinterpret_cast<const MeshCacheObject*>(file.data + objs->offset);
+        const auto* lod_records = reinterpret_cast<const MeshCacheLod*>(file.data + lods->offset);
+        const auto* clu_records = reinterpret_cast<const MeshCacheCluster*>(file.data + clus->offset);
+        const auto* names       = reinterpret_cast<const char*>(file.data + strs->offset);
+        size_t      num_records = objs->size / sizeof(MeshCacheObject);
+        size_t      num_lods    = lods->size / sizeof(MeshCacheLod);
+        size_t      num_clus    = clus->size / sizeof(MeshCacheCluster);
+        size_t      num_indices = indx->size / sizeof(GLuint);
+        size_t      num_verts   = vert->size / formats[1].stride;
+
+        for (size_t i = 0; valid && i < num_lods; ++i) {
+            const MeshCacheLod& record = lod_records[i];
+            valid = record.first_index <= num_indices && record.num_indices <= num_indices - record.first_index;
+            if (valid) {
+                MeshLod lod;
+                lod.first_index = static_cast<size_t>(record.first_index);
+                lod.num_indices = static_cast<size_t>(record.num_indices);
+                lod.error       = record.error;
+                cache->lods.push_back(lod);
+            }
+        }
+
+        for (size_t i = 0; valid && i < num_clus; ++i) {
+            const MeshCacheCluster& record = clu_records[i];
+            valid = record.first_index <= num_indices && record.num_indices <= num_indices - record.first_index;
+            if (valid) {
+                MeshCluster cluster;
+                cluster.first_index = static_cast<size_t>(record.first_index);
+                cluster.num_indices = static_cast<size_t>(record.num_indices);
+                cluster.center      = glm::vec3(record.center[0], record.center[1], record.center[2]);
+                cluster.radius      = record.radius;
+                cluster.cone_axis   = glm::vec3(record.cone_axis[0], record.cone_axis[1], record.cone_axis[2]);
+                cluster.cone_cutoff = record.cone_cutoff;
+                cache->clusters.push_back(cluster);
+            }
+        }
+
+        for (size_t i = 0; valid && i < num_records; ++i) {
+            const MeshCacheObject& record = records[i];
+            valid = static_cast<uint64_t>(record.name_offset) + record.name_length <= strs->size &&
+                    record.first_index <= num_indices && record.num_indices <= num_indices - record.first_index &&
+                    record.first_vertex <= num_verts && record.num_vertices <= num_verts - record.first_vertex &&
+                    record.first_lod <= num_lods && record.num_lods <= num_lods - record.first_lod &&
+                    record.first_cluster <= num_clus && record.num_clusters <= num_clus - record.first_cluster;
+            if (valid) {
+                MeshObject object;
+                object.name          = std::string(names + record.name_offset, record.name_length);
+                object.first_index   = static_cast<size_t>(record.first_index);
+                object.num_indices   = static_cast<size_t>(record.num_indices);
+                object.first_vertex  = static_cast<size_t>(record.first_vertex);
+                object.num_vertices  = static_cast<size_t>(record.num_vertices);
+                object.bbox_min      = glm::vec3(record.bbox_min[0], record.bbox_min[1], record.bbox_min[2]);
+                object.bbox_max      = glm::vec3(record.bbox_max[0], record.bbox_max[1], record.bbox_max[2]);
+                object.first_lod     = record.first_lod;
+                object.num_lods      = record.num_lods;
+                object.first_cluster = record.first_cluster;
+                object.num_clusters  = record.num_clusters;
+                cache->objects.push_back(object);
+            }
+        }
+    }
+
+    if (!valid) {
+        MeshCache_Close(cache);
+        return false;
+    }
+
+    MeshView& view    = cache->view;
+    view.objects      = cache->objects.data();
+    view.num_objects  = cache->objects.size();
+    view.lods         = cache->lods.data();
+    view.num_lods     = cache->lods.size();
+    view.clusters     = cache->clusters.data();
+    view.num_clusters = cache->clusters.size();
+    view.indices      = reinterpret_cast<const GLuint*>(file.data + indx->offset);
+    view.num_indices  = indx->size / sizeof(GLuint);
+    view.format       = formats[1];
+    view.vertices     = file.data + vert->offset;
+    view.num_vertices = vert->size / formats[1].stride;
+
+    return true;
+}
+
+// Salva uma malha construída a partir do ".obj" "source_path", cujos vértices
+// foram gerados por PackVertices() com o formato "requested" e cujas normais
+// ausentes foram computadas com o peso "normal_weighting", no seu arquivo
+// de cache. O arquivo é escrito com outro nome e depois renomeado, para que
+// uma execução interrompida nunca deixe um cache pela metade.
+bool MeshCache_Write(const std::string& source_path, const VertexFormat& requested, uint32_t normal_weighting,
+                     const MeshData& mesh) {
+    struct stat source_stat;
+    if (stat(source_path.c_str(), &source_stat) != 0) {
+        return false;
+    }
+
+    std::string                  names;
+    std::vector<MeshCacheObject> records;
+    for (const MeshObject& object : mesh.objects) {
+        MeshCacheObject record;
+        record.first_index   = object.first_index;
+        record.num_indices   = object.num_indices;
+        record.first_vertex  = object.first_vertex;
+        record.num_vertices  = object.num_vertices;
+        record.name_offset   = static_cast<uint32_t>(names.size());
+        record.name_length   = static_cast<uint32_t>(object.name.size());
+        record.bbox_min[0]   = object.bbox_min.x;
+        record.bbox_min[1]   = object.bbox_min.y;
+        record.bbox_min[2]   = object.bbox_min.z;
+        record.bbox_max[0]   = object.bbox_max.x;
+        record.bbox_max[1]   = object.bbox_max.y;
+        record.bbox_max[2]   = object.bbox_max.z;
+        record.first_lod     = static_cast<uint32_t>(object.first_lod);
+        record.num_lods      = static_cast<uint32_t>(object.num_lods);
+        record.first_cluster = static_cast<uint32_t>(object.first_cluster);
+        record.num_clusters  = static_cast<uint32_t>(object.num_clusters);
+        records.push_back(record);
+        names += object.name;
+    }
+
+    std::vector<MeshCacheLod> lod_records;
+    for (const MeshLod& lod : mesh.lods) {
+        MeshCacheLod record;
+        record.first_index = lod.first_index;
+        record.num_indices = lod.num_indices;
+        record.error       = lod.error;
+        record.reserved    = 0;
+        lod_records.push_back(record);
+    }
+
+    std::vector<MeshCacheCluster> cluster_records;
+    for (const MeshCluster& cluster : mesh.clusters) {
+        MeshCacheCluster record;
+        record.first_index  = cluster.first_index;
+        record.num_indices  = cluster.num_indices;
+        record.center[0]    = cluster.center.x;
+        record.center[1]    = cluster.center.y;
+        record.center[2]    = cluster.center.z;
+        record.radius       = cluster.radius;
+        record.cone_axis[0] = cluster.cone_axis.x;
+        record.cone_axis[1] = cluster.cone_axis.y;
+        record.cone_axis[2] = cluster.cone_axis.z;
+        record.cone_cutoff  = cluster.cone_cutoff;
+        cluster_records.push_back(record);
+    }
+
+    const VertexFormat formats[2] = {requested, mesh.format};
+
+    struct Blob {
+        uint32_t    tag;
+        const void* data;
+        size_t      size;
+    };
+    const Blob blobs[] = {
+            {MESHCACHE_SECTION_PATH, source_path.data(), source_path.size()},
+            {MESHCACHE_SECTION_OBJS, records.data(), records.size() * sizeof(MeshCacheObject)},
+            {MESHCACHE_SECTION_LODS, lod_records.data(), lod_records.size() * sizeof(MeshCacheLod)},
+            {MESHCACHE_SECTION_CLUS, cluster_records.data(), cluster_records.size() * sizeof(MeshCacheCluster)},
+            {MESHCACHE_SECTION_STRS, names.data(), names.size()},
+            {MESHCACHE_SECTION_INDX, mesh.indices.data(), mesh.indices.size() * sizeof(GLuint)},
+            {MESHCACHE_SECTION_VFMT, formats, sizeof(formats)},
+            {MESHCACHE_SECTION_VERT, mesh.vertices.data(), mesh.vertices.size()},
+    };
+    const uint32_t num_blobs = sizeof(blobs) / sizeof(blobs[0]);
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, g_MeshCacheMagic, sizeof(g_MeshCacheMagic));
+    header.version          = MESHCACHE_VERSION;
+    header.byte_order       = g_MeshCacheByteOrder;
+    header.source_size      = static_cast<uint64_t>(source_stat.st_size);
+    header.source_mtime     = MeshCache_ModificationTime(source_stat);
+    header.source_hash      = MeshCache_HashFile(source_path);
+    header.num_sections     = num_blobs;
+    header.normal_weighting = normal_weighting;
+
+    std::vector<MeshCacheSection> sections(num_blobs);
+    uint64_t offset = sizeof(MeshCacheHeader) + num_blobs * sizeof(MeshCacheSection);
+    for (uint32_t i = 0; i < num_blobs; ++i) {
+        offset = (offset + g_MeshCacheAlignment - 1) / g_MeshCacheAlignment * g_MeshCacheAlignment;
+        sections[i].tag      = blobs[i].tag;
+        sections[i].reserved = 0;
+        sections[i].offset   = offset;
+        sections[i].size     = blobs[i].size;
+        offset += blobs[i].size;
+    }
+
+    std::string cache_path = MeshCache_PathFor(source_path);
+    std::string temp_path  = cache_path + ".tmp";
+
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    static const unsigned char padding[g_MeshCacheAlignment] = {0};
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(sections.data(), sizeof(MeshCacheSection), num_blobs, file) == num_blobs;
+
+    uint64_t position = sizeof(MeshCacheHeader) + num_blobs * sizeof(MeshCacheSection);
+    for (uint32_t i = 0; ok && i < num_blobs; ++i) {
+        size_t pad = static_cast<size_t>(sections[i].offset - position);
+        ok         = fwrite(padding, 1, pad, file) == pad && fwrite(blobs[i].data, 1, blobs[i].size, file) == blobs[i].size;
+        position   = sections[i].offset + sections[i].size;
+    }
+
+    ok = fclose(file) == 0 && ok;
+
+    // Em Windows, rename() falha caso o destino já exista.
+    remove(cache_path.c_str());
+    ok = ok && rename(temp_path.c_str(), cache_path.c_str()) == 0;
+
+    if (!ok) {
+        remove(temp_path.c_str());
+    }
+
+    return ok;
+}
+
+#endif  // _MESHCACHE_H
+// vim: set spell spelllang=pt_br :
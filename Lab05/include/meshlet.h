@@ -0,0 +1,332 @@
+#ifndef _MESHLET_H
+#define _MESHLET_H
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "matrices.h"
+#include "mesh.h"
+
+// Divisão de objetos grandes em pequenos grupos de triângulos vizinhos
+// ("meshlets" ou "clusters").
+//
+// Um objeto como o coelho é desenhado inteiro mesmo quando metade dele está
+// fora da tela ou de costas para a câmera; o Backface Culling e o clipping só
+// descartam estes triângulos depois que os seus vértices já foram
+// processados. Dividindo o objeto em grupos de no máximo
+// MESHLET_MAX_VERTICES vértices e MESHLET_MAX_TRIANGLES triângulos, cada um
+// com uma esfera envolvente e um cone que contém as normais dos seus
+// triângulos, conseguimos descartar grupos inteiros na CPU, a cada quadro,
+// com poucos testes:
+//
+// - Frustum: a esfera está totalmente fora de algum dos seis planos do
+//   volume de visualização.
+// - Costas: todos os triângulos do grupo estão de costas para a câmera. Usamos
+//   o teste do cone de normais de meshoptimizer (Arseny Kapoulkine), que é
+//   conservador para qualquer ponto da esfera envolvente.
+//
+// Os triângulos de cada grupo ficam contíguos no array de índices, então os
+// grupos que sobram são desenhados com um único glMultiDrawElements(), e
+// grupos vizinhos visíveis são unidos em um único intervalo.
+//
+// Somente o nível de detalhe 0 (veja "meshlod.h") é dividido: os níveis mais
+// simples já são usados quando o objeto é pequeno na tela.
+
+// Limites de cada grupo. São os valores recomendados para "mesh shaders" em
+// GPUs NVIDIA, e dão esferas e cones pequenos o suficiente para o descarte.
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Objetos com menos triângulos que isso não são divididos.
+#define MESHLET_MIN_TRIANGLES 512
+
+// Contadores do descarte de grupos, acumulados por Meshlet_Cull().
+struct MeshletCullStats {
+    size_t num_clusters;          // Grupos testados
+    size_t num_frustum_culled;    // Grupos descartados por estarem fora do frustum
+    size_t num_backface_culled;   // Grupos descartados por estarem de costas para a câmera
+    size_t num_triangles;         // Triângulos dos grupos testados
+    size_t num_culled_triangles;  // Triângulos dos grupos descartados
+};
+
+// Divide os triângulos "indices" de um objeto (índices globais, entre
+// first_vertex e first_vertex+num_vertices-1) em grupos. Os triângulos são
+// reescritos em "indices" agrupados, e os grupos são adicionados em
+// "clusters", com first_index relativo a "indices" somado de "index_offset".
+//
+// Cada grupo cresce a partir do primeiro triângulo ainda livre (na ordem
+// atual, que já foi otimizada para o cache de vértices), adicionando sempre o
+// triângulo vizinho que precisa de menos vértices novos e, em caso de empate,
+// cuja normal é mais parecida com a do grupo. Dentro de cada grupo os
+// triângulos mantêm a ordem original.
+void Meshlet_Build(GLuint* indices, size_t num_indices, const float* positions, size_t first_vertex,
+                   size_t num_vertices, size_t index_offset, std::vector<MeshCluster>* clusters) {
+    const size_t num_triangles = num_indices / 3;
+    const GLuint none          = static_cast<GLuint>(-1);
+
+    // Normal de cada triângulo, e triângulos ao redor de cada vértice (CSR).
+    std::vector<glm::vec3> normals(num_triangles);
+    std::vector<GLuint>    first_triangle(num_vertices + 1, 0);
+    std::vector<GLuint>    triangles(num_indices);
+
+    for (size_t t = 0; t < num_triangles; ++t) {
+        glm::vec3 p[3];
+        for (int k = 0; k < 3; ++k) {
+            const float* position = &positions[3 * indices[3 * t + k]];
+            p[k]                  = glm::vec3(position[0], position[1], position[2]);
+            first_triangle[indices[3 * t + k] - first_vertex + 1] += 1;
+        }
+        glm::vec3 n    = glm::cross(p[1] - p[0], p[2] - p[0]);
+        float     area = glm::length(n);
+        normals[t]     = area > 0.0f ? n / area : glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+    for (size_t v = 0; v < num_vertices; ++v) {
+        first_triangle[v + 1] += first_triangle[v];
+    }
+    std::vector<GLuint> cursor(first_triangle.begin(), first_triangle.end() - 1);
+    for (size_t i = 0; i < num_indices; ++i) {
+        triangles[cursor[indices[i] - first_vertex]++] = static_cast<GLuint>(i / 3);
+    }
+
+    // "vertex_cluster[v]" indica em qual grupo o vértice v já foi incluído.
+    std::vector<GLuint>        vertex_cluster(num_vertices, none);
+    std::vector<unsigned char> assigned(num_triangles, 0);
+    std::vector<GLuint>        order;
+    order.reserve(num_triangles);
+
+    std::vector<GLuint> cluster_vertices;
+    std::vector<GLuint> cluster_triangles;
+
+    for (size_t seed = 0; seed < num_triangles; ++seed) {
+        if (assigned[seed]) {
+            continue;
+        }
+
+        const auto cluster_id = static_cast<GLuint>(clusters->size());
+        glm::vec3  normal_sum(0.0f, 0.0f, 0.0f);
+        cluster_vertices.clear();
+        cluster_triangles.clear();
+
+        auto next = static_cast<GLuint>(seed);
+        while (next != none) {
+            assigned[next] = 1;
+            cluster_triangles.push_back(next);
+            normal_sum += normals[next];
+            for (int k = 0; k < 3; ++k) {
+                GLuint v = indices[3 * next + k] - static_cast<GLuint>(first_vertex);
+                if (vertex_cluster[v] != cluster_id) {
+                    vertex_cluster[v] = cluster_id;
+                    cluster_vertices.push_back(v);
+                }
+            }
+
+            if (cluster_triangles.size() == MESHLET_MAX_TRIANGLES) {
+                break;
+            }
+
+            // Procuramos o melhor vizinho livre entre os triângulos dos
+            // vértices do grupo.
+            next                 = none;
+            int   best_new       = 3;
+            float best_alignment = -2.0f;
+            for (GLuint v : cluster_vertices) {
+                for (GLuint i = first_triangle[v]; i < first_triangle[v + 1]; ++i) {
+                    GLuint t = triangles[i];
+                    if (assigned[t]) {
+                        continue;
+                    }
+
+                    int new_vertices = 0;
+                    for (int k = 0; k < 3; ++k) {
+                        new_vertices += vertex_cluster[indices[3 * t + k] - first_vertex] != cluster_id;
+                    }
+                    if (cluster_vertices.size() + new_vertices > MESHLET_MAX_VERTICES) {
+                        continue;
+                    }
+
+                    float alignment = glm::dot(normals[t], normal_sum);
+                    if (new_vertices < best_new || (new_vertices == best_new && alignment > best_alignment)) {
+                        next           = t;
+                        best_new       = new_vertices;
+                        best_alignment = alignment;
+                    }
+                }
+            }
+        }
+
+        std::sort(cluster_triangles.begin(), cluster_triangles.end());
+
+        MeshCluster cluster;
+        cluster.first_index = index_offset + 3 * order.size();
+        cluster.num_indices = 3 * cluster_triangles.size();
+        order.insert(order.end(), cluster_triangles.begin(), cluster_triangles.end());
+
+        // Esfera envolvente: centro da AABB dos vértices do grupo.
+        glm::vec3 bbox_min(positions[3 * (first_vertex + cluster_vertices[0]) + 0],
+                           positions[3 * (first_vertex + cluster_vertices[0]) + 1],
+                           positions[3 * (first_vertex + cluster_vertices[0]) + 2]);
+        glm::vec3 bbox_max = bbox_min;
+        for (GLuint v : cluster_vertices) {
+            const float* position = &positions[3 * (first_vertex + v)];
+            glm::vec3    p(position[0], position[1], position[2]);
+            bbox_min = glm::min(bbox_min, p);
+            bbox_max = glm::max(bbox_max, p);
+        }
+        cluster.center = 0.5f * (bbox_min + bbox_max);
+        cluster.radius = 0.0f;
+        for (GLuint v : cluster_vertices) {
+            const float* position = &positions[3 * (first_vertex + v)];
+            glm::vec3    p(position[0], position[1], position[2]);
+            cluster.radius = std::max(cluster.radius, glm::length(p - cluster.center));
+        }
+
+        // Cone de normais: eixo na direção da normal média, e abertura dada
+        // pela normal mais distante do eixo. Se alguma normal faz mais de ~84
+        // graus com o eixo, o cone não permite descartar o grupo.
+        float length      = glm::length(normal_sum);
+        cluster.cone_axis = length > 0.0f ? normal_sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        float min_dot     = length > 0.0f ? 1.0f : -1.0f;
+        for (GLuint t : cluster_triangles) {
+            if (glm::dot(normals[t], normals[t]) > 0.0f) {
+                min_dot = std::min(min_dot, glm::dot(normals[t], cluster.cone_axis));
+            }
+        }
+        // O grupo está de costas quando o ângulo entre o eixo e a direção de
+        // visualização é menor que 90 graus menos a abertura do cone; o cosseno
+        // deste ângulo é sin(abertura) = sqrt(1 - min_dot^2).
+        cluster.cone_cutoff = min_dot <= 0.1f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+
+        clusters->push_back(cluster);
+    }
+
+    std::vector<GLuint> result(num_indices);
+    for (size_t i = 0; i < order.size(); ++i) {
+        std::copy(&indices[3 * order[i]], &indices[3 * order[i]] + 3, &result[3 * i]);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+// Divide em grupos o nível de detalhe 0 de cada objeto com pelo menos
+// MESHLET_MIN_TRIANGLES triângulos. Os índices do objeto são reordenados no
+// próprio intervalo [first_index, first_index+num_indices).
+void BuildMeshClusters(MeshData* mesh) {
+    mesh->clusters.clear();
+
+    for (MeshObject& object : mesh->objects) {
+        object.first_cluster = mesh->clusters.size();
+        object.num_clusters  = 0;
+
+        if (object.num_indices / 3 < MESHLET_MIN_TRIANGLES) {
+            continue;
+        }
+
+        Meshlet_Build(&mesh->indices[object.first_index], object.num_indices, mesh->positions.data(),
+                      object.first_vertex, object.num_vertices, object.first_index, &mesh->clusters);
+
+        object.num_clusters = mesh->clusters.size() - object.first_cluster;
+
+        size_t num_cullable = 0;
+        for (size_t i = object.first_cluster; i < mesh->clusters.size(); ++i) {
+            num_cullable += mesh->clusters[i].cone_cutoff < 1.0f;
+        }
+
+        printf("- Objeto '%s': %d clusters, média de %.1f triângulos (%d com cone de normais)\n", object.name.c_str(),
+               static_cast<int>(object.num_clusters), object.num_indices / 3.0 / object.num_clusters,
+               static_cast<int>(num_cullable));
+    }
+}
+
+// Seleciona os grupos visíveis de um objeto, dadas as matrizes "model_view"
+// e "projection". Os intervalos de índices a serem desenhados (em bytes,
+// prontos para glMultiDrawElements()) são escritos em "counts" e "offsets",
+// e os contadores são somados em "stats". Retorna o número de intervalos.
+//
+// Os testes são feitos no sistema de coordenadas da câmera. O teste do cone
+// supõe que "model_view" não tem escala não-uniforme; caso tenha, somente o
+// teste do frustum é feito.
+size_t Meshlet_Cull(const MeshCluster* clusters, size_t num_clusters, const glm::mat4& model_view,
+                    const glm::mat4& projection, std::vector<GLsizei>* counts, std::vector<const void*>* offsets,
+                    MeshletCullStats* stats) {
+    counts->clear();
+    offsets->clear();
+
+    // Planos do frustum (ax + by + cz + d >= 0 para pontos dentro), extraídos
+    // das linhas da matriz de projeção (Gribb e Hartmann).
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i) {
+        row[i] = glm::vec4(projection[0][i], projection[1][i], projection[2][i], projection[3][i]);
+    }
+    glm::vec4 planes[6] = {row[3] + row[0], row[3] - row[0], row[3] + row[1],
+                           row[3] - row[1], row[3] + row[2], row[3] - row[2]};
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    float scale_x = glm::length(glm::vec3(model_view[0]));
+    float scale_y = glm::length(glm::vec3(model_view[1]));
+    float scale_z = glm::length(glm::vec3(model_view[2]));
+    float scale   = std::max(scale_x, std::max(scale_y, scale_z));
+    bool  uniform = std::min(scale_x, std::min(scale_y, scale_z)) > 0.999f * scale;
+
+    // Na projeção perspectiva a câmera está na origem; na ortográfica todos
+    // os raios de visualização têm a direção -Z.
+    bool perspective = projection[3][3] == 0.0f;
+
+    for (size_t i = 0; i < num_clusters; ++i) {
+        const MeshCluster& cluster = clusters[i];
+
+        stats->num_clusters += 1;
+        stats->num_triangles += cluster.num_indices / 3;
+
+        glm::vec3 center = glm::vec3(model_view * glm::vec4(cluster.center, 1.0f));
+        float     radius = cluster.radius * scale;
+
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; ++p) {
+            outside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius;
+        }
+        if (outside) {
+            stats->num_frustum_culled += 1;
+            stats->num_culled_triangles += cluster.num_indices / 3;
+            continue;
+        }
+
+        if (uniform && cluster.cone_cutoff < 1.0f) {
+            glm::vec3 axis = glm::vec3(model_view * glm::vec4(cluster.cone_axis, 0.0f)) / scale;
+            bool      back_facing;
+            if (perspective) {
+                back_facing = glm::dot(center, axis) >= cluster.cone_cutoff * glm::length(center) + radius;
+            } else {
+                back_facing = -axis.z >= cluster.cone_cutoff;
+            }
+            if (back_facing) {
+                stats->num_backface_culled += 1;
+                stats->num_culled_triangles += cluster.num_indices / 3;
+                continue;
+            }
+        }
+
+        // Grupos vizinhos no array de índices são desenhados juntos.
+        const void* offset = reinterpret_cast<const void*>(cluster.first_index * sizeof(GLuint));
+        if (!counts->empty() && reinterpret_cast<const char*>(offsets->back()) + counts->back() * sizeof(GLuint) ==
+                                        reinterpret_cast<const char*>(offset)) {
+            counts->back() += static_cast<GLsizei>(cluster.num_indices);
+        } else {
+            counts->push_back(static_cast<GLsizei>(cluster.num_indices));
+            offsets->push_back(offset);
+        }
+    }
+
+    return counts->size();
+}
+
+#endif  // _MESHLET_H
+// vim: set spell spelllang=pt_br :
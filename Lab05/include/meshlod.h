@@ -0,0 +1,491 @@
+#ifndef _MESHLOD_H
+#define _MESHLOD_H
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "mesh.h"
+#include "meshopt.h"
+
+// Níveis de detalhe ("Level of Detail", LOD) de uma malha.
+//
+// Um objeto que ocupa poucos pixels na tela não precisa de todos os seus
+// triângulos. BuildMeshLods() gera, para cada objeto, uma cadeia de versões
+// simplificadas, cada uma com aproximadamente MESHLOD_REDUCTION vezes os
+// triângulos da anterior. Cada nível é somente um novo intervalo do array de
+// índices: todos os níveis usam os mesmos vértices (e o mesmo VBO), então
+// trocar de nível não custa nada além de um glDrawElements() diferente.
+//
+// A simplificação é feita por colapso de arestas guiado pela métrica de erro
+// quádrica ("Quadric Error Metric") de Garland e Heckbert, "Surface
+// Simplification Using Quadric Error Metrics", SIGGRAPH 1997. Cada vértice
+// acumula os planos dos triângulos ao seu redor; o erro de mover um vértice
+// para outra posição é a soma das distâncias (ao quadrado) até estes planos.
+// Como os vértices não podem ser criados nem movidos (eles são compartilhados
+// com o nível 0), um vértice só pode ser colapsado sobre um dos seus vizinhos
+// ("half-edge collapse").
+//
+// Vértices em bordas abertas da malha e em "costuras" de atributos (mesma
+// posição com normais ou coordenadas de textura diferentes, veja
+// BuildTriangles()) nunca são removidos, para que a silhueta e o mapeamento
+// de textura não se desfaçam.
+//
+// O erro de cada nível é guardado relativo à diagonal da AABB do objeto, e
+// MeshLod_Select() escolhe o nível a partir do tamanho projetado da AABB na
+// tela: o nível mais simples cujo erro projetado é menor que um limite em
+// pixels.
+
+// Número máximo de níveis por objeto, incluindo o nível 0 (malha original).
+#define MESHLOD_MAX_LEVELS 6
+
+// Fração dos triângulos do nível anterior pedida para cada novo nível.
+#define MESHLOD_REDUCTION 0.5f
+
+// Erro máximo de qualquer nível, relativo à diagonal da AABB do objeto. Níveis
+// que precisariam de um erro maior não são gerados.
+#define MESHLOD_MAX_ERROR 0.05f
+
+// Objetos (ou níveis) com menos triângulos que isso não são mais simplificados.
+#define MESHLOD_MIN_TRIANGLES 64
+
+// Um novo nível só é gerado se tiver no máximo esta fração dos triângulos do
+// nível anterior; caso contrário a simplificação travou (ex.: tudo é borda).
+#define MESHLOD_MIN_REDUCTION 0.85f
+
+// Quádrica de erro: soma de w * (n·p + d)^2 para vários planos (n, d), com
+// pesos w. Guardamos a matriz simétrica A = Σ w n n^T, o vetor b = Σ w d n, o
+// escalar c = Σ w d^2 e a soma dos pesos.
+struct MeshLodQuadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double w;
+};
+
+void MeshLod_AddPlane(MeshLodQuadric* q, const glm::vec3& n, float d, float w) {
+    q->a00 += w * n.x * n.x;
+    q->a01 += w * n.x * n.y;
+    q->a02 += w * n.x * n.z;
+    q->a11 += w * n.y * n.y;
+    q->a12 += w * n.y * n.z;
+    q->a22 += w * n.z * n.z;
+    q->b0 += w * d * n.x;
+    q->b1 += w * d * n.y;
+    q->b2 += w * d * n.z;
+    q->c += w * d * d;
+    q->w += w;
+}
+
+void MeshLod_AddQuadric(MeshLodQuadric* q, const MeshLodQuadric& other) {
+    q->a00 += other.a00;
+    q->a01 += other.a01;
+    q->a02 += other.a02;
+    q->a11 += other.a11;
+    q->a12 += other.a12;
+    q->a22 += other.a22;
+    q->b0 += other.b0;
+    q->b1 += other.b1;
+    q->b2 += other.b2;
+    q->c += other.c;
+    q->w += other.w;
+}
+
+// Distância média (ao quadrado, ponderada pelos pesos) entre "p" e os planos
+// da quádrica.
+double MeshLod_QuadricError(const MeshLodQuadric& q, const glm::vec3& p) {
+    double x = p.x, y = p.y, z = p.z;
+
+    double e = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+               2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+
+    return q.w > 0.0 ? std::max(0.0, e / q.w) : 0.0;
+}
+
+// Simplifica os triângulos "indices" (índices locais, entre 0 e
+// num_vertices-1, de "positions", com 3 floats por vértice) até que restem no
+// máximo "target_indices" índices, ou até que o próximo colapso tenha erro
+// maior que "max_error" (relativo à diagonal da AABB dos vértices). Escreve os
+// índices resultantes em "result", que deve ter espaço para "num_indices"
+// índices, e o erro alcançado em "result_error". Retorna o número de índices
+// escritos.
+size_t MeshLod_Simplify(const float* positions, size_t num_vertices, const GLuint* indices, size_t num_indices,
+                        size_t target_indices, float max_error, GLuint* result, float* result_error) {
+    std::copy(indices, indices + num_indices, result);
+    *result_error = 0.0f;
+
+    if (num_vertices == 0 || num_indices <= target_indices) {
+        return num_indices;
+    }
+
+    // Trabalhamos com as posições normalizadas pela diagonal da AABB, para que
+    // os erros sejam relativos ao tamanho do objeto.
+    glm::vec3 bbox_min(FLT_MAX, FLT_MAX, FLT_MAX);
+    glm::vec3 bbox_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t v = 0; v < num_vertices; ++v) {
+        glm::vec3 p(positions[3 * v + 0], positions[3 * v + 1], positions[3 * v + 2]);
+        bbox_min = glm::min(bbox_min, p);
+        bbox_max = glm::max(bbox_max, p);
+    }
+    float diagonal = glm::length(bbox_max - bbox_min);
+    float scale    = diagonal > 0.0f ? 1.0f / diagonal : 1.0f;
+
+    std::vector<glm::vec3> points(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v) {
+        glm::vec3 p(positions[3 * v + 0], positions[3 * v + 1], positions[3 * v + 2]);
+        points[v] = (p - bbox_min) * scale;
+    }
+
+    // Vértices com a mesma posição (costuras de normais ou de coordenadas de
+    // textura) são agrupados: "position_id[v]" é o menor vértice com a mesma
+    // posição que "v". As quádricas e a topologia são definidas por posição.
+    std::vector<GLuint> order(num_vertices);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](GLuint a, GLuint b) {
+        const glm::vec3& pa = points[a];
+        const glm::vec3& pb = points[b];
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        if (pa.z != pb.z) return pa.z < pb.z;
+        return a < b;
+    });
+
+    std::vector<GLuint> position_id(num_vertices);
+    for (size_t i = 0; i < num_vertices; ++i) {
+        GLuint v                = order[i];
+        bool   same_as_previous = i > 0 && points[order[i - 1]] == points[v];
+        position_id[v]          = same_as_previous ? position_id[order[i - 1]] : v;
+    }
+
+    // Vértices que não podem ser removidos: costuras (mais de um vértice
+    // usado na mesma posição), bordas abertas e arestas não-manifold.
+    std::vector<unsigned char> used(num_vertices, 0);
+    std::vector<unsigned int>  num_wedges(num_vertices, 0);
+    for (size_t i = 0; i < num_indices; ++i) {
+        GLuint v = indices[i];
+        if (!used[v]) {
+            used[v] = 1;
+            num_wedges[position_id[v]] += 1;
+        }
+    }
+
+    std::vector<unsigned char> locked(num_vertices, 0);
+    for (size_t v = 0; v < num_vertices; ++v) {
+        locked[v] = num_wedges[position_id[v]] > 1;
+    }
+
+    std::vector<uint64_t> edges;
+    edges.reserve(num_indices);
+    for (size_t i = 0; i < num_indices; i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            GLuint a = position_id[indices[i + k]];
+            GLuint b = position_id[indices[i + (k + 1) % 3]];
+            edges.push_back(static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<unsigned char> locked_position(num_vertices, 0);
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i]) {
+            ++j;
+        }
+        // Cada aresta interna de uma malha fechada aparece em exatamente dois
+        // triângulos.
+        if (j - i != 2) {
+            locked_position[edges[i] >> 32]        = 1;
+            locked_position[edges[i] & 0xFFFFFFFF] = 1;
+        }
+        i = j;
+    }
+    for (size_t v = 0; v < num_vertices; ++v) {
+        locked[v] = locked[v] || locked_position[position_id[v]];
+    }
+
+    // Quádricas iniciais: planos dos triângulos ao redor de cada posição,
+    // com peso igual à área do triângulo.
+    std::vector<MeshLodQuadric> quadrics(num_vertices);
+    memset(quadrics.data(), 0, quadrics.size() * sizeof(MeshLodQuadric));
+    for (size_t i = 0; i < num_indices; i += 3) {
+        const glm::vec3& a = points[indices[i + 0]];
+        const glm::vec3& b = points[indices[i + 1]];
+        const glm::vec3& c = points[indices[i + 2]];
+
+        glm::vec3 n      = glm::cross(b - a, c - a);
+        float     length = glm::length(n);
+        if (length == 0.0f) {
+            continue;
+        }
+        n /= length;
+        float d = -glm::dot(n, a);
+        float w = 0.5f * length;
+
+        for (int k = 0; k < 3; ++k) {
+            MeshLod_AddPlane(&quadrics[position_id[indices[i + k]]], n, d, w);
+        }
+    }
+
+    struct Collapse {
+        double error;
+        GLuint from;
+        GLuint to;
+    };
+
+    size_t                     count = num_indices;
+    double                     worst = 0.0;
+    double                     limit = static_cast<double>(max_error) * max_error;
+    std::vector<GLuint>        first_triangle(num_vertices + 1);
+    std::vector<GLuint>        triangles;
+    std::vector<Collapse>      collapses;
+    std::vector<unsigned char> touched(num_vertices);
+
+    // Cada passada escolhe, para cada vértice removível, o vizinho mais barato
+    // sobre o qual ele pode ser colapsado, e aplica os colapsos em ordem de
+    // erro. Vértices envolvidos em um colapso (e seus vizinhos) não participam
+    // de outro na mesma passada, então as verificações abaixo sempre usam a
+    // vizinhança atual.
+    while (count > target_indices) {
+        // Triângulos ao redor de cada vértice (CSR).
+        std::fill(first_triangle.begin(), first_triangle.end(), 0);
+        for (size_t i = 0; i < count; ++i) {
+            first_triangle[result[i] + 1] += 1;
+        }
+        for (size_t v = 0; v < num_vertices; ++v) {
+            first_triangle[v + 1] += first_triangle[v];
+        }
+        triangles.resize(count);
+        std::vector<GLuint> cursor(first_triangle.begin(), first_triangle.end() - 1);
+        for (size_t i = 0; i < count; ++i) {
+            triangles[cursor[result[i]]++] = static_cast<GLuint>(i / 3);
+        }
+
+        collapses.clear();
+        for (GLuint v = 0; v < num_vertices; ++v) {
+            if (locked[v] || first_triangle[v] == first_triangle[v + 1]) {
+                continue;
+            }
+
+            Collapse best = {DBL_MAX, v, v};
+            for (GLuint t = first_triangle[v]; t < first_triangle[v + 1]; ++t) {
+                const GLuint* tri = &result[3 * triangles[t]];
+                for (int k = 0; k < 3; ++k) {
+                    if (tri[k] == v) {
+                        continue;
+                    }
+                    double error = MeshLod_QuadricError(quadrics[position_id[v]], points[tri[k]]);
+                    if (error < best.error) {
+                        best.error = error;
+                        best.to    = tri[k];
+                    }
+                }
+            }
+
+            if (best.to != v && best.error <= limit) {
+                collapses.push_back(best);
+            }
+        }
+
+        if (collapses.empty()) {
+            break;
+        }
+
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t num_removed   = 0;
+        size_t num_collapses = 0;
+
+        for (const Collapse& collapse : collapses) {
+            // Cada colapso remove aproximadamente dois triângulos.
+            if (count - 3 * num_removed <= target_indices) {
+                break;
+            }
+
+            GLuint v = collapse.from;
+            GLuint u = collapse.to;
+            if (touched[v] || touched[u]) {
+                continue;
+            }
+
+            // Rejeitamos colapsos que invertem algum triângulo ao redor de v.
+            bool flips = false;
+            for (GLuint t = first_triangle[v]; t < first_triangle[v + 1] && !flips; ++t) {
+                const GLuint* tri = &result[3 * triangles[t]];
+                if (tri[0] == u || tri[1] == u || tri[2] == u) {
+                    continue;
+                }
+
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; ++k) {
+                    before[k] = points[tri[k]];
+                    after[k]  = tri[k] == v ? points[u] : points[tri[k]];
+                }
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips        = glm::dot(n0, n1) <= 0.0f;
+            }
+            if (flips) {
+                continue;
+            }
+
+            for (GLuint t = first_triangle[v]; t < first_triangle[v + 1]; ++t) {
+                GLuint* tri = &result[3 * triangles[t]];
+                for (int k = 0; k < 3; ++k) {
+                    touched[tri[k]] = 1;
+                }
+                if (tri[0] == u || tri[1] == u || tri[2] == u) {
+                    num_removed += 1;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    if (tri[k] == v) {
+                        tri[k] = u;
+                    }
+                }
+            }
+
+            MeshLod_AddQuadric(&quadrics[position_id[u]], quadrics[position_id[v]]);
+            worst = std::max(worst, collapse.error);
+            num_collapses += 1;
+        }
+
+        if (num_collapses == 0) {
+            break;
+        }
+
+        // Removemos os triângulos degenerados pelos colapsos.
+        size_t write = 0;
+        for (size_t i = 0; i < count; i += 3) {
+            GLuint a = result[i], b = result[i + 1], c = result[i + 2];
+            if (a != b && b != c && a != c) {
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+        }
+        count = write;
+    }
+
+    *result_error = static_cast<float>(std::sqrt(worst));
+    return count;
+}
+
+// Gera a cadeia de níveis de detalhe de cada objeto de uma malha. Os índices
+// de cada novo nível são adicionados no final de mesh->indices, com o cache
+// de vértices otimizado (veja "meshopt.h"). Deve ser chamada após
+// OptimizeMesh(), que renumera os vértices.
+void BuildMeshLods(MeshData* mesh) {
+    mesh->lods.clear();
+
+    for (MeshObject& object : mesh->objects) {
+        const float* positions = &mesh->positions[3 * object.first_vertex];
+        const GLuint base      = static_cast<GLuint>(object.first_vertex);
+
+        object.first_lod = mesh->lods.size();
+
+        MeshLod level0;
+        level0.first_index = object.first_index;
+        level0.num_indices = object.num_indices;
+        level0.error       = 0.0f;
+        mesh->lods.push_back(level0);
+
+        // Cada nível é simplificado a partir do anterior, o que é bem mais
+        // rápido. O erro de cada nível é, portanto, no máximo a soma dos erros
+        // de cada etapa.
+        std::vector<GLuint> current(mesh->indices.begin() + object.first_index,
+                                    mesh->indices.begin() + object.first_index + object.num_indices);
+        for (GLuint& index : current) {
+            index -= base;
+        }
+
+        std::vector<GLuint> simplified(current.size());
+        float               error = 0.0f;
+
+        while (mesh->lods.size() - object.first_lod < MESHLOD_MAX_LEVELS && error < MESHLOD_MAX_ERROR) {
+            size_t target = static_cast<size_t>(current.size() / 3 * MESHLOD_REDUCTION) * 3;
+            if (target < 3 * MESHLOD_MIN_TRIANGLES) {
+                break;
+            }
+
+            float  level_error;
+            size_t count = MeshLod_Simplify(positions, object.num_vertices, current.data(), current.size(), target,
+                                            MESHLOD_MAX_ERROR - error, simplified.data(), &level_error);
+            if (count > current.size() * MESHLOD_MIN_REDUCTION) {
+                break;
+            }
+
+            MeshOpt_OptimizeVertexCache(simplified.data(), count, object.num_vertices, MESHOPT_CACHE_SIZE);
+
+            error += level_error;
+            current.assign(simplified.begin(), simplified.begin() + count);
+
+            MeshLod level;
+            level.first_index = mesh->indices.size();
+            level.num_indices = count;
+            level.error       = error;
+            mesh->lods.push_back(level);
+
+            for (GLuint index : current) {
+                mesh->indices.push_back(index + base);
+            }
+        }
+
+        object.num_lods = mesh->lods.size() - object.first_lod;
+
+        printf("- Objeto '%s': %d níveis de detalhe (", object.name.c_str(), static_cast<int>(object.num_lods));
+        for (size_t i = object.first_lod; i < mesh->lods.size(); ++i) {
+            printf("%s%d", i == object.first_lod ? "" : ", ", static_cast<int>(mesh->lods[i].num_indices / 3));
+        }
+        printf(" triângulos)\n");
+    }
+}
+
+// Tamanho aproximado, em pixels, da diagonal da AABB de um objeto na tela,
+// dadas as matrizes "model_view" e "projection" e a altura da janela em
+// pixels. Usamos a esfera que envolve a AABB, e o seu ponto mais próximo da
+// câmera, então o valor é conservador (nunca menor que o real). Retorna
+// FLT_MAX caso a câmera esteja dentro da esfera.
+float MeshLod_ProjectedSize(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model_view,
+                            const glm::mat4& projection, float screen_height) {
+    // Maior fator de escala da matriz de modelagem.
+    float scale = std::max(glm::length(glm::vec3(model_view[0])),
+                           std::max(glm::length(glm::vec3(model_view[1])), glm::length(glm::vec3(model_view[2]))));
+
+    float     diagonal = scale * glm::length(bbox_max - bbox_min);
+    glm::vec4 center   = model_view * glm::vec4(0.5f * (bbox_min + bbox_max), 1.0f);
+
+    // Coordenada w do centro após a projeção, e quanto ela varia dentro da
+    // esfera. Na projeção ortográfica w é sempre 1.
+    glm::vec3 w_row(projection[0][3], projection[1][3], projection[2][3]);
+    float     w      = std::fabs(glm::dot(w_row, glm::vec3(center)) + projection[3][3]);
+    float     w_near = w - 0.5f * diagonal * glm::length(w_row);
+
+    if (w_near <= 1e-6f) {
+        return FLT_MAX;
+    }
+
+    return diagonal * std::fabs(projection[1][1]) * 0.5f * screen_height / w_near;
+}
+
+// Escolhe o nível mais simples cujo erro, projetado na tela, é no máximo
+// "pixel_error" pixels. "projected_size" é o resultado de
+// MeshLod_ProjectedSize().
+size_t MeshLod_Select(const MeshLod* lods, size_t num_lods, float projected_size, float pixel_error) {
+    size_t level = 0;
+    while (level + 1 < num_lods && lods[level + 1].error * projected_size <= pixel_error) {
+        level += 1;
+    }
+    return level;
+}
+
+#endif  // _MESHLOD_H
+// vim: set spell spelllang=pt_br :
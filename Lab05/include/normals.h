@@ -0,0 +1,240 @@
+#ifndef _NORMALS_H
+#define _NORMALS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+#include "parallel.h"
+
+// Cálculo de normais por vértice (método de Gouraud): a normal de um vértice
+// é a média, com pesos, das normais dos triângulos que o compartilham.
+//
+// Para aproveitar vários núcleos e as instruções SIMD do processador:
+//
+// 1. As posições são guardadas como "structure of arrays" (SoA): um array
+//    para X, outro para Y e outro para Z, em vez de XYZXYZ...
+// 2. As normais dos triângulos são computadas em lotes de
+//    NORMALS_BATCH_SIZE triângulos: primeiro copiamos as posições dos cantos
+//    do lote para arrays locais, depois fazemos as contas em laços simples
+//    sobre o lote, que o compilador transforma em instruções SIMD.
+// 3. Para somar as contribuições em cada vértice sem que duas threads
+//    escrevam no mesmo vértice (e sem operações atômicas), construímos a
+//    adjacência vértice -> cantos de triângulo em formato CSR ("compressed
+//    sparse row"). Então cada thread calcula sozinha um intervalo de
+//    vértices, lendo as normais dos triângulos vizinhos. A soma é sempre
+//    feita na mesma ordem, então o resultado não depende do número de
+//    threads.
+
+// Pesos possíveis para a normal de cada triângulo.
+#define NORMALS_WEIGHT_UNIFORM 0  // Todos os triângulos têm o mesmo peso
+#define NORMALS_WEIGHT_AREA    1  // Peso proporcional à área do triângulo
+#define NORMALS_WEIGHT_ANGLE   2  // Peso proporcional ao ângulo do triângulo no vértice
+
+// Número de triângulos processados juntos em cada lote.
+#define NORMALS_BATCH_SIZE 16
+
+// Número de triângulos (ou vértices) processados por cada tarefa de
+// ParallelFor().
+#define NORMALS_TASK_SIZE (64 * 1024)
+
+// Computa normais por vértice para uma malha de triângulos. As posições são
+// dadas em SoA (x[], y[], z[], com "num_vertices" elementos cada), e os
+// triângulos por "indices" (3 por triângulo). As normais são escritas em
+// nx[], ny[] e nz[]. Vértices que não são usados por nenhum triângulo recebem
+// normal nula.
+void ComputeVertexNormals(const float* x, const float* y, const float* z, size_t num_vertices, const uint32_t* indices,
+                          size_t num_triangles, int weighting, float* nx, float* ny, float* nz) {
+    // Normal de cada triângulo, já multiplicada pelo peso de cada um dos
+    // seus três cantos (SoA, 3 valores por triângulo).
+    std::vector<float> corner_x(3 * num_triangles);
+    std::vector<float> corner_y(3 * num_triangles);
+    std::vector<float> corner_z(3 * num_triangles);
+
+    size_t num_batches = (num_triangles + NORMALS_BATCH_SIZE - 1) / NORMALS_BATCH_SIZE;
+    size_t per_task    = NORMALS_TASK_SIZE / NORMALS_BATCH_SIZE;
+    size_t num_tasks   = (num_batches + per_task - 1) / per_task;
+
+    ParallelFor(num_tasks, [&](size_t task) {
+        size_t batch_end = std::min(num_batches, (task + 1) * per_task);
+
+        for (size_t batch = task * per_task; batch < batch_end; ++batch) {
+            size_t first = batch * NORMALS_BATCH_SIZE;
+            size_t count = std::min<size_t>(NORMALS_BATCH_SIZE, num_triangles - first);
+
+            // Posições dos cantos do lote (gather).
+            float ax[NORMALS_BATCH_SIZE], ay[NORMALS_BATCH_SIZE], az[NORMALS_BATCH_SIZE];
+            float bx[NORMALS_BATCH_SIZE], by[NORMALS_BATCH_SIZE], bz[NORMALS_BATCH_SIZE];
+            float cx[NORMALS_BATCH_SIZE], cy[NORMALS_BATCH_SIZE], cz[NORMALS_BATCH_SIZE];
+
+            for (size_t i = 0; i < NORMALS_BATCH_SIZE; ++i) {
+                // Lotes incompletos repetem o último triângulo.
+                const uint32_t* t = &indices[3 * (first + std::min(i, count - 1))];
+                ax[i]             = x[t[0]];
+                ay[i]             = y[t[0]];
+                az[i]             = z[t[0]];
+                bx[i]             = x[t[1]];
+                by[i]             = y[t[1]];
+                bz[i]             = z[t[1]];
+                cx[i]             = x[t[2]];
+                cy[i]             = y[t[2]];
+                cz[i]             = z[t[2]];
+            }
+
+            // Normal do triângulo: produto vetorial das arestas. Seu
+            // comprimento é o dobro da área do triângulo.
+            float fx[NORMALS_BATCH_SIZE], fy[NORMALS_BATCH_SIZE], fz[NORMALS_BATCH_SIZE];
+            float w0[NORMALS_BATCH_SIZE], w1[NORMALS_BATCH_SIZE], w2[NORMALS_BATCH_SIZE];
+
+            for (size_t i = 0; i < NORMALS_BATCH_SIZE; ++i) {
+                float ux = bx[i] - ax[i], uy = by[i] - ay[i], uz = bz[i] - az[i];
+                float vx = cx[i] - ax[i], vy = cy[i] - ay[i], vz = cz[i] - az[i];
+                fx[i]    = uy * vz - uz * vy;
+                fy[i]    = uz * vx - ux * vz;
+                fz[i]    = ux * vy - uy * vx;
+                w0[i]    = 1.0f;
+                w1[i]    = 1.0f;
+                w2[i]    = 1.0f;
+            }
+
+            if (weighting == NORMALS_WEIGHT_UNIFORM || weighting == NORMALS_WEIGHT_ANGLE) {
+                for (size_t i = 0; i < NORMALS_BATCH_SIZE; ++i) {
+                    float length = std::sqrt(fx[i] * fx[i] + fy[i] * fy[i] + fz[i] * fz[i]);
+                    float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+                    fx[i] *= scale;
+                    fy[i] *= scale;
+                    fz[i] *= scale;
+                }
+            }
+
+            if (weighting == NORMALS_WEIGHT_ANGLE) {
+                // Ângulo interno em cada canto, a partir dos cossenos entre as
+                // arestas. Os três ângulos somam pi.
+                for (size_t i = 0; i < NORMALS_BATCH_SIZE; ++i) {
+                    float abx = bx[i] - ax[i], aby = by[i] - ay[i], abz = bz[i] - az[i];
+                    float acx = cx[i] - ax[i], acy = cy[i] - ay[i], acz = cz[i] - az[i];
+                    float bcx = cx[i] - bx[i], bcy = cy[i] - by[i], bcz = cz[i] - bz[i];
+
+                    float ab = std::sqrt(abx * abx + aby * aby + abz * abz);
+                    float ac = std::sqrt(acx * acx + acy * acy + acz * acz);
+                    float bc = std::sqrt(bcx * bcx + bcy * bcy + bcz * bcz);
+
+                    float cos_a = (abx * acx + aby * acy + abz * acz) / std::max(ab * ac, 1e-30f);
+                    float cos_b = -(abx * bcx + aby * bcy + abz * bcz) / std::max(ab * bc, 1e-30f);
+
+                    w0[i] = std::acos(std::min(1.0f, std::max(-1.0f, cos_a)));
+                    w1[i] = std::acos(std::min(1.0f, std::max(-1.0f, cos_b)));
+                    w2[i] = std::max(0.0f, 3.14159265f - w0[i] - w1[i]);
+                }
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                size_t c        = 3 * (first + i);
+                corner_x[c + 0] = w0[i] * fx[i];
+                corner_y[c + 0] = w0[i] * fy[i];
+                corner_z[c + 0] = w0[i] * fz[i];
+                corner_x[c + 1] = w1[i] * fx[i];
+                corner_y[c + 1] = w1[i] * fy[i];
+                corner_z[c + 1] = w1[i] * fz[i];
+                corner_x[c + 2] = w2[i] * fx[i];
+                corner_y[c + 2] = w2[i] * fy[i];
+                corner_z[c + 2] = w2[i] * fz[i];
+            }
+        }
+    });
+
+    // Adjacência vértice -> cantos em formato CSR: os cantos que usam o
+    // vértice v estão em adjacency[offsets[v] .. offsets[v+1]).
+    size_t                num_corners = 3 * num_triangles;
+    std::vector<uint32_t> offsets(num_vertices + 1, 0);
+    for (size_t i = 0; i < num_corners; ++i) {
+        offsets[indices[i] + 1] += 1;
+    }
+    for (size_t v = 0; v < num_vertices; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> adjacency(num_corners);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < num_corners; ++i) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i);
+    }
+
+    // Soma das contribuições dos cantos de cada vértice, e normalização.
+    num_tasks = (num_vertices + NORMALS_TASK_SIZE - 1) / NORMALS_TASK_SIZE;
+
+    ParallelFor(num_tasks, [&](size_t task) {
+        size_t end = std::min(num_vertices, (task + 1) * NORMALS_TASK_SIZE);
+
+        for (size_t v = task * NORMALS_TASK_SIZE; v < end; ++v) {
+            float sx = 0.0f;
+            float sy = 0.0f;
+            float sz = 0.0f;
+            for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a) {
+                sx += corner_x[adjacency[a]];
+                sy += corner_y[adjacency[a]];
+                sz += corner_z[adjacency[a]];
+            }
+
+            float length = std::sqrt(sx * sx + sy * sy + sz * sz);
+            float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+            nx[v]        = sx * scale;
+            ny[v]        = sy * scale;
+            nz[v]        = sz * scale;
+        }
+    });
+}
+
+// Converte posições XYZXYZ... (como em tinyobj::attrib_t e MeshData) para
+// SoA, em paralelo.
+void SplitPositions(const float* positions, size_t num_vertices, std::vector<float>* x, std::vector<float>* y,
+                    std::vector<float>* z) {
+    x->resize(num_vertices);
+    y->resize(num_vertices);
+    z->resize(num_vertices);
+
+    ParallelFor((num_vertices + NORMALS_TASK_SIZE - 1) / NORMALS_TASK_SIZE, [&](size_t task) {
+        size_t end = std::min(num_vertices, (task + 1) * NORMALS_TASK_SIZE);
+        for (size_t v = task * NORMALS_TASK_SIZE; v < end; ++v) {
+            (*x)[v] = positions[3 * v + 0];
+            (*y)[v] = positions[3 * v + 1];
+            (*z)[v] = positions[3 * v + 2];
+        }
+    });
+}
+
+// Junta normais em SoA para o formato XYZXYZ..., em paralelo.
+void InterleaveNormals(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z,
+                       std::vector<float>* normals) {
+    size_t num_vertices = x.size();
+    normals->resize(3 * num_vertices);
+
+    ParallelFor((num_vertices + NORMALS_TASK_SIZE - 1) / NORMALS_TASK_SIZE, [&](size_t task) {
+        size_t end = std::min(num_vertices, (task + 1) * NORMALS_TASK_SIZE);
+        for (size_t v = task * NORMALS_TASK_SIZE; v < end; ++v) {
+            (*normals)[3 * v + 0] = x[v];
+            (*normals)[3 * v + 1] = y[v];
+            (*normals)[3 * v + 2] = z[v];
+        }
+    });
+}
+
+// Computa normais por vértice para uma malha sem normais (veja
+// ComputeVertexNormals()).
+void ComputeMeshNormals(MeshData* mesh, int weighting) {
+    size_t num_vertices = mesh->positions.size() / 3;
+
+    std::vector<float> x, y, z;
+    SplitPositions(mesh->positions.data(), num_vertices, &x, &y, &z);
+
+    std::vector<float> nx(num_vertices), ny(num_vertices), nz(num_vertices);
+    ComputeVertexNormals(x.data(), y.data(), z.data(), num_vertices, mesh->indices.data(), mesh->indices.size() / 3,
+                         weighting, nx.data(), ny.data(), nz.data());
+
+    InterleaveNormals(nx, ny, nz, &mesh->normals);
+}
+
+#endif  // _NORMALS_H
+// vim: set spell spelllang=pt_br :
@@ -0,0 +1,743 @@
+#ifndef _OBJPARSER_H
+#define _OBJPARSER_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+#include "mappedfile.h"
+#include "mesh.h"
+#include "normals.h"
+#include "parallel.h"
+
+// Leitor paralelo de arquivos ".obj".
+//
+// tinyobj::LoadObj() lê o arquivo linha por linha em uma única thread, e
+// converte os números com funções que dependem do "locale". Para modelos
+// grandes isto ocupa um núcleo do processador enquanto os outros ficam
+// parados. Aqui o arquivo é mapeado em memória e dividido em pedaços
+// ("chunks") que terminam em fim de linha; cada pedaço é lido por uma thread
+// diferente (veja ParallelFor() em "parallel.h"). Depois, somas de prefixo
+// do número de vértices e faces de cada pedaço dizem onde os resultados de
+// cada pedaço devem ser copiados, e a junção também é feita em paralelo.
+//
+// São suportados os comandos "v", "vn", "vt", "f" (triângulos), "g", "o" e
+// "s". Arquivos com materiais ("mtllib"/"usemtl"), linhas ou pontos ("l" e
+// "p"), polígonos com mais de três vértices, ou com erros, não são tratados
+// aqui: as funções retornam false e quem as chama deve usar
+// tinyobj::LoadObj(), que trata todos estes casos.
+//
+// Há duas formas de uso:
+//
+// - ObjParser_Load() preenche tinyobj::attrib_t e tinyobj::shape_t
+//   exatamente como tinyobj::LoadObj() (com triangulate = true), exceto por
+//   cores e pesos de vértices, que não são utilizados pelo resto do código.
+// - ObjParser_LoadMesh() escreve diretamente em uma MeshData (veja
+//   "mesh.h"), sem passar por tinyobj::index_t e sem "vertex welding", quando
+//   o arquivo já é uma malha indexada (cada canto usa o mesmo índice para
+//   posição, normal e textura, como em bunny.obj e sphere.obj).
+
+// Tamanho mínimo de um pedaço do arquivo. Pedaços pequenos demais gastam mais
+// tempo criando threads e juntando resultados do que lendo.
+#define OBJPARSER_MIN_CHUNK_SIZE (256 * 1024)
+
+// Índices de uma face, como guardados em ObjParserChunk::corners antes da
+// junção: índices absolutos (começando em 0) são guardados como estão, e
+// índices ausentes como -1. Índices negativos do ".obj" são relativos ao
+// número de vértices lidos até então, que uma thread só conhece dentro do seu
+// pedaço: eles são guardados como OBJPARSER_RELATIVE + (posição relativa ao
+// primeiro vértice do pedaço), e resolvidos na junção.
+#define OBJPARSER_MISSING  (-1)
+#define OBJPARSER_RELATIVE (INT_MIN / 2)
+
+// Comando "g", "o" ou "s" encontrado dentro de um pedaço.
+struct ObjParserEvent {
+    size_t       face;             // Número de faces do pedaço lidas antes do comando
+    bool         is_name;          // true para "g"/"o", false para "s"
+    std::string  name;             // Nome do grupo/objeto ("g"/"o")
+    unsigned int smoothing_group;  // Grupo de suavização ("s"), 0 para "off"
+};
+
+// Resultado da leitura de um pedaço do arquivo por uma thread.
+struct ObjParserChunk {
+    const char*                 begin;
+    const char*                 end;
+    bool                        supported;  // false se o pedaço contém algo que não tratamos
+    std::vector<float>          vertices;   // 3 floats por "v"
+    std::vector<float>          normals;    // 3 floats por "vn"
+    std::vector<float>          texcoords;  // 2 floats por "vt"
+    std::vector<int>            corners;    // 3 cantos por face, 3 ints por canto: v, vt, vn
+    std::vector<ObjParserEvent> events;
+
+    // Preenchidos na junção (somas de prefixo)
+    size_t       first_vertex;
+    size_t       first_normal;
+    size_t       first_texcoord;
+    size_t       first_face;
+    unsigned int smoothing_group;  // Grupo de suavização ativo no início do pedaço
+};
+
+// Objeto (shape) do arquivo: um intervalo contíguo de faces.
+struct ObjParserShape {
+    std::string name;
+    size_t      first_face;
+    size_t      num_faces;
+};
+
+// Arquivo ".obj" lido por ObjParser_Parse().
+struct ObjParserFile {
+    std::vector<ObjParserChunk> chunks;
+    std::vector<ObjParserShape> shapes;
+    size_t                      num_vertices;
+    size_t                      num_normals;
+    size_t                      num_texcoords;
+    size_t                      num_faces;
+};
+
+bool ObjParser_IsSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+bool ObjParser_IsEndOfLine(const char* p, const char* end) {
+    return p >= end || *p == '\n' || *p == '\r';
+}
+
+const char* ObjParser_SkipSpaces(const char* p, const char* end) {
+    while (p < end && ObjParser_IsSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* ObjParser_NextLine(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline != nullptr ? newline + 1 : end;
+}
+
+// Converte o número em ponto flutuante no início de [p, end). Retorna o
+// ponteiro para o primeiro caractere após o número, ou nullptr caso não haja
+// um número. Diferente de strtod(), não depende do "locale" e não trata
+// hexadecimais, "inf" e "nan", que não aparecem em arquivos ".obj".
+const char* ObjParser_ParseFloat(const char* p, const char* end, float* value) {
+    // Potências de 10 representadas exatamente por um double.
+    static const double powers_of_10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                          1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                          1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa   = 0;
+    int      exponent   = 0;
+    int      num_digits = 0;
+    bool     any_digit  = false;
+
+    // Guardamos no máximo 19 dígitos significativos na mantissa, que é o que
+    // cabe em 64 bits; os demais somente ajustam o expoente.
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        any_digit = true;
+        if (num_digits < 19) {
+            mantissa = 10 * mantissa + static_cast<uint64_t>(*p - '0');
+            num_digits += mantissa > 0 ? 1 : 0;
+        } else {
+            exponent += 1;
+        }
+    }
+
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+            any_digit = true;
+            if (num_digits < 19) {
+                mantissa = 10 * mantissa + static_cast<uint64_t>(*p - '0');
+                num_digits += mantissa > 0 ? 1 : 0;
+                exponent -= 1;
+            }
+        }
+    }
+
+    if (!any_digit) {
+        return nullptr;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q             = p + 1;
+        bool        exp_negative  = false;
+        int         exp_value     = 0;
+        bool        any_exp_digit = false;
+
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_negative = *q == '-';
+            ++q;
+        }
+        for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+            any_exp_digit = true;
+            if (exp_value < 10000) {
+                exp_value = 10 * exp_value + (*q - '0');
+            }
+        }
+        if (any_exp_digit) {
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = q;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0) {
+        if (exponent >= 0 && exponent <= 22) {
+            result *= powers_of_10[exponent];
+        } else if (exponent < 0 && exponent >= -22) {
+            result /= powers_of_10[-exponent];
+        } else {
+            result *= std::pow(10.0, exponent);
+        }
+    }
+
+    *value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+// Converte o inteiro no início de [p, end), com sinal opcional.
+const char* ObjParser_ParseInt(const char* p, const char* end, int* value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    if (p >= end || *p < '0' || *p > '9') {
+        return nullptr;
+    }
+
+    long result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        if (result < INT_MAX) {
+            result = 10 * result + (*p - '0');
+        }
+    }
+
+    *value = static_cast<int>(std::min<long>(negative ? -result : result, INT_MAX));
+    return p;
+}
+
+// Lê "count" floats separados por espaços. Valores extras no fim da linha (ex.:
+// o W opcional de "v" e "vt") são ignorados.
+const char* ObjParser_ParseFloats(const char* p, const char* end, size_t count, std::vector<float>* values) {
+    for (size_t i = 0; i < count; ++i) {
+        p = ObjParser_SkipSpaces(p, end);
+
+        float value;
+        p = ObjParser_ParseFloat(p, end, &value);
+        if (p == nullptr) {
+            return nullptr;
+        }
+        values->push_back(value);
+    }
+    return p;
+}
+
+// Converte um índice do ".obj" (começando em 1, ou negativo se relativo ao
+// fim da lista) para o formato de ObjParserChunk::corners. "local_count" é o
+// número de elementos da lista lidos até agora dentro do pedaço.
+int ObjParser_EncodeIndex(int index, size_t local_count) {
+    if (index > 0) {
+        return index - 1;
+    }
+    return OBJPARSER_RELATIVE + static_cast<int>(local_count) + index;
+}
+
+// Resolve um índice codificado por ObjParser_EncodeIndex(). "chunk_first" é o
+// número de elementos da lista lidos antes do início do pedaço.
+int ObjParser_DecodeIndex(int encoded, size_t chunk_first) {
+    if (encoded >= OBJPARSER_MISSING) {
+        return encoded;
+    }
+    return static_cast<int>(chunk_first) + (encoded - OBJPARSER_RELATIVE);
+}
+
+// Lê os comandos de um pedaço do arquivo.
+void ObjParser_ParseChunk(ObjParserChunk* chunk) {
+    const char* p   = chunk->begin;
+    const char* end = chunk->end;
+
+    chunk->supported = true;
+
+    for (; p < end; p = ObjParser_NextLine(p, end)) {
+        p = ObjParser_SkipSpaces(p, end);
+        if (ObjParser_IsEndOfLine(p, end)) {
+            continue;
+        }
+
+        const char c0 = p[0];
+        const char c1 = p + 1 < end ? p[1] : '\n';
+        const char c2 = p + 2 < end ? p[2] : '\n';
+
+        if (c0 == 'v' && ObjParser_IsSpace(c1)) {
+            p = ObjParser_ParseFloats(p + 2, end, 3, &chunk->vertices);
+        } else if (c0 == 'v' && c1 == 'n' && ObjParser_IsSpace(c2)) {
+            p = ObjParser_ParseFloats(p + 3, end, 3, &chunk->normals);
+        } else if (c0 == 'v' && c1 == 't' && ObjParser_IsSpace(c2)) {
+            p = ObjParser_ParseFloats(p + 3, end, 2, &chunk->texcoords);
+        } else if (c0 == 'f' && ObjParser_IsSpace(c1)) {
+            size_t num_corners = 0;
+            p += 2;
+
+            while (p != nullptr) {
+                p = ObjParser_SkipSpaces(p, end);
+                if (ObjParser_IsEndOfLine(p, end)) {
+                    break;
+                }
+
+                // Formatos "v", "v/vt", "v//vn" e "v/vt/vn".
+                int v  = 0;
+                int vt = 0;
+                int vn = 0;
+                p      = ObjParser_ParseInt(p, end, &v);
+                if (p != nullptr && p < end && *p == '/') {
+                    ++p;
+                    if (p < end && *p != '/') {
+                        p = ObjParser_ParseInt(p, end, &vt);
+                    }
+                    if (p != nullptr && p < end && *p == '/') {
+                        p = ObjParser_ParseInt(p + 1, end, &vn);
+                    }
+                }
+
+                if (p == nullptr || v == 0 || num_corners == 3) {
+                    p = nullptr;
+                    break;
+                }
+
+                chunk->corners.push_back(ObjParser_EncodeIndex(v, chunk->vertices.size() / 3));
+                chunk->corners.push_back(vt != 0 ? ObjParser_EncodeIndex(vt, chunk->texcoords.size() / 2)
+                                                 : OBJPARSER_MISSING);
+                chunk->corners.push_back(vn != 0 ? ObjParser_EncodeIndex(vn, chunk->normals.size() / 3)
+                                                 : OBJPARSER_MISSING);
+                num_corners += 1;
+            }
+
+            if (p == nullptr || num_corners != 3) {
+                p = nullptr;
+            }
+        } else if ((c0 == 'g' || c0 == 'o') && (ObjParser_IsSpace(c1) || ObjParser_IsEndOfLine(p + 1, end))) {
+            // O nome é o resto da linha. Para "g", palavras separadas por
+            // vários espaços são unidas por um único espaço, como na
+            // tinyobjloader.
+            ObjParserEvent event;
+            event.face            = chunk->corners.size() / 9;
+            event.is_name         = true;
+            event.smoothing_group = 0;
+
+            for (p = ObjParser_SkipSpaces(p + 1, end); !ObjParser_IsEndOfLine(p, end);) {
+                const char* word = p;
+                while (!ObjParser_IsEndOfLine(p, end) && (c0 == 'o' || !ObjParser_IsSpace(*p))) {
+                    ++p;
+                }
+                if (!event.name.empty()) {
+                    event.name += ' ';
+                }
+                event.name.append(word, p);
+                p = ObjParser_SkipSpaces(p, end);
+            }
+            while (!event.name.empty() && ObjParser_IsSpace(event.name.back())) {
+                event.name.pop_back();
+            }
+
+            chunk->events.push_back(event);
+        } else if (c0 == 's' && ObjParser_IsSpace(c1)) {
+            ObjParserEvent event;
+            event.face            = chunk->corners.size() / 9;
+            event.is_name         = false;
+            event.smoothing_group = 0;
+
+            p = ObjParser_SkipSpaces(p + 2, end);
+            int group;
+            if (end - p >= 3 && strncmp(p, "off", 3) == 0) {
+                event.smoothing_group = 0;
+            } else if (ObjParser_ParseInt(p, end, &group) != nullptr && group >= 0) {
+                event.smoothing_group = static_cast<unsigned int>(group);
+            }
+
+            chunk->events.push_back(event);
+        } else if (c0 == '#') {
+            continue;
+        } else if ((c0 == 'l' || c0 == 'p') && ObjParser_IsSpace(c1)) {
+            p = nullptr;
+        } else if (end - p >= 6 && (strncmp(p, "mtllib", 6) == 0 || strncmp(p, "usemtl", 6) == 0)) {
+            p = nullptr;
+        }
+        // Demais comandos (ex.: "vp", "cstype") são ignorados, como na tinyobjloader.
+
+        if (p == nullptr) {
+            chunk->supported = false;
+            return;
+        }
+    }
+}
+
+// Lê o arquivo em paralelo e calcula as somas de prefixo e os objetos. Não
+// resolve os índices das faces; isto é feito por quem usa o resultado.
+bool ObjParser_Parse(const std::string& filename, ObjParserFile* file) {
+    MappedFile mapped;
+    if (!MapFile(filename, &mapped)) {
+        return false;
+    }
+
+    const char* data = reinterpret_cast<const char*>(mapped.data);
+    size_t      size = mapped.size;
+
+    // Dividimos o arquivo em alguns pedaços por thread, para equilibrar a
+    // carga caso algumas partes do arquivo sejam mais lentas de ler.
+    size_t num_chunks = std::max<size_t>(1, std::min<size_t>(4 * ParallelThreadCount(),
+                                                             size / OBJPARSER_MIN_CHUNK_SIZE));
+
+    file->chunks.assign(num_chunks, ObjParserChunk());
+    const char* begin = data;
+    for (size_t c = 0; c < num_chunks; ++c) {
+        const char* end = c + 1 == num_chunks ? data + size : data + (c + 1) * size / num_chunks;
+        if (end < begin) {
+            end = begin;
+        }
+        end = end > data && end[-1] == '\n' ? end : ObjParser_NextLine(end, data + size);
+
+        file->chunks[c].begin = begin;
+        file->chunks[c].end   = end;
+        begin                 = end;
+    }
+
+    ParallelFor(num_chunks, [&](size_t c) { ObjParser_ParseChunk(&file->chunks[c]); });
+
+    UnmapFile(&mapped);
+
+    // Somas de prefixo e estado (nome do objeto, grupo de suavização) no
+    // início de cada pedaço.
+    file->num_vertices  = 0;
+    file->num_normals   = 0;
+    file->num_texcoords = 0;
+    file->num_faces     = 0;
+    file->shapes.clear();
+
+    // Faces antes do primeiro "g"/"o" pertencem a um objeto sem nome.
+    ObjParserShape current   = {"", 0, 0};
+    unsigned int   smoothing = 0;
+
+    for (ObjParserChunk& chunk : file->chunks) {
+        if (!chunk.supported) {
+            return false;
+        }
+
+        chunk.first_vertex    = file->num_vertices;
+        chunk.first_normal    = file->num_normals;
+        chunk.first_texcoord  = file->num_texcoords;
+        chunk.first_face      = file->num_faces;
+        chunk.smoothing_group = smoothing;
+
+        for (const ObjParserEvent& event : chunk.events) {
+            if (event.is_name) {
+                current.num_faces = chunk.first_face + event.face - current.first_face;
+                if (current.num_faces > 0) {
+                    file->shapes.push_back(current);
+                }
+                current.name       = event.name;
+                current.first_face = chunk.first_face + event.face;
+            } else {
+                smoothing = event.smoothing_group;
+            }
+        }
+
+        file->num_vertices += chunk.vertices.size() / 3;
+        file->num_normals += chunk.normals.size() / 3;
+        file->num_texcoords += chunk.texcoords.size() / 2;
+        file->num_faces += chunk.corners.size() / 9;
+    }
+
+    current.num_faces = file->num_faces - current.first_face;
+    if (current.num_faces > 0) {
+        file->shapes.push_back(current);
+    }
+
+    return true;
+}
+
+// Junta os atributos de todos os pedaços em arrays contíguos.
+void ObjParser_GatherAttributes(const ObjParserFile& file, std::vector<float>* vertices, std::vector<float>* normals,
+                                std::vector<float>* texcoords) {
+    vertices->resize(3 * file.num_vertices);
+    normals->resize(3 * file.num_normals);
+    texcoords->resize(2 * file.num_texcoords);
+
+    ParallelFor(file.chunks.size(), [&](size_t c) {
+        const ObjParserChunk& chunk = file.chunks[c];
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices->begin() + 3 * chunk.first_vertex);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals->begin() + 3 * chunk.first_normal);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords->begin() + 2 * chunk.first_texcoord);
+    });
+}
+
+// Índice do objeto que contém a face "face" (global).
+size_t ObjParser_FindShape(const ObjParserFile& file, size_t face) {
+    size_t shape = 0;
+    while (shape + 1 < file.shapes.size() && file.shapes[shape + 1].first_face <= face) {
+        ++shape;
+    }
+    return shape;
+}
+
+// Lê um arquivo ".obj" para as mesmas estruturas preenchidas por
+// tinyobj::LoadObj(). Retorna false caso o arquivo não exista, tenha erros,
+// ou use algo não suportado por este leitor (veja comentário no início do
+// arquivo).
+bool ObjParser_Load(const std::string& filename, tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes) {
+    ObjParserFile file;
+    if (!ObjParser_Parse(filename, &file)) {
+        return false;
+    }
+
+    ObjParser_GatherAttributes(file, &attrib->vertices, &attrib->normals, &attrib->texcoords);
+    attrib->colors.clear();
+
+    shapes->assign(file.shapes.size(), tinyobj::shape_t());
+    for (size_t s = 0; s < file.shapes.size(); ++s) {
+        tinyobj::mesh_t& mesh = (*shapes)[s].mesh;
+        (*shapes)[s].name     = file.shapes[s].name;
+        mesh.indices.resize(3 * file.shapes[s].num_faces);
+        mesh.num_face_vertices.assign(file.shapes[s].num_faces, 3);
+        mesh.material_ids.assign(file.shapes[s].num_faces, -1);
+        mesh.smoothing_group_ids.resize(file.shapes[s].num_faces);
+    }
+
+    // Cada pedaço escreve suas faces, já com os índices resolvidos, na posição
+    // final dentro do seu objeto.
+    std::vector<char> valid(file.chunks.size(), 1);
+
+    ParallelFor(file.chunks.size(), [&](size_t c) {
+        const ObjParserChunk& chunk     = file.chunks[c];
+        size_t                num_faces = chunk.corners.size() / 9;
+        size_t                shape     = ObjParser_FindShape(file, chunk.first_face);
+        unsigned int          smoothing = chunk.smoothing_group;
+        size_t                event     = 0;
+
+        for (size_t f = 0; f < num_faces; ++f) {
+            size_t face = chunk.first_face + f;
+            while (shape + 1 < file.shapes.size() && file.shapes[shape + 1].first_face <= face) {
+                ++shape;
+            }
+            for (; event < chunk.events.size() && chunk.events[event].face <= f; ++event) {
+                if (!chunk.events[event].is_name) {
+                    smoothing = chunk.events[event].smoothing_group;
+                }
+            }
+
+            tinyobj::mesh_t& mesh       = (*shapes)[shape].mesh;
+            size_t           shape_face = face - file.shapes[shape].first_face;
+
+            for (size_t k = 0; k < 3; ++k) {
+                const int*       corner = &chunk.corners[9 * f + 3 * k];
+                tinyobj::index_t idx;
+                idx.vertex_index   = ObjParser_DecodeIndex(corner[0], chunk.first_vertex);
+                idx.texcoord_index = ObjParser_DecodeIndex(corner[1], chunk.first_texcoord);
+                idx.normal_index   = ObjParser_DecodeIndex(corner[2], chunk.first_normal);
+
+                if (idx.vertex_index < 0 || static_cast<size_t>(idx.vertex_index) >= file.num_vertices ||
+                    idx.texcoord_index < OBJPARSER_MISSING ||
+                    idx.texcoord_index >= static_cast<int>(file.num_texcoords) ||
+                    idx.normal_index < OBJPARSER_MISSING || idx.normal_index >= static_cast<int>(file.num_normals)) {
+                    valid[c] = 0;
+                }
+
+                mesh.indices[3 * shape_face + k] = idx;
+            }
+            mesh.smoothing_group_ids[shape_face] = smoothing;
+        }
+    });
+
+    return std::find(valid.begin(), valid.end(), 0) == valid.end();
+}
+
+// Lê um arquivo ".obj" diretamente para uma MeshData, no formato que
+// BuildTriangles() produziria, mas sem "vertex welding": os arrays de
+// atributos do arquivo já são os arrays de vértices da malha. Retorna false
+// (e quem chama deve usar ObjModel e BuildTriangles()) se, além dos casos de
+// ObjParser_Load(), algum canto usar índices diferentes para posição, normal
+// e textura, se algum objeto não tiver nome, ou se os objetos compartilharem
+// vértices. Caso o arquivo não tenha normais, elas são computadas com o peso
+// "normal_weighting" (NORMALS_WEIGHT_*, veja "normals.h").
+bool ObjParser_LoadMesh(const std::string& filename, int normal_weighting, MeshData* mesh) {
+    ObjParserFile file;
+    if (!ObjParser_Parse(filename, &file)) {
+        return false;
+    }
+
+    if (file.num_faces == 0) {
+        return false;
+    }
+    for (const ObjParserShape& shape : file.shapes) {
+        if (shape.name.empty()) {
+            return false;
+        }
+    }
+
+    // Os índices das faces são escritos diretamente em mesh->indices, que
+    // tem a mesma ordem das faces do arquivo.
+    std::vector<GLuint>& indices = mesh->indices;
+    indices.resize(3 * file.num_faces);
+
+    // Para cada pedaço: índices válidos e iguais, e quantos cantos têm
+    // normal e coordenada de textura.
+    std::vector<char>   valid(file.chunks.size(), 1);
+    std::vector<size_t> corners_with_normal(file.chunks.size(), 0);
+    std::vector<size_t> corners_with_texcoord(file.chunks.size(), 0);
+
+    ParallelFor(file.chunks.size(), [&](size_t c) {
+        const ObjParserChunk& chunk       = file.chunks[c];
+        size_t                num_corners = chunk.corners.size() / 3;
+
+        for (size_t i = 0; i < num_corners; ++i) {
+            int v  = ObjParser_DecodeIndex(chunk.corners[3 * i + 0], chunk.first_vertex);
+            int vt = ObjParser_DecodeIndex(chunk.corners[3 * i + 1], chunk.first_texcoord);
+            int vn = ObjParser_DecodeIndex(chunk.corners[3 * i + 2], chunk.first_normal);
+
+            if (v < 0 || static_cast<size_t>(v) >= file.num_vertices || (vt != OBJPARSER_MISSING && vt != v) ||
+                (vn != OBJPARSER_MISSING && vn != v)) {
+                valid[c] = 0;
+                return;
+            }
+            if (vt != OBJPARSER_MISSING && static_cast<size_t>(vt) >= file.num_texcoords) {
+                valid[c] = 0;
+                return;
+            }
+            if (vn != OBJPARSER_MISSING && static_cast<size_t>(vn) >= file.num_normals) {
+                valid[c] = 0;
+                return;
+            }
+
+            corners_with_texcoord[c] += vt != OBJPARSER_MISSING ? 1 : 0;
+            corners_with_normal[c] += vn != OBJPARSER_MISSING ? 1 : 0;
+            indices[3 * chunk.first_face + i] = static_cast<GLuint>(v);
+        }
+    });
+
+    size_t num_corners   = 3 * file.num_faces;
+    size_t num_normals   = 0;
+    size_t num_texcoords = 0;
+    for (size_t c = 0; c < file.chunks.size(); ++c) {
+        if (!valid[c]) {
+            return false;
+        }
+        num_normals += corners_with_normal[c];
+        num_texcoords += corners_with_texcoord[c];
+    }
+
+    // Todos os cantos devem ter (ou não ter) normais e texturas.
+    if ((num_normals != 0 && num_normals != num_corners) || (num_texcoords != 0 && num_texcoords != num_corners)) {
+        return false;
+    }
+
+    // Intervalo de vértices usado por cada objeto. Os intervalos não podem se
+    // sobrepor, pois cada objeto deve ter seus próprios vértices.
+    std::vector<size_t> first_used(file.shapes.size());
+    std::vector<size_t> last_used(file.shapes.size());
+
+    ParallelFor(file.shapes.size(), [&](size_t s) {
+        const GLuint* begin = &indices[3 * file.shapes[s].first_face];
+        const GLuint* end   = begin + 3 * file.shapes[s].num_faces;
+        first_used[s]       = *std::min_element(begin, end);
+        last_used[s]        = *std::max_element(begin, end);
+    });
+
+    for (size_t s = 1; s < file.shapes.size(); ++s) {
+        if (first_used[s] <= last_used[s - 1]) {
+            return false;
+        }
+    }
+
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    ObjParser_GatherAttributes(file, &vertices, &normals, &texcoords);
+
+    // Caso comum: um único objeto que usa todos os vértices do arquivo. Os
+    // arrays lidos já são os arrays finais.
+    bool whole_file = file.shapes.size() == 1 && first_used[0] == 0 && last_used[0] + 1 == file.num_vertices;
+
+    if (whole_file) {
+        mesh->positions.swap(vertices);
+        if (num_normals > 0) {
+            normals.resize(3 * file.num_vertices);
+            mesh->normals.swap(normals);
+        }
+        if (num_texcoords > 0) {
+            texcoords.resize(2 * file.num_vertices);
+            mesh->texcoords.swap(texcoords);
+        }
+    }
+
+    mesh->objects.resize(file.shapes.size());
+
+    size_t num_vertices = 0;
+    for (size_t s = 0; s < file.shapes.size(); ++s) {
+        MeshObject& object   = mesh->objects[s];
+        object.name          = file.shapes[s].name;
+        object.first_index   = 3 * file.shapes[s].first_face;
+        object.num_indices   = 3 * file.shapes[s].num_faces;
+        object.first_vertex  = num_vertices;
+        object.num_vertices  = last_used[s] - first_used[s] + 1;
+        object.first_lod     = 0;
+        object.num_lods      = 0;
+        object.first_cluster = 0;
+        object.num_clusters  = 0;
+        num_vertices += object.num_vertices;
+
+        if (!whole_file) {
+            // Copiamos somente os vértices usados pelo objeto, e os índices
+            // passam a ser relativos à nova posição.
+            size_t first = first_used[s];
+            size_t count = object.num_vertices;
+
+            mesh->positions.insert(mesh->positions.end(), &vertices[3 * first], &vertices[3 * first] + 3 * count);
+            if (num_normals > 0) {
+                mesh->normals.insert(mesh->normals.end(), &normals[3 * first], &normals[3 * first] + 3 * count);
+            }
+            if (num_texcoords > 0) {
+                mesh->texcoords.insert(mesh->texcoords.end(), &texcoords[2 * first],
+                                       &texcoords[2 * first] + 2 * count);
+            }
+
+            for (size_t i = object.first_index; i < object.first_index + object.num_indices; ++i) {
+                indices[i] = static_cast<GLuint>(indices[i] - first + object.first_vertex);
+            }
+        }
+
+        // Axis-Aligned Bounding Box dos vértices usados pelos triângulos.
+        const float minval = std::numeric_limits<float>::lowest();
+        const float maxval = std::numeric_limits<float>::max();
+
+        object.bbox_min = glm::vec3(maxval, maxval, maxval);
+        object.bbox_max = glm::vec3(minval, minval, minval);
+
+        for (size_t i = object.first_index; i < object.first_index + object.num_indices; ++i) {
+            const float* position = &mesh->positions[3 * indices[i]];
+            for (int k = 0; k < 3; ++k) {
+                object.bbox_min[k] = std::min(object.bbox_min[k], position[k]);
+                object.bbox_max[k] = std::max(object.bbox_max[k], position[k]);
+            }
+        }
+    }
+
+    if (num_normals == 0) {
+        ComputeMeshNormals(mesh, normal_weighting);
+    }
+
+    return true;
+}
+
+#endif  // _OBJPARSER_H
+// vim: set spell spelllang=pt_br :
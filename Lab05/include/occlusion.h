@@ -0,0 +1,176 @@
+#ifndef _OCCLUSION_H
+#define _OCCLUSION_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "glad/glad.h"
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Descarte de objetos escondidos por outros objetos ("occlusion culling")
+// com "occlusion queries" do OpenGL.
+//
+// Antes de desenhar um objeto pesado (com muitos triângulos), desenhamos a
+// sua AABB, que tem somente 12 triângulos, sem escrever nem cor nem
+// profundidade, dentro de uma consulta GL_ANY_SAMPLES_PASSED: a GPU conta se
+// algum fragmento da caixa passou no teste de profundidade contra os objetos
+// já desenhados. O objeto é então desenhado entre glBeginConditionalRender()
+// e glEndConditionalRender(), e a própria GPU descarta o desenho caso nenhum
+// fragmento da caixa tenha passado, sem que a CPU precise esperar o
+// resultado da consulta.
+//
+// Como a fila de renderização desenha os objetos opacos do mais próximo para
+// o mais distante (veja "renderqueue.h"), os objetos que podem esconder um
+// objeto normalmente já estão no Z-buffer quando a sua caixa é testada.
+//
+// A CPU só lê os resultados para as estatísticas, alguns quadros depois, e
+// somente se eles já estiverem prontos (veja OcclusionQueries_Begin()).
+
+// Objetos com menos triângulos do que isto são desenhados sem o teste: a
+// consulta custaria mais do que desenhá-los.
+#define OCCLUSION_MIN_TRIANGLES 1000
+
+// Número de quadros com consultas em andamento ao mesmo tempo. Os
+// resultados de um quadro são lidos quando as suas consultas vão ser
+// reaproveitadas, OCCLUSION_FRAMES quadros depois.
+#define OCCLUSION_FRAMES 3
+
+// Objetos testados e escondidos em um quadro.
+struct OcclusionStats {
+    size_t num_tested;
+    size_t num_occluded;
+};
+
+struct OcclusionQueries {
+    // Cubo [0,1]^3 desenhado no lugar dos objetos; o vertex shader o leva
+    // para a AABB de cada objeto (veja "shader_vertex_occlusion.glsl").
+    GLuint vertex_array_object_id;
+    GLuint vertex_buffer_id;
+    GLuint index_buffer_id;
+
+    std::vector<GLuint> queries[OCCLUSION_FRAMES];   // Consultas criadas para cada quadro
+    size_t              num_used[OCCLUSION_FRAMES];  // Consultas usadas em cada quadro
+    int                 frame;                       // Quadro atual, em [0, OCCLUSION_FRAMES)
+
+    OcclusionStats stats;  // Último quadro cujos resultados foram lidos
+};
+
+void OcclusionQueries_Init(OcclusionQueries* occlusion) {
+    // Vértices e triângulos do cubo, com as faces no sentido anti-horário
+    // quando vistas de fora.
+    const GLfloat vertices[] = {
+            0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+    };
+    const GLubyte indices[] = {
+            0, 2, 1, 0, 3, 2,  // Z = 0
+            4, 5, 6, 4, 6, 7,  // Z = 1
+            0, 1, 5, 0, 5, 4,  // Y = 0
+            3, 7, 6, 3, 6, 2,  // Y = 1
+            0, 4, 7, 0, 7, 3,  // X = 0
+            1, 2, 6, 1, 6, 5,  // X = 1
+    };
+
+    glGenVertexArrays(1, &occlusion->vertex_array_object_id);
+    glBindVertexArray(occlusion->vertex_array_object_id);
+
+    glGenBuffers(1, &occlusion->vertex_buffer_id);
+    glBindBuffer(GL_ARRAY_BUFFER, occlusion->vertex_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &occlusion->index_buffer_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, occlusion->index_buffer_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+
+    for (int f = 0; f < OCCLUSION_FRAMES; ++f) {
+        occlusion->queries[f].clear();
+        occlusion->num_used[f] = 0;
+    }
+    occlusion->frame              = 0;
+    occlusion->stats.num_tested   = 0;
+    occlusion->stats.num_occluded = 0;
+}
+
+// Inicia um novo quadro, reaproveitando as consultas de OCCLUSION_FRAMES
+// quadros atrás. Antes, lemos os seus resultados para as estatísticas, mas
+// somente se a GPU já terminou todas elas (os resultados ficam prontos na
+// ordem das consultas); caso contrário mantemos as estatísticas anteriores,
+// em vez de esperar a GPU.
+void OcclusionQueries_Begin(OcclusionQueries* occlusion) {
+    occlusion->frame = (occlusion->frame + 1) % OCCLUSION_FRAMES;
+
+    const std::vector<GLuint>& queries  = occlusion->queries[occlusion->frame];
+    size_t                     num_used = occlusion->num_used[occlusion->frame];
+
+    GLuint available = GL_TRUE;
+    if (num_used > 0) {
+        glGetQueryObjectuiv(queries[num_used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (available == GL_TRUE) {
+        occlusion->stats.num_tested   = num_used;
+        occlusion->stats.num_occluded = 0;
+        for (size_t i = 0; i < num_used; ++i) {
+            GLuint any_samples_passed = GL_TRUE;
+            glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &any_samples_passed);
+            occlusion->stats.num_occluded += any_samples_passed == GL_FALSE ? 1 : 0;
+        }
+    }
+
+    occlusion->num_used[occlusion->frame] = 0;
+}
+
+// Retorna true se o ponto "camera" está dentro da AABB (center, extent) em
+// coordenadas globais, aumentada de "margin" em todas as direções. Nesse
+// caso a caixa pode ser cortada pelo "near plane" e o teste não é confiável:
+// o objeto deve ser desenhado sem ele.
+bool Occlusion_CameraInsideBox(const glm::vec4& camera, const glm::vec3& center, const glm::vec3& extent,
+                               float margin) {
+    return std::fabs(camera.x - center.x) <= extent.x + margin &&
+           std::fabs(camera.y - center.y) <= extent.y + margin && std::fabs(camera.z - center.z) <= extent.z + margin;
+}
+
+// Desenha a caixa de um objeto com o programa "program_id" (veja
+// "shader_vertex_occlusion.glsl"), dentro de uma nova consulta, e retorna a
+// consulta para glBeginConditionalRender(). O bloco ObjectUniforms do objeto
+// já deve estar ligado. O programa e o VAO atuais são trocados; cabe a quem
+// chama ligá-los novamente.
+GLuint OcclusionQueries_Test(OcclusionQueries* occlusion, GLuint program_id) {
+    std::vector<GLuint>& queries  = occlusion->queries[occlusion->frame];
+    size_t&              num_used = occlusion->num_used[occlusion->frame];
+    if (num_used == queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        queries.push_back(query);
+    }
+    GLuint query = queries[num_used];
+    num_used += 1;
+
+    // A caixa não altera a imagem nem o Z-buffer, e as suas faces de trás
+    // também são testadas.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDisable(GL_CULL_FACE);
+
+    glUseProgram(program_id);
+    glBindVertexArray(occlusion->vertex_array_object_id);
+
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    glEnable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    return query;
+}
+
+#endif  // _OCCLUSION_H
+// vim: set spell spelllang=pt_br :
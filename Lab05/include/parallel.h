@@ -0,0 +1,331 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Sistema de tarefas ("job system") com roubo de trabalho ("work stealing").
+//
+// Um conjunto fixo de threads de trabalho é criado uma única vez, em vez de
+// criar e destruir threads a cada ParallelFor(). Cada thread de trabalho tem
+// a sua própria fila de tarefas (um "deque"): ela executa as tarefas que ela
+// mesma criou a partir do fim da fila (a mais recente primeiro, cujos dados
+// ainda estão na cache), e, quando a sua fila fica vazia, "rouba" tarefas do
+// início das filas das outras threads. As demais threads (a thread principal
+// e as threads de "assetloader.h") submetem tarefas em uma fila
+// compartilhada, e não roubam tarefas.
+//
+// Tarefas são agrupadas por contadores (JobCounter): cada tarefa submetida
+// incrementa o seu contador, e o decrementa ao terminar. Uma thread que
+// depende de um grupo de tarefas espera o contador chegar a zero com
+// JobSystem_Wait(), executando outras tarefas enquanto espera, em vez de
+// bloquear. As threads que não são de trabalho executam somente tarefas do
+// grupo que esperam: a thread principal, esperando as tarefas de um quadro,
+// não pode pegar da fila compartilhada um pedaço de uma malha grande sendo
+// carregada por "assetloader.h".
+//
+// Com uma única thread (g_ParallelNumThreads = 1, ou "--threads 1" na linha
+// de comando), nenhuma thread de trabalho é criada e cada tarefa é executada
+// imediatamente, na ordem em que foi submetida: a execução é determinística,
+// o que facilita a depuração.
+
+// Número de threads utilizadas pelo sistema de tarefas, incluindo a thread
+// que espera as tarefas. Com 0 (padrão), usamos uma thread por núcleo lógico
+// do processador; outros valores são usados pelos benchmarks para medir a
+// escalabilidade. Só tem efeito em JobSystem_Start().
+unsigned int g_ParallelNumThreads = 0;
+
+// Número de threads indicado por g_ParallelNumThreads.
+unsigned int ParallelThreadCount() {
+    if (g_ParallelNumThreads > 0) {
+        return g_ParallelNumThreads;
+    }
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+// Contador de tarefas ainda não terminadas.
+struct JobCounter {
+    std::atomic<size_t> pending;
+
+    JobCounter() : pending(0) {}
+};
+
+struct Job {
+    std::function<void()> function;
+    JobCounter*           counter;
+};
+
+// Fila de tarefas de uma thread. O mutex só é disputado quando outra thread
+// rouba tarefas desta fila.
+struct JobQueue {
+    std::mutex      mutex;
+    std::deque<Job> jobs;
+};
+
+struct JobSystem {
+    std::atomic<unsigned int> num_threads;  // 0 enquanto o sistema não foi iniciado
+
+    // queues[0] é a fila compartilhada pelas threads que não são de
+    // trabalho; queues[w] é a fila da thread de trabalho w.
+    std::vector<std::unique_ptr<JobQueue>> queues;
+    std::vector<std::thread>               workers;
+
+    std::atomic<size_t>     num_queued;  // Tarefas em todas as filas
+    std::mutex              sleep_mutex;
+    std::condition_variable wake;        // Sinalizada quando há tarefas ou ao encerrar
+    bool                    stopping;    // Protegido por sleep_mutex
+};
+
+JobSystem g_JobSystem;
+
+// Fila da thread atual: 0 para threads que não são de trabalho.
+thread_local size_t g_JobQueueIndex = 0;
+
+// Mutex que serializa JobSystem_Start() e JobSystem_Stop().
+std::mutex g_JobSystemStartMutex;
+
+// Retira uma tarefa da fila da thread atual ou, se ela estiver vazia, rouba
+// de outra fila, executando-a. Retorna false se todas as filas estão vazias.
+bool JobSystem_RunOne() {
+    JobSystem&   system = g_JobSystem;
+    const size_t num    = system.queues.size();
+    const size_t own    = g_JobQueueIndex;
+
+    Job job;
+    bool found = false;
+    for (size_t k = 0; k < num && !found; ++k) {
+        JobQueue&                   queue = *system.queues[(own + k) % num];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        // Da própria fila, a tarefa mais recente; de outra fila, a mais
+        // antiga (que tende a ser a maior, e a que está há mais tempo
+        // esperando).
+        if (k == 0 && own != 0) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        } else {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+        found = true;
+    }
+    if (!found) {
+        return false;
+    }
+
+    system.num_queued -= 1;
+    job.function();
+    job.counter->pending -= 1;
+    return true;
+}
+
+// Retira da fila compartilhada uma tarefa contada em "counter", executando-a.
+// Retorna false se não há nenhuma. Usada pelas threads que não são de
+// trabalho enquanto esperam (veja JobSystem_Wait()).
+bool JobSystem_RunOneOf(JobCounter* counter) {
+    JobQueue& queue = *g_JobSystem.queues[0];
+
+    Job job;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        // A tarefa mais recente, como na fila de uma thread de trabalho.
+        auto it = std::find_if(queue.jobs.rbegin(), queue.jobs.rend(),
+                               [counter](const Job& queued) { return queued.counter == counter; });
+        if (it == queue.jobs.rend()) {
+            return false;
+        }
+        job = std::move(*it);
+        queue.jobs.erase(std::next(it).base());
+    }
+
+    g_JobSystem.num_queued -= 1;
+    job.function();
+    job.counter->pending -= 1;
+    return true;
+}
+
+// Laço executado por cada thread de trabalho.
+void JobSystem_WorkerLoop(size_t queue_index) {
+    g_JobQueueIndex = queue_index;
+
+    JobSystem& system = g_JobSystem;
+    for (;;) {
+        if (JobSystem_RunOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(system.sleep_mutex);
+        while (!system.stopping && system.num_queued == 0) {
+            system.wake.wait(lock);
+        }
+        if (system.stopping && system.num_queued == 0) {
+            return;
+        }
+    }
+}
+
+void JobSystem_Stop();
+
+// Inicia o sistema com ParallelThreadCount() threads: a thread que espera as
+// tarefas e mais ParallelThreadCount() - 1 threads de trabalho. Não faz nada
+// se o sistema já foi iniciado.
+void JobSystem_Start() {
+    JobSystem& system = g_JobSystem;
+    if (system.num_threads > 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_JobSystemStartMutex);
+    if (system.num_threads > 0) {
+        return;
+    }
+
+    // As threads de trabalho precisam terminar antes de g_JobSystem ser
+    // destruído, inclusive quando o programa termina com std::exit().
+    static bool registered = false;
+    if (!registered) {
+        std::atexit(JobSystem_Stop);
+        registered = true;
+    }
+
+    unsigned int num_threads = ParallelThreadCount();
+    system.num_queued = 0;
+    system.stopping   = false;
+    system.queues.clear();
+    for (unsigned int q = 0; q < num_threads; ++q) {
+        system.queues.emplace_back(new JobQueue());
+    }
+    for (unsigned int w = 1; w < num_threads; ++w) {
+        system.workers.emplace_back(JobSystem_WorkerLoop, w);
+    }
+    system.num_threads = num_threads;
+}
+
+// Termina as threads de trabalho, depois que elas executarem todas as
+// tarefas pendentes. Depois disso, JobSystem_Start() pode iniciar o sistema
+// novamente (por exemplo, com outro número de threads).
+void JobSystem_Stop() {
+    std::lock_guard<std::mutex> lock(g_JobSystemStartMutex);
+
+    JobSystem& system = g_JobSystem;
+    {
+        std::lock_guard<std::mutex> sleep_lock(system.sleep_mutex);
+        system.stopping = true;
+    }
+    system.wake.notify_all();
+    for (std::thread& worker : system.workers) {
+        worker.join();
+    }
+    system.workers.clear();
+    system.queues.clear();
+    system.num_threads = 0;
+}
+
+// Reinicia o sistema com "num_threads" threads (0 para uma por núcleo). Usado
+// pelos benchmarks que medem a escalabilidade.
+void JobSystem_SetThreadCount(unsigned int num_threads) {
+    JobSystem_Stop();
+    g_ParallelNumThreads = num_threads;
+    JobSystem_Start();
+}
+
+// Submete uma tarefa, contada em "counter". Com uma única thread, a tarefa é
+// executada imediatamente.
+void JobSystem_Run(std::function<void()> function, JobCounter* counter) {
+    JobSystem_Start();
+
+    JobSystem& system = g_JobSystem;
+    if (system.num_threads <= 1) {
+        function();
+        return;
+    }
+
+    counter->pending += 1;
+    {
+        JobQueue&                   queue = *system.queues[g_JobQueueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        Job                         job = {std::move(function), counter};
+        queue.jobs.push_back(std::move(job));
+    }
+    system.num_queued += 1;
+
+    // Tomamos o mutex antes de sinalizar para que uma thread que acabou de
+    // ver num_queued == 0 não perca o sinal.
+    { std::lock_guard<std::mutex> sleep_lock(system.sleep_mutex); }
+    system.wake.notify_one();
+}
+
+// Espera todas as tarefas contadas em "counter" terminarem, executando
+// outras tarefas enquanto isso: qualquer tarefa, nas threads de trabalho, e
+// somente as contadas em "counter", nas demais.
+void JobSystem_Wait(JobCounter* counter) {
+    const bool is_worker = g_JobQueueIndex != 0;
+    while (counter->pending > 0) {
+        bool ran = is_worker ? JobSystem_RunOne() : JobSystem_RunOneOf(counter);
+        if (!ran) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Executa function(i) para todo i em [0, count), distribuindo as chamadas
+// entre as threads do sistema de tarefas. Cada thread pega o próximo i ainda
+// não executado, então tarefas de tamanhos diferentes se equilibram. As
+// chamadas podem acontecer em qualquer ordem e em paralelo: "function" não
+// pode modificar dados compartilhados sem sincronização. Com uma única
+// thread, as chamadas são feitas em ordem.
+template <typename Function>
+void ParallelFor(size_t count, Function function) {
+    JobSystem_Start();
+
+    size_t num_jobs = std::min(static_cast<size_t>(g_JobSystem.num_threads), count);
+    if (num_jobs <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            function(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            function(i);
+        }
+    };
+
+    // A thread atual também trabalha, e depois ajuda com outras tarefas até
+    // as suas terminarem.
+    JobCounter counter;
+    for (size_t j = 1; j < num_jobs; ++j) {
+        JobSystem_Run(worker, &counter);
+    }
+    worker();
+    JobSystem_Wait(&counter);
+}
+
+// Executa function(first, last) para intervalos consecutivos [first, last)
+// de até "task_size" elementos, cobrindo [0, count), em paralelo.
+template <typename Function>
+void ParallelForRange(size_t count, size_t task_size, Function function) {
+    size_t num_tasks = (count + task_size - 1) / task_size;
+    ParallelFor(num_tasks, [&](size_t task) {
+        size_t first = task * task_size;
+        function(first, std::min(first + task_size, count));
+    });
+}
+
+#endif  // _PARALLEL_H
+// vim: set spell spelllang=pt_br :
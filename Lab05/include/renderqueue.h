@@ -0,0 +1,245 @@
+#ifndef _RENDERQUEUE_H
+#define _RENDERQUEUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "glad/glad.h"
+#include <glm/mat4x4.hpp>
+
+#include "commandlist.h"
+#include "slotmap.h"
+
+// Fila de renderização: em vez de desenhar cada objeto na ordem em que ele
+// aparece no código, o laço de renderização submete um RenderItem por objeto,
+// com todo o estado OpenGL necessário para desenhá-lo. A fila é então
+// ordenada por uma chave de 64 bits (veja RenderQueue_MakeKey()), que agrupa
+// os itens que usam o mesmo estado, e gravada em ordem em uma lista de
+// comandos (veja "commandlist.h"), ligando somente o estado que mudou entre
+// um item e o próximo.
+//
+// Dentro de cada grupo de itens com o mesmo estado, os objetos opacos são
+// desenhados do mais próximo para o mais distante da câmera: assim o teste
+// de profundidade (Z-buffer) descarta os fragmentos escondidos antes de
+// executar o fragment shader ("early-Z"). Objetos transparentes são
+// desenhados do mais distante para o mais próximo, como exige a mistura de
+// cores, antes de qualquer agrupamento por estado.
+
+// Número de unidades de textura controladas pela fila.
+#define RENDERQUEUE_MAX_TEXTURES 3
+
+// Passos de renderização, na ordem em que são executados.
+#define RENDERQUEUE_PASS_OPAQUE      0
+#define RENDERQUEUE_PASS_TRANSPARENT 1
+
+// Número de bits da profundidade quantizada dentro da chave.
+#define RENDERQUEUE_DEPTH_BITS 24
+
+struct RenderItem {
+    int           pass;                                // RENDERQUEUE_PASS_*
+    GLuint        program_id;                          // Programa de GPU
+    GLuint        vertex_array_object_id;              // VAO com os vértices do objeto
+    GLuint        textures[RENDERQUEUE_MAX_TEXTURES];  // Textura de cada unidade (0 se não usada)
+    int           material;                            // Material do objeto ("object_id" nos shaders)
+    float         depth;                               // Distância do objeto à câmera, ao longo do vetor "view"
+    SlotMapHandle object;                              // Objeto de g_VirtualScene
+    glm::mat4     model;                               // Matriz de modelagem
+    size_t        first_instance;                      // Instâncias do objeto (veja "instancing.h"); sem
+    size_t        num_instances;                       // instâncias (0), o objeto é desenhado com "model"
+    size_t        lod;                                 // Nível de detalhe (veja "meshlod.h")
+    size_t        uniform_block;                       // Variáveis "uniform" do objeto (veja "uniformbuffer.h")
+    bool          occlusion_test;                      // Teste de oclusão antes do desenho (veja "occlusion.h")
+};
+
+struct RenderQueueStats {
+    size_t num_items;              // Itens desenhados
+    size_t program_switches;       // Chamadas glUseProgram()
+    size_t vertex_array_switches;  // Chamadas glBindVertexArray()
+    size_t texture_switches;       // Chamadas glBindTexture()
+    size_t elided_binds;           // Trocas de estado evitadas por serem redundantes
+};
+
+// Par (chave, item) ordenado por RenderQueue_Sort().
+struct RenderSortEntry {
+    uint64_t key;
+    uint32_t item;
+};
+
+struct RenderQueue {
+    std::vector<RenderItem>      items;
+    std::vector<RenderSortEntry> sorted;   // Ordem de gravação dos itens
+    std::vector<RenderSortEntry> scratch;  // Memória auxiliar da ordenação
+
+    // Programas, VAOs e conjuntos de texturas usados no quadro atual. A chave
+    // guarda a posição de cada um nestas listas, que cabe em 8 bits.
+    std::vector<GLuint> programs;
+    std::vector<GLuint> vertex_arrays;
+    std::vector<GLuint> texture_sets;  // RENDERQUEUE_MAX_TEXTURES texturas por conjunto
+
+    float far_distance;  // Distância do "far plane", usada para quantizar a profundidade
+};
+
+// Inicia um novo quadro. "far_distance" é a distância (positiva) do "far
+// plane" até a câmera.
+void RenderQueue_Begin(RenderQueue* queue, float far_distance) {
+    queue->items.clear();
+    queue->programs.clear();
+    queue->vertex_arrays.clear();
+    queue->texture_sets.clear();
+    queue->far_distance = far_distance;
+}
+
+void RenderQueue_Submit(RenderQueue* queue, const RenderItem& item) { queue->items.push_back(item); }
+
+// Posição de "values[0..count)" dentro de "list", que guarda sequências de
+// "count" valores; sequências novas são adicionadas no fim. Caso a lista já
+// tenha 255 sequências, retorna 255: a ordenação fica menos eficiente, mas a
+// execução continua correta, pois ela compara o estado real de cada item.
+uint64_t RenderQueue_Intern(std::vector<GLuint>* list, const GLuint* values, size_t count) {
+    size_t num = list->size() / count;
+    for (size_t i = 0; i < num; ++i) {
+        if (std::equal(values, values + count, list->begin() + i * count)) {
+            return i;
+        }
+    }
+    if (num >= 255) {
+        return 255;
+    }
+    list->insert(list->end(), values, values + count);
+    return num;
+}
+
+// Monta a chave de ordenação de um item. Do bit mais significativo para o
+// menos significativo:
+//
+//   Opacos:        passo (2) | programa (8) | VAO (8) | texturas (8) | material (14) | profundidade (24)
+//   Transparentes: passo (2) | 1 - profundidade (24) | programa (8) | VAO (8) | texturas (8) | material (14)
+//
+// As trocas de estado mais caras (programa, VAO) ficam nos bits mais
+// significativos, para que aconteçam o menor número de vezes possível.
+uint64_t RenderQueue_MakeKey(RenderQueue* queue, const RenderItem& item) {
+    const uint64_t depth_max = (uint64_t(1) << RENDERQUEUE_DEPTH_BITS) - 1;
+
+    float    normalized = std::min(std::max(item.depth / queue->far_distance, 0.0f), 1.0f);
+    uint64_t depth      = static_cast<uint64_t>(normalized * static_cast<float>(depth_max));
+
+    uint64_t program  = RenderQueue_Intern(&queue->programs, &item.program_id, 1);
+    uint64_t vao      = RenderQueue_Intern(&queue->vertex_arrays, &item.vertex_array_object_id, 1);
+    uint64_t textures = RenderQueue_Intern(&queue->texture_sets, item.textures, RENDERQUEUE_MAX_TEXTURES);
+    uint64_t state    = (program << 16) | (vao << 8) | textures;
+    uint64_t pass     = static_cast<uint64_t>(item.pass) & 3;
+    uint64_t material = static_cast<uint64_t>(item.material);
+
+    if (item.pass == RENDERQUEUE_PASS_TRANSPARENT) {
+        return (pass << 62) | ((depth_max - depth) << 38) | (state << 14) | (material & 0x3FFF);
+    }
+    return (pass << 62) | (state << 38) | ((material & 0x3FFF) << 24) | depth;
+}
+
+// Ordena "entries" pela chave com "radix sort" (LSD, 8 bits por passada).
+// A ordenação é estável, e passadas em que todos os itens têm o mesmo byte
+// (ex.: todos usam o mesmo programa) são puladas.
+void RenderQueue_RadixSort(std::vector<RenderSortEntry>* entries, std::vector<RenderSortEntry>* scratch) {
+    const size_t count = entries->size();
+    scratch->resize(count);
+
+    RenderSortEntry* source      = entries->data();
+    RenderSortEntry* destination = scratch->data();
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[256];
+        memset(histogram, 0, sizeof(histogram));
+        for (size_t i = 0; i < count; ++i) {
+            histogram[(source[i].key >> shift) & 0xFF] += 1;
+        }
+        if (count == 0 || histogram[(source[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t& bucket : histogram) {
+            size_t size = bucket;
+            bucket      = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+
+    if (source != entries->data()) {
+        std::copy(source, source + count, entries->begin());
+    }
+}
+
+// Computa as chaves de todos os itens submetidos e os ordena.
+void RenderQueue_Sort(RenderQueue* queue) {
+    queue->sorted.resize(queue->items.size());
+    for (size_t i = 0; i < queue->items.size(); ++i) {
+        queue->sorted[i].key  = RenderQueue_MakeKey(queue, queue->items[i]);
+        queue->sorted[i].item = static_cast<uint32_t>(i);
+    }
+    RenderQueue_RadixSort(&queue->sorted, &queue->scratch);
+}
+
+// Grava os itens em "list", na ordem computada por RenderQueue_Sort(),
+// ligando somente o programa, o VAO e as texturas que mudaram em relação ao
+// item anterior. Para cada item é chamada draw(item), que deve gravar os
+// comandos que apontam as variáveis "uniform" do objeto (inclusive o
+// material) e o desenham. Ao final, o VAO é "desligado".
+template <typename DrawFunction>
+void RenderQueue_Record(const RenderQueue& queue, CommandList* list, RenderQueueStats* stats, DrawFunction draw) {
+    memset(stats, 0, sizeof(*stats));
+
+    // O estado no início do quadro é desconhecido (ex.: a renderização de
+    // texto usa outro VAO), então o primeiro item sempre liga tudo.
+    bool   first_item = true;
+    GLuint program    = 0;
+    GLuint vao        = 0;
+
+    GLuint textures[RENDERQUEUE_MAX_TEXTURES] = {0};
+
+    for (const RenderSortEntry& entry : queue.sorted) {
+        const RenderItem& item = queue.items[entry.item];
+
+        if (first_item || item.program_id != program) {
+            CommandList_BindProgram(list, item.program_id);
+            program = item.program_id;
+            stats->program_switches += 1;
+        } else {
+            stats->elided_binds += 1;
+        }
+
+        if (first_item || item.vertex_array_object_id != vao) {
+            CommandList_BindVertexArray(list, item.vertex_array_object_id);
+            vao = item.vertex_array_object_id;
+            stats->vertex_array_switches += 1;
+        } else {
+            stats->elided_binds += 1;
+        }
+
+        for (int unit = 0; unit < RENDERQUEUE_MAX_TEXTURES; ++unit) {
+            if (first_item || item.textures[unit] != textures[unit]) {
+                CommandList_BindTexture(list, unit, item.textures[unit]);
+                textures[unit] = item.textures[unit];
+                stats->texture_switches += 1;
+            } else {
+                stats->elided_binds += 1;
+            }
+        }
+
+        draw(item);
+
+        stats->num_items += 1;
+        first_item = false;
+    }
+
+    CommandList_BindVertexArray(list, 0);
+}
+
+#endif  // _RENDERQUEUE_H
+// vim: set spell spelllang=pt_br :
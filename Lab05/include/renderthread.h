@@ -0,0 +1,352 @@
+#ifndef _RENDERTHREAD_H
+#define _RENDERTHREAD_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "glad/glad.h"
+#include "glfw/glfw3.h"
+
+#include "commandlist.h"
+#include "instancing.h"
+#include "occlusion.h"
+#include "uniformbuffer.h"
+
+// Thread de renderização. Cada quadro é dividido em duas etapas:
+//
+//   - gravação, pela thread principal: trata a entrada (callbacks da GLFW),
+//     atualiza a cena e grava tudo o que o quadro vai desenhar em um
+//     RenderFrame: variáveis "uniform", instâncias, comandos (veja
+//     "commandlist.h") e texto. Nenhuma função OpenGL é chamada;
+//   - execução, pela thread de renderização, a única com o contexto OpenGL:
+//     envia os dados do quadro para a GPU, executa os comandos e troca os
+//     buffers da janela.
+//
+// Há RENDERTHREAD_FRAMES quadros ("double buffering"): enquanto a thread de
+// renderização executa o quadro N, a thread principal grava o quadro N + 1.
+// Assim um quadro lento na GPU não atrasa o tratamento da entrada, e o tempo
+// por quadro passa a ser o maior dos tempos das duas etapas, em vez da sua
+// soma. Em troca, a imagem mostrada pode ficar até um quadro mais atrasada
+// em relação à entrada (latência; veja RenderThreadStats).
+//
+// Operações que alteram recursos OpenGL fora dos quadros (envio de malhas e
+// texturas, recompilação dos shaders) são executadas pela thread de
+// renderização com RenderThread_Call(), que antes espera a execução de todos
+// os quadros já gravados. Enquanto isso a thread principal fica parada,
+// então essas operações podem alterar os dados da cena livremente.
+//
+// Com a thread desligada, cada quadro é executado pela própria thread
+// principal logo depois de gravado, como em um laço de renderização comum.
+
+// Número de quadros em que a thread principal pode gravar.
+#define RENDERTHREAD_FRAMES 2
+
+// Tamanho máximo de cada linha de texto, incluindo o '\0' final.
+#define RENDERTHREAD_TEXT_LENGTH 96
+
+// Intervalo, em segundos, em que as médias de RenderThreadStats são
+// computadas.
+#define RENDERTHREAD_STATS_PERIOD 2.0
+
+// Linha de texto desenhada sobre a cena (veja
+// TextRendering_PrintStringInWindow()).
+struct RenderText {
+    char  text[RENDERTHREAD_TEXT_LENGTH];
+    float x;
+    float y;
+    float scale;
+};
+
+// Um quadro gravado. Os vetores são reaproveitados de um quadro para o
+// outro: depois dos primeiros quadros, gravar um quadro não aloca memória.
+struct RenderFrame {
+    // Gravados pela thread principal.
+    int                         viewport_width;   // Tamanho do framebuffer (glViewport())
+    int                         viewport_height;
+    int                         window_width;     // Tamanho da janela, usado pelo texto
+    int                         window_height;
+    int                         swap_interval;    // glfwSwapInterval(), ou -1 para não alterar
+    FrameUniforms               frame_uniforms;   // Bloco FrameUniforms (veja "uniformbuffer.h")
+    std::vector<ObjectUniforms> uniform_blocks;   // Blocos ObjectUniforms dos itens do quadro
+    std::vector<InstanceData>   instances;        // Instâncias do quadro (veja "instancing.h")
+    CommandList                 commands;         // Comandos de desenho da cena
+    std::vector<RenderText>     texts;            // Texto desenhado depois da cena
+    double                      input_time;       // Instante em que a entrada do quadro foi lida
+
+    // Escritos pela thread de renderização.
+    double         present_time;     // Instante em que os buffers foram trocados
+    OcclusionStats occlusion_stats;  // Estatísticas de oclusão lidas neste quadro (veja "occlusion.h")
+};
+
+// Médias dos últimos RENDERTHREAD_STATS_PERIOD segundos.
+struct RenderThreadStats {
+    double frame_time;  // Tempo por quadro, em segundos
+    double latency;     // Tempo entre ler a entrada e mostrar o quadro, em segundos
+    bool   threaded;    // A thread de renderização estava ligada
+
+    // Acumulados do período atual.
+    double start_time;
+    size_t num_frames;
+    double latency_sum;
+};
+
+struct RenderThread {
+    RenderFrame frames[RENDERTHREAD_FRAMES];
+    GLFWwindow* window;
+    void (*execute)(RenderFrame* frame);  // Executa um quadro gravado, exceto a troca de buffers
+
+    std::thread thread;
+    bool        running;  // A thread existe; alterado somente pela thread principal
+
+    std::mutex              mutex;
+    std::condition_variable changed;             // Sinalizada quando os campos abaixo mudam
+    size_t                  num_recorded;        // Quadros gravados (RenderThread_SubmitFrame())
+    size_t                  num_executed;        // Quadros já executados
+    double                  first_present_time;  // Troca de buffers do primeiro quadro executado
+    bool                    stopping;
+    std::function<void()>   task;                // Tarefa de RenderThread_Call() ainda não executada
+
+    RenderThreadStats stats;  // Somente a thread principal usa
+};
+
+// Inicia um novo quadro, limpando os dados gravados anteriormente e mantendo
+// a memória alocada.
+void RenderFrame_Clear(RenderFrame* frame) {
+    frame->uniform_blocks.clear();
+    frame->instances.clear();
+    CommandList_Clear(&frame->commands);
+    frame->texts.clear();
+}
+
+// Adiciona o bloco ObjectUniforms de um item, retornando a sua posição (veja
+// CommandList_BindUniformBlock()).
+size_t RenderFrame_AddUniformBlock(RenderFrame* frame, const ObjectUniforms& block) {
+    frame->uniform_blocks.push_back(block);
+    return frame->uniform_blocks.size() - 1;
+}
+
+// Adiciona uma linha de texto, cortada se for maior que
+// RENDERTHREAD_TEXT_LENGTH - 1 caracteres.
+void RenderFrame_AddText(RenderFrame* frame, const char* text, float x, float y, float scale) {
+    RenderText line;
+    snprintf(line.text, RENDERTHREAD_TEXT_LENGTH, "%s", text);
+    line.x     = x;
+    line.y     = y;
+    line.scale = scale;
+    frame->texts.push_back(line);
+}
+
+// Executa um quadro e troca os buffers. Chamada pela thread que tem o
+// contexto OpenGL.
+void RenderThread_ExecuteFrame(RenderThread* render, RenderFrame* frame) {
+    static int swap_interval = -1;
+    if (frame->swap_interval >= 0 && frame->swap_interval != swap_interval) {
+        glfwSwapInterval(frame->swap_interval);
+        swap_interval = frame->swap_interval;
+    }
+
+    render->execute(frame);
+    glfwSwapBuffers(render->window);
+    frame->present_time = glfwGetTime();
+
+    if (render->num_executed == 0) {
+        render->first_present_time = frame->present_time;
+    }
+}
+
+// Laço da thread de renderização: executa os quadros na ordem em que foram
+// gravados e as tarefas de RenderThread_Call() entre eles.
+void RenderThread_Loop(RenderThread* render) {
+    glfwMakeContextCurrent(render->window);
+
+    std::unique_lock<std::mutex> lock(render->mutex);
+    for (;;) {
+        while (!render->stopping && !render->task && render->num_executed == render->num_recorded) {
+            render->changed.wait(lock);
+        }
+
+        if (render->num_executed < render->num_recorded) {
+            RenderFrame* frame = &render->frames[render->num_executed % RENDERTHREAD_FRAMES];
+            lock.unlock();
+            RenderThread_ExecuteFrame(render, frame);
+            lock.lock();
+            render->num_executed += 1;
+            render->changed.notify_all();
+        } else if (render->task) {
+            // Todos os quadros gravados já foram executados.
+            lock.unlock();
+            render->task();
+            lock.lock();
+            render->task = nullptr;
+            render->changed.notify_all();
+        } else {
+            break;  // render->stopping
+        }
+    }
+    lock.unlock();
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+// Prepara a execução de quadros pela thread principal, que deve ter o
+// contexto OpenGL de "window". "execute" executa um quadro gravado, exceto a
+// troca de buffers. A thread de renderização é iniciada por
+// RenderThread_Start().
+void RenderThread_Init(RenderThread* render, GLFWwindow* window, void (*execute)(RenderFrame* frame)) {
+    render->window       = window;
+    render->execute      = execute;
+    render->running      = false;
+    render->num_recorded = 0;
+    render->num_executed = 0;
+    render->stopping     = false;
+    render->task         = nullptr;
+
+    render->first_present_time = 0.0;
+
+    for (RenderFrame& frame : render->frames) {
+        frame.input_time                   = 0.0;
+        frame.present_time                 = 0.0;
+        frame.occlusion_stats.num_tested   = 0;
+        frame.occlusion_stats.num_occluded = 0;
+    }
+
+    memset(&render->stats, 0, sizeof(render->stats));
+    render->stats.start_time = glfwGetTime();
+}
+
+// Passa o contexto OpenGL da thread principal para uma nova thread de
+// renderização. Não faz nada se ela já existe.
+void RenderThread_Start(RenderThread* render) {
+    if (render->running) {
+        return;
+    }
+    render->stopping = false;
+    glfwMakeContextCurrent(nullptr);
+    render->thread  = std::thread(RenderThread_Loop, render);
+    render->running = true;
+}
+
+// Espera a execução dos quadros já gravados, encerra a thread de
+// renderização e devolve o contexto OpenGL para a thread principal. Não faz
+// nada se ela não existe.
+void RenderThread_Stop(RenderThread* render) {
+    if (!render->running) {
+        return;
+    }
+
+    // Chamada pela própria thread de renderização (ex.: std::exit() durante
+    // um envio de recurso): ela não pode esperar a si mesma.
+    if (std::this_thread::get_id() == render->thread.get_id()) {
+        render->thread.detach();
+        render->running = false;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(render->mutex);
+        render->stopping = true;
+    }
+    render->changed.notify_all();
+    render->thread.join();
+    render->running = false;
+
+    glfwMakeContextCurrent(render->window);
+}
+
+// Acumula o tempo por quadro e a latência de um quadro já mostrado.
+void RenderThread_UpdateStats(RenderThread* render, const RenderFrame& frame) {
+    RenderThreadStats& stats = render->stats;
+
+    // Recomeçamos a medição quando a thread é ligada ou desligada.
+    if (stats.threaded != render->running) {
+        stats.threaded    = render->running;
+        stats.start_time  = frame.present_time;
+        stats.num_frames  = 0;
+        stats.latency_sum = 0.0;
+        return;
+    }
+
+    stats.num_frames += 1;
+    stats.latency_sum += frame.present_time - frame.input_time;
+
+    double elapsed = frame.present_time - stats.start_time;
+    if (elapsed >= RENDERTHREAD_STATS_PERIOD) {
+        stats.frame_time  = elapsed / stats.num_frames;
+        stats.latency     = stats.latency_sum / stats.num_frames;
+        stats.start_time  = frame.present_time;
+        stats.num_frames  = 0;
+        stats.latency_sum = 0.0;
+    }
+}
+
+// Retorna o próximo quadro a ser gravado, esperando, se necessário, a thread
+// de renderização terminar de executar o quadro que usou a mesma memória.
+RenderFrame* RenderThread_BeginFrame(RenderThread* render) {
+    RenderFrame* frame = &render->frames[render->num_recorded % RENDERTHREAD_FRAMES];
+    if (render->running) {
+        std::unique_lock<std::mutex> lock(render->mutex);
+        while (render->num_recorded - render->num_executed >= RENDERTHREAD_FRAMES) {
+            render->changed.wait(lock);
+        }
+    }
+
+    // O quadro anterior que usou esta memória já foi mostrado.
+    if (frame->present_time > 0.0) {
+        RenderThread_UpdateStats(render, *frame);
+    }
+
+    RenderFrame_Clear(frame);
+    frame->input_time   = glfwGetTime();
+    frame->present_time = 0.0;
+    return frame;
+}
+
+// Entrega o quadro retornado por RenderThread_BeginFrame() para execução.
+// Com a thread de renderização desligada, o quadro é executado
+// imediatamente.
+void RenderThread_SubmitFrame(RenderThread* render) {
+    if (!render->running) {
+        RenderThread_ExecuteFrame(render, &render->frames[render->num_recorded % RENDERTHREAD_FRAMES]);
+        render->num_recorded += 1;
+        render->num_executed += 1;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(render->mutex);
+        render->num_recorded += 1;
+    }
+    render->changed.notify_all();
+}
+
+// Instante em que o primeiro quadro foi mostrado ao usuário (a troca de
+// buffers em RenderThread_ExecuteFrame()), ou 0 se isso ainda não aconteceu.
+double RenderThread_FirstPresentTime(RenderThread* render) {
+    std::lock_guard<std::mutex> lock(render->mutex);
+    return render->num_executed > 0 ? render->first_present_time : 0.0;
+}
+
+// Executa "task" na thread que tem o contexto OpenGL, depois de todos os
+// quadros já gravados, e espera o seu fim.
+void RenderThread_Call(RenderThread* render, const std::function<void()>& task) {
+    if (!render->running) {
+        task();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(render->mutex);
+    render->task = task;
+    render->changed.notify_all();
+    while (render->task) {
+        render->changed.wait(lock);
+    }
+}
+
+#endif  // _RENDERTHREAD_H
+// vim: set spell spelllang=pt_br :
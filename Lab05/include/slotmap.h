@@ -0,0 +1,143 @@
+#ifndef _SLOTMAP_H
+#define _SLOTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// "Slot map": um contêiner cujos elementos são identificados por handles de
+// tamanho fixo, em vez de nomes. Acessar um elemento pelo seu handle custa
+// O(1), sem comparar strings e sem alocar memória, o que permite que o laço
+// de renderização use handles no lugar de buscas em um std::map indexado por
+// nomes. Os nomes são resolvidos para handles uma única vez, quando os
+// objetos são carregados.
+//
+// Os elementos ficam lado a lado em items[], na ordem em que foram
+// inseridos (exceto pelas remoções; veja SlotMap_Remove()). O handle aponta
+// para uma posição de slots[], que guarda a posição atual do elemento em
+// items[], e uma "geração" que é incrementada sempre que o elemento é
+// removido. Assim, um handle de um elemento já removido nunca acessa o
+// elemento que reaproveitou o seu slot: SlotMap_Get() retorna nullptr.
+
+struct SlotMapHandle {
+    uint32_t index;       // Posição em slots[]
+    uint32_t generation;  // Geração do slot quando o handle foi criado (nunca 0)
+};
+
+// Handle que não aponta para nenhum elemento.
+const SlotMapHandle SLOTMAP_INVALID_HANDLE = {0, 0};
+
+inline bool operator==(const SlotMapHandle& a, const SlotMapHandle& b) {
+    return a.index == b.index && a.generation == b.generation;
+}
+
+inline bool operator!=(const SlotMapHandle& a, const SlotMapHandle& b) { return !(a == b); }
+
+struct SlotMapSlot {
+    uint32_t item;        // Posição do elemento em items[] ou, se o slot está livre, o próximo slot livre
+    uint32_t generation;  // Incrementada a cada remoção
+    bool     occupied;
+};
+
+template <typename T>
+struct SlotMap {
+    std::vector<T>           items;       // Elementos, sem buracos
+    std::vector<uint32_t>    item_slots;  // Slot de cada elemento de items[]
+    std::vector<SlotMapSlot> slots;
+    uint32_t                 free_slot;   // Primeiro slot livre (slots.size() se não há nenhum)
+
+    SlotMap() : free_slot(0) {}
+};
+
+// Reserva espaço para "capacity" elementos, evitando alocações nas próximas
+// inserções.
+template <typename T>
+void SlotMap_Reserve(SlotMap<T>* map, size_t capacity) {
+    map->items.reserve(capacity);
+    map->item_slots.reserve(capacity);
+    map->slots.reserve(capacity);
+}
+
+// Insere um elemento, retornando o seu handle.
+template <typename T>
+SlotMapHandle SlotMap_Insert(SlotMap<T>* map, const T& item) {
+    uint32_t index = map->free_slot;
+    if (index == map->slots.size()) {
+        SlotMapSlot new_slot = {0, 1, false};
+        map->slots.push_back(new_slot);
+        map->free_slot = index + 1;
+    } else {
+        map->free_slot = map->slots[index].item;
+    }
+
+    SlotMapSlot& slot = map->slots[index];
+    slot.item         = static_cast<uint32_t>(map->items.size());
+    slot.occupied     = true;
+
+    map->items.push_back(item);
+    map->item_slots.push_back(index);
+
+    SlotMapHandle handle = {index, slot.generation};
+    return handle;
+}
+
+// Retorna o elemento apontado por "handle", ou nullptr caso o elemento já
+// tenha sido removido (ou o handle seja inválido).
+template <typename T>
+T* SlotMap_Get(SlotMap<T>* map, SlotMapHandle handle) {
+    if (handle.index >= map->slots.size()) {
+        return nullptr;
+    }
+    const SlotMapSlot& slot = map->slots[handle.index];
+    if (!slot.occupied || slot.generation != handle.generation) {
+        return nullptr;
+    }
+    return &map->items[slot.item];
+}
+
+template <typename T>
+bool SlotMap_Contains(const SlotMap<T>& map, SlotMapHandle handle) {
+    return handle.index < map.slots.size() && map.slots[handle.index].occupied &&
+           map.slots[handle.index].generation == handle.generation;
+}
+
+// Remove o elemento apontado por "handle". O último elemento de items[] é
+// movido para a posição do elemento removido, mantendo items[] sem buracos;
+// ponteiros para elementos obtidos antes da remoção deixam de ser válidos,
+// mas handles continuam válidos. Retorna false se o handle já era inválido.
+template <typename T>
+bool SlotMap_Remove(SlotMap<T>* map, SlotMapHandle handle) {
+    if (!SlotMap_Contains(*map, handle)) {
+        return false;
+    }
+
+    SlotMapSlot& slot = map->slots[handle.index];
+    uint32_t     item = slot.item;
+    uint32_t     last = static_cast<uint32_t>(map->items.size() - 1);
+
+    if (item != last) {
+        map->items[item]                       = std::move(map->items[last]);
+        map->item_slots[item]                  = map->item_slots[last];
+        map->slots[map->item_slots[item]].item = item;
+    }
+    map->items.pop_back();
+    map->item_slots.pop_back();
+
+    // A geração 0 nunca é usada, para que SLOTMAP_INVALID_HANDLE nunca seja
+    // válido.
+    slot.generation = slot.generation + 1 != 0 ? slot.generation + 1 : 1;
+    slot.occupied   = false;
+    slot.item       = map->free_slot;
+    map->free_slot  = handle.index;
+
+    return true;
+}
+
+template <typename T>
+size_t SlotMap_Size(const SlotMap<T>& map) {
+    return map.items.size();
+}
+
+#endif  // _SLOTMAP_H
+// vim: set spell spelllang=pt_br :
@@ -0,0 +1,248 @@
+#ifndef _TRANSFORM_H
+#define _TRANSFORM_H
+
+#include <cstddef>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "matrices.h"
+#include "parallel.h"
+
+// Transformação de muitos pontos ou vetores de uma vez ("batch"), para o
+// trabalho feito na CPU sobre muitos elementos: AABBs, raios de seleção,
+// deformação de vértices, etc.
+//
+// Os pontos são armazenados como "structure of arrays" (SoA): um array para
+// cada coordenada (veja TransformArrays). Assim, com SSE (ou AVX), uma única
+// instrução transforma a mesma coordenada de quatro (ou oito) pontos, e a
+// matriz fica nos registradores durante todo o laço. Veja "matrices.h" para
+// a escolha entre SSE, AVX e a versão escalar.
+//
+// Cada coordenada do resultado é calculada com as mesmas operações, na mesma
+// ordem, de Matrix_Multiply_Vector() (e do operador * da GLM): os resultados
+// são idênticos bit a bit aos de transformar cada ponto separadamente.
+//
+// Acima de TRANSFORM_PARALLEL_THRESHOLD elementos, o trabalho é dividido em
+// intervalos de TRANSFORM_TASK_SIZE elementos entre as threads do sistema de
+// tarefas (veja "parallel.h"). Abaixo disso, o custo de distribuir as
+// tarefas seria maior que o ganho.
+#define TRANSFORM_PARALLEL_THRESHOLD 32768
+#define TRANSFORM_TASK_SIZE          8192
+
+// Coordenadas x, y e z de pontos ou vetores, em arrays separados. A
+// coordenada w é implícita: 1 para pontos e 0 para vetores. A entrada e a
+// saída de uma transformação podem ser os mesmos arrays.
+struct TransformArrays {
+    float* x;
+    float* y;
+    float* z;
+};
+
+// Transforma os elementos [first, last) de "in" pela matriz "m", com
+// coordenada w = "w", guardando x, y e z do resultado em "out".
+void Transform_Range_Scalar(const glm::mat4& m, float w, const TransformArrays& in, const TransformArrays& out,
+                            size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+        float x  = in.x[i];
+        float y  = in.y[i];
+        float z  = in.z[i];
+        out.x[i] = (m[0][0] * x + m[1][0] * y) + (m[2][0] * z + m[3][0] * w);
+        out.y[i] = (m[0][1] * x + m[1][1] * y) + (m[2][1] * z + m[3][1] * w);
+        out.z[i] = (m[0][2] * x + m[1][2] * y) + (m[2][2] * z + m[3][2] * w);
+    }
+}
+
+// Como Transform_Range_Scalar(), mas cada elemento "i" com a sua própria
+// matriz, matrices[i].
+void Transform_PerMatrix_Range_Scalar(const glm::mat4* matrices, float w, const TransformArrays& in,
+                                      const TransformArrays& out, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+        Transform_Range_Scalar(matrices[i], w, in, out, i, i + 1);
+    }
+}
+
+// Transforma os pontos [first, last) de "in" pela matriz "m" e divide x, y e
+// z do resultado por w, como PrintMatrixVectorProductDivW() (por exemplo,
+// para obter as coordenadas NDC de pontos com m = projection * view).
+void Transform_Project_Range_Scalar(const glm::mat4& m, const TransformArrays& in, const TransformArrays& out,
+                                   size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+        float x  = in.x[i];
+        float y  = in.y[i];
+        float z  = in.z[i];
+        float w  = (m[0][3] * x + m[1][3] * y) + (m[2][3] * z + m[3][3] * 1.0f);
+        out.x[i] = ((m[0][0] * x + m[1][0] * y) + (m[2][0] * z + m[3][0] * 1.0f)) / w;
+        out.y[i] = ((m[0][1] * x + m[1][1] * y) + (m[2][1] * z + m[3][1] * 1.0f)) / w;
+        out.z[i] = ((m[0][2] * x + m[1][2] * y) + (m[2][2] * z + m[3][2] * 1.0f)) / w;
+    }
+}
+
+// Versões SSE/AVX das funções acima. Os elementos que sobram no fim do
+// intervalo (menos de quatro ou oito) são transformados pelas versões
+// escalares.
+#if defined(MATRICES_AVX)
+// Coordenada "row" do produto das colunas "c" (com cada coeficiente copiado
+// para todas as posições) por oito elementos (x, y, z, w).
+__m256 Transform_Row_AVX(const __m256 c[4][4], int row, __m256 x, __m256 y, __m256 z, __m256 w) {
+    __m256 xy = _mm256_add_ps(_mm256_mul_ps(c[0][row], x), _mm256_mul_ps(c[1][row], y));
+    __m256 zw = _mm256_add_ps(_mm256_mul_ps(c[2][row], z), _mm256_mul_ps(c[3][row], w));
+    return _mm256_add_ps(xy, zw);
+}
+#endif
+
+#ifdef MATRICES_SSE
+// Coordenada "row" do produto das colunas "c" por quatro elementos.
+__m128 Transform_Row_SSE(const __m128 c[4][4], int row, __m128 x, __m128 y, __m128 z, __m128 w) {
+    __m128 xy = _mm_add_ps(_mm_mul_ps(c[0][row], x), _mm_mul_ps(c[1][row], y));
+    __m128 zw = _mm_add_ps(_mm_mul_ps(c[2][row], z), _mm_mul_ps(c[3][row], w));
+    return _mm_add_ps(xy, zw);
+}
+#endif
+
+void Transform_Range(const glm::mat4& m, float w, const TransformArrays& in, const TransformArrays& out,
+                     size_t first, size_t last) {
+    size_t i = first;
+#if defined(MATRICES_AVX)
+    __m256 c[4][4];
+    for (int j = 0; j < 4; ++j) {
+        for (int k = 0; k < 4; ++k) {
+            c[j][k] = _mm256_set1_ps(m[j][k]);
+        }
+    }
+    __m256 vw = _mm256_set1_ps(w);
+    for (; i + 8 <= last; i += 8) {
+        __m256 x = _mm256_loadu_ps(in.x + i);
+        __m256 y = _mm256_loadu_ps(in.y + i);
+        __m256 z = _mm256_loadu_ps(in.z + i);
+        _mm256_storeu_ps(out.x + i, Transform_Row_AVX(c, 0, x, y, z, vw));
+        _mm256_storeu_ps(out.y + i, Transform_Row_AVX(c, 1, x, y, z, vw));
+        _mm256_storeu_ps(out.z + i, Transform_Row_AVX(c, 2, x, y, z, vw));
+    }
+#elif defined(MATRICES_SSE)
+    __m128 c[4][4];
+    for (int j = 0; j < 4; ++j) {
+        for (int k = 0; k < 4; ++k) {
+            c[j][k] = _mm_set1_ps(m[j][k]);
+        }
+    }
+    __m128 vw = _mm_set1_ps(w);
+    for (; i + 4 <= last; i += 4) {
+        __m128 x = _mm_loadu_ps(in.x + i);
+        __m128 y = _mm_loadu_ps(in.y + i);
+        __m128 z = _mm_loadu_ps(in.z + i);
+        _mm_storeu_ps(out.x + i, Transform_Row_SSE(c, 0, x, y, z, vw));
+        _mm_storeu_ps(out.y + i, Transform_Row_SSE(c, 1, x, y, z, vw));
+        _mm_storeu_ps(out.z + i, Transform_Row_SSE(c, 2, x, y, z, vw));
+    }
+#endif
+    Transform_Range_Scalar(m, w, in, out, i, last);
+}
+
+void Transform_PerMatrix_Range(const glm::mat4* matrices, float w, const TransformArrays& in,
+                               const TransformArrays& out, size_t first, size_t last) {
+    size_t i = first;
+#ifdef MATRICES_SSE
+    // Quatro elementos por vez. A transposta das colunas j das quatro
+    // matrizes dá, em c[j][k], o coeficiente (k, j) de cada uma delas.
+    __m128 vw = _mm_set1_ps(w);
+    for (; i + 4 <= last; i += 4) {
+        __m128 c[4][4];
+        for (int j = 0; j < 4; ++j) {
+            c[j][0] = _mm_loadu_ps(&matrices[i + 0][j][0]);
+            c[j][1] = _mm_loadu_ps(&matrices[i + 1][j][0]);
+            c[j][2] = _mm_loadu_ps(&matrices[i + 2][j][0]);
+            c[j][3] = _mm_loadu_ps(&matrices[i + 3][j][0]);
+            _MM_TRANSPOSE4_PS(c[j][0], c[j][1], c[j][2], c[j][3]);
+        }
+        __m128 x = _mm_loadu_ps(in.x + i);
+        __m128 y = _mm_loadu_ps(in.y + i);
+        __m128 z = _mm_loadu_ps(in.z + i);
+        _mm_storeu_ps(out.x + i, Transform_Row_SSE(c, 0, x, y, z, vw));
+        _mm_storeu_ps(out.y + i, Transform_Row_SSE(c, 1, x, y, z, vw));
+        _mm_storeu_ps(out.z + i, Transform_Row_SSE(c, 2, x, y, z, vw));
+    }
+#endif
+    Transform_PerMatrix_Range_Scalar(matrices, w, in, out, i, last);
+}
+
+void Transform_Project_Range(const glm::mat4& m, const TransformArrays& in, const TransformArrays& out, size_t first,
+                             size_t last) {
+    size_t i = first;
+#if defined(MATRICES_AVX)
+    __m256 c[4][4];
+    for (int j = 0; j < 4; ++j) {
+        for (int k = 0; k < 4; ++k) {
+            c[j][k] = _mm256_set1_ps(m[j][k]);
+        }
+    }
+    __m256 one = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= last; i += 8) {
+        __m256 x = _mm256_loadu_ps(in.x + i);
+        __m256 y = _mm256_loadu_ps(in.y + i);
+        __m256 z = _mm256_loadu_ps(in.z + i);
+        __m256 w = Transform_Row_AVX(c, 3, x, y, z, one);
+        _mm256_storeu_ps(out.x + i, _mm256_div_ps(Transform_Row_AVX(c, 0, x, y, z, one), w));
+        _mm256_storeu_ps(out.y + i, _mm256_div_ps(Transform_Row_AVX(c, 1, x, y, z, one), w));
+        _mm256_storeu_ps(out.z + i, _mm256_div_ps(Transform_Row_AVX(c, 2, x, y, z, one), w));
+    }
+#elif defined(MATRICES_SSE)
+    __m128 c[4][4];
+    for (int j = 0; j < 4; ++j) {
+        for (int k = 0; k < 4; ++k) {
+            c[j][k] = _mm_set1_ps(m[j][k]);
+        }
+    }
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= last; i += 4) {
+        __m128 x = _mm_loadu_ps(in.x + i);
+        __m128 y = _mm_loadu_ps(in.y + i);
+        __m128 z = _mm_loadu_ps(in.z + i);
+        __m128 w = Transform_Row_SSE(c, 3, x, y, z, one);
+        _mm_storeu_ps(out.x + i, _mm_div_ps(Transform_Row_SSE(c, 0, x, y, z, one), w));
+        _mm_storeu_ps(out.y + i, _mm_div_ps(Transform_Row_SSE(c, 1, x, y, z, one), w));
+        _mm_storeu_ps(out.z + i, _mm_div_ps(Transform_Row_SSE(c, 2, x, y, z, one), w));
+    }
+#endif
+    Transform_Project_Range_Scalar(m, in, out, i, last);
+}
+
+// Executa range(first, last) sobre [0, count), em paralelo se "count" for
+// grande o suficiente.
+template <typename Function>
+void Transform_Parallel(size_t count, Function range) {
+    if (count < TRANSFORM_PARALLEL_THRESHOLD) {
+        range(0, count);
+    } else {
+        ParallelForRange(count, TRANSFORM_TASK_SIZE, range);
+    }
+}
+
+// Transforma "count" pontos (w = 1) de "in" pela matriz "m", guardando o
+// resultado em "out".
+void Transform_Points(const glm::mat4& m, const TransformArrays& in, const TransformArrays& out, size_t count) {
+    Transform_Parallel(count, [&](size_t first, size_t last) { Transform_Range(m, 1.0f, in, out, first, last); });
+}
+
+// Transforma "count" vetores (w = 0) de "in" pela matriz "m", guardando o
+// resultado em "out". A translação da matriz não afeta vetores.
+void Transform_Vectors(const glm::mat4& m, const TransformArrays& in, const TransformArrays& out, size_t count) {
+    Transform_Parallel(count, [&](size_t first, size_t last) { Transform_Range(m, 0.0f, in, out, first, last); });
+}
+
+// Transforma cada ponto "i" de "in" pela sua matriz, matrices[i].
+void Transform_Points_PerMatrix(const glm::mat4* matrices, const TransformArrays& in, const TransformArrays& out,
+                                size_t count) {
+    Transform_Parallel(count, [&](size_t first, size_t last) {
+        Transform_PerMatrix_Range(matrices, 1.0f, in, out, first, last);
+    });
+}
+
+// Transforma "count" pontos de "in" pela matriz "m", com divisão por w.
+void Transform_Points_Project(const glm::mat4& m, const TransformArrays& in, const TransformArrays& out,
+                              size_t count) {
+    Transform_Parallel(count, [&](size_t first, size_t last) { Transform_Project_Range(m, in, out, first, last); });
+}
+
+#endif  // _TRANSFORM_H
+// vim: set spell spelllang=pt_br :
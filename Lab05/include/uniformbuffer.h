@@ -0,0 +1,194 @@
+#ifndef _UNIFORMBUFFER_H
+#define _UNIFORMBUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "glad/glad.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "matrices.h"
+
+// Uniform Buffer Objects (UBOs): em vez de enviar cada variável "uniform"
+// com uma chamada glUniform*(), as variáveis são agrupadas em blocos
+// ("uniform blocks") cujo conteúdo fica em um buffer na GPU. Os shaders
+// declaram dois blocos, com layout std140 (veja "shader_vertex.glsl"):
+//
+//   FrameUniforms:  variáveis que mudam uma vez por quadro (câmera, luz,
+//                   tempo), enviadas uma única vez por quadro;
+//   ObjectUniforms: variáveis de cada objeto desenhado. Os blocos de todos os
+//                   objetos do quadro são copiados de uma só vez para um
+//                   "ring buffer" (veja UniformRing), e cada desenho somente
+//                   aponta o bloco para o seu trecho do buffer com
+//                   glBindBufferRange().
+//
+// As structs abaixo reproduzem o layout std140 dos blocos: cada vec4 e cada
+// coluna de mat4 ou mat3x4 ocupa 16 bytes, e o tamanho do bloco é
+// arredondado para um múltiplo de 16 bytes.
+
+// Pontos de ligação ("binding points") dos blocos. Veja LoadGpuProgram() em
+// "main.cpp".
+#define UNIFORM_BINDING_FRAME  0
+#define UNIFORM_BINDING_OBJECT 1
+
+// Número de quadros cujos blocos de objetos ficam no ring buffer ao mesmo
+// tempo: enquanto a GPU desenha os quadros anteriores, a CPU escreve o
+// próximo em outra parte do buffer.
+#define UNIFORMRING_FRAMES 3
+
+// Bloco "FrameUniforms" dos shaders.
+struct FrameUniforms {
+    glm::mat4 view;             // Matriz "view"
+    glm::mat4 projection;       // Matriz "projection"
+    glm::vec4 camera_position;  // Posição da câmera em coordenadas globais (W = 1)
+    glm::vec4 light_direction;  // Sentido da fonte de luz em relação aos pontos da cena (W = 0)
+    float     time;             // Tempo, em segundos, desde o início do programa
+    float     padding[3];
+};
+
+// Bloco "ObjectUniforms" dos shaders.
+struct ObjectUniforms {
+    AffineMatrix model;            // Matriz de modelagem, uma mat3x4 ("model_matrix" nos shaders)
+    glm::vec4    bbox_min;         // Axis-Aligned Bounding Box do objeto
+    glm::vec4    bbox_max;
+    glm::vec4    position_offset;  // Reconstrução das posições dos vértices (veja
+    glm::vec4    position_scale;   // GetPositionDequantization() em "mesh.h")
+    int32_t      object_id;        // Material do objeto ("material" nos shaders)
+    int32_t      padding[3];
+};
+
+static_assert(sizeof(FrameUniforms) == 176, "FrameUniforms não segue o layout std140");
+static_assert(sizeof(ObjectUniforms) == 128, "ObjectUniforms não segue o layout std140");
+
+// Cria o buffer do bloco FrameUniforms.
+GLuint FrameUniforms_Init() {
+    GLuint buffer_id;
+    glGenBuffers(1, &buffer_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_id);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return buffer_id;
+}
+
+// Envia as variáveis do quadro atual e liga o buffer ao bloco FrameUniforms
+// de todos os programas.
+void FrameUniforms_Upload(GLuint buffer_id, const FrameUniforms& frame) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_id);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING_FRAME, buffer_id);
+}
+
+// "Ring buffer" com os blocos ObjectUniforms dos objetos de cada quadro. O
+// buffer é dividido em UNIFORMRING_FRAMES partes, e cada quadro usa a parte
+// seguinte à do quadro anterior. Um "fence" (glFenceSync()) marca o fim dos
+// desenhos de cada parte; antes de reescrever uma parte, a CPU espera
+// somente o seu fence, que normalmente já foi sinalizado, em vez de o driver
+// sincronizar o buffer inteiro.
+struct UniformRing {
+    GLuint buffer_id;
+    size_t block_stride;                // sizeof(ObjectUniforms), arredondado para o alinhamento exigido
+    size_t frame_capacity;              // Número de blocos em cada parte do buffer
+    int    frame;                       // Parte do buffer usada pelo quadro atual
+    GLsync fences[UNIFORMRING_FRAMES];  // Fim dos desenhos de cada parte (nullptr se não há)
+    size_t num_waits;                   // Quantas vezes a CPU precisou esperar a GPU
+};
+
+void UniformRing_Init(UniformRing* ring) {
+    // glBindBufferRange() exige que o início de cada bloco seja múltiplo de
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT (tipicamente 256 bytes).
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    size_t align = static_cast<size_t>(std::max(alignment, 1));
+
+    glGenBuffers(1, &ring->buffer_id);
+    ring->block_stride   = (sizeof(ObjectUniforms) + align - 1) / align * align;
+    ring->frame_capacity = 0;
+    ring->frame          = 0;
+    ring->num_waits      = 0;
+    for (GLsync& fence : ring->fences) {
+        fence = nullptr;
+    }
+}
+
+// Inicia um novo quadro, passando para a próxima parte do buffer.
+void UniformRing_Begin(UniformRing* ring) { ring->frame = (ring->frame + 1) % UNIFORMRING_FRAMES; }
+
+// Copia os "count" blocos do quadro atual, gravados junto com o quadro (veja
+// "renderthread.h"), para a sua parte do buffer. Caso eles não caibam, o
+// buffer é realocado com o dobro do tamanho; o conteúdo antigo é descartado,
+// pois os quadros anteriores continuam usando a memória antiga até a GPU
+// terminar de desenhá-los ("orphaning").
+void UniformRing_Upload(UniformRing* ring, const ObjectUniforms* blocks, size_t count) {
+    glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer_id);
+
+    if (count > ring->frame_capacity) {
+        ring->frame_capacity = std::max(count, 2 * ring->frame_capacity);
+        glBufferData(GL_UNIFORM_BUFFER,
+                     static_cast<GLsizeiptr>(UNIFORMRING_FRAMES * ring->frame_capacity * ring->block_stride), nullptr,
+                     GL_STREAM_DRAW);
+        for (GLsync& fence : ring->fences) {
+            if (fence != nullptr) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+    }
+
+    // Esperamos a GPU terminar o último quadro que usou esta parte do buffer.
+    GLsync& fence = ring->fences[ring->frame];
+    if (fence != nullptr) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            ring->num_waits += 1;
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (count > 0) {
+        // Como já sabemos que a GPU não está lendo esta parte do buffer,
+        // pedimos para o driver não fazer nenhuma sincronização
+        // (GL_MAP_UNSYNCHRONIZED_BIT).
+        GLintptr   offset = static_cast<GLintptr>(ring->frame * ring->frame_capacity * ring->block_stride);
+        GLsizeiptr size   = static_cast<GLsizeiptr>(count * ring->block_stride);
+        auto*      data   = static_cast<unsigned char*>(glMapBufferRange(
+                GL_UNIFORM_BUFFER, offset, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+        if (data != nullptr) {
+            for (size_t i = 0; i < count; ++i) {
+                memcpy(data + i * ring->block_stride, &blocks[i], sizeof(ObjectUniforms));
+            }
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        } else {
+            fprintf(stderr, "ERROR: Cannot map the uniform ring buffer.\n");
+        }
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Aponta o bloco ObjectUniforms de todos os programas para o bloco "block"
+// do quadro atual (a sua posição entre os blocos enviados por
+// UniformRing_Upload()).
+void UniformRing_Bind(const UniformRing& ring, size_t block) {
+    size_t offset = (ring.frame * ring.frame_capacity + block) * ring.block_stride;
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING_OBJECT, ring.buffer_id, static_cast<GLintptr>(offset),
+                      sizeof(ObjectUniforms));
+}
+
+// Marca o fim dos desenhos do quadro atual. Deve ser chamada depois do
+// último desenho que usa os blocos do quadro.
+void UniformRing_End(UniformRing* ring) {
+    ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+#endif  // _UNIFORMBUFFER_H
+// vim: set spell spelllang=pt_br :
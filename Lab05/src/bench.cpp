@@ -0,0 +1,1133 @@
+//     Universidade Federal do Rio Grande do Sul
+//             Instituto de Informática
+//       Departamento de Informática Aplicada
+//
+//    INF01047 Fundamentos de Computação Gráfica
+//               Prof. Eduardo Gastal
+//
+//                   LABORATÓRIO 5
+//
+
+// Testes de desempenho do laboratório, em um executável separado
+// ("Lab05_bench"), para que o programa principal seja somente o renderizador.
+// Nenhum dos testes abre uma janela. Uso:
+//
+//   ./Lab05_bench [--threads N] --bench-<teste> [argumento]
+//
+// Os testes usam as mesmas funções e variáveis globais do programa principal
+// (ex.: a leitura de ".obj" e a preparação dos quadros), então este arquivo
+// inclui "main.cpp" inteiro, sem a sua função main() (veja LAB05_BENCHMARKS).
+
+#include <chrono>
+#include <functional>
+#include <random>
+
+#define LAB05_BENCHMARKS
+#include "main.cpp"
+
+// Mede a fração de triângulos descartados pelos grupos de cada objeto de uma
+// malha, com a câmera orbitando ao redor do objeto (como em main()) em
+// várias distâncias e alturas, e o tempo gasto por Meshlet_Cull().
+// Executado com o argumento "--bench-clusters [arquivo.obj]".
+int Meshlet_Benchmark(const MeshView& mesh) {
+    typedef std::chrono::steady_clock clock;
+
+    const float distances[] = {0.75f, 1.5f, 3.0f};  // Em diagonais da AABB do objeto
+    const float phis[]      = {-0.6f, 0.0f, 0.6f};
+    const int   num_thetas  = 72;
+
+    std::vector<GLsizei>     counts;
+    std::vector<const void*> offsets;
+
+    for (size_t o = 0; o < mesh.num_objects; ++o) {
+        const MeshObject& object = mesh.objects[o];
+        if (object.num_clusters == 0) {
+            continue;
+        }
+
+        const MeshCluster* clusters = mesh.clusters + object.first_cluster;
+        glm::vec3          center   = 0.5f * (object.bbox_min + object.bbox_max);
+        float              diagonal = glm::length(object.bbox_max - object.bbox_min);
+
+        printf("Objeto '%s': %d triângulos em %d clusters.\n", object.name.c_str(),
+               static_cast<int>(object.num_indices / 3), static_cast<int>(object.num_clusters));
+
+        for (float distance : distances) {
+            MeshletCullStats stats      = {0, 0, 0, 0, 0};
+            size_t           num_ranges = 0;
+            double           seconds    = 0.0;
+            int              num_views  = 0;
+
+            for (float phi : phis) {
+                for (int i = 0; i < num_thetas; ++i) {
+                    float     theta = 2.0f * 3.14159265f * i / num_thetas;
+                    float     r     = distance * diagonal;
+                    glm::vec4 c     = glm::vec4(center.x + r * std::cos(phi) * std::sin(theta),
+                                                center.y + r * std::sin(phi),
+                                                center.z + r * std::cos(phi) * std::cos(theta), 1.0f);
+                    glm::vec4 l     = glm::vec4(center, 1.0f);
+
+                    glm::mat4 view = Matrix_Camera_View(c, l - c, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+                    glm::mat4 projection =
+                            Matrix_Perspective(3.14159265f / 3.0f, 4.0f / 3.0f, -0.01f * diagonal, -10.0f * diagonal);
+
+                    clock::time_point start = clock::now();
+                    num_ranges += Meshlet_Cull(clusters, object.num_clusters, view, projection, &counts, &offsets,
+                                               &stats);
+                    seconds += std::chrono::duration<double>(clock::now() - start).count();
+                    num_views += 1;
+                }
+            }
+
+            printf("  distância %.2fx: %5.1f%% dos triângulos descartados (%.1f%% dos clusters pelo frustum, "
+                   "%.1f%% pelo cone), %.1f intervalos, %.1f us por quadro\n",
+                   distance, 100.0 * stats.num_culled_triangles / stats.num_triangles,
+                   100.0 * stats.num_frustum_culled / stats.num_clusters,
+                   100.0 * stats.num_backface_culled / stats.num_clusters,
+                   static_cast<double>(num_ranges) / num_views, 1e6 * seconds / num_views);
+        }
+    }
+
+    return 0;
+}
+
+// Carrega um ".obj" (sem enviá-lo para a GPU) e mede o descarte dos grupos de
+// triângulos dos seus objetos. Veja Meshlet_Benchmark().
+int BenchmarkMeshClusters(const char* filename) {
+    LoadedMesh loaded;
+    LoadObjModel(filename, &loaded);
+    return Meshlet_Benchmark(loaded.View());
+}
+
+// Mede o custo, por objeto desenhado, de encontrar os dados de cada objeto
+// de uma cena com "num_objects" objetos, em ordem aleatória: pelo nome, em
+// um std::map (como era feito antes, com quatro buscas por objeto, e com uma
+// busca), e pelo handle, em um SlotMap (veja "slotmap.h"). Cada acesso lê os
+// campos usados por DrawVirtualObject().
+int BenchmarkSceneRegistry(size_t num_objects) {
+    typedef std::chrono::steady_clock clock;
+
+    std::map<std::string, SceneObject> by_name;
+    SlotMap<SceneObject>               by_handle;
+    SlotMap_Reserve(&by_handle, num_objects);
+
+    std::vector<std::string>   names(num_objects);
+    std::vector<SlotMapHandle> handles(num_objects);
+    for (size_t i = 0; i < num_objects; ++i) {
+        char name[32];
+        snprintf(name, 32, "the_object_%d", static_cast<int>(i));
+
+        SceneObject object;
+        object.name           = name;
+        object.first_index    = 3 * i;
+        object.num_indices    = 3;
+        object.rendering_mode = GL_TRIANGLES;
+        object.base_vertex    = 0;
+        object.bbox_min       = glm::vec3(-1.0f);
+        object.bbox_max       = glm::vec3(1.0f);
+        MeshLod lod0          = {object.first_index, object.num_indices, 0.0f};
+        object.lods.push_back(lod0);
+
+        names[i]          = name;
+        handles[i]        = SlotMap_Insert(&by_handle, object);
+        by_name[names[i]] = object;
+    }
+
+    // Ordem em que os objetos são "desenhados" em cada quadro.
+    std::vector<size_t> order(num_objects);
+    for (size_t i = 0; i < num_objects; ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+
+    const int   num_frames = std::max(1, static_cast<int>(2000000 / std::max<size_t>(num_objects, 1)));
+    const char* labels[3]  = {"std::map, operator[] x4", "std::map, find()       ", "SlotMap, handle        "};
+
+    printf("Acesso a %d objetos da cena em ordem aleatória (%d quadros):\n", static_cast<int>(num_objects),
+           num_frames);
+
+    for (int method = 0; method < 3; ++method) {
+        double            checksum = 0.0;
+        clock::time_point start    = clock::now();
+
+        for (int frame = 0; frame < num_frames; ++frame) {
+            for (size_t i : order) {
+                const char* name = names[i].c_str();
+
+                if (method == 0) {
+                    // Como no código original: cada acesso constrói uma
+                    // std::string temporária e percorre a árvore.
+                    checksum += by_name[name].bbox_min.x + by_name[name].bbox_max.x;
+                    checksum += by_name[name].num_indices + by_name[name].first_index;
+                } else if (method == 1) {
+                    auto it = by_name.find(name);
+                    if (it != by_name.end()) {
+                        checksum += it->second.bbox_min.x + it->second.bbox_max.x;
+                        checksum += it->second.num_indices + it->second.first_index;
+                    }
+                } else {
+                    const SceneObject* object = SlotMap_Get(&by_handle, handles[i]);
+                    if (object != nullptr) {
+                        checksum += object->bbox_min.x + object->bbox_max.x;
+                        checksum += object->num_indices + object->first_index;
+                    }
+                }
+            }
+        }
+
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        printf("  %s: %8.1f ns por objeto (checksum %.0f)\n", labels[method],
+               1e9 * seconds / (static_cast<double>(num_frames) * num_objects), checksum);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Mede o tempo de preparação de um quadro do modo multidão com "num_objects"
+// objetos (SubmitCrowd(), SubmitVisibleObjects() e RenderQueue_Sort()), sem
+// janela e sem GPU, com 1, 2, 4, ... até ParallelThreadCount() threads no
+// sistema de tarefas (veja "parallel.h"), e verifica que todas as execuções
+// produzem as mesmas instâncias e a mesma ordem de desenho.
+int BenchmarkFramePreparation(size_t num_objects) {
+    typedef std::chrono::steady_clock clock;
+
+    // Um coelho e uma esfera sem geometria, somente com a AABB e os níveis
+    // de detalhe usados pela preparação do quadro.
+    SlotMapHandle handles[2];
+    for (int k = 0; k < 2; ++k) {
+        SceneObject object;
+        object.name            = k == 0 ? "the_bunny" : "the_sphere";
+        object.first_index     = 0;
+        object.num_indices     = 3 * 10000;
+        object.rendering_mode  = GL_TRIANGLES;
+        object.base_vertex     = 0;
+        object.bbox_min        = glm::vec3(-1.0f);
+        object.bbox_max        = glm::vec3(1.0f);
+        object.position_offset = glm::vec3(0.0f);
+        object.position_scale  = glm::vec3(1.0f);
+        for (size_t level = 0; level < MESHLOD_MAX_LEVELS; ++level) {
+            MeshLod lod = {0, object.num_indices >> level, level == 0 ? 0.0f : 0.002f * static_cast<float>(1 << level)};
+            object.lods.push_back(lod);
+        }
+        handles[k] = SlotMap_Insert(&g_VirtualScene, object);
+    }
+
+    // A câmera da posição inicial do programa, olhando para o centro da
+    // multidão.
+    glm::vec4 camera_position = glm::vec4(0.0f, 1.0f, 3.0f, 1.0f);
+    g_CameraView       = Matrix_Camera_View(camera_position, -camera_position + glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                                            glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    g_CameraProjection = Matrix_Perspective(3.141592f / 3.0f, 4.0f / 3.0f, -0.1f, -10.0f);
+    g_CameraPosition   = camera_position;
+    g_CrowdSize        = static_cast<int>(num_objects);
+    g_CrowdInstancing  = true;
+
+    const int    num_frames  = 20;
+    unsigned int max_threads = ParallelThreadCount();
+
+    // O quadro é gravado como no laço de renderização, mas nunca executado.
+    RenderFrame frame;
+    g_RecordFrame = &frame;
+
+    std::vector<InstanceData>    reference_instances;
+    std::vector<RenderSortEntry> reference_order;
+    double                       single_thread = 0.0;
+
+    printf("Preparação de um quadro com %d objetos, melhor de %d quadros:\n", static_cast<int>(num_objects),
+           num_frames);
+
+    for (unsigned int threads = 1;; threads = std::min(2 * threads, max_threads)) {
+        JobSystem_SetThreadCount(threads);
+
+        double best = 1e30;
+        for (int f = 0; f < num_frames; ++f) {
+            clock::time_point start = clock::now();
+
+            g_FrameObjects.clear();
+            FrustumCull_Clear(&g_FrustumCullBatch);
+            RenderQueue_Begin(&g_RenderQueue, 10.0f);
+            RenderFrame_Clear(&frame);
+
+            SubmitCrowd(handles[0], handles[1]);
+            SubmitVisibleObjects();
+            RenderQueue_Sort(&g_RenderQueue);
+
+            best = std::min(best, std::chrono::duration<double>(clock::now() - start).count());
+        }
+
+        const std::vector<InstanceData>& instances = frame.instances;
+        if (threads == 1) {
+            single_thread       = best;
+            reference_instances = instances;
+            reference_order     = g_RenderQueue.sorted;
+        }
+
+        bool same_order = reference_order.size() == g_RenderQueue.sorted.size();
+        for (size_t i = 0; same_order && i < reference_order.size(); ++i) {
+            same_order = reference_order[i].key == g_RenderQueue.sorted[i].key &&
+                         reference_order[i].item == g_RenderQueue.sorted[i].item;
+        }
+        if (!same_order || instances.size() != reference_instances.size() ||
+            memcmp(instances.data(), reference_instances.data(), instances.size() * sizeof(InstanceData)) != 0) {
+            fprintf(stderr, "ERROR: Frame prepared with %u threads differs from the single-threaded frame.\n",
+                    threads);
+            return EXIT_FAILURE;
+        }
+
+        printf("  %2u threads: %8.3f ms por quadro (%.2fx), %d objetos visíveis, %d itens\n", threads, 1e3 * best,
+               single_thread / best, static_cast<int>(instances.size()),
+               static_cast<int>(g_RenderQueue.sorted.size()));
+
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Compara duas matrizes, ou dois vetores, bit a bit.
+template <typename T>
+bool Matrix_Identical(const T& a, const T& b) {
+    return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+// Tempo médio, em nanossegundos, de function(i) para i = 0, ..., count-1.
+template <typename Function>
+double Matrix_Benchmark_Time(int count, int repetitions, Function function) {
+    typedef std::chrono::steady_clock clock;
+
+    clock::time_point start = clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        for (int i = 0; i < count; ++i) {
+            function(i);
+        }
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return 1e9 * seconds / (static_cast<double>(count) * repetitions);
+}
+
+// Maior diferença relativa entre os coeficientes de "m" e de "expected".
+float Matrix_Max_Error(const glm::mat4& m, const glm::mat4& expected) {
+    float error = 0.0f;
+    for (int j = 0; j < 4; ++j) {
+        for (int k = 0; k < 4; ++k) {
+            error = std::max(error, std::fabs(m[j][k] - expected[j][k]) / (1.0f + std::fabs(expected[j][k])));
+        }
+    }
+    return error;
+}
+
+// Mede o tempo médio, em nanossegundos, de cada operação de Matrix_Multiply()
+// e seguintes de "matrices.h", comparado com os operadores da GLM e com as
+// versões escalares, e verifica que os resultados são idênticos bit a bit
+// aos da GLM.
+int Matrix_Benchmark() {
+#if defined(MATRICES_AVX)
+    const char* backend = "AVX";
+#elif defined(MATRICES_SSE)
+    const char* backend = "SSE";
+#else
+    const char* backend = "escalar";
+#endif
+
+    const int   count       = 1024;
+    const int   repetitions = 2000;
+    const float pi          = 3.14159265f;
+
+    // Matrizes quaisquer, matrizes afins (produtos de escala, rotação e
+    // translação) e vetores aleatórios.
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> coefficient(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.1f, 4.0f);
+
+    std::vector<glm::mat4>    a(count), b(count), affine(count), r(count);
+    std::vector<glm::vec4>    v(count), rv(count);
+    std::vector<AffineMatrix> affine3x4(count), ra(count);
+    for (int i = 0; i < count; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            for (int k = 0; k < 4; ++k) {
+                a[i][j][k] = coefficient(random);
+                b[i][j][k] = coefficient(random);
+            }
+        }
+        v[i] = glm::vec4(coefficient(random), coefficient(random), coefficient(random), coefficient(random));
+
+        glm::vec4 axis = glm::vec4(coefficient(random), coefficient(random), coefficient(random), 0.0f);
+        affine[i] = Matrix_Translate(10.0f * coefficient(random), 10.0f * coefficient(random),
+                                     10.0f * coefficient(random)) *
+                    Matrix_Rotate(pi * coefficient(random), axis) *
+                    Matrix_Scale(scale(random), scale(random), scale(random));
+        affine3x4[i] = Affine_FromMatrix(affine[i]);
+    }
+
+    // Verificação: os resultados devem ser idênticos, bit a bit, aos da GLM
+    // (a inversa afim, aos da versão escalar).
+    float max_affine_error = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        glm::mat4 product        = a[i] * b[i];
+        glm::vec4 product_v      = a[i] * v[i];
+        glm::mat4 transpose      = glm::transpose(a[i]);
+        glm::mat4 inverse        = glm::inverse(a[i]);
+        glm::mat4 affine_inverse = Matrix_Inverse_Affine_Scalar(affine[i]);
+
+        bool same = true;
+        same      = same && Matrix_Identical(product, Matrix_Multiply(a[i], b[i]));
+        same      = same && Matrix_Identical(product, Matrix_Multiply_Scalar(a[i], b[i]));
+        same      = same && Matrix_Identical(product_v, Matrix_Multiply_Vector(a[i], v[i]));
+        same      = same && Matrix_Identical(product_v, Matrix_Multiply_Vector_Scalar(a[i], v[i]));
+        same      = same && Matrix_Identical(transpose, Matrix_Transpose(a[i]));
+        same      = same && Matrix_Identical(transpose, Matrix_Transpose_Scalar(a[i]));
+        same      = same && Matrix_Identical(inverse, Matrix_Inverse(a[i]));
+        same      = same && Matrix_Identical(inverse, Matrix_Inverse_Scalar(a[i]));
+        same      = same && Matrix_Identical(affine_inverse, Matrix_Inverse_Affine(affine[i]));
+
+        // As matrizes 3x4 fazem as mesmas contas, sem a última linha.
+        int          k          = (i + 1) % count;
+        AffineMatrix product3x4 = Affine_FromMatrix(affine[i] * affine[k]);
+        AffineMatrix inverse3x4 = Affine_FromMatrix(affine_inverse);
+        same = same && Matrix_Identical(product3x4, Affine_Multiply(affine3x4[i], affine3x4[k]));
+        same = same && Matrix_Identical(product3x4, Affine_Multiply_Scalar(affine3x4[i], affine3x4[k]));
+        same = same && Matrix_Identical(inverse3x4, Affine_Inverse(affine3x4[i]));
+        same = same && Matrix_Identical(inverse3x4, Affine_Inverse_Scalar(affine3x4[i]));
+        if (!same) {
+            fprintf(stderr, "ERROR: Resultado diferente do da GLM para a matriz %d.\n", i);
+            return 1;
+        }
+
+        // A inversa afim deve ser muito próxima da inversa geral.
+        max_affine_error = std::max(max_affine_error, Matrix_Max_Error(affine_inverse, glm::inverse(affine[i])));
+    }
+    if (max_affine_error > 1e-4f) {
+        fprintf(stderr, "ERROR: Inversa afim diferente da inversa geral (erro relativo %g).\n", max_affine_error);
+        return 1;
+    }
+
+    // As matrizes construídas diretamente (TRS, Euler e quatérnios) devem ser
+    // muito próximas dos produtos das matrizes separadas, e Quat_Slerp() deve
+    // interpolar o ângulo de rotação linearmente.
+    float max_fused_error = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        float     rx   = pi * coefficient(random);
+        float     ry   = pi * coefficient(random);
+        float     rz   = pi * coefficient(random);
+        glm::vec3 t    = glm::vec3(10.0f * coefficient(random), 10.0f * coefficient(random),
+                                   10.0f * coefficient(random));
+        glm::vec3 s    = glm::vec3(scale(random), scale(random), scale(random));
+        glm::vec4 axis = glm::vec4(coefficient(random), coefficient(random), coefficient(random), 0.0f);
+
+        glm::mat4 trs = Matrix_Translate(t.x, t.y, t.z) * Matrix_Rotate_Z(rz) * Matrix_Rotate_Y(ry) *
+                        Matrix_Rotate_X(rx) * Matrix_Scale(s.x, s.y, s.z);
+        glm::mat4 zyx = Matrix_Rotate_X(rx) * Matrix_Rotate_Y(ry) * Matrix_Rotate_Z(rz);
+        glm::vec4 q0  = Quat_FromAxisAngle(rx, axis);
+        glm::vec4 q1  = Quat_FromAxisAngle(rx + 0.5f * ry, axis);
+
+        float errors[4] = {
+            Matrix_Max_Error(Matrix_TRS(t, glm::vec3(rx, ry, rz), s), trs),
+            Matrix_Max_Error(Affine_ToMatrix(Affine_Rotate_ZYX(rx, ry, rz)), zyx),
+            Matrix_Max_Error(Matrix_FromQuat(q0), Matrix_Rotate(rx, axis)),
+            Matrix_Max_Error(Matrix_FromQuat(Quat_Slerp(q0, q1, 0.25f)), Matrix_Rotate(rx + 0.125f * ry, axis)),
+        };
+        for (float error : errors) {
+            max_fused_error = std::max(max_fused_error, error);
+        }
+    }
+    if (max_fused_error > 1e-4f) {
+        fprintf(stderr, "ERROR: Construção direta diferente dos produtos de matrizes (erro relativo %g).\n",
+                max_fused_error);
+        return 1;
+    }
+
+    // Tempo de cada operação. Os resultados são guardados em r, rv e ra para
+    // que o compilador não elimine as contas.
+    printf("Resultados idênticos bit a bit aos da GLM (inversa afim: erro relativo máximo de %.1e;\n"
+           "construção direta de TRS, Euler e quatérnios: %.1e).\n",
+           max_affine_error, max_fused_error);
+    printf("%-22s %10s %10s %10s\n", "ns por operacao", "GLM", "escalar", backend);
+
+    double glm_ns    = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = a[i] * b[i]; });
+    double scalar_ns = Matrix_Benchmark_Time(count, repetitions,
+                                             [&](int i) { r[i] = Matrix_Multiply_Scalar(a[i], b[i]); });
+    double simd_ns   = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = Matrix_Multiply(a[i], b[i]); });
+    printf("%-22s %10.2f %10.2f %10.2f\n", "Matriz * matriz", glm_ns, scalar_ns, simd_ns);
+
+    glm_ns    = Matrix_Benchmark_Time(count, repetitions, [&](int i) { rv[i] = a[i] * v[i]; });
+    scalar_ns = Matrix_Benchmark_Time(count, repetitions,
+                                      [&](int i) { rv[i] = Matrix_Multiply_Vector_Scalar(a[i], v[i]); });
+    simd_ns   = Matrix_Benchmark_Time(count, repetitions, [&](int i) { rv[i] = Matrix_Multiply_Vector(a[i], v[i]); });
+    printf("%-22s %10.2f %10.2f %10.2f\n", "Matriz * vetor", glm_ns, scalar_ns, simd_ns);
+
+    glm_ns    = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = glm::transpose(a[i]); });
+    scalar_ns = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = Matrix_Transpose_Scalar(a[i]); });
+    simd_ns   = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = Matrix_Transpose(a[i]); });
+    printf("%-22s %10.2f %10.2f %10.2f\n", "Transposta", glm_ns, scalar_ns, simd_ns);
+
+    glm_ns    = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = glm::inverse(a[i]); });
+    scalar_ns = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = Matrix_Inverse_Scalar(a[i]); });
+    simd_ns   = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = Matrix_Inverse(a[i]); });
+    printf("%-22s %10.2f %10.2f %10.2f\n", "Inversa", glm_ns, scalar_ns, simd_ns);
+
+    glm_ns    = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = glm::inverse(affine[i]); });
+    scalar_ns = Matrix_Benchmark_Time(count, repetitions,
+                                      [&](int i) { r[i] = Matrix_Inverse_Affine_Scalar(affine[i]); });
+    simd_ns   = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = Matrix_Inverse_Affine(affine[i]); });
+    printf("%-22s %10.2f %10.2f %10.2f\n", "Inversa afim", glm_ns, scalar_ns, simd_ns);
+
+    // Matrizes 3x4: a coluna "GLM" mostra as mesmas operações com mat4.
+    glm_ns    = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = affine[i] * affine[(i + 1) % count]; });
+    scalar_ns = Matrix_Benchmark_Time(count, repetitions, [&](int i) {
+        ra[i] = Affine_Multiply_Scalar(affine3x4[i], affine3x4[(i + 1) % count]);
+    });
+    simd_ns   = Matrix_Benchmark_Time(count, repetitions, [&](int i) {
+        ra[i] = Affine_Multiply(affine3x4[i], affine3x4[(i + 1) % count]);
+    });
+    printf("%-22s %10.2f %10.2f %10.2f\n", "3x4 * 3x4", glm_ns, scalar_ns, simd_ns);
+
+    glm_ns    = Matrix_Benchmark_Time(count, repetitions, [&](int i) { r[i] = glm::inverse(affine[i]); });
+    scalar_ns = Matrix_Benchmark_Time(count, repetitions, [&](int i) { ra[i] = Affine_Inverse_Scalar(affine3x4[i]); });
+    simd_ns   = Matrix_Benchmark_Time(count, repetitions, [&](int i) { ra[i] = Affine_Inverse(affine3x4[i]); });
+    printf("%-22s %10.2f %10.2f %10.2f\n", "Inversa 3x4", glm_ns, scalar_ns, simd_ns);
+
+    // Impede que as contas acima sejam descartadas.
+    volatile float sink = r[count - 1][0][0] + rv[count - 1][0] + ra[count - 1].rows[0][0];
+    (void)sink;
+    return 0;
+}
+
+// Compara a vazão (MB/s) de tinyobj::LoadObj() com a de ObjParser_Load() e
+// ObjParser_LoadMesh() para o arquivo "filename", e verifica se
+// ObjParser_Load() produz os mesmos dados que a tinyobjloader. Executado com
+// o argumento "--bench-obj [arquivo.obj]".
+int ObjParser_Benchmark(const char* filename) {
+    typedef std::chrono::steady_clock clock;
+
+    MappedFile mapped;
+    if (!MapFile(filename, &mapped)) {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+        return EXIT_FAILURE;
+    }
+    double megabytes = static_cast<double>(mapped.size) / (1024.0 * 1024.0);
+    UnmapFile(&mapped);
+
+    const int num_runs = 5;
+
+    printf("Arquivo \"%s\" (%.1f MB), %u threads, melhor de %d execuções:\n", filename, megabytes,
+           ParallelThreadCount(), num_runs);
+
+    tinyobj::attrib_t                reference_attrib;
+    std::vector<tinyobj::shape_t>    reference_shapes;
+    std::vector<tinyobj::material_t> materials;
+    tinyobj::attrib_t                attrib;
+    std::vector<tinyobj::shape_t>    shapes;
+
+    double best[3] = {1e30, 1e30, 1e30};
+    bool   ok[3]   = {true, true, true};
+
+    for (int run = 0; run < num_runs; ++run) {
+        std::string warn;
+        std::string err;
+
+        reference_attrib = tinyobj::attrib_t();
+        reference_shapes.clear();
+        clock::time_point start = clock::now();
+        ok[0] = tinyobj::LoadObj(&reference_attrib, &reference_shapes, &materials, &warn, &err, filename, nullptr,
+                                 true) && ok[0];
+        best[0] = std::min(best[0], std::chrono::duration<double>(clock::now() - start).count());
+
+        attrib = tinyobj::attrib_t();
+        shapes.clear();
+        start   = clock::now();
+        ok[1]   = ObjParser_Load(filename, &attrib, &shapes) && ok[1];
+        best[1] = std::min(best[1], std::chrono::duration<double>(clock::now() - start).count());
+
+        MeshData mesh;
+        start   = clock::now();
+        ok[2]   = ObjParser_LoadMesh(filename, NORMALS_WEIGHT_AREA, &mesh) && ok[2];
+        best[2] = std::min(best[2], std::chrono::duration<double>(clock::now() - start).count());
+    }
+
+    const char* names[3] = {"tinyobj::LoadObj()", "ObjParser_Load()", "ObjParser_LoadMesh()"};
+    for (int i = 0; i < 3; ++i) {
+        if (ok[i]) {
+            printf("  %-22s %8.2f ms %9.1f MB/s (%.1fx)\n", names[i], 1000.0 * best[i], megabytes / best[i],
+                   best[0] / best[i]);
+        } else {
+            printf("  %-22s não suportado para este arquivo\n", names[i]);
+        }
+    }
+
+    if (ok[0] && ok[1]) {
+        bool same = attrib.vertices == reference_attrib.vertices && attrib.normals == reference_attrib.normals &&
+                    attrib.texcoords == reference_attrib.texcoords && shapes.size() == reference_shapes.size();
+
+        for (size_t s = 0; same && s < shapes.size(); ++s) {
+            const tinyobj::mesh_t& a = shapes[s].mesh;
+            const tinyobj::mesh_t& b = reference_shapes[s].mesh;
+
+            same = shapes[s].name == reference_shapes[s].name && a.indices.size() == b.indices.size() &&
+                   a.num_face_vertices == b.num_face_vertices && a.material_ids == b.material_ids &&
+                   a.smoothing_group_ids == b.smoothing_group_ids;
+
+            for (size_t i = 0; same && i < a.indices.size(); ++i) {
+                same = a.indices[i].vertex_index == b.indices[i].vertex_index &&
+                       a.indices[i].normal_index == b.indices[i].normal_index &&
+                       a.indices[i].texcoord_index == b.indices[i].texcoord_index;
+            }
+        }
+
+        printf("Resultado de ObjParser_Load() %s ao da tinyobjloader.\n", same ? "idêntico" : "DIFERENTE");
+        if (!same) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Mede o tempo de ComputeVertexNormals() para uma malha sintética (um terreno
+// ondulado) com aproximadamente "num_triangles" triângulos, para cada tipo de
+// peso e com 1, 2, 4, ... threads. Executado com o argumento
+// "--bench-normals [milhões de triângulos]".
+int Normals_Benchmark(size_t num_triangles) {
+    typedef std::chrono::steady_clock clock;
+
+    // Grade de side x side vértices, com 2 triângulos por célula.
+    size_t side         = static_cast<size_t>(std::sqrt(static_cast<double>(num_triangles) / 2.0)) + 2;
+    size_t num_vertices = side * side;
+    num_triangles       = 2 * (side - 1) * (side - 1);
+
+    std::vector<float> x(num_vertices), y(num_vertices), z(num_vertices);
+    for (size_t i = 0; i < side; ++i) {
+        for (size_t j = 0; j < side; ++j) {
+            float u         = static_cast<float>(i) / (side - 1);
+            float v         = static_cast<float>(j) / (side - 1);
+            x[i * side + j] = u;
+            y[i * side + j] = 0.05f * std::sin(40.0f * u) * std::cos(30.0f * v);
+            z[i * side + j] = v;
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve(3 * num_triangles);
+    for (size_t i = 0; i + 1 < side; ++i) {
+        for (size_t j = 0; j + 1 < side; ++j) {
+            uint32_t a = static_cast<uint32_t>(i * side + j);
+            uint32_t b = a + 1;
+            uint32_t c = a + static_cast<uint32_t>(side);
+            uint32_t d = c + 1;
+
+            uint32_t triangles[6] = {a, c, b, b, c, d};
+            indices.insert(indices.end(), triangles, triangles + 6);
+        }
+    }
+
+    std::vector<float> nx(num_vertices), ny(num_vertices), nz(num_vertices);
+
+    unsigned int max_threads = ParallelThreadCount();
+    const char*  names[3]    = {"uniforme", "área    ", "ângulo  "};  // Alinhados (printf conta bytes, não letras)
+    const int    num_runs    = 3;
+
+    printf("Normais de %.1f milhões de triângulos (%.1f milhões de vértices), melhor de %d execuções:\n",
+           num_triangles / 1e6, num_vertices / 1e6, num_runs);
+
+    for (int weighting = NORMALS_WEIGHT_UNIFORM; weighting <= NORMALS_WEIGHT_ANGLE; ++weighting) {
+        double single_thread = 0.0;
+
+        for (unsigned int threads = 1;; threads = std::min(2 * threads, max_threads)) {
+            JobSystem_SetThreadCount(threads);
+
+            double best = 1e30;
+            for (int run = 0; run < num_runs; ++run) {
+                clock::time_point start = clock::now();
+                ComputeVertexNormals(x.data(), y.data(), z.data(), num_vertices, indices.data(), num_triangles,
+                                     weighting, nx.data(), ny.data(), nz.data());
+                best = std::min(best, std::chrono::duration<double>(clock::now() - start).count());
+            }
+            if (threads == 1) {
+                single_thread = best;
+            }
+
+            printf("  peso %s %2u threads: %8.2f ms %8.1f Mtri/s (%.2fx)\n", names[weighting], threads,
+                   1000.0 * best, num_triangles / best / 1e6, single_thread / best);
+
+            if (threads == max_threads) {
+                break;
+            }
+        }
+    }
+
+    JobSystem_SetThreadCount(0);
+    return EXIT_SUCCESS;
+}
+
+// Mede o tempo do teste de "num_objects" objetos espalhados ao redor da
+// câmera, com o teste escalar, com o teste SSE e com o teste SSE em
+// paralelo, e verifica que todos dão o mesmo resultado. Executado com o
+// argumento "--bench-cull [número de objetos]".
+int FrustumCull_Benchmark(size_t num_objects) {
+    typedef std::chrono::steady_clock clock;
+
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> size(0.05f, 1.0f);
+
+    FrustumCullBatch batch;
+    for (size_t i = 0; i < num_objects; ++i) {
+        glm::vec3 extent = glm::vec3(size(random), size(random), size(random));
+        glm::mat4 model  = Matrix_Translate(position(random), position(random), position(random)) *
+                          Matrix_Rotate_Y(position(random));
+        FrustumCull_Add(&batch, -extent, extent, model);
+    }
+
+    glm::vec4     camera     = glm::vec4(0.0f, 2.0f, 5.0f, 1.0f);
+    glm::vec4     lookat     = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::mat4     view       = Matrix_Camera_View(camera, lookat - camera, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    glm::mat4     projection = Matrix_Perspective(3.14159265f / 3.0f, 4.0f / 3.0f, -0.1f, -10.0f);
+    FrustumPlanes planes;
+    FrustumCull_ExtractPlanes(projection * view, &planes);
+
+    const int repetitions = 20;
+
+    std::vector<uint8_t> scalar_visible;
+    size_t               num_visible = 0;
+    double               seconds     = 0.0;
+    for (int r = 0; r < repetitions; ++r) {
+        clock::time_point start = clock::now();
+        num_visible             = FrustumCull_TestScalar(planes, &batch, 0, num_objects);
+        seconds += std::chrono::duration<double>(clock::now() - start).count();
+    }
+    scalar_visible = batch.visible;
+    printf("Escalar: %d de %d objetos visíveis, %.3f ms por teste (%.1f milhões de objetos/s)\n",
+           static_cast<int>(num_visible), static_cast<int>(num_objects), 1e3 * seconds / repetitions,
+           1e-6 * num_objects * repetitions / seconds);
+
+#ifdef FRUSTUMCULL_SSE
+    seconds = 0.0;
+    for (int r = 0; r < repetitions; ++r) {
+        clock::time_point start = clock::now();
+        num_visible             = FrustumCull_TestRange(planes, &batch, 0, num_objects);
+        seconds += std::chrono::duration<double>(clock::now() - start).count();
+    }
+    printf("SSE:     %d de %d objetos visíveis, %.3f ms por teste (%.1f milhões de objetos/s)\n",
+           static_cast<int>(num_visible), static_cast<int>(num_objects), 1e3 * seconds / repetitions,
+           1e-6 * num_objects * repetitions / seconds);
+
+    if (batch.visible != scalar_visible) {
+        fprintf(stderr, "ERROR: SSE and scalar frustum culling results differ.\n");
+        return 1;
+    }
+#endif
+
+    seconds = 0.0;
+    for (int r = 0; r < repetitions; ++r) {
+        clock::time_point start = clock::now();
+        num_visible             = FrustumCull_Test(planes, &batch);
+        seconds += std::chrono::duration<double>(clock::now() - start).count();
+    }
+    printf("%u threads: %d de %d objetos visíveis, %.3f ms por teste (%.1f milhões de objetos/s)\n",
+           g_JobSystem.num_threads.load(), static_cast<int>(num_visible), static_cast<int>(num_objects),
+           1e3 * seconds / repetitions, 1e-6 * num_objects * repetitions / seconds);
+
+    if (batch.visible != scalar_visible) {
+        fprintf(stderr, "ERROR: Parallel and scalar frustum culling results differ.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+// Mede, para 10 mil, 100 mil, ... até "max_objects" objetos espalhados ao
+// redor da câmera (como em FrustumCull_Benchmark()), o tempo de construção
+// da árvore, de atualização com todos e com 1% dos objetos movidos, e a
+// vazão das consultas de frustum, raio e esfera, comparadas com testar todos
+// os objetos, e verifica que os resultados são os mesmos. Executado com o
+// argumento "--bench-bvh [número máximo de objetos]".
+int Bvh_Benchmark(size_t max_objects) {
+    typedef std::chrono::steady_clock clock;
+
+    const float pi          = 3.14159265f;
+    const int   repetitions = 20;
+    const int   num_rays    = 100000;
+    const int   num_spheres = 100000;
+    const int   num_checks  = 200;  // Consultas comparadas com o teste de todos os objetos
+
+    glm::vec4     camera     = glm::vec4(0.0f, 2.0f, 5.0f, 1.0f);
+    glm::vec4     lookat     = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::mat4     view       = Matrix_Camera_View(camera, lookat - camera, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    glm::mat4     projection = Matrix_Perspective(pi / 3.0f, 4.0f / 3.0f, -0.1f, -10.0f);
+    FrustumPlanes planes;
+    FrustumCull_ExtractPlanes(projection * view, &planes);
+
+    for (size_t n = 10000;; n *= 10) {
+        const size_t num_objects = std::min(n, max_objects);
+
+        std::mt19937                          random(42);
+        std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+        std::uniform_real_distribution<float> size(0.05f, 1.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        std::vector<glm::vec3> extents(num_objects);
+        std::vector<glm::mat4> models(num_objects);
+        FrustumCullBatch       batch;
+        FrustumCull_Resize(&batch, num_objects);
+        for (size_t i = 0; i < num_objects; ++i) {
+            extents[i] = glm::vec3(size(random), size(random), size(random));
+            models[i]  = Matrix_Translate(position(random), position(random), position(random)) *
+                        Matrix_Rotate_Y(position(random));
+            FrustumCull_Set(&batch, i, -extents[i], extents[i], models[i]);
+        }
+
+        printf("%d objetos:\n", static_cast<int>(num_objects));
+
+        // Construção.
+        Bvh               bvh;
+        clock::time_point start = clock::now();
+        Bvh_Build(&bvh, batch);
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        printf("  Construção (SAH):      %9.3f ms, %d nós\n", 1e3 * seconds, static_cast<int>(bvh.nodes.size()));
+
+        // Atualização com todos e com 1% dos objetos movidos. Os objetos
+        // movidos vão e voltam, para que a árvore não se degrade durante a
+        // medição.
+        const double fractions[] = {1.0, 0.01};
+        for (double fraction : fractions) {
+            size_t num_moved = static_cast<size_t>(fraction * num_objects);
+            seconds          = 0.0;
+            for (int r = 0; r < repetitions; ++r) {
+                float offset = r % 2 == 0 ? 0.1f : 0.0f;
+                for (size_t k = 0; k < num_moved; ++k) {
+                    size_t i = num_moved == num_objects ? k : (k * 7919) % num_objects;
+                    glm::mat4 model = Matrix_Translate(offset, 0.0f, 0.0f) * models[i];
+                    FrustumCull_Set(&batch, i, -extents[i], extents[i], model);
+                }
+                start = clock::now();
+                Bvh_Sync(&bvh, batch);
+                seconds += std::chrono::duration<double>(clock::now() - start).count();
+            }
+            printf("  Refit, %5.1f%% movidos: %9.3f ms\n", 100.0 * fraction, 1e3 * seconds / repetitions);
+        }
+
+        // Consulta de frustum, comparada com o teste SoA/SSE de todos os
+        // objetos em paralelo (veja "frustumcull.h").
+        size_t num_visible = 0;
+        seconds            = 0.0;
+        for (int r = 0; r < repetitions; ++r) {
+            start       = clock::now();
+            num_visible = FrustumCull_Test(planes, &batch);
+            seconds += std::chrono::duration<double>(clock::now() - start).count();
+        }
+        std::vector<uint8_t> linear_visible = batch.visible;
+        printf("  Frustum, linear:       %9.3f ms, %d visíveis (%u threads)\n", 1e3 * seconds / repetitions,
+               static_cast<int>(num_visible), g_JobSystem.num_threads.load());
+
+        seconds = 0.0;
+        for (int r = 0; r < repetitions; ++r) {
+            start       = clock::now();
+            num_visible = Bvh_CullBatch(bvh, planes, &batch);
+            seconds += std::chrono::duration<double>(clock::now() - start).count();
+        }
+        printf("  Frustum, BVH:          %9.3f ms, %d visíveis\n", 1e3 * seconds / repetitions,
+               static_cast<int>(num_visible));
+
+        if (batch.visible != linear_visible) {
+            fprintf(stderr, "ERROR: BVH and linear frustum culling results differ.\n");
+            return 1;
+        }
+
+        // Raios saindo da câmera em direções aleatórias.
+        std::vector<glm::vec3> directions(num_rays);
+        for (glm::vec3& direction : directions) {
+            direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)));
+        }
+        const glm::vec3 origin = glm::vec3(camera);
+        const float     max_t  = 100.0f;
+
+        int num_hits = 0;
+        start        = clock::now();
+        for (const glm::vec3& direction : directions) {
+            num_hits += Bvh_Raycast(bvh, origin, direction, max_t, nullptr) != BVH_NO_OBJECT ? 1 : 0;
+        }
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+        printf("  Raios, BVH:            %9.1f mil raios/s, %d%% acertam algum objeto\n",
+               1e-3 * num_rays / seconds, 100 * num_hits / num_rays);
+
+        // Teste de todos os objetos, somente para algumas consultas. Objetos
+        // diferentes podem ser atravessados na mesma distância (ex.: a câmera
+        // dentro de várias AABBs), então comparamos as distâncias.
+        start = clock::now();
+        for (int q = 0; q < num_checks; ++q) {
+            const glm::vec3& direction = directions[q];
+            glm::vec3        inverse_direction = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+            float linear_t = std::numeric_limits<float>::infinity();
+            for (size_t i = 0; i < num_objects; ++i) {
+                linear_t = std::min(linear_t, Bvh_RayBox(origin, inverse_direction, bvh.centers[i] - bvh.extents[i],
+                                                         bvh.centers[i] + bvh.extents[i], max_t));
+            }
+            float bvh_t = std::numeric_limits<float>::infinity();
+            Bvh_Raycast(bvh, origin, direction, max_t, &bvh_t);
+            if (bvh_t != linear_t) {
+                fprintf(stderr, "ERROR: BVH and linear raycast results differ.\n");
+                return 1;
+            }
+        }
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+        printf("  Raios, linear:         %9.1f mil raios/s\n", 1e-3 * num_checks / seconds);
+
+        // Esferas de raio 1 em posições aleatórias.
+        std::vector<glm::vec3> centers(num_spheres);
+        for (glm::vec3& center : centers) {
+            center = glm::vec3(position(random), position(random), position(random));
+        }
+        std::vector<uint32_t> results;
+
+        size_t num_found = 0;
+        start            = clock::now();
+        for (const glm::vec3& center : centers) {
+            results.clear();
+            num_found += Bvh_QuerySphere(bvh, center, 1.0f, &results);
+        }
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+        printf("  Esferas, BVH:          %9.1f mil consultas/s, %.1f objetos por consulta\n",
+               1e-3 * num_spheres / seconds, static_cast<double>(num_found) / num_spheres);
+
+        start = clock::now();
+        for (int q = 0; q < num_checks; ++q) {
+            size_t linear_count = 0;
+            for (size_t i = 0; i < num_objects; ++i) {
+                linear_count += Bvh_PointBoxDistance2(centers[q], bvh.centers[i] - bvh.extents[i],
+                                                      bvh.centers[i] + bvh.extents[i]) <= 1.0f
+                                        ? 1
+                                        : 0;
+            }
+            results.clear();
+            if (Bvh_QuerySphere(bvh, centers[q], 1.0f, &results) != linear_count) {
+                fprintf(stderr, "ERROR: BVH and linear sphere query results differ.\n");
+                return 1;
+            }
+        }
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+        printf("  Esferas, linear:       %9.1f mil consultas/s\n", 1e-3 * num_checks / seconds);
+
+        if (num_objects == max_objects) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// Mede a vazão de cada transformação acima com "num_points" pontos: a versão
+// escalar, a versão SSE/AVX com uma thread e a versão paralela, em GFLOP/s
+// (bilhões de operações de ponto flutuante por segundo), e verifica que os
+// resultados são idênticos bit a bit aos de Matrix_Multiply_Vector().
+// Executado com o argumento "--bench-transform [número de pontos]".
+int Transform_Benchmark(size_t num_points) {
+    typedef std::chrono::steady_clock clock;
+
+#if defined(MATRICES_AVX)
+    const char* backend = "AVX";
+#elif defined(MATRICES_SSE)
+    const char* backend = "SSE";
+#else
+    const char* backend = "escalar";
+#endif
+
+    const int repetitions = 10;
+
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+
+    std::vector<float>     x(num_points), y(num_points), z(num_points);
+    std::vector<float>     out_x(num_points), out_y(num_points), out_z(num_points);
+    std::vector<glm::mat4> matrices(num_points);
+    for (size_t i = 0; i < num_points; ++i) {
+        x[i]        = coordinate(random);
+        y[i]        = coordinate(random);
+        z[i]        = coordinate(random);
+        matrices[i] = Matrix_Multiply(Matrix_Translate(coordinate(random), coordinate(random), coordinate(random)),
+                                      Matrix_Rotate_Y(angle(random)));
+    }
+    TransformArrays in  = {x.data(), y.data(), z.data()};
+    TransformArrays out = {out_x.data(), out_y.data(), out_z.data()};
+
+    glm::mat4 view       = Matrix_Camera_View(glm::vec4(0.0f, 2.0f, 5.0f, 1.0f), glm::vec4(0.0f, -2.0f, -5.0f, 0.0f),
+                                              glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    glm::mat4 projection = Matrix_Perspective(3.14159265f / 3.0f, 4.0f / 3.0f, -0.1f, -10.0f);
+    glm::mat4 model      = matrices[0];
+    glm::mat4 clip       = Matrix_Multiply(projection, view);
+
+    // Operações de ponto flutuante por ponto: três coordenadas, cada uma com
+    // quatro multiplicações e três somas; com divisão por w, quatro
+    // coordenadas e três divisões.
+    const double flops_transform = 3.0 * 7.0;
+    const double flops_project   = 4.0 * 7.0 + 3.0;
+
+    // Referência: cada ponto transformado separadamente.
+    auto check = [&](const char* name, int kind) {
+        for (size_t i = 0; i < num_points; ++i) {
+            glm::vec4 p = glm::vec4(x[i], y[i], z[i], kind == 1 ? 0.0f : 1.0f);
+            glm::vec4 r;
+            if (kind <= 1) {
+                r = Matrix_Multiply_Vector(model, p);
+            } else if (kind == 2) {
+                r = Matrix_Multiply_Vector(matrices[i], p);
+            } else {
+                r = Matrix_Multiply_Vector(clip, p);
+                r = glm::vec4(r.x / r.w, r.y / r.w, r.z / r.w, 1.0f);
+            }
+            float result[3] = {out_x[i], out_y[i], out_z[i]};
+            if (memcmp(result, &r[0], sizeof(result)) != 0) {
+                fprintf(stderr, "ERROR: Batch transform results differ (%s, point %d).\n", name,
+                        static_cast<int>(i));
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Tempo médio de range(first, last) sobre todos os pontos.
+    auto measure = [&](bool parallel, const std::function<void(size_t, size_t)>& range) {
+        double seconds = 0.0;
+        for (int r = 0; r < repetitions; ++r) {
+            clock::time_point start = clock::now();
+            if (parallel) {
+                Transform_Parallel(num_points, range);
+            } else {
+                range(0, num_points);
+            }
+            seconds += std::chrono::duration<double>(clock::now() - start).count();
+        }
+        return seconds / repetitions;
+    };
+
+    const char* names[] = {"Pontos", "Vetores", "Pontos, matriz por ponto", "Pontos, divisão por w"};
+
+    printf("%d pontos, %s, %u threads:\n", static_cast<int>(num_points), backend, ParallelThreadCount());
+    for (int kind = 0; kind < 4; ++kind) {
+        float  w     = kind == 1 ? 0.0f : 1.0f;
+        double flops = (kind == 3 ? flops_project : flops_transform) * static_cast<double>(num_points);
+
+        std::function<void(size_t, size_t)> scalar, simd;
+        if (kind <= 1) {
+            scalar = [&](size_t first, size_t last) { Transform_Range_Scalar(model, w, in, out, first, last); };
+            simd   = [&](size_t first, size_t last) { Transform_Range(model, w, in, out, first, last); };
+        } else if (kind == 2) {
+            scalar = [&](size_t first, size_t last) {
+                Transform_PerMatrix_Range_Scalar(matrices.data(), w, in, out, first, last);
+            };
+            simd = [&](size_t first, size_t last) {
+                Transform_PerMatrix_Range(matrices.data(), w, in, out, first, last);
+            };
+        } else {
+            scalar = [&](size_t first, size_t last) { Transform_Project_Range_Scalar(clip, in, out, first, last); };
+            simd   = [&](size_t first, size_t last) { Transform_Project_Range(clip, in, out, first, last); };
+        }
+
+        double scalar_seconds = measure(false, scalar);
+        if (!check(names[kind], kind)) {
+            return 1;
+        }
+        double simd_seconds = measure(false, simd);
+        if (!check(names[kind], kind)) {
+            return 1;
+        }
+        double parallel_seconds = measure(true, simd);
+        if (!check(names[kind], kind)) {
+            return 1;
+        }
+
+        printf("  %s:\n", names[kind]);
+        printf("    escalar:   %8.3f ms, %6.2f GFLOP/s\n", 1e3 * scalar_seconds, 1e-9 * flops / scalar_seconds);
+        printf("    %-8s   %8.3f ms, %6.2f GFLOP/s\n", backend, 1e3 * simd_seconds, 1e-9 * flops / simd_seconds);
+        printf("    paralelo:  %8.3f ms, %6.2f GFLOP/s\n", 1e3 * parallel_seconds,
+               1e-9 * flops / parallel_seconds);
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Com os argumentos "--threads N" (antes dos demais), o sistema de
+    // tarefas usa N threads, como no programa principal (veja "parallel.h").
+    if (argc > 2 && strcmp(argv[1], "--threads") == 0) {
+        g_ParallelNumThreads = static_cast<unsigned int>(std::max(atoi(argv[2]), 0));
+        argc -= 2;
+        argv += 2;
+    }
+
+    // Com o argumento "--bench-obj [arquivo.obj]", medimos a vazão do leitor
+    // de ".obj" (veja "objparser.h").
+    if (argc > 1 && strcmp(argv[1], "--bench-obj") == 0) {
+        return ObjParser_Benchmark(argc > 2 ? argv[2] : "../../data/bunny.obj");
+    }
+
+    // Com o argumento "--bench-normals [milhões de triângulos]", medimos a
+    // escalabilidade do cálculo de normais (veja "normals.h").
+    if (argc > 1 && strcmp(argv[1], "--bench-normals") == 0) {
+        return Normals_Benchmark(static_cast<size_t>(1e6 * (argc > 2 ? atof(argv[2]) : 4.0)));
+    }
+
+    // Com o argumento "--bench-clusters [arquivo.obj]", medimos quantos
+    // triângulos são descartados pelos grupos (veja "meshlet.h") com a câmera
+    // orbitando ao redor de cada objeto.
+    if (argc > 1 && strcmp(argv[1], "--bench-clusters") == 0) {
+        return BenchmarkMeshClusters(argc > 2 ? argv[2] : "../../data/bunny.obj");
+    }
+
+    // Com o argumento "--bench-registry [número de objetos]", comparamos o
+    // custo de encontrar um objeto da cena pelo nome e pelo handle (veja
+    // "slotmap.h").
+    if (argc > 1 && strcmp(argv[1], "--bench-registry") == 0) {
+        return BenchmarkSceneRegistry(argc > 2 ? static_cast<size_t>(atol(argv[2])) : 100000);
+    }
+
+    // Com o argumento "--bench-cull [número de objetos]", medimos o tempo do
+    // teste de visibilidade dos objetos contra o frustum (veja
+    // "frustumcull.h").
+    if (argc > 1 && strcmp(argv[1], "--bench-cull") == 0) {
+        return FrustumCull_Benchmark(argc > 2 ? static_cast<size_t>(atol(argv[2])) : 1000000);
+    }
+
+    // Com o argumento "--bench-jobs [número de objetos]", medimos a
+    // escalabilidade da preparação de um quadro do modo multidão com o
+    // sistema de tarefas (veja "parallel.h").
+    if (argc > 1 && strcmp(argv[1], "--bench-jobs") == 0) {
+        return BenchmarkFramePreparation(argc > 2 ? static_cast<size_t>(atol(argv[2])) : 100000);
+    }
+
+    // Com o argumento "--bench-bvh [número de objetos]", medimos a
+    // construção, a atualização e as consultas da hierarquia de volumes
+    // envolventes (veja "bvh.h").
+    if (argc > 1 && strcmp(argv[1], "--bench-bvh") == 0) {
+        return Bvh_Benchmark(argc > 2 ? static_cast<size_t>(atol(argv[2])) : 1000000);
+    }
+
+    // Com o argumento "--bench-matrices", medimos o tempo das operações com
+    // matrizes 4x4 de "matrices.h" (produtos, transposta e inversas).
+    if (argc > 1 && strcmp(argv[1], "--bench-matrices") == 0) {
+        return Matrix_Benchmark();
+    }
+
+    // Com o argumento "--bench-transform [número de pontos]", medimos a vazão
+    // da transformação de muitos pontos de uma vez (veja "transform.h").
+    if (argc > 1 && strcmp(argv[1], "--bench-transform") == 0) {
+        return Transform_Benchmark(argc > 2 ? static_cast<size_t>(atol(argv[2])) : 1000000);
+    }
+
+    fprintf(stderr,
+            "Usage: %s [--threads N] <benchmark>\n"
+            "  --bench-obj [file.obj]\n"
+            "  --bench-normals [millions of triangles]\n"
+            "  --bench-clusters [file.obj]\n"
+            "  --bench-registry [number of objects]\n"
+            "  --bench-cull [number of objects]\n"
+            "  --bench-jobs [number of objects]\n"
+            "  --bench-bvh [number of objects]\n"
+            "  --bench-matrices\n"
+            "  --bench-transform [number of points]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
+
+// vim: set spell spelllang=pt_br :
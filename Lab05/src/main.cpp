@@ -14,17 +14,20 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 
 #include <map>
 #include <stack>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <limits>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
 #include <iostream>
+#include <memory>
 
 // Headers das bibliotecas OpenGL
 #include "glad/glad.h"   // Criação de contexto OpenGL 3.3
@@ -33,6 +36,7 @@
 // Headers da biblioteca GLM: criação de matrizes e vetores.
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
+#include <glm/matrix.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 // Headers da biblioteca para carregar modelos obj
@@ -42,6 +46,25 @@
 
 // Headers locais, definidos na pasta "include/"
 #include "matrices.h"
+#include "transform.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshopt.h"
+#include "meshlod.h"
+#include "meshlet.h"
+#include "geometryarena.h"
+#include "slotmap.h"
+#include "renderqueue.h"
+#include "commandlist.h"
+#include "instancing.h"
+#include "uniformbuffer.h"
+#include "frustumcull.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "normals.h"
+#include "objparser.h"
+#include "assetloader.h"
+#include "renderthread.h"
 
 // Estrutura que representa um modelo geométrico carregado a partir de um
 // arquivo ".obj". Veja https://en.wikipedia.org/wiki/Wavefront_.obj_file .
@@ -63,17 +86,24 @@ struct ObjModel {
             }
         }
 
-        std::string warn;
-        std::string err;
-        bool        ret =
-                tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, file_name.c_str(), base_dir, triangulate);
+        // Tentamos primeiro o leitor paralelo (veja "objparser.h"); arquivos
+        // que ele não suporta (ex.: com materiais) são lidos pela tinyobjloader.
+        if (!triangulate || !ObjParser_Load(file_name, &attrib, &shapes)) {
+            attrib = tinyobj::attrib_t();
+            shapes.clear();
 
-        if (!err.empty()) {
-            std::cerr << err << '\n';
-        }
+            std::string warn;
+            std::string err;
+            bool        ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, file_name.c_str(), base_dir,
+                                               triangulate);
+
+            if (!err.empty()) {
+                std::cerr << err << '\n';
+            }
 
-        if (!ret) {
-            throw std::runtime_error("Erro ao carregar modelo.");
+            if (!ret) {
+                throw std::runtime_error("Erro ao carregar modelo.");
+            }
         }
 
         for (auto& shape : shapes) {
@@ -99,15 +129,32 @@ void PopMatrix(glm::mat4& M);
 
 // Declaração de várias funções utilizadas em main().  Essas estão definidas
 // logo após a definição de main() neste arquivo.
-void BuildTrianglesAndAddToVirtualScene(
-        ObjModel* /*model*/);  // Constrói representação de um ObjModel como malha de triângulos para renderização
-void   ComputeNormals(ObjModel* model);  // Computa normais de um ObjModel, caso não existam.
+void BuildTrianglesAndAddToVirtualScene(ObjModel* /*model*/,
+                                        const std::string& /*model_name*/);  // Constrói e envia um ObjModel para a GPU
+void   BuildTriangles(ObjModel* model, MeshData* mesh);  // Constrói os arrays de vértices e índices de um ObjModel
+void   AddMeshToVirtualScene(const MeshView& mesh, const std::string& model_name);  // Envia uma malha para a GPU
+void   UnloadModelFromVirtualScene(const std::string& model_name);  // Remove uma malha da cena e libera seu espaço
+void   LoadObjModelToVirtualScene(const char* filename);  // Carrega um ".obj" de forma assíncrona
+void   ComputeNormals(ObjModel* model, int weighting);  // Computa normais de um ObjModel, caso não existam.
 void   LoadShadersFromFiles();           // Carrega os shaders de vértice e fragmento, criando um programa de GPU
-void   LoadTextureImage(const char* filename);              // Função que carrega imagens de textura
-void   DrawVirtualObject(const char* object_name);          // Desenha um objeto armazenado em g_VirtualScene
-GLuint LoadShader_Vertex(const char* filename);             // Carrega um vertex shader
-GLuint LoadShader_Fragment(const char* filename);           // Carrega um fragment shader
-void   LoadShader(const char* filename, GLuint shader_id);  // Função utilizada pelas duas acima
+void   LoadTextureImage(const char* filename, GLuint texture_unit);  // Função que carrega imagens de textura
+void   UploadTextureImage(GLuint texture_unit, int width, int height, const unsigned char* data);
+void   DrawVirtualObject(SlotMapHandle object_handle, const glm::mat4& model,
+                         size_t level);  // Desenha um objeto de g_VirtualScene
+bool   ResolveVirtualObject(const char* object_name, SlotMapHandle* object_handle);  // Busca um objeto pelo nome
+void   SubmitVirtualObject(SlotMapHandle object_handle, const glm::mat4& model, int object_id,
+                           bool instanced = false);  // Submete um objeto para o quadro atual
+void   SubmitVisibleObjects();  // Envia os objetos dentro do frustum para a fila (veja "frustumcull.h")
+void   DrawRenderItem(const RenderItem& item);  // Grava o desenho de um item da fila
+RenderItem MakeRenderItem(GLuint program_id, SlotMapHandle object_handle, const glm::mat4& model, int object_id,
+                          float depth);  // Cria um item da fila de renderização
+void   DrawInstancedObject(const RenderItem& item);  // Grava o desenho de instâncias (veja "instancing.h")
+void   ExecuteRenderFrame(RenderFrame* frame);     // Executa um quadro gravado (veja "renderthread.h")
+void   SubmitCrowd(SlotMapHandle bunny, SlotMapHandle sphere);  // Submete os objetos do modo multidão (tecla M)
+void   ReportCrowdFrameTime();  // Imprime no terminal o tempo médio por quadro do modo multidão
+GLuint LoadShader_Vertex(const char* filename, const char* defines = "");    // Carrega um vertex shader
+GLuint LoadShader_Fragment(const char* filename, const char* defines = "");  // Carrega um fragment shader
+void   LoadShader(const char* filename, GLuint shader_id, const char* defines);  // Função utilizada pelas duas acima
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);  // Cria um programa de GPU
 void   PrintObjModelInfo(ObjModel*);                                          // Função para debugging
 
@@ -117,6 +164,7 @@ void  TextRendering_Init();
 float TextRendering_LineHeight(GLFWwindow* window);
 float TextRendering_CharWidth(GLFWwindow* window);
 void  TextRendering_PrintString(GLFWwindow* window, const std::string& str, float x, float y, float scale = 1.0f);
+void  TextRendering_PrintStringInWindow(int width, int height, const char* str, float x, float y, float scale = 1.0f);
 void  TextRendering_PrintMatrix(GLFWwindow* window, glm::mat4 M, float x, float y, float scale = 1.0f);
 void  TextRendering_PrintVector(GLFWwindow* window, glm::vec4 v, float x, float y, float scale = 1.0f);
 void  TextRendering_PrintMatrixVectorProduct(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y,
@@ -133,6 +181,8 @@ void TextRendering_ShowModelViewProjection(GLFWwindow* window, glm::mat4 project
 void TextRendering_ShowEulerAngles(GLFWwindow* window);
 void TextRendering_ShowProjection(GLFWwindow* window);
 void TextRendering_ShowFramesPerSecond(GLFWwindow* window);
+void TextRendering_ShowLoadingStatus(GLFWwindow* window);
+void TextRendering_ShowRenderStats(GLFWwindow* window);
 
 // Funções callback para comunicação com o sistema operacional e interação do
 // usuário. Veja mais comentários nas definições das mesmas, abaixo.
@@ -147,23 +197,43 @@ void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 // cada objeto da cena virtual.
 struct SceneObject {
     std::string name;                  // Nome do objeto
-    size_t      first_index;           // Índice do primeiro vértice dentro do vetor indices[] definido em
-    // BuildTrianglesAndAddToVirtualScene()
-    size_t num_indices;                // Número de índices do objeto dentro do vetor indices[] definido em
-    // BuildTrianglesAndAddToVirtualScene()
-    GLenum    rendering_mode;          // Modo de rasterização (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
-    GLuint    vertex_array_object_id;  // ID do VAO onde estão armazenados os atributos do modelo
-    glm::vec3 bbox_min;                // Axis-Aligned Bounding Box do objeto
-    glm::vec3 bbox_max;
+    size_t      first_index;           // Índice do primeiro vértice dentro do buffer de índices da arena de
+    // geometria (veja "geometryarena.h")
+    size_t num_indices;                // Número de índices do objeto dentro do buffer de índices da arena de
+    // geometria
+    GLenum                   rendering_mode;          // Modo de rasterização (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
+    GLint                    base_vertex;             // Primeiro vértice da malha do objeto no VBO da arena
+    glm::vec3                bbox_min;                // Axis-Aligned Bounding Box do objeto
+    glm::vec3                bbox_max;
+    glm::vec3                position_offset;         // Reconstrução das posições dos vértices em "shader_vertex.glsl"
+    glm::vec3                position_scale;          // (veja GetPositionDequantization() em "mesh.h")
+    std::vector<MeshLod>     lods;                    // Níveis de detalhe; lods[0] completo (veja "meshlod.h")
+    std::vector<MeshCluster> clusters;                // Grupos de triângulos de lods[0], opcional (veja "meshlet.h")
+};
+
+// Malha carregada de um arquivo: o espaço que ela ocupa na arena de geometria
+// e os handles dos seus objetos em g_VirtualScene. Veja
+// UnloadModelFromVirtualScene().
+struct SceneModel {
+    GeometryAllocation         allocation;
+    std::vector<SlotMapHandle> objects;
 };
 
 // Abaixo definimos variáveis globais utilizadas em várias funções do código.
 
-// A cena virtual é uma lista de objetos nomeados, guardados em um dicionário
-// (map). Veja dentro da função BuildTrianglesAndAddToVirtualScene() como que são incluídos
-// objetos dentro da variável g_VirtualScene, e veja na função main() como
-// estes são acessados.
-std::map<std::string, SceneObject> g_VirtualScene;
+// A cena virtual é uma lista de objetos, identificados por handles (veja
+// "slotmap.h"). O dicionário g_VirtualSceneNames associa o nome de cada
+// objeto ao seu handle; ele só é usado para encontrar os objetos quando eles
+// são carregados, e não a cada quadro. Veja dentro da função
+// AddMeshToVirtualScene() como que são incluídos objetos dentro da variável
+// g_VirtualScene, e veja na função main() como estes são acessados.
+SlotMap<SceneObject>                           g_VirtualScene;
+std::unordered_map<std::string, SlotMapHandle> g_VirtualSceneNames;
+
+// Malhas que formam a cena virtual, indexadas pelo nome do arquivo ".obj", e
+// os buffers onde todas elas são armazenadas na GPU. Veja "geometryarena.h".
+std::map<std::string, SceneModel> g_SceneModels;
+GeometryArena                     g_GeometryArena;
 
 // Pilha que guardará as matrizes de modelagem.
 std::stack<glm::mat4> g_MatrixStack;
@@ -171,6 +241,16 @@ std::stack<glm::mat4> g_MatrixStack;
 // Razão de proporção da janela (largura/altura). Veja função FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
 
+// Altura da janela em pixels, usada para escolher o nível de detalhe dos
+// objetos. Veja função FramebufferSizeCallback().
+float g_ScreenHeight = 600.0f;
+
+// Tamanho do framebuffer em pixels, gravado em cada quadro para a chamada
+// glViewport() feita pela thread de renderização. Veja função
+// FramebufferSizeCallback().
+int g_FramebufferWidth  = 800;
+int g_FramebufferHeight = 600;
+
 // Ângulos de Euler que controlam a rotação de um dos cubos da cena virtual
 float angleX_ = 0.0f;
 float angleY_ = 0.0f;
@@ -204,21 +284,160 @@ bool usePerspectiveProjection_ = true;
 // Variável que controla se o texto informativo será mostrado na tela.
 bool g_ShowInfoText = true;
 
-// Variáveis que definem um programa de GPU (shaders). Veja função LoadShadersFromFiles().
-GLuint g_GpuProgramID = 0;
-GLint  g_model_uniform;
-GLint  g_view_uniform;
-GLint  g_projection_uniform;
-GLint  g_object_id_uniform;
-GLint  g_bbox_min_uniform;
-GLint  g_bbox_max_uniform;
+GLuint LoadGpuProgram(const char* defines);  // Cria um programa de GPU a partir dos arquivos de shaders
+void   SetupUniformBlocks(GLuint program_id);  // Liga os blocos de variáveis "uniform" de um programa aos buffers
+
+// Variáveis que definem os programas de GPU (shaders): um para objetos
+// desenhados um por vez, e outro para objetos desenhados com renderização
+// instanciada (veja "instancing.h"). Veja função LoadShadersFromFiles().
+GLuint g_GpuProgramID          = 0;
+GLuint g_InstancedGpuProgramID = 0;
+
+// Programa que desenha as caixas dos testes de oclusão. Veja "occlusion.h".
+GLuint g_OcclusionGpuProgramID = 0;
+
+// Buffers das variáveis "uniform" dos shaders, compartilhados pelos dois
+// programas: um com as variáveis do quadro, e um "ring buffer" com as
+// variáveis de cada objeto desenhado. Veja "uniformbuffer.h".
+GLuint      g_FrameUniformBuffer = 0;
+UniformRing g_UniformRing;
+
+// Formato dos vértices enviados para a GPU. Veja VertexFormat em "mesh.h".
+// Para usar o formato original (floats de 32 bits), troque por:
+//   MakeVertexFormat(VERTEX_POSITION_FLOAT32, VERTEX_NORMAL_FLOAT32, VERTEX_TEXCOORD_FLOAT32)
+VertexFormat g_VertexFormat =
+        MakeVertexFormat(VERTEX_POSITION_UNORM16, VERTEX_NORMAL_INT_2_10_10_10, VERTEX_TEXCOORD_FLOAT16);
+
+// Peso dado a cada triângulo ao computar normais de modelos que não as
+// possuem. Veja ComputeNormals() e "normals.h".
+int g_NormalWeighting = NORMALS_WEIGHT_AREA;
 
 // Número de texturas carregadas pela função LoadTextureImage()
 GLuint g_NumLoadedTextures = 0;
 
+// Textura de cada unidade (TextureImage0, TextureImage1, ...), ligadas pela
+// fila de renderização. Veja UploadTextureImage().
+GLuint g_TextureImages[RENDERQUEUE_MAX_TEXTURES] = {0};
+
+// Fila onde os objetos de cada quadro são submetidos antes de serem
+// desenhados, e quantas trocas de estado ela fez no quadro atual. Veja
+// "renderqueue.h".
+RenderQueue      g_RenderQueue;
+RenderQueueStats g_FrameRenderQueueStats;
+
+// Matrizes "view" e "projection" do quadro atual, usadas por SelectLod()
+// para escolher o nível de detalhe de cada objeto, e a posição da câmera em
+// coordenadas globais.
+glm::mat4 g_CameraView;
+glm::mat4 g_CameraProjection;
+glm::vec4 g_CameraPosition;
+
+// Erro máximo, em pixels, permitido ao escolher o nível de detalhe de um
+// objeto (teclas K e shift+K). Com g_ForcedLod >= 0, todos os objetos usam
+// este nível (tecla L). Veja "meshlod.h".
+float g_LodPixelError = 1.0f;
+int   g_ForcedLod     = -1;
+
+// Variável que controla se os grupos de triângulos de objetos grandes que
+// estão fora da tela ou de costas para a câmera são descartados (tecla C).
+// Veja "meshlet.h".
+bool g_ClusterCulling = true;
+
+// Variável que controla se objetos pesados escondidos atrás de outros
+// objetos são descartados pela GPU (tecla Q), e as consultas de oclusão
+// usadas para isso. Veja "occlusion.h".
+bool             g_OcclusionCulling = true;
+OcclusionQueries g_OcclusionQueries;
+
+// Estatísticas do quadro atual, mostradas por TextRendering_ShowRenderStats().
+size_t           g_FrameTriangles = 0;  // Triângulos enviados para a GPU
+size_t           g_FrameDrawCalls = 0;  // Chamadas glDrawElementsBaseVertex() e glMultiDrawElementsBaseVertex()
+MeshletCullStats g_FrameClusterStats;   // Grupos de triângulos testados e descartados
+
+// Objetos submetidos no quadro atual, e as suas AABBs em coordenadas
+// globais, que são testadas contra o frustum da câmera antes de os objetos
+// chegarem à fila de renderização. Veja SubmitVisibleObjects() e
+// "frustumcull.h".
+struct FrameObject {
+    SlotMapHandle object;
+    glm::mat4     model;
+    int           object_id;
+    bool          instanced;  // Desenhado com renderização instanciada (veja "instancing.h")
+
+    // Computados por SubmitVisibleObjects() para os objetos visíveis.
+    float  depth;     // Distância do centro da AABB à câmera, ao longo do vetor "view"
+    size_t lod;       // Nível de detalhe
+    size_t group;     // Grupo de instâncias do objeto (somente instanciados)
+    size_t instance;  // Posição do objeto dentro do grupo (somente instanciados)
+};
+
+// Número de objetos processados por tarefa nas partes paralelas da
+// preparação de cada quadro. Veja "parallel.h".
+#define FRAME_TASK_SIZE 1024
+
+std::vector<FrameObject> g_FrameObjects;
+FrustumCullBatch         g_FrustumCullBatch;
+FrustumCullStats         g_FrameFrustumStats;
+
+// Hierarquia de volumes envolventes sobre as AABBs de g_FrameObjects,
+// atualizada a cada quadro (veja "bvh.h"). Com g_BvhCulling = true (tecla
+// B), o teste contra o frustum percorre a árvore em vez de testar todos os
+// objetos; a seleção de objetos com o mouse sempre usa a árvore (veja
+// PickObject()).
+Bvh  g_SceneBvh;
+bool g_BvhCulling = true;
+
+// Modo "multidão" (tecla M): g_CrowdSize coelhos e esferas sobre o plano do
+// chão, desenhados com renderização instanciada ou, com g_CrowdInstancing =
+// false (tecla I), um objeto por vez. As teclas N e shift+N multiplicam e
+// dividem o número de objetos por 10. Veja SubmitCrowd().
+int            g_CrowdSize       = 0;  // 0 se o modo está desligado
+bool           g_CrowdInstancing = true;
+InstanceBuffer g_InstanceBuffer;
+
+// Threads que carregam malhas e texturas em segundo plano. Veja "assetloader.h".
+AssetLoader g_AssetLoader;
+
+// Thread de renderização, que executa os quadros gravados pela thread
+// principal, e o quadro sendo gravado agora. Com g_RenderThreadEnabled =
+// false (tecla T), cada quadro é executado pela thread principal logo depois
+// de gravado. Veja "renderthread.h".
+bool         g_RenderThreadEnabled = true;
+RenderThread g_RenderThread;
+RenderFrame* g_RecordFrame = nullptr;
+
+// Intervalo de troca de buffers (glfwSwapInterval()) pedido pela tecla M, ou
+// -1 para manter o padrão do sistema.
+int g_SwapInterval = -1;
+
+// Estatísticas de oclusão do último quadro executado, mostradas por
+// TextRendering_ShowRenderStats(). Veja "occlusion.h".
+OcclusionStats g_FrameOcclusionStats;
+
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "modernize-macro-to-enum"
+
+// Identificadores dos objetos, usados em "shader_fragment.glsl" para escolher
+// o modelo de iluminação e a textura. Definidos fora de main() porque também
+// são usados por SubmitCrowd().
+#define SPHERE 0
+#define BUNNY  1
+#define PLANE  2
+
+// Os testes de desempenho ("bench.cpp") incluem este arquivo para usar as
+// mesmas funções, mas têm a sua própria função main().
+#ifndef LAB05_BENCHMARKS
 int main(int argc, char* argv[]) {
+    // Com os argumentos "--threads N" (antes dos demais), o sistema de
+    // tarefas usa N threads (veja "parallel.h"). Com "--threads 1", todo o
+    // trabalho é feito pela thread principal, em uma ordem determinística, o
+    // que facilita a depuração.
+    if (argc > 2 && strcmp(argv[1], "--threads") == 0) {
+        g_ParallelNumThreads = static_cast<unsigned int>(std::max(atoi(argv[2]), 0));
+        argc -= 2;
+        argv += 2;
+    }
+
     // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
     // sistema operacional, onde poderemos renderizar com OpenGL.
     int success = glfwInit();
@@ -288,28 +507,66 @@ int main(int argc, char* argv[]) {
     //
     LoadShadersFromFiles();
 
-    // Carregamos duas imagens para serem utilizadas como textura
-    LoadTextureImage("../../data/tc-earth_daymap_surface.jpg");       // TextureImage0
-    LoadTextureImage("../../data/tc-earth_nightmap_citylights.gif");  // TextureImage1
+    // Criamos os buffers que armazenarão todas as malhas da cena na GPU. Veja
+    // "geometryarena.h".
+    GeometryArena_Init(&g_GeometryArena, g_VertexFormat);
 
-    // Construímos a representação de objetos geométricos por malhas de triângulos
-    ObjModel sphere_model("../../data/sphere.obj");
-    ComputeNormals(&sphere_model);
-    BuildTrianglesAndAddToVirtualScene(&sphere_model);
+    // Criamos o buffer que armazenará as matrizes de modelagem dos objetos
+    // instanciados. Veja "instancing.h".
+    InstanceBuffer_Init(&g_InstanceBuffer);
+
+    // Criamos os buffers das variáveis "uniform" dos shaders. Veja
+    // "uniformbuffer.h".
+    g_FrameUniformBuffer = FrameUniforms_Init();
+    UniformRing_Init(&g_UniformRing);
+
+    // Criamos a caixa desenhada nos testes de oclusão. Veja "occlusion.h".
+    OcclusionQueries_Init(&g_OcclusionQueries);
+
+    // Iniciamos as threads de trabalho que dividem entre si as partes
+    // paralelas de cada quadro. Veja "parallel.h".
+    JobSystem_Start();
+
+    // Iniciamos as threads que carregam os recursos abaixo em segundo plano,
+    // enquanto os primeiros quadros já são desenhados. Veja "assetloader.h".
+    stbi_set_flip_vertically_on_load(1);
+    AssetLoader_Start(&g_AssetLoader);
+
+    // As threads de carregamento também precisam terminar antes de
+    // g_AssetLoader ser destruído quando o programa termina com std::exit()
+    // (veja KeyCallback() e AssetLoader_WorkerLoop()). Como as funções
+    // registradas com std::atexit() são chamadas na ordem inversa, elas
+    // terminam antes das threads de "parallel.h", que podem estar usando.
+    std::atexit([]() { AssetLoader_Stop(&g_AssetLoader); });
+
+    // Instante em que os recursos começaram a ser carregados, para medirmos o
+    // tempo até o primeiro quadro ser mostrado e o tempo total de
+    // carregamento.
+    double load_start_time = glfwGetTime();
+    bool   first_frame     = true;
+    bool   loading         = true;
 
-    ObjModel bunny_model("../../data/bunny.obj");
-    ComputeNormals(&bunny_model);
-    BuildTrianglesAndAddToVirtualScene(&bunny_model);
+    // Carregamos duas imagens para serem utilizadas como textura
+    LoadTextureImage("../../data/tc-earth_daymap_surface.jpg", 0);       // TextureImage0
+    LoadTextureImage("../../data/tc-earth_nightmap_citylights.gif", 1);  // TextureImage1
 
-    ObjModel plane_model("../../data/plane.obj");
-    ComputeNormals(&plane_model);
-    BuildTrianglesAndAddToVirtualScene(&plane_model);
+    // Construímos a representação de objetos geométricos por malhas de
+    // triângulos. Veja LoadObjModelToVirtualScene() e "meshcache.h".
+    LoadObjModelToVirtualScene("../../data/sphere.obj");
+    LoadObjModelToVirtualScene("../../data/bunny.obj");
+    LoadObjModelToVirtualScene("../../data/plane.obj");
 
     if (argc > 1) {
-        ObjModel model(argv[1]);
-        BuildTrianglesAndAddToVirtualScene(&model);
+        LoadObjModelToVirtualScene(argv[1]);
     }
 
+    // Handles dos objetos desenhados abaixo. Eles são obtidos a partir dos
+    // nomes dos objetos somente quando estes terminam de ser carregados; veja
+    // ResolveVirtualObject().
+    SlotMapHandle the_sphere = SLOTMAP_INVALID_HANDLE;
+    SlotMapHandle the_bunny  = SLOTMAP_INVALID_HANDLE;
+    SlotMapHandle the_plane  = SLOTMAP_INVALID_HANDLE;
+
     // Inicializamos o código para renderização de texto.
     TextRendering_Init();
 
@@ -322,25 +579,62 @@ int main(int argc, char* argv[]) {
     glCullFace(GL_BACK);
     glFrontFace(GL_CCW);
 
+    // Preparamos a execução dos quadros gravados abaixo. A thread de
+    // renderização é iniciada no início do laço; a partir daí, somente ela
+    // chama funções OpenGL. Veja "renderthread.h".
+    RenderThread_Init(&g_RenderThread, window, ExecuteRenderFrame);
+
+    // A thread de renderização precisa terminar antes de g_RenderThread ser
+    // destruída, inclusive quando o programa termina com std::exit() (veja
+    // KeyCallback()).
+    std::atexit([]() { RenderThread_Stop(&g_RenderThread); });
+
     // Ficamos em um loop infinito, renderizando, até que o usuário feche a janela
     while (glfwWindowShouldClose(window) == GLFW_FALSE) {
-        // Aqui executamos as operações de renderização
+        // Ligamos ou desligamos a thread de renderização (tecla T).
+        if (g_RenderThreadEnabled) {
+            RenderThread_Start(&g_RenderThread);
+        } else {
+            RenderThread_Stop(&g_RenderThread);
+        }
 
-        // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor é
-        // definida como coeficientes RGBA: Red, Green, Blue, Alpha; isto é:
-        // Vermelho, Verde, Azul, Alpha (valor de transparência).
-        // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminação.
-        //
-        //           R     G     B     A
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        // Enviamos para a GPU os recursos que as threads de trabalho já
+        // terminaram de carregar, respeitando o limite de bytes por quadro.
+        // Malhas também podem ser recarregadas depois do início (tecla U).
+        // Os envios são feitos pela thread com o contexto OpenGL, antes de
+        // começarmos a gravar o quadro.
+        bool pending = AssetLoader_NumPending(&g_AssetLoader) > 0;
+        if (pending) {
+            RenderThread_Call(&g_RenderThread,
+                              []() { AssetLoader_ProcessUploads(&g_AssetLoader, ASSET_UPLOAD_BUDGET); });
+            pending = AssetLoader_NumPending(&g_AssetLoader) > 0;
+
+            if (!pending) {
+                if (loading) {
+                    loading = false;
+                    printf("Todos os recursos carregados em %.1f ms (%.1f MB enviados para a GPU).\n",
+                           1000.0 * (glfwGetTime() - load_start_time),
+                           static_cast<double>(g_AssetLoader.uploaded_bytes) / (1024.0 * 1024.0));
+                }
+                GeometryArena_PrintStats(g_GeometryArena);
+            }
+        }
 
-        // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
-        // e também resetamos todos os pixels do Z-buffer (depth buffer).
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Iniciamos a gravação de um quadro. Com a thread de renderização
+        // ligada, ela pode estar executando o quadro anterior enquanto isso.
+        // Nenhuma função OpenGL é chamada durante a gravação: os desenhos são
+        // gravados em g_RecordFrame e executados por ExecuteRenderFrame().
+        g_RecordFrame         = RenderThread_BeginFrame(&g_RenderThread);
+        g_FrameOcclusionStats = g_RecordFrame->occlusion_stats;
 
-        // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
-        // os shaders de vértice e fragmentos).
-        glUseProgram(g_GpuProgramID);
+        g_RecordFrame->viewport_width  = g_FramebufferWidth;
+        g_RecordFrame->viewport_height = g_FramebufferHeight;
+        g_RecordFrame->swap_interval   = g_SwapInterval;
+        glfwGetWindowSize(window, &g_RecordFrame->window_width, &g_RecordFrame->window_height);
+
+        g_FrameTriangles = 0;
+        g_FrameDrawCalls = 0;
+        memset(&g_FrameClusterStats, 0, sizeof(g_FrameClusterStats));
 
         // Computamos a posição da câmera utilizando coordenadas esféricas.  As
         // variáveis g_CameraDistance, g_CameraPhi, e g_CameraTheta são
@@ -394,35 +688,72 @@ int main(int argc, char* argv[]) {
 
         glm::mat4 model = Matrix_Identity();  // Transformação identidade de modelagem
 
-        // Enviamos as matrizes "view" e "projection" para a placa de vídeo
-        // (GPU). Veja o arquivo "shader_vertex.glsl", onde estas são
-        // efetivamente aplicadas em todos os pontos.
-        glUniformMatrix4fv(g_view_uniform, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(g_projection_uniform, 1, GL_FALSE, glm::value_ptr(projection));
+        // Gravamos as matrizes "view" e "projection", e as demais variáveis
+        // que não mudam durante o quadro, que serão enviadas para a placa de
+        // vídeo (GPU) uma única vez para todos os programas. Veja o arquivo
+        // "shader_vertex.glsl", onde estas são efetivamente aplicadas em
+        // todos os pontos, e "uniformbuffer.h".
+        FrameUniforms& frame  = g_RecordFrame->frame_uniforms;
+        frame.view            = view;
+        frame.projection      = projection;
+        frame.camera_position = camera_position_c;
+        frame.light_direction = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);  // Normalizado em "shader_fragment.glsl"
+        frame.time            = static_cast<float>(glfwGetTime());
+        g_CameraView       = view;
+        g_CameraProjection = projection;
+        g_CameraPosition   = camera_position_c;
+
+        ResolveVirtualObject("the_sphere", &the_sphere);
+        ResolveVirtualObject("the_bunny", &the_bunny);
+        ResolveVirtualObject("the_plane", &the_plane);
+
+        // Os objetos não são desenhados imediatamente: cada um é submetido
+        // para o teste de visibilidade (veja "frustumcull.h"), e os objetos
+        // visíveis seguem para a fila de renderização, que os ordena para
+        // minimizar as trocas de estado e para desenhá-los do mais próximo
+        // para o mais distante da câmera. Veja "renderqueue.h".
+        g_FrameObjects.clear();
+        FrustumCull_Clear(&g_FrustumCullBatch);
+        RenderQueue_Begin(&g_RenderQueue, -farplane);
+
+        // Desenhamos o modelo da esfera, girando em torno de Y, depois
+        // inclinada em torno de X e de Z. As três rotações são compostas como
+        // quatérnios, e a matriz é construída diretamente (veja
+        // Matrix_TRS_Quat() em "matrices.h").
+        glm::vec4 tilt = Quat_Multiply(Quat_FromAxisAngle(0.6f, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)),
+                                       Quat_FromAxisAngle(0.2f, glm::vec4(1.0f, 0.0f, 0.0f, 0.0f)));
+        glm::vec4 spin = Quat_FromAxisAngle(angleY_ + static_cast<float>(glfwGetTime()) * 0.1f,
+                                            glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+        model = Matrix_TRS_Quat(glm::vec3(-1.0f, 0.0f, 0.0f), Quat_Multiply(tilt, spin), glm::vec3(1.0f));
+        SubmitVirtualObject(the_sphere, model, SPHERE);
 
-#define SPHERE 0
-#define BUNNY  1
-#define PLANE  2
+        // Desenhamos o modelo do coelho
+        model = Matrix_TRS(glm::vec3(1.0f, 0.0f, 0.0f),
+                           glm::vec3(angleX_ + static_cast<float>(glfwGetTime()) * 0.1f, 0.0f, 0.0f), glm::vec3(1.0f));
+        SubmitVirtualObject(the_bunny, model, BUNNY);
+
+        // Desenhamos o plano do chão. Sua matriz não muda entre quadros, e é
+        // calculada pelo compilador.
+        constexpr glm::mat4 kPlaneModel = Matrix_Translate(0.0f, -1.1f, 0.0f);
+        static_assert(kPlaneModel[0][0] == 1.0f && kPlaneModel[1][1] == 1.0f && kPlaneModel[2][2] == 1.0f &&
+                          kPlaneModel[0][1] == 0.0f && kPlaneModel[1][2] == 0.0f && kPlaneModel[3][1] == -1.1f,
+                      "Matriz do plano incorreta: o plano não deve ser rotacionado nem escalado");
+        SubmitVirtualObject(the_plane, kPlaneModel, PLANE);
+
+        // Desenhamos a multidão de coelhos e esferas (tecla M)
+        if (g_CrowdSize > 0) {
+            SubmitCrowd(the_bunny, the_sphere);
+        }
 
-        // Desenhamos o modelo da esfera
-        model = Matrix_Translate(-1.0f, 0.0f, 0.0f) * Matrix_Rotate_Z(0.6f) * Matrix_Rotate_X(0.2f) *
-                Matrix_Rotate_Y(angleY_ + static_cast<float>(glfwGetTime()) * 0.1f);
-        glUniformMatrix4fv(g_model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, SPHERE);
-        DrawVirtualObject("the_sphere");
+        // Descartamos os objetos fora do frustum da câmera.
+        SubmitVisibleObjects();
 
-        // Desenhamos o modelo do coelho
-        model =
-                Matrix_Translate(1.0f, 0.0f, 0.0f) * Matrix_Rotate_X(angleX_ + static_cast<float>(glfwGetTime()) * 0.1f);
-        glUniformMatrix4fv(g_model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, BUNNY);
-        DrawVirtualObject("the_bunny");
-
-        // Desenhamos o plano do chão
-        model = Matrix_Translate(0.0f, -1.1f, 0.0f);
-        glUniformMatrix4fv(g_model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE);
-        DrawVirtualObject("the_plane");
+        // Gravamos os desenhos dos objetos visíveis, na ordem da fila. As
+        // matrizes dos objetos instanciados e as variáveis de todos os
+        // objetos já estão no quadro, e são enviadas de uma só vez antes de
+        // qualquer desenho (veja ExecuteRenderFrame()).
+        RenderQueue_Sort(&g_RenderQueue);
+        RenderQueue_Record(g_RenderQueue, &g_RecordFrame->commands, &g_FrameRenderQueueStats, DrawRenderItem);
 
         // Imprimimos na tela os ângulos de Euler que controlam a rotação do
         // terceiro cubo.
@@ -435,6 +766,17 @@ int main(int argc, char* argv[]) {
         // por segundo (frames per second).
         TextRendering_ShowFramesPerSecond(window);
 
+        // Imprimimos na tela quantos triângulos foram desenhados neste quadro.
+        TextRendering_ShowRenderStats(window);
+
+        // Imprimimos no terminal o tempo médio por quadro do modo multidão.
+        ReportCrowdFrameTime();
+
+        // Imprimimos na tela quantos recursos ainda estão sendo carregados.
+        if (pending) {
+            TextRendering_ShowLoadingStatus(window);
+        }
+
         // O framebuffer onde OpenGL executa as operações de renderização não
         // é o mesmo que está sendo mostrado para o usuário, caso contrário
         // seria possível ver artefatos conhecidos como "screen tearing". A
@@ -442,7 +784,21 @@ int main(int argc, char* argv[]) {
         // tudo que foi renderizado pelas funções acima.
         // Veja o link:
         // https://en.wikipedia.org/w/index.php?title=Multiple_buffering&oldid=793452829#Double_buffering_in_computer_graphics
-        glfwSwapBuffers(window);
+        //
+        // Aqui entregamos o quadro gravado para a thread de renderização, que
+        // o executa e troca os buffers (veja RenderThread_ExecuteFrame()).
+        RenderThread_SubmitFrame(&g_RenderThread);
+        g_RecordFrame = nullptr;
+
+        // O primeiro quadro só é mostrado quando a thread de renderização
+        // troca os buffers, possivelmente depois de gravarmos outros quadros.
+        if (first_frame) {
+            double present_time = RenderThread_FirstPresentTime(&g_RenderThread);
+            if (present_time > 0.0) {
+                first_frame = false;
+                printf("Primeiro quadro mostrado após %.1f ms.\n", 1000.0 * (present_time - load_start_time));
+            }
+        }
 
         // Verificamos com o sistema operacional se houve alguma interação do
         // usuário (teclado, mouse, ...). Caso positivo, as funções de callback
@@ -451,32 +807,70 @@ int main(int argc, char* argv[]) {
         glfwPollEvents();
     }
 
+    // Esperamos a execução dos últimos quadros e encerramos a thread de
+    // renderização.
+    RenderThread_Stop(&g_RenderThread);
+
+    // Encerramos as threads de trabalho, caso a janela tenha sido fechada
+    // antes do fim do carregamento.
+    AssetLoader_Stop(&g_AssetLoader);
+
     // Finalizamos o uso dos recursos do sistema operacional
     glfwTerminate();
 
     // Fim do programa
     return 0;
 }
+#endif  // LAB05_BENCHMARKS
 #pragma clang diagnostic pop
 
-// Função que carrega uma imagem para ser utilizada como textura
-void LoadTextureImage(const char* filename) {
-    printf("Carregando imagem \"%s\"... ", filename);
-
-    // Primeiro fazemos a leitura da imagem do disco
-    stbi_set_flip_vertically_on_load(1);
-    int   width;
-    int   height;
-    int   channels;
-    auto* data = stbi_load(filename, &width, &height, &channels, 3);
+// Imagem decodificada por uma thread de trabalho.
+struct LoadedImage {
+    unsigned char* data;
+    int            width;
+    int            height;
 
-    if (data == nullptr) {
-        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
+    LoadedImage() : data(nullptr), width(0), height(0) {}
+    ~LoadedImage() {
+        if (data != nullptr) {
+            stbi_image_free(data);
+        }
     }
+};
+
+// Função que carrega uma imagem para ser utilizada como textura na unidade de
+// textura "texture_unit" (TextureImage0, TextureImage1, ... nos shaders). A
+// imagem é lida e decodificada de forma assíncrona (veja "assetloader.h");
+// como as imagens podem ficar prontas em qualquer ordem, a unidade de
+// textura é explícita.
+void LoadTextureImage(const char* filename, GLuint texture_unit) {
+    std::string name = filename;
+
+    AssetLoader_Submit(&g_AssetLoader, [name, texture_unit]() -> AssetUpload {
+        std::shared_ptr<LoadedImage> image(new LoadedImage());
+
+        // Primeiro fazemos a leitura da imagem do disco. Note que
+        // stbi_set_flip_vertically_on_load() foi chamada em main(), antes de
+        // iniciarmos as threads de trabalho.
+        int channels;
+        image->data = stbi_load(name.c_str(), &image->width, &image->height, &channels, 3);
+
+        if (image->data == nullptr) {
+            throw std::runtime_error("Cannot open image file \"" + name + "\".");
+        }
 
-    printf("OK (%dx%d).\n", width, height);
+        printf("Imagem \"%s\" carregada (%dx%d).\n", name.c_str(), image->width, image->height);
+
+        return [image, texture_unit]() -> size_t {
+            UploadTextureImage(texture_unit, image->width, image->height, image->data);
+            return static_cast<size_t>(image->width) * image->height * 3;
+        };
+    });
+}
 
+// Envia para a GPU uma imagem RGB já decodificada, na unidade de textura
+// "texture_unit".
+void UploadTextureImage(GLuint texture_unit, int width, int height, const unsigned char* data) {
     // Agora criamos objetos na GPU com OpenGL para armazenar a textura
     GLuint texture_id;
     GLuint sampler_id;
@@ -497,44 +891,494 @@ void LoadTextureImage(const char* filename) {
     glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
     glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 
-    GLuint texture_unit = g_NumLoadedTextures;
     glActiveTexture(GL_TEXTURE0 + texture_unit);
     glBindTexture(GL_TEXTURE_2D, texture_id);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
     glGenerateMipmap(GL_TEXTURE_2D);
     glBindSampler(texture_unit, sampler_id);
 
-    stbi_image_free(data);
-
+    if (texture_unit < RENDERQUEUE_MAX_TEXTURES) {
+        g_TextureImages[texture_unit] = texture_id;
+    }
     g_NumLoadedTextures += 1;
 }
 
-// Função que desenha um objeto armazenado em g_VirtualScene. Veja definição
-// dos objetos na função BuildTrianglesAndAddToVirtualScene().
-void DrawVirtualObject(const char* object_name) {
-    // "Ligamos" o VAO. Informamos que queremos utilizar os atributos de
-    // vértices apontados pelo VAO criado pela função BuildTrianglesAndAddToVirtualScene(). Veja
-    // comentários detalhados dentro da definição de BuildTrianglesAndAddToVirtualScene().
-    glBindVertexArray(g_VirtualScene[object_name].vertex_array_object_id);
-
-    // Setamos as variáveis "bbox_min" e "bbox_max" do fragment shader
-    // com os parâmetros da axis-aligned bounding box (AABB) do modelo.
-    glm::vec3 bbox_min = g_VirtualScene[object_name].bbox_min;
-    glm::vec3 bbox_max = g_VirtualScene[object_name].bbox_max;
-    glUniform4f(g_bbox_min_uniform, bbox_min.x, bbox_min.y, bbox_min.z, 1.0f);
-    glUniform4f(g_bbox_max_uniform, bbox_max.x, bbox_max.y, bbox_max.z, 1.0f);
-
-    // Pedimos para a GPU rasterizar os vértices dos eixos XYZ
-    // apontados pelo VAO como linhas. Veja a definição de
-    // g_VirtualScene[""] dentro da função BuildTrianglesAndAddToVirtualScene(), e veja
-    // a documentação da função glDrawElements() em
-    // http://docs.gl/gl3/glDrawElements.
-    glDrawElements(g_VirtualScene[object_name].rendering_mode, g_VirtualScene[object_name].num_indices, GL_UNSIGNED_INT,
-                   reinterpret_cast<void*>(g_VirtualScene[object_name].first_index * sizeof(GLuint)));
-
-    // "Desligamos" o VAO, evitando assim que operações posteriores alterem
-    //  o mesmo. Isso evita bugs.
-    glBindVertexArray(0);
+// Escolhe o nível de detalhe com que um objeto será desenhado, a partir do
+// tamanho da sua AABB projetada na tela. Veja "meshlod.h".
+size_t SelectLod(const SceneObject& object, const glm::mat4& model) {
+    if (g_ForcedLod >= 0) {
+        return std::min(static_cast<size_t>(g_ForcedLod), object.lods.size() - 1);
+    }
+
+    float size = MeshLod_ProjectedSize(object.bbox_min, object.bbox_max, Matrix_Multiply(g_CameraView, model),
+                                       g_CameraProjection, g_ScreenHeight);
+    return MeshLod_Select(object.lods.data(), object.lods.size(), size, g_LodPixelError);
+}
+
+// Faz "object_handle" apontar para o objeto de g_VirtualScene chamado
+// "object_name". O nome só é procurado quando o handle não aponta para um
+// objeto válido: antes de o objeto ser carregado (veja "assetloader.h"), ou
+// depois de ele ser removido ou recarregado. Retorna false caso o objeto não
+// exista.
+bool ResolveVirtualObject(const char* object_name, SlotMapHandle* object_handle) {
+    if (SlotMap_Contains(g_VirtualScene, *object_handle)) {
+        return true;
+    }
+
+    auto it = g_VirtualSceneNames.find(object_name);
+    if (it == g_VirtualSceneNames.end()) {
+        *object_handle = SLOTMAP_INVALID_HANDLE;
+        return false;
+    }
+
+    *object_handle = it->second;
+    return true;
+}
+
+// Define o objeto "index" de g_FrameObjects e de g_FrustumCullBatch, que já
+// devem ter espaço para ele. Objetos diferentes podem ser definidos em
+// paralelo (veja SubmitCrowd()).
+void SetFrameObject(size_t index, const SceneObject& object, SlotMapHandle object_handle, const glm::mat4& model,
+                    int object_id, bool instanced) {
+    FrustumCull_Set(&g_FrustumCullBatch, index, object.bbox_min, object.bbox_max, model);
+
+    FrameObject& frame_object = g_FrameObjects[index];
+    frame_object.object       = object_handle;
+    frame_object.model        = model;
+    frame_object.object_id    = object_id;
+    frame_object.instanced    = instanced;
+    frame_object.depth        = 0.0f;
+    frame_object.lod          = 0;
+    frame_object.group        = 0;
+    frame_object.instance     = 0;
+}
+
+// Submete um objeto de g_VirtualScene para o quadro atual, com a matriz de
+// modelagem "model" e o material "object_id" (veja "shader_fragment.glsl").
+// Objetos ainda não carregados são ignorados. O objeto só chega à fila de
+// renderização se estiver dentro do frustum da câmera; veja
+// SubmitVisibleObjects(). Com "instanced", ele é desenhado junto com os
+// demais objetos instanciados que usam a mesma malha (veja "instancing.h").
+void SubmitVirtualObject(SlotMapHandle object_handle, const glm::mat4& model, int object_id, bool instanced) {
+    const SceneObject* object = SlotMap_Get(&g_VirtualScene, object_handle);
+    if (object == nullptr) {
+        return;
+    }
+
+    size_t index = g_FrameObjects.size();
+    g_FrameObjects.resize(index + 1);
+    FrustumCull_Resize(&g_FrustumCullBatch, index + 1);
+    SetFrameObject(index, *object, object_handle, model, object_id, instanced);
+}
+
+// Testa os objetos submetidos no quadro atual contra o frustum da câmera, e
+// envia para a fila de renderização somente os visíveis.
+//
+// Objetos instanciados são agrupados por malha, material e nível de
+// detalhe; cada grupo ocupa um intervalo contíguo das instâncias do quadro
+// (veja "instancing.h") e é submetido como um único item, desenhado com uma chamada
+// glDrawElementsInstancedBaseVertex() (veja DrawInstancedObject()).
+//
+// O trabalho por objeto (teste contra o frustum, profundidade, nível de
+// detalhe e cópia das matrizes das instâncias) é dividido entre as threads
+// do sistema de tarefas (veja "parallel.h"). Somente a criação dos itens e
+// dos grupos é sequencial, para que a fila, os blocos de variáveis "uniform"
+// e as instâncias fiquem na mesma ordem com qualquer número de threads.
+void SubmitVisibleObjects() {
+    FrustumPlanes planes;
+    FrustumCull_ExtractPlanes(g_CameraProjection * g_CameraView, &planes);
+
+    size_t num_visible;
+    if (g_BvhCulling) {
+        Bvh_Sync(&g_SceneBvh, g_FrustumCullBatch);
+        num_visible = Bvh_CullBatch(g_SceneBvh, planes, &g_FrustumCullBatch);
+    } else {
+        num_visible = FrustumCull_Test(planes, &g_FrustumCullBatch);
+    }
+
+    g_FrameFrustumStats.num_objects = g_FrameObjects.size();
+    g_FrameFrustumStats.num_culled  = g_FrameObjects.size() - num_visible;
+
+    // Profundidade do centro da AABB de cada objeto visível no sistema de
+    // coordenadas da câmera, onde a câmera olha no sentido negativo do eixo
+    // Z, e nível de detalhe de cada objeto visível.
+    ParallelForRange(g_FrameObjects.size(), FRAME_TASK_SIZE, [](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (!g_FrustumCullBatch.visible[i]) {
+                continue;
+            }
+            FrameObject& frame_object = g_FrameObjects[i];
+
+            glm::vec4 center   = glm::vec4(g_FrustumCullBatch.center_x[i], g_FrustumCullBatch.center_y[i],
+                                           g_FrustumCullBatch.center_z[i], 1.0f);
+            frame_object.depth = -Matrix_Multiply_Vector(g_CameraView, center).z;
+
+            const SceneObject& object = *SlotMap_Get(&g_VirtualScene, frame_object.object);
+            frame_object.lod          = SelectLod(object, frame_object.model);
+        }
+    });
+
+    // Grupos de instâncias. O vetor é estático para reaproveitar a memória
+    // alocada nos quadros anteriores.
+    struct InstanceGroup {
+        SlotMapHandle object;
+        int           object_id;
+        size_t        lod;
+        float         depth;           // Profundidade da instância mais próxima da câmera
+        size_t        first_instance;  // Primeira instância do grupo no quadro
+        size_t        num_instances;
+    };
+    static std::vector<InstanceGroup> groups;
+    groups.clear();
+
+    for (size_t i = 0; i < g_FrameObjects.size(); ++i) {
+        if (!g_FrustumCullBatch.visible[i]) {
+            continue;
+        }
+        FrameObject& frame_object = g_FrameObjects[i];
+
+        if (!frame_object.instanced) {
+            const SceneObject& object = *SlotMap_Get(&g_VirtualScene, frame_object.object);
+            RenderItem         item   = MakeRenderItem(g_GpuProgramID, frame_object.object, frame_object.model,
+                                                       frame_object.object_id, frame_object.depth);
+
+            // Objetos pesados passam antes pelo teste de oclusão, exceto se
+            // a câmera estiver dentro da sua AABB (aumentada com folga
+            // maior do que a distância da câmera aos cantos do "near
+            // plane"). Veja "occlusion.h".
+            glm::vec3 center    = glm::vec3(g_FrustumCullBatch.center_x[i], g_FrustumCullBatch.center_y[i],
+                                            g_FrustumCullBatch.center_z[i]);
+            glm::vec3 extent    = glm::vec3(g_FrustumCullBatch.extent_x[i], g_FrustumCullBatch.extent_y[i],
+                                            g_FrustumCullBatch.extent_z[i]);
+            item.occlusion_test = g_OcclusionCulling && object.num_indices / 3 >= OCCLUSION_MIN_TRIANGLES &&
+                                  !Occlusion_CameraInsideBox(g_CameraPosition, center, extent, 0.2f);
+            item.lod = frame_object.lod;
+
+            RenderQueue_Submit(&g_RenderQueue, item);
+            continue;
+        }
+
+        size_t g = 0;
+        while (g < groups.size() &&
+               (groups[g].object != frame_object.object || groups[g].object_id != frame_object.object_id ||
+                groups[g].lod != frame_object.lod)) {
+            ++g;
+        }
+        if (g == groups.size()) {
+            InstanceGroup group = {frame_object.object, frame_object.object_id, frame_object.lod, frame_object.depth,
+                                   0, 0};
+            groups.push_back(group);
+        }
+        groups[g].depth       = std::min(groups[g].depth, frame_object.depth);
+        frame_object.group    = g;
+        frame_object.instance = groups[g].num_instances;
+        groups[g].num_instances += 1;
+    }
+
+    size_t num_instances = g_RecordFrame->instances.size();
+    for (InstanceGroup& group : groups) {
+        group.first_instance = num_instances;
+        num_instances += group.num_instances;
+
+        RenderItem item     = MakeRenderItem(g_InstancedGpuProgramID, group.object, Matrix_Identity(),
+                                             group.object_id, group.depth);
+        item.first_instance = group.first_instance;
+        item.num_instances  = group.num_instances;
+        item.lod            = group.lod;
+        RenderQueue_Submit(&g_RenderQueue, item);
+    }
+
+    // Com a posição de cada grupo conhecida, cada instância é copiada
+    // diretamente para o seu lugar.
+    g_RecordFrame->instances.resize(num_instances);
+    ParallelForRange(g_FrameObjects.size(), FRAME_TASK_SIZE, [](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const FrameObject& frame_object = g_FrameObjects[i];
+            if (g_FrustumCullBatch.visible[i] && frame_object.instanced) {
+                size_t index = groups[frame_object.group].first_instance + frame_object.instance;
+                InstanceData_Set(&g_RecordFrame->instances[index], Affine_FromMatrix(frame_object.model),
+                                 frame_object.object_id);
+            }
+        }
+    });
+}
+
+// Item da fila de renderização que desenha um objeto de g_VirtualScene com o
+// programa "program_id", a arena de geometria e as texturas da cena. As
+// variáveis "uniform" do objeto são gravadas no quadro atual (veja
+// "uniformbuffer.h"); o objeto já deve estar carregado.
+RenderItem MakeRenderItem(GLuint program_id, SlotMapHandle object_handle, const glm::mat4& model, int object_id,
+                          float depth) {
+    const SceneObject& object = *SlotMap_Get(&g_VirtualScene, object_handle);
+
+    // Parâmetros da axis-aligned bounding box (AABB) do modelo, usados pelo
+    // fragment shader, e variáveis que reconstroem a posição de vértices
+    // quantizados no vertex shader (veja GetPositionDequantization() em
+    // "mesh.h").
+    ObjectUniforms uniforms;
+    uniforms.model           = Affine_FromMatrix(model);
+    uniforms.bbox_min        = glm::vec4(object.bbox_min, 1.0f);
+    uniforms.bbox_max        = glm::vec4(object.bbox_max, 1.0f);
+    uniforms.position_offset = glm::vec4(object.position_offset, 0.0f);
+    uniforms.position_scale  = glm::vec4(object.position_scale, 0.0f);
+    uniforms.object_id       = object_id;
+
+    RenderItem item;
+    item.pass                   = RENDERQUEUE_PASS_OPAQUE;
+    item.program_id             = program_id;
+    item.vertex_array_object_id = g_GeometryArena.vertex_array_object_id;
+    for (int unit = 0; unit < RENDERQUEUE_MAX_TEXTURES; ++unit) {
+        item.textures[unit] = g_TextureImages[unit];
+    }
+    item.material = object_id;
+    item.depth    = depth;
+    item.object   = object_handle;
+    item.model    = model;
+
+    item.first_instance = 0;
+    item.num_instances  = 0;
+    item.lod            = 0;
+    item.uniform_block  = RenderFrame_AddUniformBlock(g_RecordFrame, uniforms);
+    item.occlusion_test = false;
+    return item;
+}
+
+// Submete a multidão do modo multidão (tecla M): g_CrowdSize objetos,
+// alternando entre coelhos e esferas, em uma grade centrada na origem sobre
+// o plano do chão.
+//
+// Com g_CrowdInstancing, as instâncias visíveis de cada objeto são
+// desenhadas com poucas chamadas glDrawElementsInstancedBaseVertex() (veja
+// SubmitVisibleObjects()). Sem, cada instância é desenhada como os demais
+// objetos da cena, custando um glBindBufferRange() e uma chamada
+// glDrawElementsBaseVertex() por objeto.
+void SubmitCrowd(SlotMapHandle bunny, SlotMapHandle sphere) {
+    const float spacing = 0.1f;   // Distância entre objetos vizinhos da grade
+    const float radius  = 0.04f;  // Metade da diagonal da AABB de cada objeto, após a escala
+
+    const SlotMapHandle handles[2]    = {bunny, sphere};
+    const int           object_ids[2] = {BUNNY, SPHERE};
+
+    // A multidão só aparece depois que as duas malhas forem carregadas, para
+    // que a posição de cada objeto em g_FrameObjects seja conhecida.
+    const SceneObject* objects[2];
+    float              scales[2];
+    for (int k = 0; k < 2; ++k) {
+        objects[k] = SlotMap_Get(&g_VirtualScene, handles[k]);
+        if (objects[k] == nullptr) {
+            return;
+        }
+        scales[k] = radius / (0.5f * glm::length(objects[k]->bbox_max - objects[k]->bbox_min));
+    }
+
+    const int   side  = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(g_CrowdSize))));
+    const float start = -0.5f * spacing * static_cast<float>(side - 1);
+
+    // Os objetos são definidos em paralelo, cada um na sua posição. Veja
+    // "parallel.h".
+    const size_t offset = g_FrameObjects.size();
+    g_FrameObjects.resize(offset + static_cast<size_t>(g_CrowdSize));
+    FrustumCull_Resize(&g_FrustumCullBatch, g_FrameObjects.size());
+
+    ParallelForRange(static_cast<size_t>(g_CrowdSize), FRAME_TASK_SIZE, [&](size_t first, size_t last) {
+        for (int i = static_cast<int>(first); i < static_cast<int>(last); ++i) {
+            int row    = i / side;
+            int column = i % side;
+            int k      = (row + column) % 2;  // Coelhos e esferas alternados, como em um tabuleiro de xadrez
+
+            // Apoiamos o objeto no plano do chão (y = -1.1), girando cada um
+            // de um ângulo diferente.
+            // A matriz de modelagem é construída diretamente, sem produtos
+            // de matrizes (veja Affine_TRS() em "matrices.h").
+            float        x     = start + spacing * static_cast<float>(column);
+            float        z     = start + spacing * static_cast<float>(row);
+            float        y     = -1.1f - scales[k] * objects[k]->bbox_min.y;
+            AffineMatrix model = Affine_TRS(glm::vec3(x, y, z), glm::vec3(0.0f, 2.4f * static_cast<float>(i), 0.0f),
+                                            glm::vec3(scales[k]));
+
+            SetFrameObject(offset + static_cast<size_t>(i), *objects[k], handles[k], Affine_ToMatrix(model),
+                           object_ids[k], g_CrowdInstancing);
+        }
+    });
+}
+
+// Imprime no terminal, a cada dois segundos, o tempo médio por quadro do modo
+// multidão. Assim podemos comparar como o tempo cresce com o número de
+// objetos, com e sem renderização instanciada (teclas N e I), e com e sem a
+// thread de renderização (tecla T). A latência é o tempo médio entre ler a
+// entrada e mostrar o quadro (veja RenderThreadStats em "renderthread.h").
+void ReportCrowdFrameTime() {
+    static double start_time = 0.0;
+    static int    num_frames = 0;
+    static int    size       = 0;
+    static bool   instancing = true;
+    static bool   threaded   = false;
+
+    double now = glfwGetTime();
+
+    // Recomeçamos a medição sempre que o modo muda.
+    if (g_CrowdSize != size || g_CrowdInstancing != instancing || g_RenderThread.running != threaded) {
+        size       = g_CrowdSize;
+        instancing = g_CrowdInstancing;
+        threaded   = g_RenderThread.running;
+        start_time = now;
+        num_frames = 0;
+        return;
+    }
+    if (size == 0) {
+        return;
+    }
+
+    num_frames += 1;
+    if (now - start_time >= 2.0) {
+        printf("Multidão de %d objetos (%s, %s): %.2f ms por quadro, latência %.2f ms, %d draws, %.1f milhões de "
+               "triângulos.\n",
+               size, instancing ? "instanciada" : "um objeto por vez",
+               threaded ? "com thread de renderização" : "sem thread de renderização",
+               1000.0 * (now - start_time) / num_frames, 1000.0 * g_RenderThread.stats.latency,
+               static_cast<int>(g_FrameDrawCalls), static_cast<double>(g_FrameTriangles) / 1e6);
+        start_time = now;
+        num_frames = 0;
+    }
+}
+
+// Grava o desenho de um item da fila de renderização. O programa, o VAO e as
+// texturas já foram ligados por RenderQueue_Record(), e as variáveis
+// específicas do objeto (inclusive o material) já estão gravadas no quadro;
+// aqui somente apontamos o bloco ObjectUniforms para elas (veja
+// "uniformbuffer.h").
+//
+// Itens com "occlusion_test" são desenhados somente se a sua AABB não estiver
+// escondida pelos objetos já desenhados (veja "occlusion.h" e
+// CommandList_BeginOcclusion()).
+void DrawRenderItem(const RenderItem& item) {
+    CommandList* commands = &g_RecordFrame->commands;
+    CommandList_BindUniformBlock(commands, item.uniform_block);
+
+    if (item.num_instances > 0) {
+        DrawInstancedObject(item);
+    } else if (item.occlusion_test) {
+        CommandList_BeginOcclusion(commands);
+        DrawVirtualObject(item.object, item.model, item.lod);
+        CommandList_EndOcclusion(commands);
+    } else {
+        DrawVirtualObject(item.object, item.model, item.lod);
+    }
+}
+
+// Grava o desenho, com uma única chamada, das instâncias [first_instance,
+// first_instance + num_instances) do quadro de um objeto, no nível de
+// detalhe "item.lod". A matriz de modelagem e o material de cada instância
+// vêm do buffer de instâncias, e não de variáveis "uniform".
+void DrawInstancedObject(const RenderItem& item) {
+    const SceneObject* object = SlotMap_Get(&g_VirtualScene, item.object);
+    if (object == nullptr) {
+        return;
+    }
+
+    const MeshLod& lod = object->lods[std::min(item.lod, object->lods.size() - 1)];
+    CommandList_DrawInstanced(&g_RecordFrame->commands, object->rendering_mode, lod.first_index, lod.num_indices,
+                              object->base_vertex, item.first_instance, item.num_instances);
+
+    g_FrameTriangles += lod.num_indices / 3 * item.num_instances;
+    g_FrameDrawCalls += 1;
+}
+
+// Função que grava o desenho de um objeto armazenado em g_VirtualScene, com a
+// matriz de modelagem "model" (que já deve estar no bloco ObjectUniforms), no
+// nível de detalhe "level" escolhido por SubmitVisibleObjects(). O programa e
+// o VAO da arena de geometria já devem estar "ligados" (veja
+// DrawRenderItem()). Veja definição dos objetos na função
+// AddMeshToVirtualScene().
+void DrawVirtualObject(SlotMapHandle object_handle, const glm::mat4& model, size_t level) {
+    // Objetos ainda sendo carregados (veja "assetloader.h") ou já removidos
+    // não são desenhados; eles aparecem assim que forem enviados para a GPU.
+    const SceneObject* found = SlotMap_Get(&g_VirtualScene, object_handle);
+    if (found == nullptr) {
+        return;
+    }
+    const SceneObject& object = *found;
+
+    // Pedimos para a GPU rasterizar os triângulos do objeto. Os índices são
+    // relativos ao primeiro vértice da malha dentro da arena, que é somado
+    // pela GPU; veja a documentação da função glDrawElementsBaseVertex() em
+    // http://docs.gl/gl3/glDrawElementsBaseVertex.
+    //
+    // Desenhamos somente os índices do nível de detalhe escolhido para o
+    // tamanho atual do objeto na tela. O objeto pode ter sido recarregado
+    // com menos níveis depois da escolha.
+    level              = std::min(level, object.lods.size() - 1);
+    const MeshLod& lod = object.lods[level];
+
+    if (level == 0 && g_ClusterCulling && !object.clusters.empty()) {
+        // Objetos divididos em grupos: desenhamos somente os intervalos de
+        // índices dos grupos que não foram descartados (veja "meshlet.h").
+        // Os intervalos são copiados para a lista de comandos.
+        static std::vector<GLsizei>     counts;
+        static std::vector<const void*> offsets;
+
+        size_t num_ranges = Meshlet_Cull(object.clusters.data(), object.clusters.size(), g_CameraView * model,
+                                         g_CameraProjection, &counts, &offsets, &g_FrameClusterStats);
+        if (num_ranges > 0) {
+            CommandList_DrawRanges(&g_RecordFrame->commands, object.rendering_mode, counts.data(), offsets.data(),
+                                   num_ranges, object.base_vertex);
+            g_FrameDrawCalls += 1;
+        }
+        for (GLsizei count : counts) {
+            g_FrameTriangles += count / 3;
+        }
+    } else {
+        CommandList_Draw(&g_RecordFrame->commands, object.rendering_mode, lod.first_index, lod.num_indices,
+                         object.base_vertex);
+
+        g_FrameTriangles += lod.num_indices / 3;
+        g_FrameDrawCalls += 1;
+    }
+}
+
+// Executa um quadro gravado pela thread principal: envia para a GPU as
+// variáveis "uniform" e as instâncias do quadro, executa a sua lista de
+// comandos e desenha o texto. Chamada somente pela thread com o contexto
+// OpenGL; a troca de buffers é feita depois, por RenderThread_ExecuteFrame().
+// Veja "renderthread.h".
+void ExecuteRenderFrame(RenderFrame* frame) {
+    // Indicamos que queremos renderizar em toda região do framebuffer. A
+    // função "glViewport" define o mapeamento das "normalized device
+    // coordinates" (NDC) para "pixel coordinates".  Essa é a operação de
+    // "Screen Mapping" ou "Viewport Mapping" vista em aula ({+ViewportMapping2+}).
+    glViewport(0, 0, frame->viewport_width, frame->viewport_height);
+
+    // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor é
+    // definida como coeficientes RGBA: Red, Green, Blue, Alpha; isto é:
+    // Vermelho, Verde, Azul, Alpha (valor de transparência).
+    // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminação.
+    //
+    //           R     G     B     A
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+
+    // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
+    // e também resetamos todos os pixels do Z-buffer (depth buffer).
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // As variáveis do quadro, as matrizes dos objetos instanciados e as
+    // variáveis de todos os objetos são enviadas de uma só vez, antes de
+    // desenharmos qualquer objeto.
+    FrameUniforms_Upload(g_FrameUniformBuffer, frame->frame_uniforms);
+    UniformRing_Begin(&g_UniformRing);
+    UniformRing_Upload(&g_UniformRing, frame->uniform_blocks.data(), frame->uniform_blocks.size());
+    InstanceBuffer_Upload(&g_InstanceBuffer, frame->instances.data(), frame->instances.size());
+    OcclusionQueries_Begin(&g_OcclusionQueries);
+
+    CommandList_Execute(frame->commands, g_UniformRing, g_InstanceBuffer, &g_OcclusionQueries,
+                        g_OcclusionGpuProgramID);
+    UniformRing_End(&g_UniformRing);
+
+    for (const RenderText& text : frame->texts) {
+        TextRendering_PrintStringInWindow(frame->window_width, frame->window_height, text.text, text.x, text.y,
+                                          text.scale);
+    }
+
+    frame->occlusion_stats = g_OcclusionQueries.stats;
 }
 
 // Função que carrega os shaders de vértices e de fragmentos que serão
@@ -559,33 +1403,54 @@ void LoadShadersFromFiles() {
     //       |
     //       o-- shader_fragment.glsl
     //
-    GLuint vertex_shader_id   = LoadShader_Vertex("../../src/shader_vertex.glsl");
-    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_fragment.glsl");
-
-    // Deletamos o programa de GPU anterior, caso ele exista.
+    // Deletamos os programas de GPU anteriores, caso eles existam.
     if (g_GpuProgramID != 0) glDeleteProgram(g_GpuProgramID);
+    if (g_InstancedGpuProgramID != 0) glDeleteProgram(g_InstancedGpuProgramID);
+    if (g_OcclusionGpuProgramID != 0) glDeleteProgram(g_OcclusionGpuProgramID);
+
+    // Os dois programas são compilados dos mesmos arquivos; o programa de
+    // objetos instanciados define INSTANCED no início dos shaders, lendo a
+    // matriz "model" e o "object_id" dos atributos de instância em vez de
+    // variáveis "uniform". Veja "instancing.h".
+    g_GpuProgramID          = LoadGpuProgram("");
+    g_InstancedGpuProgramID = LoadGpuProgram("#define INSTANCED\n");
+
+    // Programa das caixas desenhadas nos testes de oclusão (veja
+    // "occlusion.h").
+    g_OcclusionGpuProgramID = CreateGpuProgram(LoadShader_Vertex("../../src/shader_vertex_occlusion.glsl"),
+                                               LoadShader_Fragment("../../src/shader_fragment_occlusion.glsl"));
+    SetupUniformBlocks(g_OcclusionGpuProgramID);
+}
+
+// Cria um programa de GPU a partir de "shader_vertex.glsl" e
+// "shader_fragment.glsl", compilados com as definições "defines" (veja
+// LoadShader()).
+GLuint LoadGpuProgram(const char* defines) {
+    GLuint vertex_shader_id   = LoadShader_Vertex("../../src/shader_vertex.glsl", defines);
+    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_fragment.glsl", defines);
 
     // Criamos um programa de GPU utilizando os shaders carregados acima.
-    g_GpuProgramID = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
-
-    // Buscamos o endereço das variáveis definidas dentro do Vertex Shader.
-    // Utilizaremos estas variáveis para enviar dados para a placa de vídeo
-    // (GPU)! Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
-    g_model_uniform = glGetUniformLocation(g_GpuProgramID, "model");  // Variável da matriz "model"
-    g_view_uniform  = glGetUniformLocation(g_GpuProgramID, "view");  // Variável da matriz "view" em shader_vertex.glsl
-    g_projection_uniform =
-            glGetUniformLocation(g_GpuProgramID, "projection");  // Variável da matriz "projection" em shader_vertex.glsl
-    g_object_id_uniform =
-            glGetUniformLocation(g_GpuProgramID, "object_id");  // Variável "object_id" em shader_fragment.glsl
-    g_bbox_min_uniform = glGetUniformLocation(g_GpuProgramID, "bbox_min");
-    g_bbox_max_uniform = glGetUniformLocation(g_GpuProgramID, "bbox_max");
+    GLuint program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+
+    SetupUniformBlocks(program_id);
 
     // Variáveis em "shader_fragment.glsl" para acesso das imagens de textura
-    glUseProgram(g_GpuProgramID);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage0"), 0);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage1"), 1);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage2"), 2);
+    glUseProgram(program_id);
+    glUniform1i(glGetUniformLocation(program_id, "TextureImage0"), 0);
+    glUniform1i(glGetUniformLocation(program_id, "TextureImage1"), 1);
+    glUniform1i(glGetUniformLocation(program_id, "TextureImage2"), 2);
     glUseProgram(0);
+
+    return program_id;
+}
+
+// Liga os blocos de variáveis "uniform" definidos nos shaders aos buffers que
+// os armazenam. Em vez de buscar o endereço de cada variável, todos os
+// programas leem os mesmos buffers, nos mesmos pontos de ligação. Veja
+// "uniformbuffer.h".
+void SetupUniformBlocks(GLuint program_id) {
+    glUniformBlockBinding(program_id, glGetUniformBlockIndex(program_id, "FrameUniforms"), UNIFORM_BINDING_FRAME);
+    glUniformBlockBinding(program_id, glGetUniformBlockIndex(program_id, "ObjectUniforms"), UNIFORM_BINDING_OBJECT);
 }
 
 // Função que pega a matriz M e guarda a mesma no topo da pilha
@@ -602,8 +1467,9 @@ void PopMatrix(glm::mat4& M) {
 }
 
 // Função que computa as normais de um ObjModel, caso elas não tenham sido
-// especificadas dentro do arquivo ".obj"
-void ComputeNormals(ObjModel* model) {
+// especificadas dentro do arquivo ".obj". O tipo de peso dado a cada triângulo
+// é um dos NORMALS_WEIGHT_* (veja "normals.h").
+void ComputeNormals(ObjModel* model, int weighting) {
     if (!model->attrib.normals.empty()) {
         return;
     }
@@ -611,91 +1477,98 @@ void ComputeNormals(ObjModel* model) {
     // Primeiro computamos as normais para todos os TRIÂNGULOS.
     // Segundo, computamos as normais dos VÉRTICES através do método proposto
     // por Gouraud, onde a normal de cada vértice vai ser a média das normais de
-    // todas as faces que compartilham este vértice.
+    // todas as faces que compartilham este vértice. Veja ComputeVertexNormals().
 
     size_t num_vertices = model->attrib.vertices.size() / 3;
 
-    std::vector<int>       num_triangles_per_vertex(num_vertices, 0);
-    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
-
+    // Juntamos os índices de posição dos triângulos de todos os objetos. Como
+    // as normais são computadas por posição, cada canto usa como normal o
+    // mesmo índice da sua posição.
+    std::vector<uint32_t> indices;
     for (size_t shape = 0; shape < model->shapes.size(); ++shape) {
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
-
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle) {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
-
-            glm::vec4 vertices[3];
-            for (size_t vertex = 0; vertex < 3; ++vertex) {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3 * triangle + vertex];
-                const float      vx  = model->attrib.vertices[3 * idx.vertex_index + 0];
-                const float      vy  = model->attrib.vertices[3 * idx.vertex_index + 1];
-                const float      vz  = model->attrib.vertices[3 * idx.vertex_index + 2];
-                vertices[vertex]     = glm::vec4(vx, vy, vz, 1.0);
-            }
-
-            const glm::vec4 a = vertices[0];
-            const glm::vec4 b = vertices[1];
-            const glm::vec4 c = vertices[2];
+        tinyobj::mesh_t& mesh = model->shapes[shape].mesh;
+        assert(mesh.indices.size() == 3 * mesh.num_face_vertices.size());
 
-            const glm::vec4 n = crossproduct(b - a, c - a);
-
-            for (size_t vertex = 0; vertex < 3; ++vertex) {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3 * triangle + vertex];
-                num_triangles_per_vertex[idx.vertex_index] += 1;
-                vertex_normals[idx.vertex_index] += n;
-                model->shapes[shape].mesh.indices[3 * triangle + vertex].normal_index = idx.vertex_index;
-            }
+        for (tinyobj::index_t& idx : mesh.indices) {
+            indices.push_back(static_cast<uint32_t>(idx.vertex_index));
+            idx.normal_index = idx.vertex_index;
         }
     }
 
-    model->attrib.normals.resize(3 * num_vertices);
+    std::vector<float> x, y, z;
+    SplitPositions(model->attrib.vertices.data(), num_vertices, &x, &y, &z);
 
-    for (size_t i = 0; i < vertex_normals.size(); ++i) {
-        glm::vec4 n = vertex_normals[i] / static_cast<float>(num_triangles_per_vertex[i]);
-        n /= norm(n);
-        model->attrib.normals[3 * i + 0] = n.x;
-        model->attrib.normals[3 * i + 1] = n.y;
-        model->attrib.normals[3 * i + 2] = n.z;
-    }
+    std::vector<float> nx(num_vertices), ny(num_vertices), nz(num_vertices);
+    ComputeVertexNormals(x.data(), y.data(), z.data(), num_vertices, indices.data(), indices.size() / 3, weighting,
+                         nx.data(), ny.data(), nz.data());
+
+    InterleaveNormals(nx, ny, nz, &model->attrib.normals);
 }
 
-// Constrói triângulos para futura renderização a partir de um ObjModel.
-void BuildTrianglesAndAddToVirtualScene(ObjModel* model) {
-    GLuint vertex_array_object_id;
-    glGenVertexArrays(1, &vertex_array_object_id);
-    glBindVertexArray(vertex_array_object_id);
+// Constrói os arrays de vértices e índices de um ObjModel, prontos para
+// serem enviados para a GPU por AddMeshToVirtualScene().
+//
+// Cada canto de triângulo do ".obj" referencia uma posição, uma normal e uma
+// coordenada de textura (tinyobj::index_t). Cantos com os mesmos três índices
+// são o mesmo vértice, então guardamos cada combinação única somente uma vez
+// ("vertex welding") e geramos uma malha realmente indexada. Em malhas
+// fechadas isto reduz em ~3x o número de vértices enviados para a GPU e
+// processados pelo Vertex Shader, além de permitir que o cache de vértices
+// pós-transformação da GPU seja aproveitado.
+//
+// Os vértices não são compartilhados entre objetos (shapes) diferentes, para
+// que cada objeto ocupe um intervalo contíguo de vértices.
+void BuildTriangles(ObjModel* model, MeshData* mesh) {
+    std::vector<GLuint>& indices   = mesh->indices;
+    std::vector<float>&  positions = mesh->positions;
+    std::vector<float>&  normals   = mesh->normals;
+    std::vector<float>&  texcoords = mesh->texcoords;
+
+    // Tabela de vértices únicos do objeto atual: índice do vértice (dentro de
+    // positions[]) para cada combinação de índices do ".obj".
+    std::unordered_map<VertexKey, GLuint, VertexKeyHash> unique_vertices;
 
-    std::vector<GLuint> indices;
-    std::vector<float>  model_coefficients;
-    std::vector<float>  normal_coefficients;
-    std::vector<float>  texture_coefficients;
+    size_t num_corners = 0;
 
     for (size_t shape = 0; shape < model->shapes.size(); ++shape) {
         size_t first_index   = indices.size();
+        size_t first_vertex  = positions.size() / 3;
         size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
 
-        const float minval = std::numeric_limits<float>::min();
+        const float minval = std::numeric_limits<float>::lowest();
         const float maxval = std::numeric_limits<float>::max();
 
         glm::vec3 bbox_min = glm::vec3(maxval, maxval, maxval);
         glm::vec3 bbox_max = glm::vec3(minval, minval, minval);
 
+        unique_vertices.clear();
+        unique_vertices.reserve(3 * num_triangles);
+        num_corners += 3 * num_triangles;
+
         for (size_t triangle = 0; triangle < num_triangles; ++triangle) {
             assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
 
             for (size_t vertex = 0; vertex < 3; ++vertex) {
                 tinyobj::index_t idx = model->shapes[shape].mesh.indices[3 * triangle + vertex];
 
-                indices.push_back(first_index + 3 * triangle + vertex);
+                VertexKey key        = {idx.vertex_index, idx.normal_index, idx.texcoord_index};
+                auto      new_vertex = static_cast<GLuint>(positions.size() / 3);
+                auto      inserted   = unique_vertices.insert(std::make_pair(key, new_vertex));
+
+                indices.push_back(inserted.first->second);
+
+                // Vértice já visto: somente o índice é necessário.
+                if (!inserted.second) {
+                    continue;
+                }
 
                 const float vx = model->attrib.vertices[3 * idx.vertex_index + 0];
                 const float vy = model->attrib.vertices[3 * idx.vertex_index + 1];
                 const float vz = model->attrib.vertices[3 * idx.vertex_index + 2];
                 // printf("tri %d vert %d = (%.2f, %.2f, %.2f)\n", (int)triangle, (int)vertex, vx, vy, vz);
-                model_coefficients.push_back(vx);    // X
-                model_coefficients.push_back(vy);    // Y
-                model_coefficients.push_back(vz);    // Z
-                model_coefficients.push_back(1.0f);  // W
+                positions.push_back(vx);  // X
+                positions.push_back(vy);  // Y
+                positions.push_back(vz);  // Z
 
                 bbox_min.x = std::min(bbox_min.x, vx);
                 bbox_min.y = std::min(bbox_min.y, vy);
@@ -713,117 +1586,248 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model) {
                     const float nx = model->attrib.normals[3 * idx.normal_index + 0];
                     const float ny = model->attrib.normals[3 * idx.normal_index + 1];
                     const float nz = model->attrib.normals[3 * idx.normal_index + 2];
-                    normal_coefficients.push_back(nx);    // X
-                    normal_coefficients.push_back(ny);    // Y
-                    normal_coefficients.push_back(nz);    // Z
-                    normal_coefficients.push_back(0.0f);  // W
+                    normals.push_back(nx);  // X
+                    normals.push_back(ny);  // Y
+                    normals.push_back(nz);  // Z
                 }
 
                 if (idx.texcoord_index != -1) {
                     const float u = model->attrib.texcoords[2 * idx.texcoord_index + 0];
                     const float v = model->attrib.texcoords[2 * idx.texcoord_index + 1];
-                    texture_coefficients.push_back(u);
-                    texture_coefficients.push_back(v);
+                    texcoords.push_back(u);
+                    texcoords.push_back(v);
                 }
             }
         }
 
         size_t last_index = indices.size() - 1;
 
+        MeshObject theobject;
+        theobject.name          = model->shapes[shape].name;
+        theobject.first_index   = first_index;                   // Primeiro índice
+        theobject.num_indices   = last_index - first_index + 1;  // Número de indices
+        theobject.first_vertex  = first_vertex;
+        theobject.num_vertices  = positions.size() / 3 - first_vertex;
+        theobject.bbox_min      = bbox_min;
+        theobject.bbox_max      = bbox_max;
+        theobject.first_lod     = 0;
+        theobject.num_lods      = 0;
+        theobject.first_cluster = 0;
+        theobject.num_clusters  = 0;
+
+        mesh->objects.push_back(theobject);
+    }
+
+    printf("Malha indexada: %d vértices únicos para %d cantos de triângulos.\n",
+           static_cast<int>(positions.size() / 3), static_cast<int>(num_corners));
+}
+
+// Envia uma malha para a arena de geometria (veja "geometryarena.h") e
+// adiciona todos os seus objetos em g_VirtualScene. Os ponteiros da malha são
+// passados diretamente para glBufferSubData(), então eles podem apontar para
+// um arquivo mapeado em memória (veja "meshcache.h"). Caso já exista uma
+// malha com o mesmo nome, ela é substituída.
+void AddMeshToVirtualScene(const MeshView& mesh, const std::string& model_name) {
+    UnloadModelFromVirtualScene(model_name);
+
+    SceneModel scenemodel;
+    if (!GeometryArena_Upload(&g_GeometryArena, mesh, &scenemodel.allocation)) {
+        fprintf(stderr, "ERROR: Cannot add \"%s\" to the virtual scene.\n", model_name.c_str());
+        return;
+    }
+
+    // Os intervalos de índices da malha são deslocados para a posição em que
+    // ela foi colocada na arena; os índices em si continuam relativos ao
+    // primeiro vértice da malha (veja "base_vertex").
+    const size_t first_index = scenemodel.allocation.first_index;
+
+    for (size_t i = 0; i < mesh.num_objects; ++i) {
         SceneObject theobject;
-        theobject.name           = model->shapes[shape].name;
-        theobject.first_index    = first_index;                   // Primeiro índice
-        theobject.num_indices    = last_index - first_index + 1;  // Número de indices
+        theobject.name           = mesh.objects[i].name;
+        theobject.first_index    = first_index + mesh.objects[i].first_index;
+        theobject.num_indices    = mesh.objects[i].num_indices;
         theobject.rendering_mode = GL_TRIANGLES;  // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
-        theobject.vertex_array_object_id = vertex_array_object_id;
-
-        theobject.bbox_min = bbox_min;
-        theobject.bbox_max = bbox_max;
-
-        g_VirtualScene[model->shapes[shape].name] = theobject;
-    }
-
-    GLuint VBO_model_coefficients_id;
-    glGenBuffers(1, &VBO_model_coefficients_id);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), nullptr, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
-    GLuint location             = 0;  // "(location = 0)" em "shader_vertex.glsl"
-    GLint  number_of_dimensions = 4;  // vec4 em "shader_vertex.glsl"
-    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    if (!normal_coefficients.empty()) {
-        GLuint VBO_normal_coefficients_id;
-        glGenBuffers(1, &VBO_normal_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
-        location             = 1;  // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 4;  // vec4 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
-
-    if (!texture_coefficients.empty()) {
-        GLuint VBO_texture_coefficients_id;
-        glGenBuffers(1, &VBO_texture_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), nullptr, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
-        location             = 2;  // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 2;  // vec2 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
-
-    GLuint indices_id;
-    glGenBuffers(1, &indices_id);
-
-    // "Ligamos" o buffer. Note que o tipo agora é GL_ELEMENT_ARRAY_BUFFER.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // XXX Errado!
-    //
+        theobject.base_vertex    = static_cast<GLint>(scenemodel.allocation.base_vertex);
+
+        theobject.bbox_min = mesh.objects[i].bbox_min;
+        theobject.bbox_max = mesh.objects[i].bbox_max;
+
+        GetPositionDequantization(mesh.format, theobject.bbox_min, theobject.bbox_max, &theobject.position_offset,
+                                  &theobject.position_scale);
+
+        // Malhas sem níveis de detalhe (veja BuildMeshLods()) têm somente o
+        // nível 0, que é o objeto completo.
+        if (mesh.objects[i].num_lods > 0) {
+            const MeshLod* first = mesh.lods + mesh.objects[i].first_lod;
+            theobject.lods.assign(first, first + mesh.objects[i].num_lods);
+            for (MeshLod& lod : theobject.lods) {
+                lod.first_index += first_index;
+            }
+        } else {
+            MeshLod lod0 = {theobject.first_index, theobject.num_indices, 0.0f};
+            theobject.lods.push_back(lod0);
+        }
+
+        const MeshCluster* clusters = mesh.clusters + mesh.objects[i].first_cluster;
+        theobject.clusters.assign(clusters, clusters + mesh.objects[i].num_clusters);
+        for (MeshCluster& cluster : theobject.clusters) {
+            cluster.first_index += first_index;
+        }
+
+        // Um objeto com o mesmo nome, vindo de outro arquivo, é substituído.
+        auto previous = g_VirtualSceneNames.find(theobject.name);
+        if (previous != g_VirtualSceneNames.end()) {
+            SlotMap_Remove(&g_VirtualScene, previous->second);
+        }
+
+        SlotMapHandle handle                = SlotMap_Insert(&g_VirtualScene, theobject);
+        g_VirtualSceneNames[theobject.name] = handle;
+        scenemodel.objects.push_back(handle);
+    }
+
+    g_SceneModels[model_name] = scenemodel;
+}
+
+// Remove de g_VirtualScene os objetos de uma malha adicionada por
+// AddMeshToVirtualScene(), liberando o seu espaço na arena de geometria para
+// as próximas malhas.
+void UnloadModelFromVirtualScene(const std::string& model_name) {
+    auto it = g_SceneModels.find(model_name);
+    if (it == g_SceneModels.end()) {
+        return;
+    }
+
+    for (SlotMapHandle handle : it->second.objects) {
+        const SceneObject* object = SlotMap_Get(&g_VirtualScene, handle);
+        if (object == nullptr) {
+            continue;  // Já substituído por um objeto de mesmo nome de outro arquivo
+        }
+
+        g_VirtualSceneNames.erase(object->name);
+        SlotMap_Remove(&g_VirtualScene, handle);
+    }
+
+    GeometryArena_Free(&g_GeometryArena, it->second.allocation);
+    g_SceneModels.erase(it);
+}
+
+// Constrói triângulos para futura renderização a partir de um ObjModel.
+void BuildTrianglesAndAddToVirtualScene(ObjModel* model, const std::string& model_name) {
+    MeshData mesh;
+    BuildTriangles(model, &mesh);
+    OptimizeMesh(&mesh);
+    BuildMeshClusters(&mesh);
+    BuildMeshLods(&mesh);
+    PackVertices(&mesh, g_VertexFormat);
+    AddMeshToVirtualScene(MakeMeshView(mesh), model_name);
+}
+
+// Malha carregada por uma thread de trabalho, pronta para ser enviada para a
+// GPU: ou um cache binário mapeado em memória, ou uma MeshData construída a
+// partir do ".obj".
+struct LoadedMesh {
+    MeshCache cache;
+    MeshData  mesh;
+    bool      from_cache;
+
+    LoadedMesh() : from_cache(false) {}
+    ~LoadedMesh() {
+        if (from_cache) {
+            MeshCache_Close(&cache);
+        }
+    }
+
+    MeshView View() const {
+        return from_cache ? cache.view : MakeMeshView(mesh);
+    }
+};
+
+// Parte do carregamento de um ".obj" que não depende da GPU (executada por
+// uma thread de trabalho). Caso exista um cache binário válido para o
+// arquivo, ele é mapeado em memória; caso contrário, lemos o ".obj",
+// computamos as normais, construímos e otimizamos os triângulos (veja
+// "meshopt.h"), dividimos os objetos grandes em grupos (veja "meshlet.h"),
+// geramos os níveis de detalhe (veja "meshlod.h") e salvamos o cache para a próxima execução.
+void LoadObjModel(const std::string& filename, LoadedMesh* loaded) {
+    if (MeshCache_Open(filename, g_VertexFormat, g_NormalWeighting, &loaded->cache)) {
+        loaded->from_cache = true;
+        printf("Malha carregada do cache \"%s\" (%d objetos).\n", MeshCache_PathFor(filename).c_str(),
+               static_cast<int>(loaded->cache.view.num_objects));
+        return;
+    }
+
+    // Se o ".obj" já é uma malha indexada, ele é lido diretamente para os
+    // arrays da malha; caso contrário usamos ObjModel e BuildTriangles().
+    MeshData& mesh = loaded->mesh;
+    if (ObjParser_LoadMesh(filename, g_NormalWeighting, &mesh)) {
+        printf("Malha lida diretamente do arquivo \"%s\": %d vértices, %d objetos.\n", filename.c_str(),
+               static_cast<int>(mesh.positions.size() / 3), static_cast<int>(mesh.objects.size()));
+    } else {
+        mesh = MeshData();
+
+        ObjModel model(filename);
+        ComputeNormals(&model, g_NormalWeighting);
+        BuildTriangles(&model, &mesh);
+    }
 
-    // "Desligamos" o VAO, evitando assim que operações posteriores venham a
-    // alterar o mesmo. Isso evita bugs.
-    glBindVertexArray(0);
+    OptimizeMesh(&mesh);
+    BuildMeshClusters(&mesh);
+    BuildMeshLods(&mesh);
+    PackVertices(&mesh, g_VertexFormat);
+
+    if (!MeshCache_Write(filename, g_VertexFormat, g_NormalWeighting, mesh)) {
+        fprintf(stderr, "WARNING: Cannot write mesh cache \"%s\".\n", MeshCache_PathFor(filename).c_str());
+    }
+}
+
+// Carrega um arquivo ".obj" de forma assíncrona (veja "assetloader.h"). Seus
+// objetos são adicionados em g_VirtualScene quando estiverem prontos.
+void LoadObjModelToVirtualScene(const char* filename) {
+    std::string name = filename;
+
+    AssetLoader_Submit(&g_AssetLoader, [name]() -> AssetUpload {
+        std::shared_ptr<LoadedMesh> loaded(new LoadedMesh());
+        LoadObjModel(name, loaded.get());
+
+        return [loaded, name]() -> size_t {
+            MeshView view = loaded->View();
+            AddMeshToVirtualScene(view, name);
+            return view.num_vertices * view.format.stride + view.num_indices * sizeof(GLuint);
+        };
+    });
 }
 
 // Carrega um Vertex Shader de um arquivo GLSL. Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Vertex(const char* filename) {
+GLuint LoadShader_Vertex(const char* filename, const char* defines) {
     // Criamos um identificador (ID) para este shader, informando que o mesmo
     // será aplicado nos vértices.
     GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
 
     // Carregamos e compilamos o shader
-    LoadShader(filename, vertex_shader_id);
+    LoadShader(filename, vertex_shader_id, defines);
 
     // Retorna o ID gerado acima
     return vertex_shader_id;
 }
 
 // Carrega um Fragment Shader de um arquivo GLSL. Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Fragment(const char* filename) {
+GLuint LoadShader_Fragment(const char* filename, const char* defines) {
     // Criamos um identificador (ID) para este shader, informando que o mesmo
     // será aplicado nos fragmentos.
     GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
 
     // Carregamos e compilamos o shader
-    LoadShader(filename, fragment_shader_id);
+    LoadShader(filename, fragment_shader_id, defines);
 
     // Retorna o ID gerado acima
     return fragment_shader_id;
 }
 
 // Função auxiliar, utilizada pelas duas funções acima. Carrega código de GPU de
-// um arquivo GLSL e faz sua compilação.
-void LoadShader(const char* filename, GLuint shader_id) {
+// um arquivo GLSL e faz sua compilação. As definições "defines" (ex.:
+// "#define INSTANCED\n") são inseridas logo após a linha "#version", que
+// precisa ser a primeira do arquivo.
+void LoadShader(const char* filename, GLuint shader_id, const char* defines) {
     // Lemos o arquivo de texto indicado pela variável "filename"
     // e colocamos seu conteúdo em memória, apontado pela variável
     // "shader_string".
@@ -837,7 +1841,13 @@ void LoadShader(const char* filename, GLuint shader_id) {
     }
     std::stringstream shader;
     shader << file.rdbuf();
-    std::string   str                  = shader.str();
+    std::string str = shader.str();
+    if (defines[0] != '\0') {
+        // "#line 2" mantém os números de linha das mensagens de erro iguais
+        // aos do arquivo.
+        size_t end_of_version = str.find('\n') + 1;
+        str.insert(end_of_version, std::string(defines) + "#line 2\n");
+    }
     const GLchar* shader_string        = str.c_str();
     const auto    shader_string_length = static_cast<GLint>(str.length());
 
@@ -936,20 +1946,21 @@ GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id) {
 // operacional for redimensionada, por consequência alterando o tamanho do
 // "framebuffer" (região de memória onde são armazenados os pixels da imagem).
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height) {
-    // Indicamos que queremos renderizar em toda região do framebuffer. A
-    // função "glViewport" define o mapeamento das "normalized device
-    // coordinates" (NDC) para "pixel coordinates".  Essa é a operação de
-    // "Screen Mapping" ou "Viewport Mapping" vista em aula ({+ViewportMapping2+}).
-    glViewport(0, 0, width, height);
+    // Guardamos o tamanho do framebuffer para a chamada glViewport() de cada
+    // quadro, feita pela thread de renderização (veja ExecuteRenderFrame()).
+    g_FramebufferWidth  = width;
+    g_FramebufferHeight = height;
 
     // Atualizamos também a razão que define a proporção da janela (largura /
     // altura), a qual será utilizada na definição das matrizes de projeção,
     // tal que não ocorra distorções durante o processo de "Screen Mapping"
-    // acima, quando NDC é mapeado para coordenadas de pixels. Veja slides 205-215 do documento Aula_09_Projecoes.pdf.
+    // em ExecuteRenderFrame(), quando NDC é mapeado para coordenadas de pixels.
+    // Veja slides 205-215 do documento Aula_09_Projecoes.pdf.
     //
     // O cast para float é necessário, pois números inteiros são arredondados ao
     // serem divididos!
-    g_ScreenRatio = static_cast<float>(width) / static_cast<float>(height);
+    g_ScreenRatio  = static_cast<float>(width) / static_cast<float>(height);
+    g_ScreenHeight = static_cast<float>(height);
 }
 
 // Variáveis globais que armazenam a última posição do cursor do mouse, para
@@ -957,6 +1968,50 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height) {
 // de tempo. Utilizadas no callback CursorPosCallback() abaixo.
 double g_LastCursorPosX, g_LastCursorPosY;
 
+// Seleciona o objeto do último quadro sob o ponto (x, y) da janela, em
+// pixels: o primeiro objeto cuja AABB é atravessada pelo raio que sai do
+// "near plane" e vai até o "far plane" passando pelo ponto, encontrado com a
+// hierarquia de volumes envolventes (veja "bvh.h"). Imprime no terminal o
+// nome do objeto e quantos objetos estão próximos dele.
+void PickObject(GLFWwindow* window, double x, double y) {
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    // Coordenadas NDC do ponto; o eixo Y da janela aponta para baixo.
+    float ndc_x = static_cast<float>(2.0 * x / width - 1.0);
+    float ndc_y = static_cast<float>(1.0 - 2.0 * y / height);
+
+    // Pontos do raio no "near plane" e no "far plane", em coordenadas
+    // globais.
+    glm::mat4 inverse    = glm::inverse(g_CameraProjection * g_CameraView);
+    glm::vec4 near_point = inverse * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+    glm::vec4 far_point  = inverse * glm::vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+    glm::vec3 origin     = glm::vec3(near_point / near_point.w);
+    glm::vec3 direction  = glm::vec3(far_point / far_point.w) - origin;
+
+    Bvh_Sync(&g_SceneBvh, g_FrustumCullBatch);
+
+    float   t;
+    int32_t index = Bvh_Raycast(g_SceneBvh, origin, direction, 1.0f, &t);
+    if (index == BVH_NO_OBJECT) {
+        printf("Nenhum objeto selecionado.\n");
+        return;
+    }
+
+    const SceneObject* object = SlotMap_Get(&g_VirtualScene, g_FrameObjects[index].object);
+    glm::vec3          hit    = origin + t * direction;
+
+    std::vector<uint32_t> neighbors;
+    Bvh_QuerySphere(g_SceneBvh, hit, 0.5f, &neighbors);
+
+    printf("Objeto selecionado: %s (objeto %d do quadro), a %.2f do near plane; %d objetos a menos de 0.5 do ponto\n",
+           object != nullptr ? object->name.c_str() : "?", static_cast<int>(index), t * glm::length(direction),
+           static_cast<int>(neighbors.size()));
+}
+
 // Função callback chamada sempre que o usuário aperta algum dos botões do mouse
 void MouseButtonCallback(GLFWwindow* window, int button, int action, int /*mods*/) {
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
@@ -967,6 +2022,9 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int /*mods*
         // com o botão esquerdo pressionado.
         glfwGetCursorPos(window, &g_LastCursorPosX, &g_LastCursorPosY);
         g_LeftMouseButtonPressed = true;
+
+        // Também selecionamos o objeto sob o cursor.
+        PickObject(window, g_LastCursorPosX, g_LastCursorPosY);
     }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
         // Quando o usuário soltar o botão esquerdo do mouse, atualizamos a
@@ -1152,10 +2210,88 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
         g_ShowInfoText = !g_ShowInfoText;
     }
 
+    // Se o usuário apertar a tecla L, alternamos entre a escolha automática
+    // do nível de detalhe e cada um dos níveis fixos.
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        g_ForcedLod = g_ForcedLod + 1 < MESHLOD_MAX_LEVELS ? g_ForcedLod + 1 : -1;
+    }
+
+    // Se o usuário apertar a tecla K, dobramos o erro permitido (em pixels)
+    // na escolha automática do nível de detalhe; com shift+K, o reduzimos
+    // pela metade.
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+        g_LodPixelError *= (mod & GLFW_MOD_SHIFT) != 0 ? 0.5f : 2.0f;
+    }
+
+    // Se o usuário apertar a tecla C, ligamos ou desligamos o descarte de
+    // grupos de triângulos.
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        g_ClusterCulling = !g_ClusterCulling;
+    }
+
+    // Se o usuário apertar a tecla Q, ligamos ou desligamos o descarte de
+    // objetos escondidos por outros objetos.
+    if (key == GLFW_KEY_Q && action == GLFW_PRESS) {
+        g_OcclusionCulling = !g_OcclusionCulling;
+    }
+
+    // Se o usuário apertar a tecla M, ligamos ou desligamos o modo multidão.
+    // Enquanto ele estiver ligado, não esperamos a sincronização vertical
+    // (V-Sync) ao trocar os buffers, para que o tempo por quadro meça o custo
+    // real de desenhar a multidão. Veja SubmitCrowd(). A troca de buffers é
+    // feita pela thread de renderização, que aplica o novo intervalo.
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        g_CrowdSize    = g_CrowdSize > 0 ? 0 : 1000;
+        g_SwapInterval = g_CrowdSize > 0 ? 0 : 1;
+    }
+
+    // Se o usuário apertar a tecla N, multiplicamos o número de objetos da
+    // multidão por 10 (até um milhão); com shift+N, o dividimos por 10.
+    if (key == GLFW_KEY_N && action == GLFW_PRESS && g_CrowdSize > 0) {
+        if ((mod & GLFW_MOD_SHIFT) != 0) {
+            g_CrowdSize = std::max(g_CrowdSize / 10, 10);
+        } else {
+            g_CrowdSize = std::min(g_CrowdSize * 10, 1000000);
+        }
+    }
+
+    // Se o usuário apertar a tecla I, alternamos entre desenhar a multidão
+    // com renderização instanciada ou um objeto por vez.
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        g_CrowdInstancing = !g_CrowdInstancing;
+    }
+
+    // Se o usuário apertar a tecla T, ligamos ou desligamos a thread de
+    // renderização (veja "renderthread.h"). A mudança é feita no início do
+    // próximo quadro.
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        g_RenderThreadEnabled = !g_RenderThreadEnabled;
+    }
+
+    // Se o usuário apertar a tecla B, alternamos entre testar os objetos
+    // contra o frustum percorrendo a hierarquia de volumes envolventes ou
+    // testando todos eles (veja "bvh.h" e "frustumcull.h").
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        g_BvhCulling = !g_BvhCulling;
+    }
+
+    // Se o usuário apertar a tecla U, removemos o coelho da cena, liberando o
+    // seu espaço na arena de geometria, ou o carregamos novamente.
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        const char* filename = "../../data/bunny.obj";
+        if (g_SceneModels.count(filename) > 0) {
+            UnloadModelFromVirtualScene(filename);
+            GeometryArena_PrintStats(g_GeometryArena);
+        } else {
+            LoadObjModelToVirtualScene(filename);
+        }
+    }
+
     // Se o usuário apertar a tecla R, recarregamos os shaders dos arquivos "shader_fragment.glsl" e
-    // "shader_vertex.glsl".
+    // "shader_vertex.glsl". Os shaders são compilados pela thread com o
+    // contexto OpenGL, depois que ela executar os quadros já gravados.
     if (key == GLFW_KEY_R && action == GLFW_PRESS) {
-        LoadShadersFromFiles();
+        RenderThread_Call(&g_RenderThread, LoadShadersFromFiles);
         fprintf(stdout, "Shaders recarregados!\n");
         fflush(stdout);
     }
@@ -1208,9 +2344,7 @@ void TextRendering_ShowModelViewProjection(GLFWwindow* window, glm::mat4 project
     glm::vec2 p = glm::vec2(0, 0);
     glm::vec2 q = glm::vec2(width, height);
 
-    glm::mat4 viewport_mapping = Matrix((q.x - p.x) / (b.x - a.x), 0.0f, 0.0f, (b.x * p.x - a.x * q.x) / (b.x - a.x),
-                                        0.0f, (q.y - p.y) / (b.y - a.y), 0.0f, (b.y * p.y - a.y * q.y) / (b.y - a.y),
-                                        0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    glm::mat4 viewport_mapping = Matrix_Viewport(a, b, p, q);
 
     TextRendering_PrintString(window, "                                                       |  ", -1.0f,
                               1.0f - 22 * pad, 1.0f);
@@ -1236,7 +2370,7 @@ void TextRendering_ShowEulerAngles(GLFWwindow* window) {
     char buffer[80];
     snprintf(buffer, 80, "Euler Angles rotation matrix = Z(%.2f)*Y(%.2f)*X(%.2f)\n", angleZ_, angleY_, angleX_);
 
-    TextRendering_PrintString(window, buffer, -1.0f + pad / 10, -1.0f + 2 * pad / 10, 1.0f);
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + pad / 10, -1.0f + 2 * pad / 10, 1.0f);
 }
 
 // Escrevemos na tela qual matriz de projeção está sendo utilizada.
@@ -1249,9 +2383,9 @@ void TextRendering_ShowProjection(GLFWwindow* window) {
     float charwidth  = TextRendering_CharWidth(window);
 
     if (usePerspectiveProjection_) {
-        TextRendering_PrintString(window, "Perspective", 1.0f - 13 * charwidth, -1.0f + 2 * lineheight / 10, 1.0f);
+        RenderFrame_AddText(g_RecordFrame, "Perspective", 1.0f - 13 * charwidth, -1.0f + 2 * lineheight / 10, 1.0f);
     } else {
-        TextRendering_PrintString(window, "Orthographic", 1.0f - 13 * charwidth, -1.0f + 2 * lineheight / 10, 1.0f);
+        RenderFrame_AddText(g_RecordFrame, "Orthographic", 1.0f - 13 * charwidth, -1.0f + 2 * lineheight / 10, 1.0f);
     }
 }
 
@@ -1287,7 +2421,120 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window) {
     float lineheight = TextRendering_LineHeight(window);
     float charwidth  = TextRendering_CharWidth(window);
 
-    TextRendering_PrintString(window, buffer, 1.0f - (numchars + 1) * charwidth, 1.0f - lineheight, 1.0f);
+    RenderFrame_AddText(g_RecordFrame, buffer, 1.0f - (numchars + 1) * charwidth, 1.0f - lineheight, 1.0f);
+}
+
+// Escrevemos na tela o número de recursos (malhas e texturas) que ainda estão
+// sendo carregados em segundo plano.
+void TextRendering_ShowLoadingStatus(GLFWwindow* window) {
+    if (!g_ShowInfoText) {
+        return;
+    }
+
+    char buffer[40];
+    int  numchars = snprintf(buffer, 40, "Carregando: %d recursos",
+                             static_cast<int>(AssetLoader_NumPending(&g_AssetLoader)));
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth  = TextRendering_CharWidth(window);
+
+    RenderFrame_AddText(g_RecordFrame, buffer, 1.0f - (numchars + 1) * charwidth, 1.0f - 2 * lineheight, 1.0f);
+}
+
+// Escrevemos na tela o número de triângulos e de chamadas de desenho do
+// quadro atual, como o nível de detalhe dos objetos está sendo escolhido,
+// quantos grupos de triângulos foram descartados, a ocupação da arena de
+// geometria e as trocas de estado feitas pela fila de renderização.
+void TextRendering_ShowRenderStats(GLFWwindow* window) {
+    if (!g_ShowInfoText) {
+        return;
+    }
+
+    char lod[20];
+    if (g_ForcedLod >= 0) {
+        snprintf(lod, 20, "%d", g_ForcedLod);
+    } else {
+        snprintf(lod, 20, "auto (%.2g px)", g_LodPixelError);
+    }
+
+    char buffer[80];
+    snprintf(buffer, 80, "Triangulos: %d em %d draws, LOD: %s", static_cast<int>(g_FrameTriangles),
+             static_cast<int>(g_FrameDrawCalls), lod);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth  = TextRendering_CharWidth(window);
+
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - lineheight, 1.0f);
+
+    const MeshletCullStats& stats = g_FrameClusterStats;
+    if (!g_ClusterCulling) {
+        snprintf(buffer, 80, "Clusters: desligados");
+    } else if (stats.num_clusters > 0) {
+        snprintf(buffer, 80, "Clusters: %d/%d visiveis, %.0f%% dos triangulos descartados",
+                 static_cast<int>(stats.num_clusters - stats.num_frustum_culled - stats.num_backface_culled),
+                 static_cast<int>(stats.num_clusters), 100.0 * stats.num_culled_triangles / stats.num_triangles);
+    } else {
+        snprintf(buffer, 80, "Clusters: nenhum objeto dividido visivel");
+    }
+
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - 2 * lineheight, 1.0f);
+
+    // Ocupação da arena de geometria (vértices e índices) e fragmentação do
+    // seu espaço livre. Veja "geometryarena.h".
+    const GeometryArena& arena    = g_GeometryArena;
+    const double         mb       = 1.0 / (1024.0 * 1024.0);
+    const size_t         stride   = arena.format.stride;
+    double               used     = mb * (arena.vertices.used * stride + arena.indices.used * sizeof(GLuint));
+    double               capacity = mb * (arena.vertices.capacity * stride + arena.indices.capacity * sizeof(GLuint));
+    snprintf(buffer, 80, "Geometria: %.1f/%.1f MB, fragmentacao %.0f%%/%.0f%%", used, capacity,
+             100.0f * ArenaAllocator_Fragmentation(arena.vertices),
+             100.0f * ArenaAllocator_Fragmentation(arena.indices));
+
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - 3 * lineheight, 1.0f);
+
+    // Trocas de estado feitas pela fila de renderização. Veja "renderqueue.h".
+    const RenderQueueStats& queue = g_FrameRenderQueueStats;
+    snprintf(buffer, 80, "Trocas: %d programa, %d VAO, %d textura (%d evitadas)",
+             static_cast<int>(queue.program_switches), static_cast<int>(queue.vertex_array_switches),
+             static_cast<int>(queue.texture_switches), static_cast<int>(queue.elided_binds));
+
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - 4 * lineheight, 1.0f);
+
+    // Objetos descartados por estarem fora do frustum. Veja "frustumcull.h".
+    const FrustumCullStats& frustum = g_FrameFrustumStats;
+    snprintf(buffer, 80, "Frustum (%s): %d/%d objetos visiveis, %d descartados", g_BvhCulling ? "BVH" : "linear",
+             static_cast<int>(frustum.num_objects - frustum.num_culled), static_cast<int>(frustum.num_objects),
+             static_cast<int>(frustum.num_culled));
+
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - 5 * lineheight, 1.0f);
+
+    // Objetos pesados testados e escondidos por outros objetos. Os números são
+    // de alguns quadros atrás; veja "occlusion.h".
+    const OcclusionStats& occlusion = g_FrameOcclusionStats;
+    if (!g_OcclusionCulling) {
+        snprintf(buffer, 80, "Oclusao: desligada");
+    } else {
+        snprintf(buffer, 80, "Oclusao: %d/%d objetos testados escondidos", static_cast<int>(occlusion.num_occluded),
+                 static_cast<int>(occlusion.num_tested));
+    }
+
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - 6 * lineheight, 1.0f);
+
+    // Thread de renderização (tecla T), com o tempo por quadro e a latência
+    // médios dos últimos segundos. Veja "renderthread.h".
+    const RenderThreadStats& render = g_RenderThread.stats;
+    snprintf(buffer, 80, "Thread de renderizacao: %s, %.2f ms por quadro, latencia %.2f ms",
+             g_RenderThread.running ? "ligada" : "desligada", 1000.0 * render.frame_time, 1000.0 * render.latency);
+
+    RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - 7 * lineheight, 1.0f);
+
+    // Modo multidão (teclas M, N e I).
+    if (g_CrowdSize > 0) {
+        snprintf(buffer, 80, "Multidao: %d objetos, %s", g_CrowdSize,
+                 g_CrowdInstancing ? "instanciados" : "um por vez");
+
+        RenderFrame_AddText(g_RecordFrame, buffer, -1.0f + charwidth, 1.0f - 8 * lineheight, 1.0f);
+    }
 }
 
 // Função para debugging: imprime no terminal todas informações de um modelo
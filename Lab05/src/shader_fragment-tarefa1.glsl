@@ -13,20 +13,39 @@ in vec4 position_model;
 // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
 in vec2 texcoords;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-// Identificador que define qual objeto está sendo desenhado no momento
+// Variáveis computadas no código C++ e enviadas para a GPU em "uniform
+// blocks", com layout std140 (veja "uniformbuffer.h"). Os dois blocos são
+// declarados de forma idêntica em "shader_vertex.glsl".
+//
+// Variáveis que mudam uma vez por quadro:
+layout (std140) uniform FrameUniforms
+{
+    mat4  view;
+    mat4  projection;
+    vec4  camera_position;  // Posição da câmera em coordenadas globais
+    vec4  light_direction;  // Sentido da fonte de luz
+    float time;             // Tempo em segundos
+};
+
+// Variáveis de cada objeto. A posição é reconstruída como: posição =
+// position_offset + position_scale * atributo; veja
+// GetPositionDequantization() em "mesh.h".
+layout (std140) uniform ObjectUniforms
+{
+    mat3x4 model_matrix;
+    vec4   bbox_min;        // Axis-Aligned Bounding Box do objeto
+    vec4   bbox_max;
+    vec4   position_offset;
+    vec4   position_scale;
+    int    material;        // Identificador do objeto (SPHERE, BUNNY, ...)
+};
+
+// Identificador que define qual objeto está sendo desenhado no momento,
+// recebido de "shader_vertex.glsl".
 #define SPHERE 0
 #define BUNNY  1
 #define PLANE  2
-uniform int object_id;
-
-// Parâmetros da axis-aligned bounding box (AABB) do modelo
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
+flat in int object_id;
 
 // Variáveis para acesso das imagens de textura
 uniform sampler2D TextureImage0;
@@ -42,10 +61,9 @@ out vec4 color;
 
 void main()
 {
-    // Obtemos a posição da câmera utilizando a inversa da matriz que define o
-    // sistema de coordenadas da câmera.
-    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-    vec4 camera_position = inverse(view) * origin;
+    // A posição da câmera (camera_position) vem do bloco FrameUniforms: ela
+    // é computada uma única vez por quadro no código C++, e não em cada
+    // fragmento com a inversa da matriz "view".
 
     // O fragmento atual é coberto por um ponto que percente à superfície de um
     // dos objetos virtuais da cena. Este ponto, p, possui uma posição no
@@ -59,7 +77,7 @@ void main()
     vec4 n = normalize(normal);
 
     // Vetor que define o sentido da fonte de luz em relação ao ponto atual.
-    vec4 l = normalize(vec4(1.0,1.0,0.0,0.0));
+    vec4 l = normalize(light_direction);
 
     // Vetor que define o sentido da câmera em relação ao ponto atual.
     vec4 v = normalize(camera_position - p);
@@ -0,0 +1,11 @@
+#version 330 core
+
+// Fragment shader das caixas desenhadas nos testes de oclusão (veja
+// "occlusion.h"). A cor não é escrita no framebuffer (glColorMask()); a
+// consulta só conta se algum fragmento passou no teste de profundidade.
+out vec4 color;
+
+void main()
+{
+    color = vec4(1.0, 1.0, 1.0, 1.0);
+}
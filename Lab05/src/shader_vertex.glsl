@@ -1,15 +1,56 @@
 #version 330 core
 
 // Atributos de vértice recebidos como entrada ("in") pelo Vertex Shader.
-// Veja a função BuildTrianglesAndAddToVirtualScene() em "main.cpp".
-layout (location = 0) in vec4 model_coefficients;
-layout (location = 1) in vec4 normal_coefficients;
+// Veja a função AddMeshToVirtualScene() em "main.cpp" e VertexFormat em
+// "mesh.h". Dependendo do formato, a posição pode chegar quantizada em [0,1]
+// e a normal empacotada em 10 bits por coeficiente; em todos os casos o
+// coeficiente W não é armazenado e é reconstruído abaixo.
+layout (location = 0) in vec3 position_attribute;
+layout (location = 1) in vec4 normal_attribute;
 layout (location = 2) in vec2 texture_coefficients;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Variáveis computadas no código C++ e enviadas para a GPU em "uniform
+// blocks", com layout std140 (veja "uniformbuffer.h"). Os dois blocos são
+// declarados de forma idêntica em "shader_fragment.glsl".
+//
+// Variáveis que mudam uma vez por quadro:
+layout (std140) uniform FrameUniforms
+{
+    mat4  view;
+    mat4  projection;
+    vec4  camera_position;  // Posição da câmera em coordenadas globais
+    vec4  light_direction;  // Sentido da fonte de luz
+    float time;             // Tempo em segundos
+};
+
+// Variáveis de cada objeto. A posição é reconstruída como: posição =
+// position_offset + position_scale * atributo; veja
+// GetPositionDequantization() em "mesh.h".
+//
+// A matriz de modelagem é afim, e somente as suas três primeiras linhas são
+// enviadas, como as três colunas de uma mat3x4 (veja AffineMatrix em
+// "matrices.h"). Assim, o produto "M*p" da matriz 4x4 M por um ponto p é
+// escrito abaixo como "p * model_matrix", que resulta em um vec3.
+layout (std140) uniform ObjectUniforms
+{
+    mat3x4 model_matrix;
+    vec4   bbox_min;        // Axis-Aligned Bounding Box do objeto
+    vec4   bbox_max;
+    vec4   position_offset;
+    vec4   position_scale;
+    int    material;        // Identificador do objeto (SPHERE, BUNNY, ...)
+};
+
+// Este arquivo é compilado em duas variantes (veja LoadShadersFromFiles() em
+// "main.cpp"). Na variante INSTANCED, a matriz de modelagem e o
+// identificador do objeto são atributos de instância, que mudam a cada
+// instância desenhada em vez de a cada vértice (veja "instancing.h"); na
+// variante normal, eles vêm do bloco ObjectUniforms, um por chamada de
+// desenho.
+#ifdef INSTANCED
+layout (location = 3) in mat3x4 instance_model;      // Ocupa as posições 3, 4 e 5
+layout (location = 6) in int    instance_object_id;
+#endif
 
 // Atributos de vértice que serão gerados como saída ("out") pelo Vertex Shader.
 // ** Estes serão interpolados pelo rasterizador! ** gerando, assim, valores
@@ -19,9 +60,23 @@ out vec4 position_world;
 out vec4 position_model;
 out vec4 normal;
 out vec2 texcoords;
+flat out int object_id;
 
 void main()
 {
+#ifdef INSTANCED
+    mat3x4 model = instance_model;
+    object_id = instance_object_id;
+#else
+    mat3x4 model = model_matrix;
+    object_id = material;
+#endif
+
+    // Posição (W = 1, ponto) e normal (W = 0, vetor) do vértice em
+    // coordenadas locais do modelo.
+    vec4 model_coefficients = vec4(position_offset.xyz + position_scale.xyz * position_attribute, 1.0);
+    vec4 normal_coefficients = vec4(normal_attribute.xyz, 0.0);
+
     // A variável gl_Position define a posição final de cada vértice
     // OBRIGATORIAMENTE em "normalized device coordinates" (NDC), onde cada
     // coeficiente estará entre -1 e 1 após divisão por w.
@@ -34,7 +89,7 @@ void main()
     // deste Vertex Shader, a placa de vídeo (GPU) fará a divisão por W. Veja
     // slides 41-67 e 69-86 do documento Aula_09_Projecoes.pdf.
 
-    gl_Position = projection * view * model * model_coefficients;
+    gl_Position = projection * view * vec4(model_coefficients * model, 1.0);
 
     // Como as variáveis acima  (tipo vec4) são vetores com 4 coeficientes,
     // também é possível acessar e modificar cada coeficiente de maneira
@@ -51,15 +106,24 @@ void main()
     // rasterizador para gerar atributos únicos para cada fragmento gerado.
 
     // Posição do vértice atual no sistema de coordenadas global (World).
-    position_world = model * model_coefficients;
+    position_world = vec4(model_coefficients * model, 1.0);
 
     // Posição do vértice atual no sistema de coordenadas local do modelo.
     position_model = model_coefficients;
 
     // Normal do vértice atual no sistema de coordenadas global (World).
     // Veja slides 123-151 do documento Aula_07_Transformacoes_Geometricas_3D.pdf.
-    normal = inverse(transpose(model)) * normal_coefficients;
-    normal.w = 0.0;
+    //
+    // A normal é transformada pela inversa da transposta da parte linear A
+    // da matriz de modelagem. Em vez de inverter uma matriz 4x4 a cada
+    // vértice, calculamos A^-T diretamente: sendo r0, r1 e r2 as linhas de A
+    // (as colunas de "model"), as linhas de A^-T são r1 x r2, r2 x r0 e
+    // r0 x r1, divididas pelo determinante r0 . (r1 x r2).
+    vec3 r0 = model[0].xyz;
+    vec3 r1 = model[1].xyz;
+    vec3 r2 = model[2].xyz;
+    mat3 inverse_transpose_rows = mat3(cross(r1, r2), cross(r2, r0), cross(r0, r1));
+    normal = vec4((normal_coefficients.xyz * inverse_transpose_rows) / dot(r0, cross(r1, r2)), 0.0);
 
     // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
     texcoords = texture_coefficients;
@@ -0,0 +1,33 @@
+#version 330 core
+
+// Vertex shader das caixas desenhadas nos testes de oclusão (veja
+// "occlusion.h"). O atributo de entrada é um vértice do cubo [0,1]^3, que é
+// levado para a Axis-Aligned Bounding Box do objeto testado.
+layout (location = 0) in vec3 position_attribute;
+
+// Os mesmos blocos de variáveis "uniform" de "shader_vertex.glsl".
+layout (std140) uniform FrameUniforms
+{
+    mat4  view;
+    mat4  projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    float time;
+};
+
+layout (std140) uniform ObjectUniforms
+{
+    mat3x4 model_matrix;
+    vec4   bbox_min;
+    vec4   bbox_max;
+    vec4   position_offset;
+    vec4   position_scale;
+    int    material;
+};
+
+void main()
+{
+    vec3 position_model = mix(bbox_min.xyz, bbox_max.xyz, position_attribute);
+
+    gl_Position = projection * view * vec4(vec4(position_model, 1.0) * model_matrix, 1.0);
+}
@@ -140,14 +140,16 @@ void TextRendering_Init() {
 
 float textscale = 1.5f;
 
-void TextRendering_PrintString(GLFWwindow* window, const std::string& str, float x, float y, float scale = 1.0f) {
+// Como TextRendering_PrintString(), mas com o tamanho da janela informado por
+// quem chama. As funções de janela da GLFW só podem ser chamadas pela thread
+// principal; esta pode ser chamada por qualquer thread com o contexto OpenGL.
+void TextRendering_PrintStringInWindow(int width, int height, const char* str, float x, float y, float scale = 1.0f) {
     scale *= textscale;
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
     float sx = scale / static_cast<float>(width);
     float sy = scale / static_cast<float>(height);
 
-    for (char i : str) {
+    for (; *str != '\0'; ++str) {
+        char i = *str;
         // Find the glyph for the character we are looking for
         texture_glyph_t* glyph = nullptr;
         for (size_t j = 0; j < dejavufont.glyphs_count; ++j) {
@@ -199,6 +201,12 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string& str, float
     }
 }
 
+void TextRendering_PrintString(GLFWwindow* window, const std::string& str, float x, float y, float scale = 1.0f) {
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    TextRendering_PrintStringInWindow(width, height, str.c_str(), x, y, scale);
+}
+
 float TextRendering_LineHeight(GLFWwindow* window) {
     int width, height;
     glfwGetWindowSize(window, &width, &height);